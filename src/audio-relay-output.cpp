@@ -0,0 +1,386 @@
+#include "audio-relay-output.h"
+#include "flv-tags.h"
+#include "process-pipe.h"
+#include "ffmpeg-publish.h"
+#include <util/platform.h>
+#include <util/threading.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Audio the writer may fall behind by before the oldest is dropped
+#define AUDIO_RELAY_MAX_BUFFER_MS 5000
+
+static std::mutex ffmpegPathMutex;
+static std::string ffmpegPath = AUDIO_RELAY_DEFAULT_FFMPEG;
+
+struct QueuedTag {
+    std::vector<uint8_t> data;
+    int64_t timestampMs;
+};
+
+// Private data of a relay output instance
+struct AudioRelayData {
+    obs_output_t* output;
+    std::string url;
+    std::string key;
+
+    os_process_pipe_t* pipe;
+    std::string keyPath;
+    std::thread writer;
+
+    // Everything below is shared with the writer thread under mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<uint8_t> preamble;
+    std::deque<QueuedTag> queue;
+    bool writing;
+    bool stopping;
+    bool haveFirstPacket;
+    int64_t firstDtsUsec;
+
+    std::atomic<uint64_t> totalBytes;
+    std::atomic<int> droppedPackets;
+};
+
+// ============================================================================
+// Companion Process
+// ============================================================================
+
+std::string AudioRelayOutput::BuildCommand(const std::string& url, const std::string& key, std::string& keyPath) {
+    keyPath.clear();
+    if (!key.empty() && !WriteFfmpegKeyFile(key, keyPath)) {
+        blog(LOG_ERROR, "[multistream] Cannot write the stream key file for ffmpeg");
+        return std::string();
+    }
+
+    // Stream copy: ffmpeg only remuxes the FLV it reads into an RTMP publish
+    std::string command = BuildFfmpegPublishCommand(GetFfmpegPath(), url, keyPath);
+    if (command.empty()) {
+        RemoveFfmpegKeyFile(keyPath);
+    }
+    return command;
+}
+
+static void WriterThread(AudioRelayData* relay) {
+    os_set_thread_name("multistream-audio-relay");
+
+    BlockPipeSignals();
+
+    std::vector<uint8_t> data;
+    {
+        std::lock_guard<std::mutex> lock(relay->mutex);
+        data.swap(relay->preamble);
+    }
+
+    bool failed = false;
+    for (;;) {
+        if (!data.empty()) {
+            if (!WriteProcessPipe(relay->pipe, data)) {
+                failed = true;
+                break;
+            }
+            relay->totalBytes += data.size();
+            data.clear();
+
+            if (relay->totalBytes.load() > FFMPEG_KEY_FILE_READ_BYTES) {
+                RemoveFfmpegKeyFile(relay->keyPath);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(relay->mutex);
+        relay->wake.wait(lock, [relay] { return !relay->queue.empty() || relay->stopping; });
+        if (relay->queue.empty()) break;
+
+        data.swap(relay->queue.front().data);
+        relay->queue.pop_front();
+    }
+
+    int exitCode = CloseProcessPipe(relay->pipe);
+    RemoveFfmpegKeyFile(relay->keyPath);
+
+    bool stopRequested;
+    {
+        std::lock_guard<std::mutex> lock(relay->mutex);
+        relay->writing = false;
+        relay->queue.clear();
+        stopRequested = relay->stopping;
+    }
+
+    if (stopRequested) {
+        obs_output_end_data_capture(relay->output);
+        return;
+    }
+
+    if (failed) {
+        blog(LOG_WARNING, "[multistream] Audio relay to %s lost its ffmpeg process (exit code %d)", relay->url.c_str(),
+             exitCode);
+    }
+    obs_output_signal_stop(relay->output, OBS_OUTPUT_DISCONNECTED);
+}
+
+static void StopWriter(AudioRelayData* relay, bool discard) {
+    {
+        std::lock_guard<std::mutex> lock(relay->mutex);
+        relay->stopping = true;
+        if (discard) relay->queue.clear();
+    }
+    relay->wake.notify_one();
+}
+
+// ============================================================================
+// Output Type Callbacks
+// ============================================================================
+
+static const char* RelayGetName(void* typeData) {
+    UNUSED_PARAMETER(typeData);
+    return "Multistream Audio Relay";
+}
+
+static void RelayUpdate(void* data, obs_data_t* settings) {
+    AudioRelayData* relay = static_cast<AudioRelayData*>(data);
+    relay->url = obs_data_get_string(settings, "url");
+    relay->key = obs_data_get_string(settings, "key");
+}
+
+static void* RelayCreate(obs_data_t* settings, obs_output_t* output) {
+    AudioRelayData* relay = new AudioRelayData();
+    relay->output = output;
+    relay->pipe = nullptr;
+    relay->writing = false;
+    relay->stopping = false;
+    relay->haveFirstPacket = false;
+    relay->firstDtsUsec = 0;
+    relay->totalBytes = 0;
+    relay->droppedPackets = 0;
+
+    RelayUpdate(relay, settings);
+    return relay;
+}
+
+static void RelayDestroy(void* data) {
+    AudioRelayData* relay = static_cast<AudioRelayData*>(data);
+
+    StopWriter(relay, true);
+    if (relay->writer.joinable()) {
+        relay->writer.join();
+    }
+
+    delete relay;
+}
+
+static bool RelayStart(void* data) {
+    AudioRelayData* relay = static_cast<AudioRelayData*>(data);
+
+    // The previous connection's writer has finished by the time libobs
+    // reconnects, but still needs joining
+    if (relay->writer.joinable()) {
+        relay->writer.join();
+    }
+
+    if (!obs_output_can_begin_data_capture(relay->output, 0)) return false;
+    if (!obs_output_initialize_encoders(relay->output, 0)) return false;
+
+    obs_encoder_t* encoder = obs_output_get_audio_encoder(relay->output, 0);
+    const char* codec = encoder ? obs_encoder_get_codec(encoder) : nullptr;
+    uint8_t* sequenceHeader = nullptr;
+    size_t sequenceHeaderSize = 0;
+
+    if (!codec || strcmp(codec, "aac") != 0 ||
+        !obs_encoder_get_extra_data(encoder, &sequenceHeader, &sequenceHeaderSize)) {
+        blog(LOG_ERROR, "[multistream] Audio relay needs an AAC encoder");
+        return false;
+    }
+
+    std::string command = AudioRelayOutput::BuildCommand(relay->url, relay->key, relay->keyPath);
+    if (command.empty()) {
+        blog(LOG_ERROR, "[multistream] Audio relay URL or ffmpeg path contains unsupported characters");
+        return false;
+    }
+
+    relay->pipe = os_process_pipe_create(command.c_str(), "w");
+    if (!relay->pipe) {
+        blog(LOG_ERROR, "[multistream] Failed to run %s for the audio relay", AudioRelayOutput::GetFfmpegPath().c_str());
+        RemoveFfmpegKeyFile(relay->keyPath);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(relay->mutex);
+        relay->preamble.clear();
+        AppendFlvPreamble(relay->preamble, nullptr, 0, sequenceHeader, sequenceHeaderSize);
+        relay->queue.clear();
+        relay->writing = true;
+        relay->stopping = false;
+        relay->haveFirstPacket = false;
+    }
+
+    relay->totalBytes = 0;
+    relay->droppedPackets = 0;
+    relay->writer = std::thread(WriterThread, relay);
+
+    if (!obs_output_begin_data_capture(relay->output, 0)) {
+        StopWriter(relay, true);
+        relay->writer.join();
+        return false;
+    }
+
+    return true;
+}
+
+static void RelayStop(void* data, uint64_t ts) {
+    AudioRelayData* relay = static_cast<AudioRelayData*>(data);
+
+    bool writing;
+    {
+        std::lock_guard<std::mutex> lock(relay->mutex);
+        writing = relay->writing;
+    }
+
+    // Between reconnect attempts there is nothing to flush
+    if (!writing) {
+        obs_output_end_data_capture(relay->output);
+        return;
+    }
+
+    // A force stop (ts == 0) drops what ffmpeg has not taken yet
+    StopWriter(relay, ts == 0);
+}
+
+static void RelayEncodedPacket(void* data, struct encoder_packet* packet) {
+    AudioRelayData* relay = static_cast<AudioRelayData*>(data);
+
+    if (!packet) {
+        obs_output_signal_stop(relay->output, OBS_OUTPUT_ENCODE_ERROR);
+        return;
+    }
+
+    if (packet->type != OBS_ENCODER_AUDIO) return;
+
+    std::unique_lock<std::mutex> lock(relay->mutex);
+    if (relay->stopping || !relay->writing) return;
+
+    if (!relay->haveFirstPacket) {
+        relay->firstDtsUsec = packet->dts_usec;
+        relay->haveFirstPacket = true;
+    }
+
+    int64_t timestampMs = (packet->dts_usec - relay->firstDtsUsec) / 1000;
+    if (timestampMs < 0) timestampMs = 0;
+
+    QueuedTag tag;
+    tag.timestampMs = timestampMs;
+    AppendAudioTag(tag.data, (uint32_t)timestampMs, FLV_AAC_RAW, packet->data, packet->size);
+    relay->queue.push_back(std::move(tag));
+
+    // The ingest is not keeping up; old audio is worth less than new
+    while (relay->queue.size() > 1 &&
+           relay->queue.back().timestampMs - relay->queue.front().timestampMs > AUDIO_RELAY_MAX_BUFFER_MS) {
+        relay->queue.pop_front();
+        relay->droppedPackets++;
+    }
+
+    lock.unlock();
+    relay->wake.notify_one();
+}
+
+static uint64_t RelayGetTotalBytes(void* data) {
+    return static_cast<AudioRelayData*>(data)->totalBytes.load();
+}
+
+static int RelayGetDroppedFrames(void* data) {
+    return static_cast<AudioRelayData*>(data)->droppedPackets.load();
+}
+
+static float RelayGetCongestion(void* data) {
+    AudioRelayData* relay = static_cast<AudioRelayData*>(data);
+    std::lock_guard<std::mutex> lock(relay->mutex);
+
+    if (relay->queue.size() < 2) return 0.0f;
+
+    int64_t bufferedMs = relay->queue.back().timestampMs - relay->queue.front().timestampMs;
+    return std::min(1.0f, (float)bufferedMs / AUDIO_RELAY_MAX_BUFFER_MS);
+}
+
+// ============================================================================
+// AudioRelayOutput
+// ============================================================================
+
+void AudioRelayOutput::RegisterOutputType() {
+    struct obs_output_info info = {};
+    info.id = AUDIO_RELAY_OUTPUT_ID;
+    info.flags = OBS_OUTPUT_AUDIO | OBS_OUTPUT_ENCODED;
+    info.encoded_audio_codecs = "aac";
+    info.get_name = RelayGetName;
+    info.create = RelayCreate;
+    info.destroy = RelayDestroy;
+    info.update = RelayUpdate;
+    info.start = RelayStart;
+    info.stop = RelayStop;
+    info.encoded_packet = RelayEncodedPacket;
+    info.get_total_bytes = RelayGetTotalBytes;
+    info.get_dropped_frames = RelayGetDroppedFrames;
+    info.get_congestion = RelayGetCongestion;
+    obs_register_output(&info);
+}
+
+obs_output_t* AudioRelayOutput::Create(const char* name, const std::string& url, const std::string& key) {
+    obs_data_t* settings = obs_data_create();
+    obs_data_set_string(settings, "url", url.c_str());
+    obs_data_set_string(settings, "key", key.c_str());
+
+    obs_output_t* output = obs_output_create(AUDIO_RELAY_OUTPUT_ID, name, settings, nullptr);
+    obs_data_release(settings);
+
+    if (!output) {
+        blog(LOG_ERROR, "[multistream] Failed to create audio relay output");
+    }
+
+    return output;
+}
+
+void AudioRelayOutput::SetFfmpegPath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(ffmpegPathMutex);
+    ffmpegPath = path.empty() ? AUDIO_RELAY_DEFAULT_FFMPEG : path;
+}
+
+std::string AudioRelayOutput::GetFfmpegPath() {
+    std::lock_guard<std::mutex> lock(ffmpegPathMutex);
+    return ffmpegPath;
+}
+
+bool AudioRelayOutput::HasFfmpeg() {
+    std::string path = GetFfmpegPath();
+    if (path.find_first_of("/\\") != std::string::npos) {
+        return os_file_exists(path.c_str());
+    }
+
+#ifdef _WIN32
+    const char separator = ';';
+    if (path.size() < 4 || path.compare(path.size() - 4, 4, ".exe") != 0) path += ".exe";
+#else
+    const char separator = ':';
+#endif
+
+    // A bare name runs whatever PATH finds first
+    const char* searchPath = getenv("PATH");
+    std::string directories = searchPath ? searchPath : "";
+    size_t start = 0;
+    while (start <= directories.size()) {
+        size_t end = directories.find(separator, start);
+        if (end == std::string::npos) end = directories.size();
+
+        std::string directory = directories.substr(start, end - start);
+        if (!directory.empty() && os_file_exists((directory + "/" + path).c_str())) {
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
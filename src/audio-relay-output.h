@@ -0,0 +1,44 @@
+#pragma once
+
+#include <obs.h>
+#include <string>
+
+#define AUDIO_RELAY_OUTPUT_ID "multistream_audio_relay"
+
+// Companion process that publishes the relay's FLV stream (ffmpeg 7.0 or
+// newer), found next to the plugin or on PATH unless configured
+#define AUDIO_RELAY_DEFAULT_FFMPEG "ffmpeg"
+
+// Audio-only RTMP output for destinations that carry no picture, such as
+// radio simulcasts and podcast ingests.
+//
+// rtmp_output is an audio+video output and will not start without a video
+// encoder, so audio-only destinations use this plugin-registered encoded
+// output instead. It takes AAC packets from the destination's audio encoder,
+// muxes them into an audio-only FLV stream and pipes that to an ffmpeg
+// process, which publishes it with stream copy (no re-encoding). Packets are
+// handed to a writer thread so a slow ingest never blocks the encoder thread;
+// the queue is bounded and sheds its oldest audio when the ingest falls
+// behind. When ffmpeg exits the output reports a disconnect and libobs's
+// reconnect logic starts a new one.
+class AudioRelayOutput {
+public:
+    // Register the relay output type with libobs, from obs_module_load
+    static void RegisterOutputType();
+
+    // Create a relay publishing to url with the given stream key
+    static obs_output_t* Create(const char* name, const std::string& url, const std::string& key);
+
+    // ffmpeg executable used by relays started from now on
+    static void SetFfmpegPath(const std::string& path);
+    static std::string GetFfmpegPath();
+
+    // Whether the ffmpeg path names an existing file, directly or on PATH
+    static bool HasFfmpeg();
+
+    // ffmpeg command line that publishes the FLV stream on its stdin to url
+    // with stream copy, see ffmpeg-publish.h. The key goes into a new file,
+    // returned in keyPath, for the caller to remove once ffmpeg has read it.
+    // Empty if the command cannot be built. Shared with DelayRelayOutput.
+    static std::string BuildCommand(const std::string& url, const std::string& key, std::string& keyPath);
+};
@@ -0,0 +1,632 @@
+#include "delay-buffer.h"
+#include "packet-tap.h"
+#include <obs-avc.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Ring space beyond the delay, for readers that fall behind
+#define DELAY_BUFFER_HEADROOM_SEC 30
+
+// Smallest ring worth creating
+#define DELAY_BUFFER_MIN_BYTES (64ULL * 1024 * 1024)
+
+// Packets the writer thread may fall behind by before the newest are dropped
+#define DELAY_BUFFER_MAX_QUEUE_BYTES (32 * 1024 * 1024)
+
+#define DELAY_RECORD_PAD 0
+#define DELAY_RECORD_VIDEO 1
+#define DELAY_RECORD_AUDIO 2
+
+// Precedes each packet in the ring. Records are 8-byte aligned and never
+// wrap: the writer pads to the end of the ring instead, with a pad record
+// if there is room for one.
+struct DelayRecordHeader {
+    uint32_t size;
+    uint8_t type;
+    uint8_t keyframe;
+    uint16_t reserved;
+    int32_t timebaseNum;
+    int32_t timebaseDen;
+    int64_t pts;
+    int64_t dts;
+    int64_t dtsUsec;
+    uint64_t receivedNs;
+};
+
+static uint64_t RecordSize(uint64_t payloadSize) {
+    return (sizeof(DelayRecordHeader) + payloadSize + 7) & ~7ULL;
+}
+
+// Static members
+std::mutex DelayBuffer::buffersMutex;
+std::vector<DelayBuffer*> DelayBuffer::buffers;
+std::string DelayBuffer::directory;
+
+// ============================================================================
+// Buffer Registry
+// ============================================================================
+
+void DelayBuffer::SetDirectory(const std::string& newDirectory) {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    directory = newDirectory;
+}
+
+std::string DelayBuffer::GetDirectory() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    return directory;
+}
+
+int DelayBuffer::ClampDelay(int delaySec) {
+    if (delaySec <= 0) return 0;
+    return std::min(DELAY_BUFFER_MAX_SEC, std::max(DELAY_BUFFER_MIN_SEC, delaySec));
+}
+
+DelayBuffer* DelayBuffer::Acquire(obs_encoder_t* videoEncoder, obs_encoder_t* audioEncoder, int delaySec,
+                                  int expectedKbps) {
+    if (!videoEncoder || delaySec <= 0) return nullptr;
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+
+    for (auto* buffer : buffers) {
+        if (buffer->videoEncoder == videoEncoder && buffer->audioEncoder == audioEncoder &&
+            buffer->delaySec == delaySec) {
+            buffer->refCount++;
+            return buffer;
+        }
+    }
+
+    DelayBuffer* buffer = new DelayBuffer(videoEncoder, audioEncoder, delaySec);
+    if (!buffer->Start(expectedKbps)) {
+        delete buffer;
+        return nullptr;
+    }
+
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+void DelayBuffer::Release(DelayBuffer* buffer) {
+    if (!buffer) return;
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+
+    if (--buffer->refCount > 0) return;
+
+    buffers.erase(std::remove(buffers.begin(), buffers.end(), buffer), buffers.end());
+    buffer->LogSummary();
+    delete buffer;
+}
+
+void DelayBuffer::Retain(DelayBuffer* buffer) {
+    if (!buffer) return;
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffer->refCount++;
+}
+
+DelayReader* DelayBuffer::CreateReader() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    refCount++;
+    return new DelayReader(this);
+}
+
+// ============================================================================
+// DelayBuffer Implementation
+// ============================================================================
+
+DelayBuffer::DelayBuffer(obs_encoder_t* video, obs_encoder_t* audio, int delay)
+    : videoEncoder(video), audioEncoder(audio), delaySec(delay), delayNs((uint64_t)delay * 1000000000ULL),
+      refCount(1), convertAvc(false), tap(nullptr), capacity(0),
+#ifdef _WIN32
+      fileHandle(nullptr), mappingHandle(nullptr),
+#else
+      fd(-1),
+#endif
+      queuedBytes(0), maxQueuedBytes(0), needKeyframe(true), stopping(false), writePosition(0), head(0), tail(0),
+      packetsWritten(0), droppedPackets(0), lappedReads(0) {
+}
+
+DelayBuffer::~DelayBuffer() {
+    Stop();
+}
+
+int DelayBuffer::GetDelaySec() const {
+    return delaySec;
+}
+
+bool DelayBuffer::Start(int expectedKbps) {
+    if (directory.empty()) {
+        blog(LOG_ERROR, "[multistream] No directory configured for delay buffers");
+        return false;
+    }
+
+    // Twice the expected bytes covers keyframe and VBR peaks
+    uint64_t size = (uint64_t)std::max(expectedKbps, 1) * 125 * (delaySec + DELAY_BUFFER_HEADROOM_SEC) * 2;
+    size = std::max<uint64_t>(size, DELAY_BUFFER_MIN_BYTES);
+    size = (size + DELAY_BUFFER_WINDOW_BYTES - 1) / DELAY_BUFFER_WINDOW_BYTES * DELAY_BUFFER_WINDOW_BYTES;
+
+    static uint32_t fileCounter = 0;
+    os_mkdirs(directory.c_str());
+    path = directory + "/delay-" + std::to_string(delaySec) + "s-" + std::to_string(++fileCounter) + ".ring";
+
+    if (!OpenFile(size)) {
+        blog(LOG_ERROR, "[multistream] Failed to create delay buffer file %s", path.c_str());
+        return false;
+    }
+    capacity = size;
+
+    // FLV carries H.264 as AVCC; converting once here saves every reader the work
+    const char* codec = obs_encoder_get_codec(videoEncoder);
+    convertAvc = codec && strcmp(codec, "h264") == 0;
+
+    writer = std::thread(&DelayBuffer::WriterThread, this);
+
+    tap = PacketTap::Acquire(videoEncoder, audioEncoder);
+    if (!tap) {
+        blog(LOG_ERROR, "[multistream] Delay buffer has no packet tap");
+        return false;
+    }
+    tap->AddCallback(OnTapPacket, this);
+
+    blog(LOG_INFO, "[multistream] Delaying by %d s through %s (%llu MB ring, %d MB mapped per window)", delaySec,
+         path.c_str(), (unsigned long long)(capacity / (1024 * 1024)), DELAY_BUFFER_WINDOW_BYTES / (1024 * 1024));
+    return true;
+}
+
+void DelayBuffer::Stop() {
+    if (tap) {
+        tap->RemoveCallback(OnTapPacket, this);
+        PacketTap::Release(tap);
+        tap = nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueWake.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    for (auto& queued : queue) {
+        obs_encoder_packet_release(&queued.packet);
+    }
+    queue.clear();
+    queuedBytes = 0;
+
+    UnmapWindow(writeWindow);
+    CloseFile();
+}
+
+void DelayBuffer::LogSummary() {
+    blog(LOG_INFO,
+         "[multistream] Delay buffer %d s: %llu packet(s) through a %llu MB ring, %llu dropped, %llu lapped read(s), "
+         "writer queue peaked at %llu KB",
+         delaySec, (unsigned long long)packetsWritten.load(), (unsigned long long)(capacity / (1024 * 1024)),
+         (unsigned long long)droppedPackets.load(), (unsigned long long)lappedReads.load(),
+         (unsigned long long)(maxQueuedBytes / 1024));
+}
+
+void DelayBuffer::OnTapPacket(void* data, struct encoder_packet* packet, uint64_t receivedNs) {
+    DelayBuffer* buffer = static_cast<DelayBuffer*>(data);
+
+    {
+        std::lock_guard<std::mutex> lock(buffer->queueMutex);
+        if (buffer->stopping) return;
+
+        bool video = packet->type == OBS_ENCODER_VIDEO;
+        if (video && packet->keyframe) {
+            buffer->needKeyframe = false;
+        }
+
+        bool full = buffer->queuedBytes + packet->size > DELAY_BUFFER_MAX_QUEUE_BYTES ||
+                    RecordSize(packet->size) > buffer->capacity / 4;
+        if (full || (video && buffer->needKeyframe)) {
+            // Recording resumes at the next keyframe, so readers never see
+            // frames that reference a dropped one
+            if (video) buffer->needKeyframe = true;
+            buffer->droppedPackets++;
+            return;
+        }
+
+        QueuedPacket queued;
+        obs_encoder_packet_ref(&queued.packet, packet);
+        queued.receivedNs = receivedNs;
+        buffer->queue.push_back(queued);
+        buffer->queuedBytes += packet->size;
+        buffer->maxQueuedBytes = std::max(buffer->maxQueuedBytes, buffer->queuedBytes);
+    }
+
+    buffer->queueWake.notify_one();
+}
+
+void DelayBuffer::WriterThread() {
+    os_set_thread_name("multistream-delay-buffer");
+
+    for (;;) {
+        QueuedPacket queued;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueWake.wait(lock, [this] { return !queue.empty() || stopping; });
+            if (stopping) break;
+
+            queued = queue.front();
+            queue.pop_front();
+            queuedBytes -= queued.packet.size;
+        }
+
+        Append(&queued.packet, queued.receivedNs);
+        obs_encoder_packet_release(&queued.packet);
+    }
+}
+
+void DelayBuffer::Append(struct encoder_packet* packet, uint64_t receivedNs) {
+    bool video = packet->type == OBS_ENCODER_VIDEO;
+
+    struct encoder_packet converted = {};
+    struct encoder_packet* source = packet;
+    if (video && convertAvc) {
+        obs_parse_avc_packet(&converted, packet);
+        source = &converted;
+    }
+
+    DelayRecordHeader header = {};
+    header.size = (uint32_t)source->size;
+    header.type = video ? DELAY_RECORD_VIDEO : DELAY_RECORD_AUDIO;
+    header.keyframe = packet->keyframe ? 1 : 0;
+    header.timebaseNum = packet->timebase_num;
+    header.timebaseDen = packet->timebase_den;
+    header.pts = packet->pts;
+    header.dts = packet->dts;
+    header.dtsUsec = packet->dts_usec;
+    header.receivedNs = receivedNs;
+
+    uint64_t recordSize = RecordSize(header.size);
+    uint64_t remaining = capacity - writePosition % capacity;
+    uint64_t start = remaining < recordSize ? writePosition + remaining : writePosition;
+    uint64_t end = start + recordSize;
+
+    // Claim the space before touching it, so readers can tell a torn copy
+    if (end > capacity) {
+        tail.store(end - capacity, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    bool written = true;
+    if (start != writePosition && remaining >= sizeof(DelayRecordHeader)) {
+        DelayRecordHeader pad = {};
+        pad.type = DELAY_RECORD_PAD;
+        written = CopyIn(writeWindow, writePosition, &pad, sizeof(pad));
+    }
+    written = written && CopyIn(writeWindow, start, &header, sizeof(header)) &&
+              CopyIn(writeWindow, start + sizeof(header), source->data, source->size);
+
+    if (source == &converted) {
+        obs_encoder_packet_release(&converted);
+    }
+
+    writePosition = end;
+    head.store(end, std::memory_order_release);
+
+    if (!written) {
+        // The record is garbage; make readers skip everything written so far
+        blog(LOG_WARNING, "[multistream] Failed to map the delay buffer file %s", path.c_str());
+        tail.store(end, std::memory_order_relaxed);
+        droppedPackets++;
+        return;
+    }
+
+    packetsWritten++;
+
+    std::lock_guard<std::mutex> lock(indexMutex);
+    if (video && packet->keyframe) {
+        keyframes.push_back({start, receivedNs});
+    }
+
+    uint64_t oldest = tail.load(std::memory_order_relaxed);
+    while (!keyframes.empty() && keyframes.front().position < oldest) {
+        keyframes.pop_front();
+    }
+}
+
+bool DelayBuffer::FindKeyframe(uint64_t atNs, uint64_t& position) {
+    std::lock_guard<std::mutex> lock(indexMutex);
+
+    uint64_t oldest = tail.load(std::memory_order_relaxed);
+    while (!keyframes.empty() && keyframes.front().position < oldest) {
+        keyframes.pop_front();
+    }
+
+    if (keyframes.empty()) return false;
+
+    // Nothing is a whole delay old yet: wait for the oldest keyframe to fall due
+    position = keyframes.front().position;
+    for (auto it = keyframes.rbegin(); it != keyframes.rend(); ++it) {
+        if (it->receivedNs <= atNs) {
+            position = it->position;
+            break;
+        }
+    }
+
+    return true;
+}
+
+DelayReadResult DelayBuffer::PeekRecord(DelayWindow& window, uint64_t& position, DelayRecordHeader& header) {
+    for (;;) {
+        uint64_t remaining = capacity - position % capacity;
+        if (remaining < sizeof(DelayRecordHeader)) {
+            position += remaining;
+            continue;
+        }
+
+        if (position >= head.load(std::memory_order_acquire)) return DELAY_READ_WAIT;
+        if (position < tail.load(std::memory_order_relaxed)) return DELAY_READ_LAPPED;
+
+        bool copied = CopyOut(window, position, &header, sizeof(header));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!copied || position < tail.load(std::memory_order_relaxed)) return DELAY_READ_LAPPED;
+
+        if (header.type != DELAY_RECORD_PAD) return DELAY_READ_PACKET;
+        position += remaining;
+    }
+}
+
+DelayReadResult DelayBuffer::ReadPayload(DelayWindow& window, uint64_t& position, const DelayRecordHeader& header,
+                                         DelayedPacket& packet) {
+    packet.data.resize(header.size);
+
+    bool copied = CopyOut(window, position + sizeof(header), packet.data.data(), header.size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!copied || position < tail.load(std::memory_order_relaxed)) return DELAY_READ_LAPPED;
+
+    packet.type = header.type == DELAY_RECORD_VIDEO ? OBS_ENCODER_VIDEO : OBS_ENCODER_AUDIO;
+    packet.keyframe = header.keyframe != 0;
+    packet.pts = header.pts;
+    packet.dts = header.dts;
+    packet.timebaseNum = header.timebaseNum;
+    packet.timebaseDen = header.timebaseDen;
+    packet.dtsUsec = header.dtsUsec;
+    packet.receivedNs = header.receivedNs;
+
+    position += RecordSize(header.size);
+    return DELAY_READ_PACKET;
+}
+
+// ============================================================================
+// Ring Access
+// ============================================================================
+
+bool DelayBuffer::CopyIn(DelayWindow& window, uint64_t position, const void* data, size_t size) {
+    const uint8_t* source = static_cast<const uint8_t*>(data);
+
+    while (size > 0) {
+        uint64_t physical = position % capacity;
+        uint8_t* view = MapWindow(window, physical, true);
+        if (!view) return false;
+
+        size_t chunk = (size_t)std::min<uint64_t>(size, window.offset + DELAY_BUFFER_WINDOW_BYTES - physical);
+        memcpy(view + (physical - window.offset), source, chunk);
+
+        source += chunk;
+        position += chunk;
+        size -= chunk;
+    }
+
+    return true;
+}
+
+bool DelayBuffer::CopyOut(DelayWindow& window, uint64_t position, void* data, size_t size) {
+    uint8_t* target = static_cast<uint8_t*>(data);
+
+    while (size > 0) {
+        uint64_t physical = position % capacity;
+        uint8_t* view = MapWindow(window, physical, false);
+        if (!view) return false;
+
+        size_t chunk = (size_t)std::min<uint64_t>(size, window.offset + DELAY_BUFFER_WINDOW_BYTES - physical);
+        memcpy(target, view + (physical - window.offset), chunk);
+
+        target += chunk;
+        position += chunk;
+        size -= chunk;
+    }
+
+    return true;
+}
+
+#ifdef _WIN32
+
+bool DelayBuffer::OpenFile(uint64_t size) {
+    // Deleted by the system when the last handle closes, even after a crash
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    // Sizing the mapping extends the file to its full length
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    return true;
+}
+
+void DelayBuffer::CloseFile() {
+    if (mappingHandle) {
+        CloseHandle((HANDLE)mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if (fileHandle) {
+        CloseHandle((HANDLE)fileHandle);
+        fileHandle = nullptr;
+    }
+}
+
+uint8_t* DelayBuffer::MapWindow(DelayWindow& window, uint64_t physical, bool writable) {
+    if (window.view && physical >= window.offset && physical < window.offset + DELAY_BUFFER_WINDOW_BYTES) {
+        return window.view;
+    }
+
+    UnmapWindow(window);
+
+    uint64_t offset = physical / DELAY_BUFFER_WINDOW_BYTES * DELAY_BUFFER_WINDOW_BYTES;
+    void* view = MapViewOfFile((HANDLE)mappingHandle, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+                               (DWORD)(offset >> 32), (DWORD)offset, DELAY_BUFFER_WINDOW_BYTES);
+    if (!view) return nullptr;
+
+    window.view = static_cast<uint8_t*>(view);
+    window.offset = offset;
+    return window.view;
+}
+
+void DelayBuffer::UnmapWindow(DelayWindow& window) {
+    if (!window.view) return;
+
+    UnmapViewOfFile(window.view);
+    window.view = nullptr;
+}
+
+#else
+
+bool DelayBuffer::OpenFile(uint64_t size) {
+    int file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (file < 0) return false;
+
+    // Only the descriptor needs it, and nothing is left behind after a crash
+    unlink(path.c_str());
+
+    // Reserve the blocks up front: a full disk must fail here, not fault a
+    // mapped write later
+#ifdef __linux__
+    bool sized = posix_fallocate(file, 0, (off_t)size) == 0;
+#else
+    bool sized = false;
+#endif
+    if (!sized && ftruncate(file, (off_t)size) != 0) {
+        close(file);
+        return false;
+    }
+
+    fd = file;
+    return true;
+}
+
+void DelayBuffer::CloseFile() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+uint8_t* DelayBuffer::MapWindow(DelayWindow& window, uint64_t physical, bool writable) {
+    if (window.view && physical >= window.offset && physical < window.offset + DELAY_BUFFER_WINDOW_BYTES) {
+        return window.view;
+    }
+
+    UnmapWindow(window);
+
+    uint64_t offset = physical / DELAY_BUFFER_WINDOW_BYTES * DELAY_BUFFER_WINDOW_BYTES;
+    void* view = mmap(nullptr, DELAY_BUFFER_WINDOW_BYTES, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+                      fd, (off_t)offset);
+    if (view == MAP_FAILED) return nullptr;
+
+    // Both ends move through the ring front to back
+    madvise(view, DELAY_BUFFER_WINDOW_BYTES, MADV_SEQUENTIAL);
+
+    window.view = static_cast<uint8_t*>(view);
+    window.offset = offset;
+    return window.view;
+}
+
+void DelayBuffer::UnmapWindow(DelayWindow& window) {
+    if (!window.view) return;
+
+    munmap(window.view, DELAY_BUFFER_WINDOW_BYTES);
+    window.view = nullptr;
+}
+
+#endif
+
+// ============================================================================
+// DelayReader Implementation
+// ============================================================================
+
+DelayReader::DelayReader(DelayBuffer* owner) : buffer(owner), position(0), positioned(false), lagNs(0) {
+}
+
+DelayReader::~DelayReader() {
+    buffer->UnmapWindow(window);
+    DelayBuffer::Release(buffer);
+}
+
+void DelayReader::Resync() {
+    uint64_t now = os_gettime_ns();
+    uint64_t target;
+
+    // Only ever forward: going back would repeat what was already sent
+    if (positioned && buffer->FindKeyframe(now > buffer->delayNs ? now - buffer->delayNs : 0, target) &&
+        target > position) {
+        position = target;
+    }
+}
+
+uint64_t DelayReader::GetLagNs() const {
+    return lagNs;
+}
+
+DelayReadResult DelayReader::Next(DelayedPacket& packet, uint64_t timeoutMs) {
+    uint64_t deadline = os_gettime_ns() + timeoutMs * 1000000ULL;
+
+    for (;;) {
+        uint64_t now = os_gettime_ns();
+        uint64_t wakeAt = deadline;
+
+        if (!positioned) {
+            positioned = buffer->FindKeyframe(now > buffer->delayNs ? now - buffer->delayNs : 0, position);
+        }
+
+        if (positioned) {
+            DelayRecordHeader header;
+            DelayReadResult result = buffer->PeekRecord(window, position, header);
+
+            if (result == DELAY_READ_PACKET) {
+                uint64_t due = header.receivedNs + buffer->delayNs;
+                if (due <= now) {
+                    result = buffer->ReadPayload(window, position, header, packet);
+                    if (result == DELAY_READ_PACKET) {
+                        lagNs = now - due;
+                        return result;
+                    }
+                } else {
+                    wakeAt = std::min(due, deadline);
+                }
+            }
+
+            if (result == DELAY_READ_LAPPED) {
+                positioned = false;
+                buffer->lappedReads++;
+                return result;
+            }
+        }
+
+        if (now >= deadline) return DELAY_READ_WAIT;
+
+        // Anything written from now on is due a whole delay later, so only
+        // the next due time (or the timeout) needs waking for
+        os_sleepto_ns(wakeAt);
+    }
+}
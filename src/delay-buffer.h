@@ -0,0 +1,210 @@
+#pragma once
+
+#include <obs.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Delays rights holders typically ask for; 0 means live
+#define DELAY_BUFFER_MIN_SEC 30
+#define DELAY_BUFFER_MAX_SEC 120
+
+// Size of each mapped view into a ring file. This, not the delay, bounds the
+// memory a buffer and each of its readers map.
+#define DELAY_BUFFER_WINDOW_BYTES (4 * 1024 * 1024)
+
+class PacketTap;
+class DelayBuffer;
+struct DelayRecordHeader;
+
+// One encoded packet read back from a delay buffer. H.264 video is stored
+// as AVCC (length-prefixed NAL units), ready for FLV.
+struct DelayedPacket {
+    enum obs_encoder_type type;
+    bool keyframe;
+    int64_t pts;
+    int64_t dts;
+    int32_t timebaseNum;
+    int32_t timebaseDen;
+    int64_t dtsUsec;
+    // os_gettime_ns() when the packet reached the buffer; it is due one
+    // delay later
+    uint64_t receivedNs;
+    std::vector<uint8_t> data;
+};
+
+// Sliding mapped view of a ring file
+struct DelayWindow {
+    uint8_t* view;
+    uint64_t offset;
+
+    DelayWindow() : view(nullptr), offset(0) {}
+};
+
+enum DelayReadResult {
+    DELAY_READ_PACKET,
+    // Nothing due before the timeout
+    DELAY_READ_WAIT,
+    // The writer overwrote the reader's position; the next read resyncs
+    DELAY_READ_LAPPED,
+};
+
+// Cursor into a delay buffer that hands out packets as they fall due.
+//
+// A new reader, and one that lapped or was resynced, starts at the latest
+// video keyframe received at least one delay ago, so every (re)connect
+// airs exactly what went live one delay earlier. Readers keep a reference to
+// their buffer until they are deleted.
+class DelayReader {
+public:
+    ~DelayReader();
+
+    // Next packet once it is due, waiting at most timeoutMs
+    DelayReadResult Next(DelayedPacket& packet, uint64_t timeoutMs);
+
+    // Skip ahead to the keyframe at the current delay point, if that is
+    // ahead of the reader, e.g. after falling behind
+    void Resync();
+
+    // How late the last packet was handed out
+    uint64_t GetLagNs() const;
+
+private:
+    friend class DelayBuffer;
+    explicit DelayReader(DelayBuffer* buffer);
+
+    DelayBuffer* buffer;
+    DelayWindow window;
+    uint64_t position;
+    bool positioned;
+    uint64_t lagNs;
+};
+
+// Shared disk-backed buffer of an encoder pair's packets for one delay.
+//
+// Destinations with the same encoders and delay share one buffer. A
+// PacketTap feeds it; a writer thread appends each packet to a ring file
+// that is written and read sequentially through small mapped windows, so
+// memory stays bounded however long the delay and high the bitrate. The
+// ring is sized from the expected bitrate with ample headroom, and a
+// reader that still falls a whole ring behind is resynced instead of
+// reading overwritten data. Buffers are reference counted by the outputs
+// that use them and by their readers; the ring file is deleted with the
+// buffer.
+class DelayBuffer {
+public:
+    // Directory for ring files
+    static void SetDirectory(const std::string& directory);
+    static std::string GetDirectory();
+
+    // 0 stays live; anything else is kept within the supported range
+    static int ClampDelay(int delaySec);
+
+    // Get (and start recording, if new) the buffer for an encoder pair and
+    // delay. expectedKbps (video and audio) sizes a new ring.
+    static DelayBuffer* Acquire(obs_encoder_t* videoEncoder, obs_encoder_t* audioEncoder, int delaySec,
+                                int expectedKbps);
+    static void Release(DelayBuffer* buffer);
+
+    // Another reference to a buffer the caller already holds
+    static void Retain(DelayBuffer* buffer);
+
+    int GetDelaySec() const;
+
+    DelayReader* CreateReader();
+
+private:
+    friend class DelayReader;
+
+    DelayBuffer(obs_encoder_t* videoEncoder, obs_encoder_t* audioEncoder, int delaySec);
+    ~DelayBuffer();
+
+    bool Start(int expectedKbps);
+    void Stop();
+    void LogSummary();
+
+    static void OnTapPacket(void* data, struct encoder_packet* packet, uint64_t receivedNs);
+    void WriterThread();
+    void Append(struct encoder_packet* packet, uint64_t receivedNs);
+
+    // Latest keyframe received at or before atNs, else the oldest one
+    bool FindKeyframe(uint64_t atNs, uint64_t& position);
+
+    // Record header at position, skipping padding; DELAY_READ_WAIT at the head
+    DelayReadResult PeekRecord(DelayWindow& window, uint64_t& position, DelayRecordHeader& header);
+    DelayReadResult ReadPayload(DelayWindow& window, uint64_t& position, const DelayRecordHeader& header,
+                                DelayedPacket& packet);
+
+    // Copy between memory and the ring through a window, remapping it as
+    // the copy crosses window boundaries
+    bool CopyIn(DelayWindow& window, uint64_t position, const void* data, size_t size);
+    bool CopyOut(DelayWindow& window, uint64_t position, void* data, size_t size);
+    uint8_t* MapWindow(DelayWindow& window, uint64_t physical, bool writable);
+    void UnmapWindow(DelayWindow& window);
+
+    // Platform file and mapping
+    bool OpenFile(uint64_t size);
+    void CloseFile();
+
+    static std::mutex buffersMutex;
+    static std::vector<DelayBuffer*> buffers;
+    static std::string directory;
+
+    obs_encoder_t* videoEncoder;
+    obs_encoder_t* audioEncoder;
+    int delaySec;
+    uint64_t delayNs;
+    int refCount;
+    bool convertAvc;
+
+    PacketTap* tap;
+    std::string path;
+    uint64_t capacity;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fd;
+#endif
+
+    // Packets from the tap, waiting for the writer thread. After a drop,
+    // video is dropped until the next keyframe.
+    struct QueuedPacket {
+        struct encoder_packet packet;
+        uint64_t receivedNs;
+    };
+    std::mutex queueMutex;
+    std::condition_variable queueWake;
+    std::deque<QueuedPacket> queue;
+    size_t queuedBytes;
+    size_t maxQueuedBytes;
+    bool needKeyframe;
+    bool stopping;
+    std::thread writer;
+
+    // Writer-only state
+    DelayWindow writeWindow;
+    uint64_t writePosition;
+
+    // Records end at head; everything before tail may already be
+    // overwritten. Readers check tail again after copying a record.
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+
+    // Video keyframe positions, oldest first
+    struct KeyframeMark {
+        uint64_t position;
+        uint64_t receivedNs;
+    };
+    std::mutex indexMutex;
+    std::deque<KeyframeMark> keyframes;
+
+    // Session counters
+    std::atomic<uint64_t> packetsWritten;
+    std::atomic<uint64_t> droppedPackets;
+    std::atomic<uint64_t> lappedReads;
+};
@@ -0,0 +1,362 @@
+#include "delay-relay-output.h"
+#include "audio-relay-output.h"
+#include "delay-buffer.h"
+#include "flv-tags.h"
+#include "process-pipe.h"
+#include "ffmpeg-publish.h"
+#include <util/platform.h>
+#include <util/threading.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// How often the relay thread checks for a stop while nothing is due
+#define DELAY_RELAY_POLL_MS 100
+
+// A relay this far behind schedule skips ahead to the delay point
+#define DELAY_RELAY_MAX_LAG_MS 5000
+
+// Private data of a relay output instance
+struct DelayRelayData {
+    obs_output_t* output;
+    std::string url;
+    std::string key;
+
+    // Set up by RelayStart() for the relay thread
+    DelayReader* reader;
+    std::string command;
+    std::string keyPath;
+    std::vector<uint8_t> preamble;
+    os_process_pipe_t* pipe;
+    std::thread thread;
+
+    std::mutex mutex;
+    bool running;
+    std::atomic<bool> stopping;
+
+    std::atomic<uint64_t> totalBytes;
+    std::atomic<int> droppedPackets;
+    std::atomic<uint64_t> lagMs;
+};
+
+// The buffer each relay output reads, with a reference of its own. Kept here
+// because libobs gives no way from an obs_output_t to its private data.
+static std::mutex buffersMutex;
+static std::unordered_map<obs_output_t*, DelayBuffer*> buffers;
+
+// A reader of the output's buffer, which holds a reference of its own
+static DelayReader* CreateReader(obs_output_t* output) {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    auto it = buffers.find(output);
+    return it != buffers.end() ? it->second->CreateReader() : nullptr;
+}
+
+// Drops the reference held for the output
+static void ReleaseBuffer(obs_output_t* output) {
+    DelayBuffer* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        auto it = buffers.find(output);
+        if (it == buffers.end()) return;
+
+        buffer = it->second;
+        buffers.erase(it);
+    }
+    DelayBuffer::Release(buffer);
+}
+
+// ============================================================================
+// Relay Thread
+// ============================================================================
+
+static void MuxPacket(std::vector<uint8_t>& out, const DelayedPacket& packet, uint32_t timestampMs) {
+    if (packet.type == OBS_ENCODER_AUDIO) {
+        AppendAudioTag(out, timestampMs, FLV_AAC_RAW, packet.data.data(), packet.data.size());
+        return;
+    }
+
+    int64_t compositionMs = packet.timebaseDen
+                                ? (packet.pts - packet.dts) * 1000 * packet.timebaseNum / packet.timebaseDen
+                                : 0;
+    AppendVideoTag(out, timestampMs, packet.keyframe, FLV_AVC_NALU, (int32_t)compositionMs, packet.data.data(),
+                   packet.data.size());
+}
+
+static void RelayThread(DelayRelayData* relay) {
+    os_set_thread_name("multistream-delay-relay");
+
+    BlockPipeSignals();
+
+    DelayReader* reader = relay->reader;
+    DelayedPacket packet;
+    std::vector<uint8_t> data;
+    bool haveFirstPacket = false;
+    int64_t firstDtsUsec = 0;
+    bool failed = false;
+
+    while (!relay->stopping.load()) {
+        DelayReadResult result = reader->Next(packet, DELAY_RELAY_POLL_MS);
+        if (result == DELAY_READ_LAPPED) {
+            relay->droppedPackets++;
+            continue;
+        }
+        if (result != DELAY_READ_PACKET) continue;
+
+        // Sending late packets would stretch the delay
+        relay->lagMs = reader->GetLagNs() / 1000000;
+        if (relay->lagMs.load() > DELAY_RELAY_MAX_LAG_MS) {
+            reader->Resync();
+            relay->droppedPackets++;
+        }
+
+        // ffmpeg only connects once something is due, a delay after the start
+        if (!relay->pipe) {
+            relay->pipe = os_process_pipe_create(relay->command.c_str(), "w");
+            if (!relay->pipe) {
+                blog(LOG_ERROR, "[multistream] Failed to run %s for the delay relay",
+                     AudioRelayOutput::GetFfmpegPath().c_str());
+                failed = true;
+                break;
+            }
+            data = relay->preamble;
+        }
+
+        if (!haveFirstPacket) {
+            firstDtsUsec = packet.dtsUsec;
+            haveFirstPacket = true;
+        }
+
+        int64_t timestampMs = std::max<int64_t>(0, (packet.dtsUsec - firstDtsUsec) / 1000);
+        MuxPacket(data, packet, (uint32_t)timestampMs);
+
+        if (!WriteProcessPipe(relay->pipe, data)) {
+            failed = true;
+            break;
+        }
+        relay->totalBytes += data.size();
+        data.clear();
+
+        if (relay->totalBytes.load() > FFMPEG_KEY_FILE_READ_BYTES) {
+            RemoveFfmpegKeyFile(relay->keyPath);
+        }
+    }
+
+    delete reader;
+    relay->reader = nullptr;
+
+    int exitCode = CloseProcessPipe(relay->pipe);
+    RemoveFfmpegKeyFile(relay->keyPath);
+
+    bool stopRequested;
+    {
+        std::lock_guard<std::mutex> lock(relay->mutex);
+        relay->running = false;
+        stopRequested = relay->stopping.load();
+    }
+
+    if (stopRequested) {
+        obs_output_end_data_capture(relay->output);
+        return;
+    }
+
+    if (failed) {
+        blog(LOG_WARNING, "[multistream] Delay relay to %s lost its ffmpeg process (exit code %d)", relay->url.c_str(),
+             exitCode);
+    }
+    obs_output_signal_stop(relay->output, OBS_OUTPUT_DISCONNECTED);
+}
+
+// ============================================================================
+// Output Type Callbacks
+// ============================================================================
+
+static const char* RelayGetName(void* typeData) {
+    UNUSED_PARAMETER(typeData);
+    return "Multistream Delay Relay";
+}
+
+static void RelayUpdate(void* data, obs_data_t* settings) {
+    DelayRelayData* relay = static_cast<DelayRelayData*>(data);
+    relay->url = obs_data_get_string(settings, "url");
+    relay->key = obs_data_get_string(settings, "key");
+}
+
+static void* RelayCreate(obs_data_t* settings, obs_output_t* output) {
+    DelayRelayData* relay = new DelayRelayData();
+    relay->output = output;
+    relay->reader = nullptr;
+    relay->pipe = nullptr;
+    relay->running = false;
+    relay->stopping = false;
+    relay->totalBytes = 0;
+    relay->droppedPackets = 0;
+    relay->lagMs = 0;
+
+    RelayUpdate(relay, settings);
+    return relay;
+}
+
+static void RelayDestroy(void* data) {
+    DelayRelayData* relay = static_cast<DelayRelayData*>(data);
+
+    relay->stopping = true;
+    if (relay->thread.joinable()) {
+        relay->thread.join();
+    }
+
+    ReleaseBuffer(relay->output);
+    delete relay;
+}
+
+static bool RelayStart(void* data) {
+    DelayRelayData* relay = static_cast<DelayRelayData*>(data);
+
+    // The previous connection's thread has finished by the time libobs
+    // reconnects, but still needs joining
+    if (relay->thread.joinable()) {
+        relay->thread.join();
+    }
+
+    if (!obs_output_can_begin_data_capture(relay->output, 0)) return false;
+    if (!obs_output_initialize_encoders(relay->output, 0)) return false;
+
+    obs_encoder_t* videoEncoder = obs_output_get_video_encoder(relay->output);
+    obs_encoder_t* audioEncoder = obs_output_get_audio_encoder(relay->output, 0);
+    const char* videoCodec = videoEncoder ? obs_encoder_get_codec(videoEncoder) : nullptr;
+    const char* audioCodec = audioEncoder ? obs_encoder_get_codec(audioEncoder) : nullptr;
+    uint8_t* videoExtra = nullptr;
+    size_t videoExtraSize = 0;
+    uint8_t* audioExtra = nullptr;
+    size_t audioExtraSize = 0;
+
+    if (!videoCodec || strcmp(videoCodec, "h264") != 0 || !audioCodec || strcmp(audioCodec, "aac") != 0 ||
+        !obs_encoder_get_extra_data(videoEncoder, &videoExtra, &videoExtraSize) ||
+        !obs_encoder_get_extra_data(audioEncoder, &audioExtra, &audioExtraSize)) {
+        blog(LOG_ERROR, "[multistream] Delay relay needs H.264 and AAC encoders");
+        return false;
+    }
+
+    relay->command = AudioRelayOutput::BuildCommand(relay->url, relay->key, relay->keyPath);
+    if (relay->command.empty()) {
+        blog(LOG_ERROR, "[multistream] Delay relay URL or ffmpeg path contains unsupported characters");
+        return false;
+    }
+
+    relay->preamble.clear();
+    AppendFlvPreamble(relay->preamble, videoExtra, videoExtraSize, audioExtra, audioExtraSize);
+
+    relay->reader = CreateReader(relay->output);
+    if (!relay->reader) {
+        blog(LOG_ERROR, "[multistream] Delay relay started without a delay buffer");
+        RemoveFfmpegKeyFile(relay->keyPath);
+        return false;
+    }
+
+    relay->stopping = false;
+    relay->totalBytes = 0;
+    relay->droppedPackets = 0;
+    relay->lagMs = 0;
+    {
+        std::lock_guard<std::mutex> lock(relay->mutex);
+        relay->running = true;
+    }
+    relay->thread = std::thread(RelayThread, relay);
+
+    if (!obs_output_begin_data_capture(relay->output, 0)) {
+        relay->stopping = true;
+        relay->thread.join();
+        return false;
+    }
+
+    return true;
+}
+
+static void RelayStop(void* data, uint64_t ts) {
+    UNUSED_PARAMETER(ts);
+    DelayRelayData* relay = static_cast<DelayRelayData*>(data);
+
+    // What is still in the buffer is never aired, so graceful and forced
+    // stops are the same
+    std::lock_guard<std::mutex> lock(relay->mutex);
+    relay->stopping = true;
+
+    // Between reconnect attempts there is no thread to end the capture
+    if (!relay->running) {
+        obs_output_end_data_capture(relay->output);
+    }
+}
+
+static void RelayEncodedPacket(void* data, struct encoder_packet* packet) {
+    DelayRelayData* relay = static_cast<DelayRelayData*>(data);
+
+    // Live packets are ignored: the delay buffer records the same stream
+    if (!packet) {
+        obs_output_signal_stop(relay->output, OBS_OUTPUT_ENCODE_ERROR);
+    }
+}
+
+static uint64_t RelayGetTotalBytes(void* data) {
+    return static_cast<DelayRelayData*>(data)->totalBytes.load();
+}
+
+static int RelayGetDroppedFrames(void* data) {
+    return static_cast<DelayRelayData*>(data)->droppedPackets.load();
+}
+
+static float RelayGetCongestion(void* data) {
+    DelayRelayData* relay = static_cast<DelayRelayData*>(data);
+    return std::min(1.0f, (float)relay->lagMs.load() / DELAY_RELAY_MAX_LAG_MS);
+}
+
+// ============================================================================
+// DelayRelayOutput
+// ============================================================================
+
+void DelayRelayOutput::RegisterOutputType() {
+    struct obs_output_info info = {};
+    info.id = DELAY_RELAY_OUTPUT_ID;
+    info.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED;
+    info.encoded_video_codecs = "h264";
+    info.encoded_audio_codecs = "aac";
+    info.get_name = RelayGetName;
+    info.create = RelayCreate;
+    info.destroy = RelayDestroy;
+    info.update = RelayUpdate;
+    info.start = RelayStart;
+    info.stop = RelayStop;
+    info.encoded_packet = RelayEncodedPacket;
+    info.get_total_bytes = RelayGetTotalBytes;
+    info.get_dropped_frames = RelayGetDroppedFrames;
+    info.get_congestion = RelayGetCongestion;
+    obs_register_output(&info);
+}
+
+obs_output_t* DelayRelayOutput::Create(const char* name, const std::string& url, const std::string& key) {
+    obs_data_t* settings = obs_data_create();
+    obs_data_set_string(settings, "url", url.c_str());
+    obs_data_set_string(settings, "key", key.c_str());
+
+    obs_output_t* output = obs_output_create(DELAY_RELAY_OUTPUT_ID, name, settings, nullptr);
+    obs_data_release(settings);
+
+    if (!output) {
+        blog(LOG_ERROR, "[multistream] Failed to create delay relay output");
+    }
+
+    return output;
+}
+
+void DelayRelayOutput::SetBuffer(obs_output_t* output, DelayBuffer* buffer) {
+    if (!output) return;
+
+    DelayBuffer::Retain(buffer);
+    ReleaseBuffer(output);
+    if (!buffer) return;
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffers[output] = buffer;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <obs.h>
+#include <string>
+
+class DelayBuffer;
+
+#define DELAY_RELAY_OUTPUT_ID "multistream_delay_relay"
+
+// RTMP output for destinations with a broadcast delay.
+//
+// rtmp_output sends packets as the encoders produce them, and OBS's own
+// stream delay holds them in memory for the main output only. A delayed
+// destination uses this plugin-registered encoded output instead: it
+// ignores the live packets libobs hands it and reads its destination's
+// DelayBuffer, muxing each packet into FLV as it falls due and piping it to
+// an ffmpeg process that publishes with stream copy, like the
+// AudioRelayOutput. Every (re)connect resumes at the keyframe that went
+// live one delay ago, so the delay is the same before and after a
+// reconnect; a relay that falls too far behind skips ahead to keep it.
+// H.264 and AAC only.
+class DelayRelayOutput {
+public:
+    // Register the relay output type with libobs, from obs_module_load
+    static void RegisterOutputType();
+
+    // Create a relay publishing to url with the given stream key
+    static obs_output_t* Create(const char* name, const std::string& url, const std::string& key);
+
+    // Buffer the relay reads from whenever it (re)starts. The relay keeps a
+    // reference until it is destroyed or given another buffer.
+    static void SetBuffer(obs_output_t* output, DelayBuffer* buffer);
+};
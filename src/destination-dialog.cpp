@@ -0,0 +1,359 @@
+#include "destination-dialog.h"
+#include "delay-buffer.h"
+#include "audio-relay-output.h"
+#include <obs.h>
+#include <string>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <CommCtrl.h>
+#endif
+
+void ShowDockMessage(const char* title, const char* text) {
+#ifdef _WIN32
+    MessageBoxA(nullptr, text, title, MB_OK | MB_ICONINFORMATION);
+#else
+    blog(LOG_INFO, "[obs-multistream] %s: %s", title, text);
+#endif
+}
+
+// ============================================================================
+// Stream Destination Dialog
+// ============================================================================
+
+StreamDestinationDialog::StreamDestinationDialog(void* parent)
+    : currentDest(nullptr), dialogOK(false), parentWindow(parent) {
+}
+
+StreamDestinationDialog::~StreamDestinationDialog() {
+}
+
+bool StreamDestinationDialog::ShowDialog(StreamDestination* dest) {
+    currentDest = dest;
+    dialogOK = false;
+    
+    // For now, use a simple message box approach
+    // In a full implementation, you would create a proper dialog resource
+    
+    // Simple input simulation for demonstration
+    if (dest) {
+        // Edit mode - show current values
+        blog(LOG_INFO, "[obs-multistream] Edit destination: %s", dest->name.c_str());
+    } else {
+        // Add mode - create new destination
+        dialogResult = StreamDestination();
+        dialogResult.name = "New Stream";
+        dialogResult.url = "rtmp://live.twitch.tv/live/";
+        dialogResult.key = "";
+        dialogResult.enabled = true;
+        dialogResult.useMainEncoder = true;
+        dialogResult.bitrate = 2500;
+        
+        dialogOK = true;
+    }
+    
+    return dialogOK;
+}
+
+StreamDestination StreamDestinationDialog::GetDestination() const {
+    return dialogResult;
+}
+
+#ifdef _WIN32
+
+// Resource IDs for dialog controls
+#define IDC_NAME_EDIT           1001
+#define IDC_PRESET_COMBO        1002
+#define IDC_URL_EDIT            1003
+#define IDC_KEY_EDIT            1004
+#define IDC_ENABLED_CHECK       1005
+#define IDC_MAIN_ENCODER_CHECK  1006
+#define IDC_BITRATE_SPIN        1007
+#define IDC_OK_BUTTON           1008
+#define IDC_CANCEL_BUTTON       1009
+#define IDC_BIND_EDIT           1010
+#define IDC_CODEC_COMBO         1011
+#define IDC_BACKUP_URL_EDIT     1012
+#define IDC_AUDIO_ONLY_CHECK    1013
+#define IDC_PROFILE_COMBO       1014
+#define IDC_VERTICAL_CHECK      1015
+#define IDC_DELAY_SPIN          1016
+#define IDC_CONNECT_BY_ADDRESS_CHECK 1017
+
+// Dialog template resource ID
+#define IDD_DESTINATION_DIALOG  2001
+
+// ============================================================================
+// Win32 Helper Functions
+// ============================================================================
+
+namespace Win32Helpers {
+
+void SetWindowText(HWND hWnd, int controlId, const std::string& text) {
+    HWND control = GetDlgItem(hWnd, controlId);
+    if (control) {
+        ::SetWindowTextA(control, text.c_str());
+    }
+}
+
+std::string GetWindowText(HWND hWnd, int controlId) {
+    HWND control = GetDlgItem(hWnd, controlId);
+    if (!control) return "";
+    
+    char buffer[1024];
+    GetWindowTextA(control, buffer, sizeof(buffer));
+    return std::string(buffer);
+}
+
+void SetCheckBox(HWND hWnd, int controlId, bool checked) {
+    HWND control = GetDlgItem(hWnd, controlId);
+    if (control) {
+        SendMessage(control, BM_SETCHECK, checked ? BST_CHECKED : BST_UNCHECKED, 0);
+    }
+}
+
+bool GetCheckBox(HWND hWnd, int controlId) {
+    HWND control = GetDlgItem(hWnd, controlId);
+    if (!control) return false;
+    
+    return SendMessage(control, BM_GETCHECK, 0, 0) == BST_CHECKED;
+}
+
+void SetSpinBox(HWND hWnd, int controlId, int value) {
+    HWND control = GetDlgItem(hWnd, controlId);
+    if (control) {
+        SetDlgItemInt(hWnd, controlId, value, FALSE);
+    }
+}
+
+int GetSpinBox(HWND hWnd, int controlId) {
+    BOOL translated;
+    int value = GetDlgItemInt(hWnd, controlId, &translated, FALSE);
+    return translated ? value : 0;
+}
+
+void SetComboBox(HWND hWnd, int controlId, int index) {
+    HWND control = GetDlgItem(hWnd, controlId);
+    if (control) {
+        SendMessage(control, CB_SETCURSEL, index, 0);
+    }
+}
+
+int GetComboBox(HWND hWnd, int controlId) {
+    HWND control = GetDlgItem(hWnd, controlId);
+    if (!control) return -1;
+    
+    return (int)SendMessage(control, CB_GETCURSEL, 0, 0);
+}
+
+void AddComboBoxItem(HWND hWnd, int controlId, const std::string& text) {
+    HWND control = GetDlgItem(hWnd, controlId);
+    if (control) {
+        SendMessageA(control, CB_ADDSTRING, 0, (LPARAM)text.c_str());
+    }
+}
+
+void ClearComboBox(HWND hWnd, int controlId) {
+    HWND control = GetDlgItem(hWnd, controlId);
+    if (control) {
+        SendMessage(control, CB_RESETCONTENT, 0, 0);
+    }
+}
+
+} // namespace Win32Helpers
+
+// ============================================================================
+// Win32 Dialog Procedure
+// ============================================================================
+
+INT_PTR CALLBACK StreamDestinationDialog::DialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
+    StreamDestinationDialog* dialog = nullptr;
+    
+    if (message == WM_INITDIALOG) {
+        dialog = reinterpret_cast<StreamDestinationDialog*>(lParam);
+        SetWindowLongPtr(hDlg, DWLP_USER, (LONG_PTR)dialog);
+        dialog->InitializeDialog(hDlg);
+        return TRUE;
+    } else {
+        dialog = reinterpret_cast<StreamDestinationDialog*>(GetWindowLongPtr(hDlg, DWLP_USER));
+    }
+    
+    if (!dialog) return FALSE;
+    
+    switch (message) {
+    case WM_COMMAND:
+        switch (LOWORD(wParam)) {
+        case IDC_OK_BUTTON:
+            if (dialog->ValidateAndSave(hDlg)) {
+                dialog->dialogOK = true;
+                EndDialog(hDlg, IDOK);
+            }
+            return TRUE;
+            
+        case IDC_CANCEL_BUTTON:
+            EndDialog(hDlg, IDCANCEL);
+            return TRUE;
+            
+        case IDC_PRESET_COMBO:
+            if (HIWORD(wParam) == CBN_SELCHANGE) {
+                dialog->OnPresetChanged(hDlg);
+            }
+            return TRUE;
+        }
+        break;
+        
+    case WM_CLOSE:
+        EndDialog(hDlg, IDCANCEL);
+        return TRUE;
+    }
+    
+    return FALSE;
+}
+
+void StreamDestinationDialog::InitializeDialog(HWND hDlg) {
+    PopulatePresets(hDlg);
+    
+    if (currentDest) {
+        LoadDestination(hDlg, *currentDest);
+    } else {
+        // Set defaults for new destination
+        Win32Helpers::SetWindowText(hDlg, IDC_NAME_EDIT, "New Stream");
+        Win32Helpers::SetCheckBox(hDlg, IDC_ENABLED_CHECK, true);
+        Win32Helpers::SetCheckBox(hDlg, IDC_MAIN_ENCODER_CHECK, true);
+        Win32Helpers::SetSpinBox(hDlg, IDC_BITRATE_SPIN, 2500);
+    }
+}
+
+void StreamDestinationDialog::LoadDestination(HWND hDlg, const StreamDestination& dest) {
+    Win32Helpers::SetWindowText(hDlg, IDC_NAME_EDIT, dest.name);
+    Win32Helpers::SetWindowText(hDlg, IDC_URL_EDIT, dest.url);
+    Win32Helpers::SetWindowText(hDlg, IDC_BACKUP_URL_EDIT, dest.backupUrl);
+    Win32Helpers::SetWindowText(hDlg, IDC_KEY_EDIT, dest.key);
+    Win32Helpers::SetCheckBox(hDlg, IDC_ENABLED_CHECK, dest.enabled);
+    Win32Helpers::SetCheckBox(hDlg, IDC_MAIN_ENCODER_CHECK, dest.useMainEncoder);
+    Win32Helpers::SetSpinBox(hDlg, IDC_BITRATE_SPIN, dest.bitrate);
+    Win32Helpers::SetWindowText(hDlg, IDC_BIND_EDIT, dest.bindAddress);
+    Win32Helpers::SetComboBox(hDlg, IDC_CODEC_COMBO, dest.codec == "hevc" ? 1 : dest.codec == "av1" ? 2 : 0);
+    Win32Helpers::SetCheckBox(hDlg, IDC_AUDIO_ONLY_CHECK, dest.audioOnly);
+    Win32Helpers::SetCheckBox(hDlg, IDC_VERTICAL_CHECK, dest.vertical);
+    Win32Helpers::SetSpinBox(hDlg, IDC_DELAY_SPIN, dest.delaySec);
+    Win32Helpers::SetCheckBox(hDlg, IDC_CONNECT_BY_ADDRESS_CHECK, dest.connectByAddress);
+    
+    std::vector<std::string> profiles = EncoderProfiles::GetNames();
+    for (size_t i = 0; i < profiles.size(); i++) {
+        if (profiles[i] == dest.encoderProfile) {
+            Win32Helpers::SetComboBox(hDlg, IDC_PROFILE_COMBO, (int)i);
+        }
+    }
+}
+
+bool StreamDestinationDialog::ValidateAndSave(HWND hDlg) {
+    dialogResult.name = Win32Helpers::GetWindowText(hDlg, IDC_NAME_EDIT);
+    dialogResult.url = Win32Helpers::GetWindowText(hDlg, IDC_URL_EDIT);
+    dialogResult.backupUrl = Win32Helpers::GetWindowText(hDlg, IDC_BACKUP_URL_EDIT);
+    dialogResult.key = Win32Helpers::GetWindowText(hDlg, IDC_KEY_EDIT);
+    dialogResult.enabled = Win32Helpers::GetCheckBox(hDlg, IDC_ENABLED_CHECK);
+    dialogResult.useMainEncoder = Win32Helpers::GetCheckBox(hDlg, IDC_MAIN_ENCODER_CHECK);
+    dialogResult.bitrate = Win32Helpers::GetSpinBox(hDlg, IDC_BITRATE_SPIN);
+    dialogResult.bindAddress = Win32Helpers::GetWindowText(hDlg, IDC_BIND_EDIT);
+    dialogResult.audioOnly = Win32Helpers::GetCheckBox(hDlg, IDC_AUDIO_ONLY_CHECK);
+    dialogResult.vertical = Win32Helpers::GetCheckBox(hDlg, IDC_VERTICAL_CHECK);
+    dialogResult.delaySec = Win32Helpers::GetSpinBox(hDlg, IDC_DELAY_SPIN);
+    dialogResult.connectByAddress = Win32Helpers::GetCheckBox(hDlg, IDC_CONNECT_BY_ADDRESS_CHECK);
+    
+    std::vector<std::string> profiles = EncoderProfiles::GetNames();
+    int profileIndex = Win32Helpers::GetComboBox(hDlg, IDC_PROFILE_COMBO);
+    dialogResult.encoderProfile = profileIndex >= 0 && profileIndex < (int)profiles.size() ? profiles[profileIndex]
+                                                                                           : ENCODER_PROFILE_DEFAULT;
+    
+    static const char* codecs[] = {"h264", "hevc", "av1"};
+    int codecIndex = Win32Helpers::GetComboBox(hDlg, IDC_CODEC_COMBO);
+    dialogResult.codec = codecs[codecIndex >= 0 && codecIndex < 3 ? codecIndex : 0];
+    
+    // Basic validation
+    if (dialogResult.name.empty()) {
+        MessageBoxA(hDlg, "Please enter a name for the destination.", "Validation Error", MB_OK | MB_ICONWARNING);
+        return false;
+    }
+    
+    if (dialogResult.url.empty()) {
+        MessageBoxA(hDlg, "Please enter an RTMP URL.", "Validation Error", MB_OK | MB_ICONWARNING);
+        return false;
+    }
+    
+    if (dialogResult.key.empty()) {
+        MessageBoxA(hDlg, "Please enter a stream key.", "Validation Error", MB_OK | MB_ICONWARNING);
+        return false;
+    }
+    
+    if (dialogResult.delaySec != DelayBuffer::ClampDelay(dialogResult.delaySec)) {
+        MessageBoxA(hDlg, "The delay must be 0 (live) or between 30 and 120 seconds.", "Validation Error",
+                    MB_OK | MB_ICONWARNING);
+        return false;
+    }
+    
+    // Saved either way; the destination connects once ffmpeg is installed
+    if ((dialogResult.audioOnly || dialogResult.delaySec > 0) && !AudioRelayOutput::HasFfmpeg()) {
+        std::string message = "Audio-only and delayed destinations publish through ffmpeg 7.0 or newer, which was "
+                              "not found at '" + AudioRelayOutput::GetFfmpegPath() +
+                              "'.\n\nInstall ffmpeg next to the plugin or on PATH, or set audioRelayFfmpeg in "
+                              "obs-multistream.json.";
+        MessageBoxA(hDlg, message.c_str(), "ffmpeg Not Found", MB_OK | MB_ICONINFORMATION);
+    }
+    
+    return true;
+}
+
+void StreamDestinationDialog::PopulatePresets(HWND hDlg) {
+    Win32Helpers::ClearComboBox(hDlg, IDC_PRESET_COMBO);
+    Win32Helpers::AddComboBoxItem(hDlg, IDC_PRESET_COMBO, "Custom");
+    Win32Helpers::AddComboBoxItem(hDlg, IDC_PRESET_COMBO, "Twitch");
+    Win32Helpers::AddComboBoxItem(hDlg, IDC_PRESET_COMBO, "YouTube");
+    Win32Helpers::AddComboBoxItem(hDlg, IDC_PRESET_COMBO, "Facebook");
+    Win32Helpers::AddComboBoxItem(hDlg, IDC_PRESET_COMBO, "TikTok");
+    Win32Helpers::SetComboBox(hDlg, IDC_PRESET_COMBO, 0);
+    
+    Win32Helpers::ClearComboBox(hDlg, IDC_CODEC_COMBO);
+    Win32Helpers::AddComboBoxItem(hDlg, IDC_CODEC_COMBO, "H.264");
+    Win32Helpers::AddComboBoxItem(hDlg, IDC_CODEC_COMBO, "HEVC (Enhanced RTMP)");
+    Win32Helpers::AddComboBoxItem(hDlg, IDC_CODEC_COMBO, "AV1 (Enhanced RTMP)");
+    Win32Helpers::SetComboBox(hDlg, IDC_CODEC_COMBO, 0);
+    
+    Win32Helpers::ClearComboBox(hDlg, IDC_PROFILE_COMBO);
+    for (const auto& name : EncoderProfiles::GetNames()) {
+        Win32Helpers::AddComboBoxItem(hDlg, IDC_PROFILE_COMBO, name);
+    }
+    Win32Helpers::SetComboBox(hDlg, IDC_PROFILE_COMBO, 0);
+}
+
+void StreamDestinationDialog::OnPresetChanged(HWND hDlg) {
+    int selection = Win32Helpers::GetComboBox(hDlg, IDC_PRESET_COMBO);
+    
+    // Only YouTube publishes a backup ingest
+    Win32Helpers::SetWindowText(hDlg, IDC_BACKUP_URL_EDIT, "");
+    
+    // Only TikTok takes portrait video
+    if (selection > 0) {
+        Win32Helpers::SetCheckBox(hDlg, IDC_VERTICAL_CHECK, selection == 4);
+    }
+    
+    switch (selection) {
+    case 1: // Twitch
+        Win32Helpers::SetWindowText(hDlg, IDC_URL_EDIT, "rtmp://live.twitch.tv/live/");
+        break;
+    case 2: // YouTube
+        Win32Helpers::SetWindowText(hDlg, IDC_URL_EDIT, "rtmp://a.rtmp.youtube.com/live2/");
+        Win32Helpers::SetWindowText(hDlg, IDC_BACKUP_URL_EDIT, "rtmp://b.rtmp.youtube.com/live2?backup=1");
+        break;
+    case 3: // Facebook
+        Win32Helpers::SetWindowText(hDlg, IDC_URL_EDIT, "rtmps://live-api-s.facebook.com:443/rtmp/");
+        break;
+    case 4: // TikTok
+        Win32Helpers::SetWindowText(hDlg, IDC_URL_EDIT, "rtmp://push.tiktokcdn.com/live/");
+        break;
+    default: // Custom
+        break;
+    }
+}
+
+#endif
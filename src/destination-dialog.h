@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+
+// Include StreamDestination definition
+#include "stream-destination.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// Informational message from the dock: a message box on Windows, the log elsewhere
+void ShowDockMessage(const char* title, const char* text);
+
+// Destination configuration dialog. The editing UI is Win32; other
+// platforms get the same defaults without showing a window.
+class StreamDestinationDialog {
+public:
+    StreamDestinationDialog(void* parent = nullptr);
+    ~StreamDestinationDialog();
+    
+    // Show dialog and return true if OK was pressed
+    bool ShowDialog(StreamDestination* dest = nullptr);
+    
+    // Get the configured destination after dialog closes
+    StreamDestination GetDestination() const;
+
+private:
+#ifdef _WIN32
+    static INT_PTR CALLBACK DialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
+    
+    void InitializeDialog(HWND hDlg);
+    void LoadDestination(HWND hDlg, const StreamDestination& dest);
+    bool ValidateAndSave(HWND hDlg);
+    void PopulatePresets(HWND hDlg);
+    void OnPresetChanged(HWND hDlg);
+#endif
+    
+    StreamDestination* currentDest;
+    StreamDestination dialogResult;
+    bool dialogOK;
+    void* parentWindow;
+};
+
+#ifdef _WIN32
+// Helper functions for Win32 dialogs
+namespace Win32Helpers {
+    void SetWindowText(HWND hWnd, int controlId, const std::string& text);
+    std::string GetWindowText(HWND hWnd, int controlId);
+    void SetCheckBox(HWND hWnd, int controlId, bool checked);
+    bool GetCheckBox(HWND hWnd, int controlId);
+    void SetSpinBox(HWND hWnd, int controlId, int value);
+    int GetSpinBox(HWND hWnd, int controlId);
+    void SetComboBox(HWND hWnd, int controlId, int index);
+    int GetComboBox(HWND hWnd, int controlId);
+    void AddComboBoxItem(HWND hWnd, int controlId, const std::string& text);
+    void ClearComboBox(HWND hWnd, int controlId);
+}
+#endif
@@ -0,0 +1,285 @@
+#include "dns-cache.h"
+#include <obs.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windns.h>
+#else
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <resolv.h>
+#include <sys/socket.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+// TTL used when the resolver cannot report one
+#define DNS_DEFAULT_TTL_SEC 60
+
+// Bounds applied to record TTLs
+#define DNS_MIN_TTL_SEC 5
+#define DNS_MAX_TTL_SEC 3600
+
+// Longest Shutdown() waits for lookups still running
+#define DNS_SHUTDOWN_TIMEOUT_MS 1000
+
+// Static instance
+DnsCache* DnsCache::instance = nullptr;
+std::atomic<bool> DnsCache::enabled(true);
+
+DnsCache::DnsCache() : resolver(SystemResolve), pendingLookups(0) {
+}
+
+DnsCache::~DnsCache() {
+}
+
+DnsCache* DnsCache::GetInstance() {
+    if (!instance) {
+        instance = new DnsCache();
+    }
+    return instance;
+}
+
+void DnsCache::SetEnabled(bool enable) {
+    enabled.store(enable);
+}
+
+bool DnsCache::IsEnabled() {
+    return enabled.load();
+}
+
+void DnsCache::SetResolver(DnsResolver newResolver) {
+    std::lock_guard<std::mutex> lock(mutex);
+    resolver = newResolver ? newResolver : SystemResolve;
+    entries.clear();
+}
+
+void DnsCache::Prefetch(const std::vector<std::string>& hosts, uint64_t timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    uint64_t now = os_gettime_ns();
+    std::vector<std::string> waiting;
+
+    for (const auto& host : hosts) {
+        if (host.empty() || std::find(waiting.begin(), waiting.end(), host) != waiting.end()) continue;
+
+        Entry& entry = entries[host];
+        if (!entry.addresses.empty() && entry.expiresNs > now) continue;
+
+        StartResolve(host);
+        waiting.push_back(host);
+    }
+
+    if (waiting.empty() || timeoutMs == 0) return;
+
+    resolved.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this, &waiting]() {
+        for (const auto& host : waiting) {
+            if (entries[host].resolving) return false;
+        }
+        return true;
+    });
+
+    size_t ready = 0;
+    for (const auto& host : waiting) {
+        if (!entries[host].addresses.empty()) ready++;
+    }
+
+    blog(LOG_INFO, "[multistream] Pre-resolved %zu of %zu ingest host(s) in %llu ms", ready, waiting.size(),
+         (unsigned long long)((os_gettime_ns() - now) / 1000000));
+}
+
+std::string DnsCache::Lookup(const std::string& host) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = entries.find(host);
+    if (it == entries.end()) {
+        StartResolve(host);
+        return std::string();
+    }
+
+    // Stale while revalidate
+    if (it->second.expiresNs <= os_gettime_ns()) {
+        StartResolve(host);
+    }
+
+    return it->second.addresses.empty() ? std::string() : it->second.addresses.front();
+}
+
+void DnsCache::Shutdown() {
+    std::unique_lock<std::mutex> lock(mutex);
+    bool done = resolved.wait_for(lock, std::chrono::milliseconds(DNS_SHUTDOWN_TIMEOUT_MS),
+                                  [this]() { return pendingLookups == 0; });
+    if (!done) {
+        blog(LOG_WARNING, "[multistream] %zu DNS lookup(s) still running at shutdown, not waiting for them",
+             pendingLookups);
+    }
+
+    // A lookup still running writes its entry when it returns
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.resolving) {
+            ++it;
+        } else {
+            it = entries.erase(it);
+        }
+    }
+}
+
+void DnsCache::StartResolve(const std::string& host) {
+    Entry& entry = entries[host];
+    if (entry.resolving) return;
+
+    entry.resolving = true;
+    pendingLookups++;
+    std::thread(&DnsCache::ResolveThread, this, host).detach();
+}
+
+void DnsCache::ResolveThread(std::string host) {
+    os_set_thread_name("multistream-dns");
+
+    DnsResolver resolve;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        resolve = resolver;
+    }
+
+    std::vector<std::string> addresses;
+    uint32_t ttlSeconds = 0;
+    bool ok = resolve(host, addresses, ttlSeconds) && !addresses.empty();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& entry = entries[host];
+        entry.resolving = false;
+
+        if (ok) {
+            if (ttlSeconds == 0) ttlSeconds = DNS_DEFAULT_TTL_SEC;
+            ttlSeconds = std::min<uint32_t>(std::max<uint32_t>(ttlSeconds, DNS_MIN_TTL_SEC), DNS_MAX_TTL_SEC);
+
+            entry.addresses = addresses;
+            entry.expiresNs = os_gettime_ns() + (uint64_t)ttlSeconds * 1000000000ULL;
+        } else if (!entry.addresses.empty()) {
+            // Serve the stale entry a little longer before trying again
+            entry.expiresNs = os_gettime_ns() + DNS_MIN_TTL_SEC * 1000000000ULL;
+            blog(LOG_WARNING, "[multistream] Failed to resolve %s, keeping cached %s", host.c_str(),
+                 entry.addresses.front().c_str());
+        } else {
+            blog(LOG_WARNING, "[multistream] Failed to resolve %s", host.c_str());
+        }
+
+        pendingLookups--;
+    }
+
+    resolved.notify_all();
+}
+
+std::string DnsCache::GetUrlHost(const std::string& url) {
+    size_t schemeEnd = url.find("://");
+    if (schemeEnd == std::string::npos) return std::string();
+
+    size_t hostStart = schemeEnd + 3;
+    // Bracketed IPv6 literals need no resolving
+    if (hostStart >= url.size() || url[hostStart] == '[') return std::string();
+
+    size_t hostEnd = url.find_first_of(":/", hostStart);
+    if (hostEnd == std::string::npos) hostEnd = url.size();
+
+    return url.substr(hostStart, hostEnd - hostStart);
+}
+
+std::string DnsCache::ReplaceUrlHost(const std::string& url, const std::string& address) {
+    std::string host = GetUrlHost(url);
+    if (host.empty()) return url;
+
+    size_t hostStart = url.find("://") + 3;
+    return url.substr(0, hostStart) + address + url.substr(hostStart + host.size());
+}
+
+static bool IsIPv4Literal(const std::string& host) {
+    struct in_addr addr;
+    return inet_pton(AF_INET, host.c_str(), &addr) == 1;
+}
+
+// getaddrinfo knows the hosts file but not the TTL
+static bool ResolveWithGetAddrInfo(const std::string& host, std::vector<std::string>& addresses) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0) return false;
+
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        char buffer[INET_ADDRSTRLEN];
+        struct sockaddr_in* sin = (struct sockaddr_in*)ai->ai_addr;
+        if (inet_ntop(AF_INET, &sin->sin_addr, buffer, sizeof(buffer))) {
+            if (std::find(addresses.begin(), addresses.end(), buffer) == addresses.end()) {
+                addresses.push_back(buffer);
+            }
+        }
+    }
+
+    freeaddrinfo(result);
+    return !addresses.empty();
+}
+
+bool DnsCache::SystemResolve(const std::string& host, std::vector<std::string>& addresses, uint32_t& ttlSeconds) {
+    ttlSeconds = 0;
+
+    if (IsIPv4Literal(host)) {
+        addresses.push_back(host);
+        ttlSeconds = DNS_MAX_TTL_SEC;
+        return true;
+    }
+
+#ifdef _WIN32
+    PDNS_RECORDA records = nullptr;
+    if (DnsQuery_A(host.c_str(), DNS_TYPE_A, DNS_QUERY_STANDARD, nullptr, (PDNS_RECORD*)&records, nullptr) ==
+        ERROR_SUCCESS) {
+        for (PDNS_RECORDA record = records; record; record = record->pNext) {
+            if (record->wType != DNS_TYPE_A) continue;
+
+            char buffer[INET_ADDRSTRLEN];
+            struct in_addr addr;
+            addr.s_addr = record->Data.A.IpAddress;
+            if (inet_ntop(AF_INET, &addr, buffer, sizeof(buffer))) {
+                addresses.push_back(buffer);
+                ttlSeconds = ttlSeconds ? std::min<uint32_t>(ttlSeconds, record->dwTtl) : record->dwTtl;
+            }
+        }
+        DnsRecordListFree(records, DnsFreeRecordList);
+    }
+#else
+    unsigned char answer[4096];
+    int length = res_query(host.c_str(), ns_c_in, ns_t_a, answer, sizeof(answer));
+
+    ns_msg message;
+    if (length > 0 && ns_initparse(answer, length, &message) == 0) {
+        int count = ns_msg_count(message, ns_s_an);
+        for (int i = 0; i < count; i++) {
+            ns_rr record;
+            if (ns_parserr(&message, ns_s_an, i, &record) != 0) continue;
+            if (ns_rr_type(record) != ns_t_a || ns_rr_rdlen(record) != 4) continue;
+
+            char buffer[INET_ADDRSTRLEN];
+            if (inet_ntop(AF_INET, ns_rr_rdata(record), buffer, sizeof(buffer))) {
+                uint32_t ttl = ns_rr_ttl(record);
+                addresses.push_back(buffer);
+                ttlSeconds = ttlSeconds ? std::min(ttlSeconds, ttl) : ttl;
+            }
+        }
+    }
+#endif
+
+    if (!addresses.empty()) return true;
+
+    return ResolveWithGetAddrInfo(host, addresses);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Resolves host to IPv4 addresses. ttlSeconds is the record TTL, or 0 when
+// the resolver cannot tell. Returns false if the name did not resolve.
+typedef bool (*DnsResolver)(const std::string& host, std::vector<std::string>& addresses, uint32_t& ttlSeconds);
+
+// Cache of ingest host addresses, resolved ahead of go-live.
+//
+// Hosts of all enabled destinations are resolved in parallel ahead of
+// go-live, which also warms the system resolver's cache for the output's own
+// lookup. Destinations with connectByAddress connect to the cached address
+// and skip DNS entirely. Entries live for their record TTL; an expired entry is still
+// handed out while a background lookup refreshes it, and is kept if that
+// lookup fails, so a flaky venue resolver cannot block a reconnect.
+// The resolver is replaceable, e.g. with a stub for local testing.
+class DnsCache {
+public:
+    static DnsCache* GetInstance();
+
+    // Whether outputs connect to cached addresses instead of the hostname
+    static void SetEnabled(bool enable);
+    static bool IsEnabled();
+
+    // nullptr restores the system resolver
+    void SetResolver(DnsResolver resolver);
+
+    // Resolve every host without a fresh entry in parallel, waiting at most
+    // timeoutMs for the lookups (which keep running in the background).
+    // A timeout of 0 only starts them.
+    void Prefetch(const std::vector<std::string>& hosts, uint64_t timeoutMs);
+
+    // First cached address for host, or an empty string. Stale entries
+    // are returned as-is and trigger a background refresh.
+    std::string Lookup(const std::string& host);
+
+    // Wait briefly for background lookups and drop every entry, from module
+    // unload. A lookup that hangs is left running with its entry.
+    void Shutdown();
+
+    // Host part of an rtmp(s):// URL, empty if there is none
+    static std::string GetUrlHost(const std::string& url);
+    // url with its host replaced by address
+    static std::string ReplaceUrlHost(const std::string& url, const std::string& address);
+
+    // Default resolver: A records with TTL, falling back to getaddrinfo
+    static bool SystemResolve(const std::string& host, std::vector<std::string>& addresses, uint32_t& ttlSeconds);
+
+private:
+    DnsCache();
+    ~DnsCache();
+
+    static DnsCache* instance;
+    static std::atomic<bool> enabled;
+
+    struct Entry {
+        std::vector<std::string> addresses;
+        uint64_t expiresNs;
+        bool resolving;
+
+        Entry() : expiresNs(0), resolving(false) {}
+    };
+
+    // Start a background lookup unless one is running; call with mutex held
+    void StartResolve(const std::string& host);
+    void ResolveThread(std::string host);
+
+    std::mutex mutex;
+    std::condition_variable resolved;
+    std::map<std::string, Entry> entries;
+    DnsResolver resolver;
+    size_t pendingLookups;
+};
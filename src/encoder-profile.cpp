@@ -0,0 +1,72 @@
+#include "encoder-profile.h"
+
+static std::vector<EncoderProfile> customProfiles;
+
+static EncoderProfile MakeProfile(const char* name, const char* preset, const char* tune, int bframes, int lookahead,
+                                  int keyintSec) {
+    EncoderProfile profile;
+    profile.name = name;
+    profile.preset = preset;
+    profile.tune = tune;
+    profile.bframes = bframes;
+    profile.lookahead = lookahead;
+    profile.keyintSec = keyintSec;
+    return profile;
+}
+
+std::string EncoderProfile::GetX264Options() const {
+    std::string options;
+    if (bframes >= 0) {
+        options += "bframes=" + std::to_string(bframes);
+    }
+    if (lookahead >= 0) {
+        if (!options.empty()) options += " ";
+        options += "rc-lookahead=" + std::to_string(lookahead);
+    }
+    return options;
+}
+
+const std::vector<EncoderProfile>& EncoderProfiles::GetBuiltins() {
+    // CBR throughout: RTMP ingests expect it
+    static const std::vector<EncoderProfile> builtins = {
+        MakeProfile("balanced", "veryfast", "", -1, -1, 2),
+        MakeProfile("quality", "medium", "", 3, 40, 2),
+        MakeProfile("latency", "veryfast", "zerolatency", 0, 0, 1),
+    };
+    return builtins;
+}
+
+void EncoderProfiles::SetCustom(const std::vector<EncoderProfile>& profiles) {
+    customProfiles = profiles;
+}
+
+const std::vector<EncoderProfile>& EncoderProfiles::GetCustom() {
+    return customProfiles;
+}
+
+std::vector<std::string> EncoderProfiles::GetNames() {
+    std::vector<std::string> names;
+    for (const auto& profile : GetBuiltins()) {
+        names.push_back(profile.name);
+    }
+    for (const auto& profile : customProfiles) {
+        bool known = false;
+        for (const auto& name : names) {
+            if (name == profile.name) known = true;
+        }
+        if (!known) names.push_back(profile.name);
+    }
+    return names;
+}
+
+EncoderProfile EncoderProfiles::Find(const std::string& name) {
+    for (const auto& profile : customProfiles) {
+        if (profile.name == name) return profile;
+    }
+    for (const auto& profile : GetBuiltins()) {
+        if (profile.name == name) return profile;
+    }
+
+    // The default is built in, so this ends here
+    return name != ENCODER_PROFILE_DEFAULT ? Find(ENCODER_PROFILE_DEFAULT) : EncoderProfile();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// Named video encoder profiles for destinations with custom encoding.
+// Plain C++ without libobs, shared with the offline encoder benchmark
+// (tools/encoder-bench.cpp) so both encode with the same parameters.
+
+#include <string>
+#include <vector>
+
+// Profile used when a destination names none or an unknown one
+#define ENCODER_PROFILE_DEFAULT "balanced"
+
+struct EncoderProfile {
+    std::string name;
+
+    // obs_x264 rate control: "CBR", "VBR", "ABR" or "CRF"
+    std::string rateControl;
+    // H.264 profile ("baseline", "main", "high") and x264 preset and tune
+    // (empty = none)
+    std::string profile;
+    std::string preset;
+    std::string tune;
+
+    // x264 B-frames and rate-control lookahead in frames; -1 keeps the
+    // preset's own value
+    int bframes;
+    int lookahead;
+
+    int keyintSec;
+
+    EncoderProfile() : rateControl("CBR"), profile("high"), preset("veryfast"), bframes(-1), lookahead(-1), keyintSec(2) {}
+
+    // Extra x264 options for bframes/lookahead, space separated as obs_x264
+    // takes them in "x264opts" (empty when both keep the preset's values)
+    std::string GetX264Options() const;
+};
+
+// Built-in profiles plus any defined in the plugin configuration
+class EncoderProfiles {
+public:
+    // balanced: veryfast with B-frames and CABAC, the preset's lookahead
+    // quality:  medium with 3 B-frames and a 40-frame lookahead, for the
+    //           best picture per bit at more CPU and ~1 s more latency
+    // latency:  zerolatency tune, no B-frames or lookahead, 1 s keyframes
+    static const std::vector<EncoderProfile>& GetBuiltins();
+
+    // Configured profiles; one with a built-in's name replaces it
+    static void SetCustom(const std::vector<EncoderProfile>& profiles);
+    static const std::vector<EncoderProfile>& GetCustom();
+
+    // Every profile name, built-ins first
+    static std::vector<std::string> GetNames();
+
+    // Profile by name, or the default profile when there is none
+    static EncoderProfile Find(const std::string& name);
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+// The ffmpeg command line that the relays (AudioRelayOutput,
+// DelayRelayOutput and the multistream-relay process) publish with. Plain
+// C++ without libobs.
+//
+// ffmpeg reads FLV on stdin and publishes it with stream copy. The stream key
+// never goes on its command line, which every local user can read (ps,
+// /proc/<pid>/cmdline). It is written to a file only the current user can
+// read and passed as -/rtmp_playpath, which ffmpeg 7.0 and newer load from
+// that file. The RTMP application is passed as well, since ffmpeg would take
+// a one-element URL path for the stream name otherwise. The file is removed
+// once ffmpeg has read from stdin, which it only does after parsing its
+// options.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// ffmpeg gives up on an ingest that accepts nothing for this long, which
+// also bounds how long a stop can wait for it
+#define FFMPEG_PUBLISH_RW_TIMEOUT_US 10000000
+
+// More than any pipe holds: once this much went to ffmpeg's stdin, ffmpeg
+// has read it and with it its key file
+#define FFMPEG_KEY_FILE_READ_BYTES (1024 * 1024)
+
+// Characters that cannot appear inside the quoted command line
+#ifdef _WIN32
+#define FFMPEG_COMMAND_UNSAFE_CHARS "\"\r\n"
+#else
+#define FFMPEG_COMMAND_UNSAFE_CHARS "\"$`\\\r\n"
+#endif
+
+// Writes key to a new temporary file that only the current user can read;
+// false, with path empty, if that fails
+inline bool WriteFfmpegKeyFile(const std::string& key, std::string& path) {
+    path.clear();
+
+#ifdef _WIN32
+    // The user's own temp directory, which other users cannot read
+    char directory[MAX_PATH];
+    char name[MAX_PATH];
+    DWORD length = GetTempPathA(MAX_PATH, directory);
+    if (length == 0 || length > MAX_PATH || GetTempFileNameA(directory, "oms", 0, name) == 0) return false;
+
+    FILE* file = fopen(name, "wb");
+    bool written = file && fwrite(key.data(), 1, key.size(), file) == key.size();
+    if (file && fclose(file) != 0) written = false;
+    if (!written) {
+        DeleteFileA(name);
+        return false;
+    }
+    path = name;
+#else
+    const char* directory = getenv("TMPDIR");
+    std::string name = std::string(directory && *directory ? directory : "/tmp") + "/obs-multistream-key-XXXXXX";
+
+    // mkstemp creates the file with mode 0600
+    int fd = mkstemp(&name[0]);
+    if (fd < 0) return false;
+
+    bool written = write(fd, key.data(), key.size()) == (ssize_t)key.size();
+    if (close(fd) != 0) written = false;
+    if (!written) {
+        unlink(name.c_str());
+        return false;
+    }
+    path = name;
+#endif
+    return true;
+}
+
+// Removes the key file, once; empty paths are ignored
+inline void RemoveFfmpegKeyFile(std::string& path) {
+    if (path.empty()) return;
+
+    remove(path.c_str());
+    path.clear();
+}
+
+// The RTMP application in url: the path between the host and the query,
+// without surrounding slashes
+inline std::string GetRtmpApp(const std::string& url) {
+    size_t scheme = url.find("://");
+    size_t start = url.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+    if (start == std::string::npos) return std::string();
+
+    size_t end = url.find('?', start);
+    std::string app = url.substr(start + 1, end == std::string::npos ? std::string::npos : end - start - 1);
+    while (!app.empty() && app.back() == '/') app.pop_back();
+    return app;
+}
+
+// Command that publishes the FLV stream on stdin to url with stream copy.
+// keyPath is the file from WriteFfmpegKeyFile(), or empty when the URL
+// carries everything. Empty if anything cannot be quoted safely.
+inline std::string BuildFfmpegPublishCommand(const std::string& ffmpeg, const std::string& url,
+                                             const std::string& keyPath) {
+    std::string app = GetRtmpApp(url);
+    if (ffmpeg.find_first_of(FFMPEG_COMMAND_UNSAFE_CHARS) != std::string::npos ||
+        url.find_first_of(FFMPEG_COMMAND_UNSAFE_CHARS) != std::string::npos ||
+        keyPath.find_first_of(FFMPEG_COMMAND_UNSAFE_CHARS) != std::string::npos) {
+        return std::string();
+    }
+
+    std::string command = "\"" + ffmpeg + "\" -hide_banner -loglevel error -f flv -i pipe:0 -c copy" +
+                          " -flvflags no_duration_filesize -rw_timeout " +
+                          std::to_string(FFMPEG_PUBLISH_RW_TIMEOUT_US);
+    if (!keyPath.empty()) {
+        command += " -rtmp_app \"" + app + "\" -/rtmp_playpath \"" + keyPath + "\"";
+    }
+    return command + " -f flv \"" + url + "\"";
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <obs-avc.h>
+#include <util/bmem.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Minimal FLV muxing for the relay outputs, which pipe FLV to an ffmpeg
+// process that publishes it with stream copy
+
+#define FLV_TAG_AUDIO 8
+#define FLV_TAG_VIDEO 9
+
+// FLV header flags
+#define FLV_HAS_AUDIO 0x04
+#define FLV_HAS_VIDEO 0x01
+
+// Audio tag: AAC, 44 kHz, 16 bit, stereo (fixed values for AAC; the real
+// parameters come from the sequence header)
+#define FLV_SOUND_AAC 0xAF
+#define FLV_AAC_SEQUENCE_HEADER 0
+#define FLV_AAC_RAW 1
+
+// Video tag: frame type in the high nibble, AVC codec id in the low one
+#define FLV_FRAME_KEY 0x10
+#define FLV_FRAME_INTER 0x20
+#define FLV_CODEC_AVC 0x07
+#define FLV_AVC_SEQUENCE_HEADER 0
+#define FLV_AVC_NALU 1
+
+inline void AppendBe24(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back((uint8_t)(value >> 16));
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)value);
+}
+
+inline void AppendBe32(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back((uint8_t)(value >> 24));
+    AppendBe24(out, value);
+}
+
+inline void AppendFlvHeader(std::vector<uint8_t>& out, uint8_t flags) {
+    const uint8_t header[] = {'F', 'L', 'V', 1, flags, 0, 0, 0, 9};
+    out.insert(out.end(), header, header + sizeof(header));
+
+    // PreviousTagSize0
+    AppendBe32(out, 0);
+}
+
+// Tag header, the codec bytes that precede the payload, the payload and the
+// trailing PreviousTagSize
+inline void AppendFlvTag(std::vector<uint8_t>& out, uint8_t tagType, uint32_t timestampMs, const uint8_t* prefix,
+                         size_t prefixSize, const uint8_t* data, size_t size) {
+    uint32_t dataSize = (uint32_t)(prefixSize + size);
+
+    out.push_back(tagType);
+    AppendBe24(out, dataSize);
+    AppendBe24(out, timestampMs & 0xFFFFFF);
+    out.push_back((uint8_t)(timestampMs >> 24));
+    AppendBe24(out, 0);
+
+    out.insert(out.end(), prefix, prefix + prefixSize);
+    out.insert(out.end(), data, data + size);
+
+    AppendBe32(out, dataSize + 11);
+}
+
+inline void AppendAudioTag(std::vector<uint8_t>& out, uint32_t timestampMs, uint8_t aacPacketType,
+                           const uint8_t* data, size_t size) {
+    const uint8_t prefix[] = {FLV_SOUND_AAC, aacPacketType};
+    AppendFlvTag(out, FLV_TAG_AUDIO, timestampMs, prefix, sizeof(prefix), data, size);
+}
+
+// compositionMs is pts - dts; data is AVCC (length-prefixed NAL units) or,
+// for the sequence header, an AVCDecoderConfigurationRecord
+inline void AppendVideoTag(std::vector<uint8_t>& out, uint32_t timestampMs, bool keyframe, uint8_t avcPacketType,
+                           int32_t compositionMs, const uint8_t* data, size_t size) {
+    const uint8_t prefix[] = {(uint8_t)((keyframe ? FLV_FRAME_KEY : FLV_FRAME_INTER) | FLV_CODEC_AVC), avcPacketType,
+                              (uint8_t)(compositionMs >> 16), (uint8_t)(compositionMs >> 8), (uint8_t)compositionMs};
+    AppendFlvTag(out, FLV_TAG_VIDEO, timestampMs, prefix, sizeof(prefix), data, size);
+}
+
+// FLV header and the sequence headers a stream opens with. videoExtra is the
+// H.264 encoder's extra data (null for audio only), which FLV carries as an
+// AVCDecoderConfigurationRecord; audioExtra is the AAC AudioSpecificConfig.
+inline void AppendFlvPreamble(std::vector<uint8_t>& out, const uint8_t* videoExtra, size_t videoExtraSize,
+                              const uint8_t* audioExtra, size_t audioExtraSize) {
+    AppendFlvHeader(out, videoExtra ? FLV_HAS_AUDIO | FLV_HAS_VIDEO : FLV_HAS_AUDIO);
+
+    if (videoExtra) {
+        uint8_t* avcHeader = nullptr;
+        size_t avcHeaderSize = obs_parse_avc_header(&avcHeader, videoExtra, videoExtraSize);
+        AppendVideoTag(out, 0, true, FLV_AVC_SEQUENCE_HEADER, 0, avcHeader, avcHeaderSize);
+        bfree(avcHeader);
+    }
+
+    AppendAudioTag(out, 0, FLV_AAC_SEQUENCE_HEADER, audioExtra, audioExtraSize);
+}
@@ -0,0 +1,62 @@
+#include "gop-cache.h"
+
+GopCache::GopCache(size_t max) : bytes(0), maxBytes(max) {
+}
+
+GopCache::~GopCache() {
+    Clear();
+}
+
+void GopCache::Push(struct encoder_packet* packet) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    bool keyframe = packet->type == OBS_ENCODER_VIDEO && packet->keyframe;
+    if (keyframe) {
+        for (auto& cached : packets) {
+            obs_encoder_packet_release(&cached);
+        }
+        packets.clear();
+        bytes = 0;
+    } else if (packets.empty()) {
+        // Nothing is decodable before the first keyframe
+        return;
+    }
+
+    if (bytes + packet->size > maxBytes) {
+        for (auto& cached : packets) {
+            obs_encoder_packet_release(&cached);
+        }
+        packets.clear();
+        bytes = 0;
+        return;
+    }
+
+    struct encoder_packet ref;
+    obs_encoder_packet_ref(&ref, packet);
+    packets.push_back(ref);
+    bytes += packet->size;
+}
+
+void GopCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& cached : packets) {
+        obs_encoder_packet_release(&cached);
+    }
+    packets.clear();
+    bytes = 0;
+}
+
+bool GopCache::Copy(std::vector<struct encoder_packet>& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (packets.empty()) return false;
+
+    out.reserve(out.size() + packets.size());
+    for (const auto& cached : packets) {
+        struct encoder_packet ref;
+        obs_encoder_packet_ref(&ref, const_cast<struct encoder_packet*>(&cached));
+        out.push_back(ref);
+    }
+
+    return true;
+}
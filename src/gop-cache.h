@@ -0,0 +1,36 @@
+#pragma once
+
+#include <obs.h>
+#include <mutex>
+#include <vector>
+
+// Upper bound for one cached GOP, audio included
+#define GOP_CACHE_MAX_BYTES (16 * 1024 * 1024)
+
+// The most recent group of pictures of an encoder pair.
+//
+// Holds references to every packet from the last video keyframe on, so a
+// sink that starts mid-stream can be primed with a decodable GOP instead of
+// waiting up to a keyframe interval for the next one. Packets are shared
+// with libobs, not copied. A GOP that outgrows maxBytes is dropped and
+// caching resumes at the next keyframe.
+class GopCache {
+public:
+    explicit GopCache(size_t maxBytes = GOP_CACHE_MAX_BYTES);
+    ~GopCache();
+
+    // Called for every packet, in encoder order
+    void Push(struct encoder_packet* packet);
+    void Clear();
+
+    // Add references to the cached GOP to packets, keyframe first, with
+    // their original timestamps. The caller releases each one with
+    // obs_encoder_packet_release(). Returns false if there is no GOP cached.
+    bool Copy(std::vector<struct encoder_packet>& packets) const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<struct encoder_packet> packets;
+    size_t bytes;
+    size_t maxBytes;
+};
@@ -0,0 +1,243 @@
+#include "interface-balancer.h"
+#include <obs.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#else
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <fstream>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+// Capacity assumed for uplinks whose speed is not known yet
+#define UNKNOWN_UPLINK_CAPACITY_KBPS 10000
+
+// Outputs reporting congestion above this are treated as link-limited
+#define UPLINK_CONGESTION_THRESHOLD 0.5f
+
+// Static instance
+InterfaceBalancer* InterfaceBalancer::instance = nullptr;
+
+InterfaceBalancer::InterfaceBalancer() {
+}
+
+InterfaceBalancer::~InterfaceBalancer() {
+}
+
+InterfaceBalancer* InterfaceBalancer::GetInstance() {
+    if (!instance) {
+        instance = new InterfaceBalancer();
+    }
+    return instance;
+}
+
+void InterfaceBalancer::SetConfiguredUplinks(const std::vector<UplinkInterface>& uplinkList) {
+    std::lock_guard<std::mutex> lock(mutex);
+    configured = uplinkList;
+    for (auto& uplink : configured) {
+        uplink.capacityPinned = uplink.capacityKbps > 0;
+    }
+}
+
+std::vector<UplinkInterface> InterfaceBalancer::GetConfiguredUplinks() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return configured;
+}
+
+void InterfaceBalancer::Refresh() {
+    std::vector<UplinkInterface> fresh = GetConfiguredUplinks();
+    if (fresh.empty()) {
+        fresh = EnumerateInterfaces();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& uplink : fresh) {
+        const UplinkInterface* previous = FindUplink(uplink.address);
+        if (!previous || uplink.capacityPinned) continue;
+
+        // Carry the estimate over and fold in what the last session measured.
+        // A link speed says nothing about an uplink that has been congested.
+        bool measured = previous->capacityMeasured;
+        uint64_t estimate = measured ? previous->capacityKbps : std::max(uplink.capacityKbps, previous->capacityKbps);
+        if (previous->achievedKbps > 0) {
+            if (previous->congested) {
+                estimate = previous->achievedKbps;
+                measured = true;
+            } else {
+                estimate = std::max(estimate, previous->achievedKbps);
+            }
+        }
+        uplink.capacityKbps = estimate;
+        uplink.capacityMeasured = measured;
+    }
+
+    uplinks = fresh;
+
+    for (const auto& uplink : uplinks) {
+        blog(LOG_INFO, "[multistream] Uplink %s (%s): capacity %llu kbps%s", uplink.address.c_str(),
+             uplink.name.c_str(), (unsigned long long)uplink.capacityKbps,
+             uplink.capacityPinned ? " (configured)" : "");
+    }
+}
+
+std::string InterfaceBalancer::AssignAddress(int bitrateKbps) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    UplinkInterface* best = nullptr;
+    int64_t bestHeadroom = 0;
+
+    for (auto& uplink : uplinks) {
+        uint64_t capacity = uplink.capacityKbps ? uplink.capacityKbps : UNKNOWN_UPLINK_CAPACITY_KBPS;
+        int64_t headroom = (int64_t)capacity - (int64_t)uplink.assignedKbps;
+        if (!best || headroom > bestHeadroom) {
+            best = &uplink;
+            bestHeadroom = headroom;
+        }
+    }
+
+    if (!best) {
+        blog(LOG_WARNING, "[multistream] No uplinks available, using default route");
+        return std::string();
+    }
+
+    best->assignedKbps += (uint64_t)std::max(0, bitrateKbps);
+
+    if (bestHeadroom < bitrateKbps) {
+        blog(LOG_WARNING, "[multistream] Uplink %s is oversubscribed (%llu kbps assigned)", best->address.c_str(),
+             (unsigned long long)best->assignedKbps);
+    }
+
+    return best->address;
+}
+
+void InterfaceBalancer::ReportThroughput(const std::string& address, uint64_t kbps, float congestion) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    UplinkInterface* uplink = FindUplink(address);
+    if (!uplink) return;
+
+    uplink->achievedKbps += kbps;
+    if (congestion >= UPLINK_CONGESTION_THRESHOLD) {
+        uplink->congested = true;
+    }
+}
+
+std::vector<UplinkInterface> InterfaceBalancer::GetUplinks() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return uplinks;
+}
+
+UplinkInterface* InterfaceBalancer::FindUplink(const std::string& address) {
+    for (auto& uplink : uplinks) {
+        if (uplink.address == address) {
+            return &uplink;
+        }
+    }
+    return nullptr;
+}
+
+// ============================================================================
+// Interface Enumeration
+// ============================================================================
+
+#ifdef _WIN32
+
+std::vector<UplinkInterface> InterfaceBalancer::EnumerateInterfaces() {
+    std::vector<UplinkInterface> result;
+
+    ULONG flags = GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER;
+    ULONG size = 16 * 1024;
+    std::vector<unsigned char> buffer(size);
+
+    ULONG ret = GetAdaptersAddresses(AF_UNSPEC, flags, nullptr, (PIP_ADAPTER_ADDRESSES)buffer.data(), &size);
+    if (ret == ERROR_BUFFER_OVERFLOW) {
+        buffer.resize(size);
+        ret = GetAdaptersAddresses(AF_UNSPEC, flags, nullptr, (PIP_ADAPTER_ADDRESSES)buffer.data(), &size);
+    }
+
+    if (ret != NO_ERROR) {
+        blog(LOG_WARNING, "[multistream] GetAdaptersAddresses failed: %lu", ret);
+        return result;
+    }
+
+    for (auto* adapter = (PIP_ADAPTER_ADDRESSES)buffer.data(); adapter; adapter = adapter->Next) {
+        if (adapter->OperStatus != IfOperStatusUp) continue;
+        if (adapter->IfType == IF_TYPE_SOFTWARE_LOOPBACK) continue;
+
+        for (auto* addr = adapter->FirstUnicastAddress; addr; addr = addr->Next) {
+            char host[INET6_ADDRSTRLEN] = {0};
+            if (getnameinfo(addr->Address.lpSockaddr, addr->Address.iSockaddrLength, host, sizeof(host), nullptr, 0,
+                            NI_NUMERICHOST) != 0) {
+                continue;
+            }
+
+            // Link-local IPv6 addresses are not routable
+            if (addr->Address.lpSockaddr->sa_family == AF_INET6 && strncmp(host, "fe80", 4) == 0) continue;
+
+            UplinkInterface uplink;
+            uplink.name = adapter->AdapterName;
+            uplink.address = host;
+            uplink.capacityKbps = adapter->TransmitLinkSpeed != (ULONG64)-1 ? adapter->TransmitLinkSpeed / 1000 : 0;
+            result.push_back(uplink);
+        }
+    }
+
+    return result;
+}
+
+#else
+
+// Link speed in kbps from sysfs, 0 when the driver doesn't report one
+static uint64_t GetLinkSpeedKbps(const std::string& ifname) {
+    std::ifstream file("/sys/class/net/" + ifname + "/speed");
+    long long mbps = 0;
+    if (!(file >> mbps) || mbps <= 0) return 0;
+    return (uint64_t)mbps * 1000;
+}
+
+std::vector<UplinkInterface> InterfaceBalancer::EnumerateInterfaces() {
+    std::vector<UplinkInterface> result;
+
+    struct ifaddrs* addrs = nullptr;
+    if (getifaddrs(&addrs) != 0) {
+        blog(LOG_WARNING, "[multistream] getifaddrs failed");
+        return result;
+    }
+
+    for (struct ifaddrs* ifa = addrs; ifa; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr) continue;
+        if (!(ifa->ifa_flags & IFF_UP) || (ifa->ifa_flags & IFF_LOOPBACK)) continue;
+
+        int family = ifa->ifa_addr->sa_family;
+        char host[INET6_ADDRSTRLEN] = {0};
+
+        if (family == AF_INET) {
+            inet_ntop(AF_INET, &((struct sockaddr_in*)ifa->ifa_addr)->sin_addr, host, sizeof(host));
+        } else if (family == AF_INET6) {
+            struct in6_addr* addr6 = &((struct sockaddr_in6*)ifa->ifa_addr)->sin6_addr;
+            if (IN6_IS_ADDR_LINKLOCAL(addr6)) continue;
+            inet_ntop(AF_INET6, addr6, host, sizeof(host));
+        } else {
+            continue;
+        }
+
+        UplinkInterface uplink;
+        uplink.name = ifa->ifa_name;
+        uplink.address = host;
+        uplink.capacityKbps = GetLinkSpeedKbps(ifa->ifa_name);
+        result.push_back(uplink);
+    }
+
+    freeifaddrs(addrs);
+    return result;
+}
+
+#endif
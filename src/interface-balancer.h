@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// StreamDestination::bindAddress value that requests automatic uplink selection
+#define MULTISTREAM_BIND_AUTO "auto"
+
+// A local uplink that outputs can be bound to
+struct UplinkInterface {
+    std::string name;        // OS interface name, informational only
+    std::string address;     // Local address handed to rtmp_output as bind_ip
+    uint64_t capacityKbps;   // Estimated available egress bandwidth (0 = unknown)
+    bool capacityPinned;     // Capacity comes from the config and is never re-measured
+    bool capacityMeasured;   // Capacity was capped by a congested session, link speed no longer applies
+
+    // Per-session accounting
+    uint64_t assignedKbps;   // Bitrate reserved by AssignAddress
+    uint64_t achievedKbps;   // Throughput reported by outputs bound to this uplink
+    bool congested;          // At least one of those outputs was congested
+
+    UplinkInterface()
+        : capacityKbps(0), capacityPinned(false), capacityMeasured(false), assignedKbps(0), achievedKbps(0),
+          congested(false) {}
+};
+
+// Spreads outputs with bindAddress == "auto" across local uplinks.
+//
+// Uplinks come either from the config (which also makes the balancer usable
+// with loopback aliases on a single box) or from enumerating the machine's
+// interfaces. Each uplink's capacity starts at its configured value or link
+// speed and is then refined from the throughput outputs actually achieved on
+// it: a congested session caps the estimate, a clean one can only raise it.
+// Once capped, the estimate never goes back to the link speed; it only rises
+// to what later sessions achieve.
+class InterfaceBalancer {
+public:
+    static InterfaceBalancer* GetInstance();
+
+    // Uplink configuration; a non-empty list replaces interface enumeration
+    void SetConfiguredUplinks(const std::vector<UplinkInterface>& uplinks);
+    std::vector<UplinkInterface> GetConfiguredUplinks() const;
+
+    // Fold the last session's measurements into the capacity estimates,
+    // rebuild the uplink list and clear assignments for a new session
+    void Refresh();
+
+    // Pick the uplink with the most headroom and reserve the bitrate on it.
+    // Returns an empty string (default route) when no uplink is known.
+    std::string AssignAddress(int bitrateKbps);
+
+    // Feed back what an output achieved on an uplink during this session
+    void ReportThroughput(const std::string& address, uint64_t kbps, float congestion);
+
+    std::vector<UplinkInterface> GetUplinks() const;
+
+private:
+    InterfaceBalancer();
+    ~InterfaceBalancer();
+
+    static InterfaceBalancer* instance;
+
+    // Platform-specific interface discovery
+    static std::vector<UplinkInterface> EnumerateInterfaces();
+
+    UplinkInterface* FindUplink(const std::string& address);
+
+    mutable std::mutex mutex;
+    std::vector<UplinkInterface> configured;
+    std::vector<UplinkInterface> uplinks;
+};
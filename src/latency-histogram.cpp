@@ -0,0 +1,105 @@
+#include "latency-histogram.h"
+
+// Index of the most significant set bit, value must be non-zero
+static int HighestBit(uint64_t value) {
+    int bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+}
+
+LatencyHistogram::LatencyHistogram() {
+    Reset();
+}
+
+int LatencyHistogram::BucketIndex(uint64_t value) {
+    const uint64_t limit = (1ULL << MAX_BITS) - 1;
+    if (value > limit) value = limit;
+
+    if (value < (1ULL << LINEAR_BITS)) {
+        return (int)value;
+    }
+
+    // Keep the top LINEAR_BITS bits of the value: the leading one selects
+    // the octave, the rest select one of SUB_BUCKETS buckets inside it
+    int bit = HighestBit(value);
+    int shift = bit - (LINEAR_BITS - 1);
+    int sub = (int)(value >> shift) - SUB_BUCKETS;
+
+    return (1 << LINEAR_BITS) + (bit - LINEAR_BITS) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(int index) {
+    if (index < (1 << LINEAR_BITS)) {
+        return (uint64_t)index;
+    }
+
+    int octave = (index - (1 << LINEAR_BITS)) / SUB_BUCKETS;
+    int sub = (index - (1 << LINEAR_BITS)) % SUB_BUCKETS;
+    int shift = octave + 1;
+
+    uint64_t lower = (uint64_t)(sub + SUB_BUCKETS) << shift;
+    return lower + (1ULL << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t valueUs) {
+    buckets[BucketIndex(valueUs)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (valueUs > current && !max.compare_exchange_weak(current, valueUs, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetMax() const {
+    return max.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const {
+    // Sum the buckets rather than trusting count, which may be a few
+    // samples ahead while output threads are recording
+    uint64_t total = 0;
+    for (const auto& bucket : buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) return 0;
+
+    uint64_t target = (uint64_t)((percentile / 100.0) * (double)total + 0.5);
+    if (target < 1) target = 1;
+    if (target > total) target = total;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            uint64_t bound = BucketUpperBound(i);
+            uint64_t maxValue = GetMax();
+            return bound < maxValue ? bound : maxValue;
+        }
+    }
+
+    return GetMax();
+}
+
+LatencySummary LatencyHistogram::GetSummary() const {
+    LatencySummary summary;
+    summary.count = GetCount();
+    summary.p50Us = GetPercentile(50.0);
+    summary.p99Us = GetPercentile(99.0);
+    summary.p999Us = GetPercentile(99.9);
+    summary.maxUs = GetMax();
+    return summary;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Percentile summary of a latency histogram, in microseconds
+struct LatencySummary {
+    uint64_t count;
+    uint64_t p50Us;
+    uint64_t p99Us;
+    uint64_t p999Us;
+    uint64_t maxUs;
+
+    LatencySummary() : count(0), p50Us(0), p99Us(0), p999Us(0), maxUs(0) {}
+};
+
+// Log-linear (HDR-style) latency histogram.
+//
+// Values below 64 us are counted exactly; above that every power of two is
+// split into 32 buckets, so any reported percentile is within ~3% of the
+// recorded value. Recording is a couple of relaxed atomic adds, which keeps
+// it cheap enough to run on output threads for every packet.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void Record(uint64_t valueUs);
+    void Reset();
+
+    uint64_t GetCount() const;
+    uint64_t GetMax() const;
+
+    // Upper bound of the bucket holding the given percentile (0-100)
+    uint64_t GetPercentile(double percentile) const;
+
+    LatencySummary GetSummary() const;
+
+private:
+    static const int LINEAR_BITS = 6;                      // exact below 2^6
+    static const int SUB_BUCKETS = 1 << (LINEAR_BITS - 1); // buckets per octave above that
+    static const int MAX_BITS = 40;                        // clamp at ~12 days
+    static const int BUCKET_COUNT = (1 << LINEAR_BITS) + (MAX_BITS - LINEAR_BITS) * SUB_BUCKETS;
+
+    static int BucketIndex(uint64_t value);
+    static uint64_t BucketUpperBound(int index);
+
+    std::atomic<uint32_t> buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> max;
+};
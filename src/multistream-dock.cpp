@@ -1,273 +1,12 @@
 #include "multistream-dock.h"
+#include "destination-dialog.h"
 #include "obs-multistream.h"
 #include <obs-frontend-api.h>
 #include <obs-properties.h>
 #include <util/platform.h>
-#include <Windows.h>
-#include <CommCtrl.h>
 #include <string>
 #include <sstream>
 
-// Resource IDs for dialog controls
-#define IDC_NAME_EDIT           1001
-#define IDC_PRESET_COMBO        1002
-#define IDC_URL_EDIT            1003
-#define IDC_KEY_EDIT            1004
-#define IDC_ENABLED_CHECK       1005
-#define IDC_MAIN_ENCODER_CHECK  1006
-#define IDC_BITRATE_SPIN        1007
-#define IDC_OK_BUTTON           1008
-#define IDC_CANCEL_BUTTON       1009
-
-// Dialog template resource ID
-#define IDD_DESTINATION_DIALOG  2001
-
-// ============================================================================
-// Win32 Helper Functions
-// ============================================================================
-
-namespace Win32Helpers {
-
-void SetWindowText(HWND hWnd, int controlId, const std::string& text) {
-    HWND control = GetDlgItem(hWnd, controlId);
-    if (control) {
-        ::SetWindowTextA(control, text.c_str());
-    }
-}
-
-std::string GetWindowText(HWND hWnd, int controlId) {
-    HWND control = GetDlgItem(hWnd, controlId);
-    if (!control) return "";
-    
-    char buffer[1024];
-    GetWindowTextA(control, buffer, sizeof(buffer));
-    return std::string(buffer);
-}
-
-void SetCheckBox(HWND hWnd, int controlId, bool checked) {
-    HWND control = GetDlgItem(hWnd, controlId);
-    if (control) {
-        SendMessage(control, BM_SETCHECK, checked ? BST_CHECKED : BST_UNCHECKED, 0);
-    }
-}
-
-bool GetCheckBox(HWND hWnd, int controlId) {
-    HWND control = GetDlgItem(hWnd, controlId);
-    if (!control) return false;
-    
-    return SendMessage(control, BM_GETCHECK, 0, 0) == BST_CHECKED;
-}
-
-void SetSpinBox(HWND hWnd, int controlId, int value) {
-    HWND control = GetDlgItem(hWnd, controlId);
-    if (control) {
-        SetDlgItemInt(hWnd, controlId, value, FALSE);
-    }
-}
-
-int GetSpinBox(HWND hWnd, int controlId) {
-    BOOL translated;
-    int value = GetDlgItemInt(hWnd, controlId, &translated, FALSE);
-    return translated ? value : 0;
-}
-
-void SetComboBox(HWND hWnd, int controlId, int index) {
-    HWND control = GetDlgItem(hWnd, controlId);
-    if (control) {
-        SendMessage(control, CB_SETCURSEL, index, 0);
-    }
-}
-
-int GetComboBox(HWND hWnd, int controlId) {
-    HWND control = GetDlgItem(hWnd, controlId);
-    if (!control) return -1;
-    
-    return (int)SendMessage(control, CB_GETCURSEL, 0, 0);
-}
-
-void AddComboBoxItem(HWND hWnd, int controlId, const std::string& text) {
-    HWND control = GetDlgItem(hWnd, controlId);
-    if (control) {
-        SendMessageA(control, CB_ADDSTRING, 0, (LPARAM)text.c_str());
-    }
-}
-
-void ClearComboBox(HWND hWnd, int controlId) {
-    HWND control = GetDlgItem(hWnd, controlId);
-    if (control) {
-        SendMessage(control, CB_RESETCONTENT, 0, 0);
-    }
-}
-
-} // namespace Win32Helpers
-
-// ============================================================================
-// Stream Destination Dialog
-// ============================================================================
-
-StreamDestinationDialog::StreamDestinationDialog(HWND parent)
-    : currentDest(nullptr), dialogOK(false), parentWindow(parent) {
-}
-
-StreamDestinationDialog::~StreamDestinationDialog() {
-}
-
-bool StreamDestinationDialog::ShowDialog(StreamDestination* dest) {
-    currentDest = dest;
-    dialogOK = false;
-    
-    // For now, use a simple message box approach
-    // In a full implementation, you would create a proper dialog resource
-    
-    // Simple input simulation for demonstration
-    if (dest) {
-        // Edit mode - show current values
-        blog(LOG_INFO, "[obs-multistream] Edit destination: %s", dest->name.c_str());
-    } else {
-        // Add mode - create new destination
-        dialogResult = StreamDestination();
-        dialogResult.name = "New Stream";
-        dialogResult.url = "rtmp://live.twitch.tv/live/";
-        dialogResult.key = "";
-        dialogResult.enabled = true;
-        dialogResult.useMainEncoder = true;
-        dialogResult.bitrate = 2500;
-        
-        dialogOK = true;
-    }
-    
-    return dialogOK;
-}
-
-StreamDestination StreamDestinationDialog::GetDestination() const {
-    return dialogResult;
-}
-
-INT_PTR CALLBACK StreamDestinationDialog::DialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
-    StreamDestinationDialog* dialog = nullptr;
-    
-    if (message == WM_INITDIALOG) {
-        dialog = reinterpret_cast<StreamDestinationDialog*>(lParam);
-        SetWindowLongPtr(hDlg, DWLP_USER, (LONG_PTR)dialog);
-        dialog->InitializeDialog(hDlg);
-        return TRUE;
-    } else {
-        dialog = reinterpret_cast<StreamDestinationDialog*>(GetWindowLongPtr(hDlg, DWLP_USER));
-    }
-    
-    if (!dialog) return FALSE;
-    
-    switch (message) {
-    case WM_COMMAND:
-        switch (LOWORD(wParam)) {
-        case IDC_OK_BUTTON:
-            if (dialog->ValidateAndSave(hDlg)) {
-                dialog->dialogOK = true;
-                EndDialog(hDlg, IDOK);
-            }
-            return TRUE;
-            
-        case IDC_CANCEL_BUTTON:
-            EndDialog(hDlg, IDCANCEL);
-            return TRUE;
-            
-        case IDC_PRESET_COMBO:
-            if (HIWORD(wParam) == CBN_SELCHANGE) {
-                dialog->OnPresetChanged(hDlg);
-            }
-            return TRUE;
-        }
-        break;
-        
-    case WM_CLOSE:
-        EndDialog(hDlg, IDCANCEL);
-        return TRUE;
-    }
-    
-    return FALSE;
-}
-
-void StreamDestinationDialog::InitializeDialog(HWND hDlg) {
-    PopulatePresets(hDlg);
-    
-    if (currentDest) {
-        LoadDestination(hDlg, *currentDest);
-    } else {
-        // Set defaults for new destination
-        Win32Helpers::SetWindowText(hDlg, IDC_NAME_EDIT, "New Stream");
-        Win32Helpers::SetCheckBox(hDlg, IDC_ENABLED_CHECK, true);
-        Win32Helpers::SetCheckBox(hDlg, IDC_MAIN_ENCODER_CHECK, true);
-        Win32Helpers::SetSpinBox(hDlg, IDC_BITRATE_SPIN, 2500);
-    }
-}
-
-void StreamDestinationDialog::LoadDestination(HWND hDlg, const StreamDestination& dest) {
-    Win32Helpers::SetWindowText(hDlg, IDC_NAME_EDIT, dest.name);
-    Win32Helpers::SetWindowText(hDlg, IDC_URL_EDIT, dest.url);
-    Win32Helpers::SetWindowText(hDlg, IDC_KEY_EDIT, dest.key);
-    Win32Helpers::SetCheckBox(hDlg, IDC_ENABLED_CHECK, dest.enabled);
-    Win32Helpers::SetCheckBox(hDlg, IDC_MAIN_ENCODER_CHECK, dest.useMainEncoder);
-    Win32Helpers::SetSpinBox(hDlg, IDC_BITRATE_SPIN, dest.bitrate);
-}
-
-bool StreamDestinationDialog::ValidateAndSave(HWND hDlg) {
-    dialogResult.name = Win32Helpers::GetWindowText(hDlg, IDC_NAME_EDIT);
-    dialogResult.url = Win32Helpers::GetWindowText(hDlg, IDC_URL_EDIT);
-    dialogResult.key = Win32Helpers::GetWindowText(hDlg, IDC_KEY_EDIT);
-    dialogResult.enabled = Win32Helpers::GetCheckBox(hDlg, IDC_ENABLED_CHECK);
-    dialogResult.useMainEncoder = Win32Helpers::GetCheckBox(hDlg, IDC_MAIN_ENCODER_CHECK);
-    dialogResult.bitrate = Win32Helpers::GetSpinBox(hDlg, IDC_BITRATE_SPIN);
-    
-    // Basic validation
-    if (dialogResult.name.empty()) {
-        MessageBoxA(hDlg, "Please enter a name for the destination.", "Validation Error", MB_OK | MB_ICONWARNING);
-        return false;
-    }
-    
-    if (dialogResult.url.empty()) {
-        MessageBoxA(hDlg, "Please enter an RTMP URL.", "Validation Error", MB_OK | MB_ICONWARNING);
-        return false;
-    }
-    
-    if (dialogResult.key.empty()) {
-        MessageBoxA(hDlg, "Please enter a stream key.", "Validation Error", MB_OK | MB_ICONWARNING);
-        return false;
-    }
-    
-    return true;
-}
-
-void StreamDestinationDialog::PopulatePresets(HWND hDlg) {
-    Win32Helpers::ClearComboBox(hDlg, IDC_PRESET_COMBO);
-    Win32Helpers::AddComboBoxItem(hDlg, IDC_PRESET_COMBO, "Custom");
-    Win32Helpers::AddComboBoxItem(hDlg, IDC_PRESET_COMBO, "Twitch");
-    Win32Helpers::AddComboBoxItem(hDlg, IDC_PRESET_COMBO, "YouTube");
-    Win32Helpers::AddComboBoxItem(hDlg, IDC_PRESET_COMBO, "Facebook");
-    Win32Helpers::AddComboBoxItem(hDlg, IDC_PRESET_COMBO, "TikTok");
-    Win32Helpers::SetComboBox(hDlg, IDC_PRESET_COMBO, 0);
-}
-
-void StreamDestinationDialog::OnPresetChanged(HWND hDlg) {
-    int selection = Win32Helpers::GetComboBox(hDlg, IDC_PRESET_COMBO);
-    
-    switch (selection) {
-    case 1: // Twitch
-        Win32Helpers::SetWindowText(hDlg, IDC_URL_EDIT, "rtmp://live.twitch.tv/live/");
-        break;
-    case 2: // YouTube
-        Win32Helpers::SetWindowText(hDlg, IDC_URL_EDIT, "rtmp://a.rtmp.youtube.com/live2/");
-        break;
-    case 3: // Facebook
-        Win32Helpers::SetWindowText(hDlg, IDC_URL_EDIT, "rtmps://live-api-s.facebook.com:443/rtmp/");
-        break;
-    case 4: // TikTok
-        Win32Helpers::SetWindowText(hDlg, IDC_URL_EDIT, "rtmp://push.tiktokcdn.com/live/");
-        break;
-    default: // Custom
-        break;
-    }
-}
-
 // ============================================================================
 // Multistream Dock - Conditional Implementation
 // ============================================================================
@@ -370,14 +109,12 @@ void MultistreamDock::OnAddDestination() {
 
 void MultistreamDock::OnEditDestination() {
     // For simplicity, just show a message for now
-    MessageBoxA(nullptr, "Edit functionality would open the edit dialog for the selected destination.", 
-                "Edit Destination", MB_OK | MB_ICONINFORMATION);
+    ShowDockMessage("Edit Destination", "Edit functionality would open the edit dialog for the selected destination.");
 }
 
 void MultistreamDock::OnRemoveDestination() {
     // For simplicity, just show a message for now
-    MessageBoxA(nullptr, "Remove functionality would delete the selected destination.", 
-                "Remove Destination", MB_OK | MB_ICONINFORMATION);
+    ShowDockMessage("Remove Destination", "Remove functionality would delete the selected destination.");
 }
 
 void MultistreamDock::OnStartStop() {
@@ -408,6 +145,23 @@ void MultistreamDock::UpdateDestinationList() {
             ss << " (Disabled)";
         }
         ss << "\n   URL: " << dest.url << "\n";
+        if (!dest.backupUrl.empty()) {
+            ss << "   Backup: " << dest.backupUrl << "\n";
+        }
+        if (!dest.bindAddress.empty()) {
+            ss << "   Bind: " << dest.bindAddress << "\n";
+        }
+        if (dest.audioOnly) {
+            ss << "   Audio only\n";
+        } else if (dest.vertical) {
+            ss << "   Vertical canvas\n";
+        }
+        if (!dest.audioOnly && dest.delaySec > 0) {
+            ss << "   Delayed " << dest.delaySec << " s\n";
+        }
+        if (!dest.audioOnly && !dest.useMainEncoder) {
+            ss << "   Codec: " << dest.codec << ", profile: " << dest.encoderProfile << "\n";
+        }
     }
     
     if (destinations.empty()) {
@@ -509,7 +263,7 @@ obs_properties_t* MultistreamDock::GetProperties(void* data) {
     return props;
 }
 
-void MultistreamDock::OnAddDestination(obs_properties_t* props, obs_property_t* property, void* data) {
+bool MultistreamDock::OnAddDestination(obs_properties_t* props, obs_property_t* property, void* data) {
     UNUSED_PARAMETER(props);
     UNUSED_PARAMETER(property);
     
@@ -521,29 +275,33 @@ void MultistreamDock::OnAddDestination(obs_properties_t* props, obs_property_t*
         MultistreamPlugin::GetInstance()->AddDestination(dest);
         dock->UpdateDestinationList();
     }
+    
+    return true;
 }
 
-void MultistreamDock::OnEditDestination(obs_properties_t* props, obs_property_t* property, void* data) {
+bool MultistreamDock::OnEditDestination(obs_properties_t* props, obs_property_t* property, void* data) {
     UNUSED_PARAMETER(props);
     UNUSED_PARAMETER(property);
     UNUSED_PARAMETER(data);
     
     // For simplicity, just show a message for now
-    MessageBoxA(nullptr, "Edit functionality would open the edit dialog for the selected destination.", 
-                "Edit Destination", MB_OK | MB_ICONINFORMATION);
+    ShowDockMessage("Edit Destination", "Edit functionality would open the edit dialog for the selected destination.");
+    
+    return false;
 }
 
-void MultistreamDock::OnRemoveDestination(obs_properties_t* props, obs_property_t* property, void* data) {
+bool MultistreamDock::OnRemoveDestination(obs_properties_t* props, obs_property_t* property, void* data) {
     UNUSED_PARAMETER(props);
     UNUSED_PARAMETER(property);
     UNUSED_PARAMETER(data);
     
     // For simplicity, just show a message for now
-    MessageBoxA(nullptr, "Remove functionality would delete the selected destination.", 
-                "Remove Destination", MB_OK | MB_ICONINFORMATION);
+    ShowDockMessage("Remove Destination", "Remove functionality would delete the selected destination.");
+    
+    return false;
 }
 
-void MultistreamDock::OnStartStop(obs_properties_t* props, obs_property_t* property, void* data) {
+bool MultistreamDock::OnStartStop(obs_properties_t* props, obs_property_t* property, void* data) {
     UNUSED_PARAMETER(props);
     UNUSED_PARAMETER(property);
     
@@ -557,15 +315,19 @@ void MultistreamDock::OnStartStop(obs_properties_t* props, obs_property_t* prope
     }
     
     dock->UpdateStatus();
+    
+    return true;
 }
 
-void MultistreamDock::OnRefresh(obs_properties_t* props, obs_property_t* property, void* data) {
+bool MultistreamDock::OnRefresh(obs_properties_t* props, obs_property_t* property, void* data) {
     UNUSED_PARAMETER(props);
     UNUSED_PARAMETER(property);
     
     MultistreamDock* dock = static_cast<MultistreamDock*>(data);
     dock->UpdateDestinationList();
     dock->UpdateStatus();
+    
+    return true;
 }
 
 void MultistreamDock::UpdateDestinationList() {
@@ -584,6 +346,23 @@ void MultistreamDock::UpdateDestinationList() {
             ss << " (Disabled)";
         }
         ss << "\n   URL: " << dest.url << "\n";
+        if (!dest.backupUrl.empty()) {
+            ss << "   Backup: " << dest.backupUrl << "\n";
+        }
+        if (!dest.bindAddress.empty()) {
+            ss << "   Bind: " << dest.bindAddress << "\n";
+        }
+        if (dest.audioOnly) {
+            ss << "   Audio only\n";
+        } else if (dest.vertical) {
+            ss << "   Vertical canvas\n";
+        }
+        if (!dest.audioOnly && dest.delaySec > 0) {
+            ss << "   Delayed " << dest.delaySec << " s\n";
+        }
+        if (!dest.audioOnly && !dest.useMainEncoder) {
+            ss << "   Codec: " << dest.codec << ", profile: " << dest.encoderProfile << "\n";
+        }
     }
     
     if (destinations.empty()) {
@@ -2,12 +2,8 @@
 
 #include <obs-frontend-api.h>
 #include <obs-properties.h>
-#include <Windows.h>
 #include <string>
 
-// Include StreamDestination definition
-#include "stream-destination.h"
-
 // Check if Qt is available
 #ifdef QT_CORE_LIB
 // Qt includes for dock widget
@@ -24,33 +20,6 @@
 #define HAVE_QT
 #endif
 
-// Simple Win32-based configuration dialog
-class StreamDestinationDialog {
-public:
-    StreamDestinationDialog(HWND parent = nullptr);
-    ~StreamDestinationDialog();
-    
-    // Show dialog and return true if OK was pressed
-    bool ShowDialog(StreamDestination* dest = nullptr);
-    
-    // Get the configured destination after dialog closes
-    StreamDestination GetDestination() const;
-
-private:
-    static INT_PTR CALLBACK DialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
-    
-    void InitializeDialog(HWND hDlg);
-    void LoadDestination(HWND hDlg, const StreamDestination& dest);
-    bool ValidateAndSave(HWND hDlg);
-    void PopulatePresets(HWND hDlg);
-    void OnPresetChanged(HWND hDlg);
-    
-    StreamDestination* currentDest;
-    StreamDestination dialogResult;
-    bool dialogOK;
-    HWND parentWindow;
-};
-
 // OBS Frontend dock implementation
 #ifdef HAVE_QT
 class MultistreamDock : public QObject {
@@ -89,13 +58,14 @@ public:
     void Shutdown();
     
 private:
-    // Create OBS properties for the dock
+    // Create OBS properties for the dock; button callbacks return true
+    // when the properties view should refresh
     static obs_properties_t* GetProperties(void* data);
-    static void OnAddDestination(obs_properties_t* props, obs_property_t* property, void* data);
-    static void OnEditDestination(obs_properties_t* props, obs_property_t* property, void* data);
-    static void OnRemoveDestination(obs_properties_t* props, obs_property_t* property, void* data);
-    static void OnStartStop(obs_properties_t* props, obs_property_t* property, void* data);
-    static void OnRefresh(obs_properties_t* props, obs_property_t* property, void* data);
+    static bool OnAddDestination(obs_properties_t* props, obs_property_t* property, void* data);
+    static bool OnEditDestination(obs_properties_t* props, obs_property_t* property, void* data);
+    static bool OnRemoveDestination(obs_properties_t* props, obs_property_t* property, void* data);
+    static bool OnStartStop(obs_properties_t* props, obs_property_t* property, void* data);
+    static bool OnRefresh(obs_properties_t* props, obs_property_t* property, void* data);
     
     void UpdateDestinationList();
     void UpdateStatus();
@@ -104,17 +74,3 @@ private:
     obs_data_t* settings;
 };
 #endif
-
-// Helper functions for Win32 dialogs
-namespace Win32Helpers {
-    void SetWindowText(HWND hWnd, int controlId, const std::string& text);
-    std::string GetWindowText(HWND hWnd, int controlId);
-    void SetCheckBox(HWND hWnd, int controlId, bool checked);
-    bool GetCheckBox(HWND hWnd, int controlId);
-    void SetSpinBox(HWND hWnd, int controlId, int value);
-    int GetSpinBox(HWND hWnd, int controlId);
-    void SetComboBox(HWND hWnd, int controlId, int index);
-    int GetComboBox(HWND hWnd, int controlId);
-    void AddComboBoxItem(HWND hWnd, int controlId, const std::string& text);
-    void ClearComboBox(HWND hWnd, int controlId);
-} 
\ No newline at end of file
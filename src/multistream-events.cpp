@@ -0,0 +1,42 @@
+#include "multistream-events.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+struct EventCallback {
+    MultistreamEventCallback callback;
+    void* param;
+};
+
+static std::mutex callbacksMutex;
+static std::vector<EventCallback> callbacks;
+static std::atomic<size_t> callbackCount(0);
+
+void MultistreamEvents::AddCallback(MultistreamEventCallback callback, void* param) {
+    std::lock_guard<std::mutex> lock(callbacksMutex);
+    callbacks.push_back({callback, param});
+    callbackCount.store(callbacks.size());
+}
+
+void MultistreamEvents::RemoveCallback(MultistreamEventCallback callback, void* param) {
+    std::lock_guard<std::mutex> lock(callbacksMutex);
+    callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(),
+                                   [callback, param](const EventCallback& entry) {
+                                       return entry.callback == callback && entry.param == param;
+                                   }),
+                    callbacks.end());
+    callbackCount.store(callbacks.size());
+}
+
+bool MultistreamEvents::HasCallbacks() {
+    return callbackCount.load() > 0;
+}
+
+void MultistreamEvents::Emit(const char* eventType, obs_data_t* data) {
+    // Held while calling out so a callback is never invoked after its removal
+    std::lock_guard<std::mutex> lock(callbacksMutex);
+    for (const auto& entry : callbacks) {
+        entry.callback(eventType, data, entry.param);
+    }
+}
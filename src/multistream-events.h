@@ -0,0 +1,21 @@
+#pragma once
+
+#include <obs.h>
+
+// Called with the event type and its payload, which the callee must not keep
+typedef void (*MultistreamEventCallback)(const char* eventType, obs_data_t* data, void* param);
+
+// State change notifications for remote controllers.
+//
+// Emit() runs every callback synchronously on the emitting thread, which can
+// be a libobs output thread, so callbacks must be quick and must not add or
+// remove callbacks. Emitters check HasCallbacks() first so nothing is
+// allocated when nobody is listening.
+class MultistreamEvents {
+public:
+    static void AddCallback(MultistreamEventCallback callback, void* param);
+    static void RemoveCallback(MultistreamEventCallback callback, void* param);
+
+    static bool HasCallbacks();
+    static void Emit(const char* eventType, obs_data_t* data);
+};
@@ -0,0 +1,240 @@
+#include "multistream-log.h"
+#include <obs.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+
+// Queue capacity, must be a power of two
+#define LOG_QUEUE_SIZE 1024
+
+// Repeats of an event inside this window are summarized
+#define LOG_RATE_WINDOW_NS 10000000000ULL
+
+// How often the writer drains the queue
+#define LOG_WRITER_INTERVAL_MS 50
+
+struct LogEntry {
+    int level;
+    const char* message;
+    // Rate limiting key and summary label; message when null
+    const char* group;
+    char destination[64];
+    char detail[160];
+    uint64_t timestamp;
+    bool rateLimited;
+};
+
+// Bounded multi-producer, single-consumer queue. Each cell carries a
+// sequence number telling producers and the consumer whose turn it is.
+struct LogCell {
+    std::atomic<size_t> sequence;
+    LogEntry entry;
+};
+
+static LogCell queueCells[LOG_QUEUE_SIZE];
+static std::atomic<size_t> enqueuePos(0);
+static std::atomic<size_t> dequeuePos(0);
+
+static std::thread writerThread;
+static os_event_t* stopEvent = nullptr;
+
+std::atomic<bool> MultistreamLog::running(false);
+std::atomic<int> MultistreamLog::producers(0);
+std::atomic<uint64_t> MultistreamLog::suppressedCount(0);
+std::atomic<uint64_t> MultistreamLog::droppedCount(0);
+
+static bool QueuePush(const LogEntry& entry) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    LogCell* cell;
+
+    for (;;) {
+        cell = &queueCells[pos & (LOG_QUEUE_SIZE - 1)];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->entry = entry;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+static bool QueuePop(LogEntry& entry) {
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    LogCell* cell = &queueCells[pos & (LOG_QUEUE_SIZE - 1)];
+
+    if (cell->sequence.load(std::memory_order_acquire) != pos + 1) return false;
+
+    entry = cell->entry;
+    cell->sequence.store(pos + LOG_QUEUE_SIZE, std::memory_order_release);
+    dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+static void WriteEntry(const LogEntry& entry) {
+    if (entry.detail[0]) {
+        blog(entry.level, "[multistream] %s for %s: %s", entry.message, entry.destination, entry.detail);
+    } else {
+        blog(entry.level, "[multistream] %s for %s", entry.message, entry.destination);
+    }
+}
+
+// Rate limiting state for one (message, destination) pair
+struct RateWindow {
+    uint64_t windowStart;
+    uint64_t suppressed;
+    int level;
+    const char* message;
+    std::string destination;
+
+    RateWindow() : windowStart(0), suppressed(0), level(LOG_INFO), message(nullptr) {}
+};
+
+static void FlushWindow(RateWindow& window) {
+    if (window.suppressed == 0) return;
+
+    blog(window.level, "[multistream] %s for %s: x%llu in last %llus", window.message, window.destination.c_str(),
+         (unsigned long long)window.suppressed, (unsigned long long)(LOG_RATE_WINDOW_NS / 1000000000ULL));
+    window.suppressed = 0;
+}
+
+void MultistreamLog::Start() {
+    if (running.load()) return;
+
+    for (size_t i = 0; i < LOG_QUEUE_SIZE; i++) {
+        queueCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    enqueuePos.store(0);
+    dequeuePos.store(0);
+
+    os_event_init(&stopEvent, OS_EVENT_TYPE_MANUAL);
+    running.store(true);
+    writerThread = std::thread(WriterThread);
+}
+
+void MultistreamLog::Stop() {
+    if (!running.load()) return;
+
+    // New events go straight to blog() while the writer drains the rest.
+    // Wait out producers that saw the writer running, so that nothing is
+    // queued after the final drain below.
+    running.store(false);
+    while (producers.load() > 0) {
+        std::this_thread::yield();
+    }
+
+    os_event_signal(stopEvent);
+    writerThread.join();
+
+    LogEntry entry;
+    while (QueuePop(entry)) {
+        WriteEntry(entry);
+    }
+
+    os_event_destroy(stopEvent);
+    stopEvent = nullptr;
+
+    blog(LOG_INFO, "[multistream] Async log: %llu event(s) suppressed, %llu dropped",
+         (unsigned long long)suppressedCount.load(), (unsigned long long)droppedCount.load());
+}
+
+void MultistreamLog::Event(int level, const char* message, const char* destination, const char* detail,
+                           const char* group) {
+    Queue(level, message, destination, detail, group, true);
+}
+
+void MultistreamLog::Lifecycle(int level, const char* message, const char* destination, const char* detail) {
+    Queue(level, message, destination, detail, nullptr, false);
+}
+
+void MultistreamLog::Queue(int level, const char* message, const char* destination, const char* detail,
+                           const char* group, bool rateLimited) {
+    LogEntry entry;
+    entry.level = level;
+    entry.message = message;
+    entry.group = group ? group : message;
+    entry.timestamp = os_gettime_ns();
+    entry.rateLimited = rateLimited;
+
+    strncpy(entry.destination, destination ? destination : "", sizeof(entry.destination) - 1);
+    entry.destination[sizeof(entry.destination) - 1] = 0;
+    strncpy(entry.detail, detail ? detail : "", sizeof(entry.detail) - 1);
+    entry.detail[sizeof(entry.detail) - 1] = 0;
+
+    // Without the writer (before load/after unload) log directly
+    producers.fetch_add(1);
+    if (!running.load()) {
+        producers.fetch_sub(1);
+        WriteEntry(entry);
+        return;
+    }
+
+    if (!QueuePush(entry)) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    producers.fetch_sub(1);
+}
+
+uint64_t MultistreamLog::GetSuppressedCount() {
+    return suppressedCount.load(std::memory_order_relaxed);
+}
+
+uint64_t MultistreamLog::GetDroppedCount() {
+    return droppedCount.load(std::memory_order_relaxed);
+}
+
+void MultistreamLog::WriterThread() {
+    os_set_thread_name("multistream-log");
+
+    std::map<std::pair<const char*, std::string>, RateWindow> windows;
+    bool stopping = false;
+
+    while (!stopping) {
+        stopping = os_event_timedwait(stopEvent, LOG_WRITER_INTERVAL_MS) == 0;
+
+        LogEntry entry;
+        while (QueuePop(entry)) {
+            if (!entry.rateLimited) {
+                WriteEntry(entry);
+                continue;
+            }
+            
+            RateWindow& window = windows[std::make_pair(entry.group, std::string(entry.destination))];
+
+            if (window.message && entry.timestamp - window.windowStart < LOG_RATE_WINDOW_NS) {
+                window.suppressed++;
+                suppressedCount.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            FlushWindow(window);
+            window.windowStart = entry.timestamp;
+            window.level = entry.level;
+            window.message = entry.group;
+            window.destination = entry.destination;
+
+            WriteEntry(entry);
+        }
+
+        // Summaries for windows that have closed, or everything on shutdown
+        uint64_t now = os_gettime_ns();
+        for (auto it = windows.begin(); it != windows.end();) {
+            if (stopping || now - it->second.windowStart >= LOG_RATE_WINDOW_NS) {
+                FlushWindow(it->second);
+                it = windows.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
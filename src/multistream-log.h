@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Asynchronous, rate-limited logging for per-destination output events.
+//
+// Output signal callbacks run on libobs output threads, which should never
+// wait on log I/O. Event() copies the message into a bounded lock-free queue
+// and returns; a writer thread formats it and calls blog(). Repeats of the
+// same event for the same destination within a window are collapsed into a
+// single summary line ("Reconnecting stream for X: x37 in last 10s").
+// Events can share a window through a group, so that a reconnect storm
+// collapses as a whole. Lifecycle events (started, stopped) are never
+// collapsed.
+// Events that find the queue full are dropped and counted.
+class MultistreamLog {
+public:
+    // Start/stop the writer thread; Stop() flushes everything still queued
+    static void Start();
+    static void Stop();
+
+    // Queue an event. message must be a string literal; it, or group when
+    // given, and destination together identify the event for rate limiting.
+    // group is a string literal that names the summary line. detail is
+    // optional.
+    static void Event(int level, const char* message, const char* destination, const char* detail = nullptr,
+                      const char* group = nullptr);
+
+    // Queue a state change, which is always written however often it repeats
+    static void Lifecycle(int level, const char* message, const char* destination, const char* detail = nullptr);
+
+    // Events folded into a summary instead of being written
+    static uint64_t GetSuppressedCount();
+    // Events lost because the queue was full
+    static uint64_t GetDroppedCount();
+
+private:
+    static void Queue(int level, const char* message, const char* destination, const char* detail,
+                      const char* group, bool rateLimited);
+    static void WriterThread();
+
+    static std::atomic<bool> running;
+    // Event()/Lifecycle() calls between checking running and queueing
+    static std::atomic<int> producers;
+    static std::atomic<uint64_t> suppressedCount;
+    static std::atomic<uint64_t> droppedCount;
+};
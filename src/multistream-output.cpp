@@ -1,11 +1,26 @@
 #include "multistream-output.h"
 #include "obs-multistream.h"
+#include "interface-balancer.h"
+#include "packet-tap.h"
+#include "multistream-trace.h"
+#include "multistream-log.h"
+#include "dns-cache.h"
+#include "multistream-events.h"
+#include "telemetry-recorder.h"
+#include "audio-relay-output.h"
+#include "vertical-canvas.h"
+#include "delay-buffer.h"
+#include "delay-relay-output.h"
 #include <obs-frontend-api.h>
 #include <util/platform.h>
 #include <util/dstr.h>
+#include <util/config-file.h>
+#include <algorithm>
+#include <cstring>
 
 // Static instance for SharedEncoderManager
 SharedEncoderManager* SharedEncoderManager::instance = nullptr;
+uint64_t MultistreamOutput::stallWindowMs = MULTISTREAM_STALL_WINDOW_MS;
 
 // ============================================================================
 // MultistreamOutput Implementation
@@ -13,12 +28,30 @@ SharedEncoderManager* SharedEncoderManager::instance = nullptr;
 
 MultistreamOutput::MultistreamOutput() 
     : output(nullptr), videoEncoder(nullptr), audioEncoder(nullptr), 
-      service(nullptr), isInitialized(false), isActive(false),
-      isConnecting(false), isReconnecting(false) {
+      service(nullptr), ownsEncoders(false), verticalCanvas(nullptr), delayBuffer(nullptr),
+      offloaded(false), offload(nullptr), isInitialized(false), isActive(false),
+      stopEvent(nullptr), stopRequestTime(0), stopLatencyMs(0), forceStopped(false),
+      isConnecting(false), isReconnecting(false), startTime(0), publishTime(0),
+      reconnectStartTime(0), timeToPublishMs(0), reconnectCount(0), lastReconnectRecoveryMs(0),
+      maxReconnectRecoveryMs(0), connectCount(0), lastConnectMs(0), maxConnectMs(0), totalConnectMs(0),
+      backupOutput(nullptr), backupService(nullptr), retiringOutput(nullptr), retiringService(nullptr),
+      backupPublishing(false), backupFailed(false), backupStartTime(0), retireStartTime(0),
+      failoverCooldownUntil(0), congestedSince(0), stalledSince(0), lastTickBytes(0), reconnectWindowStart(0),
+      reconnectWindowBase(0), failoverCount(0), replacingStalled(false), watchdogLastBytes(0), watchdogLastTick(0),
+      stallOnset(0), stallCount(0), lastStallDetectMs(0), maxStallDetectMs(0),
+      keyframeWaitStart(0), lastKeyframeWaitMs(0), maxKeyframeWaitMs(0),
+      videoEgressSavedKbps(0), telemetrySlot(TELEMETRY_NO_SLOT), tap(nullptr), dropThresholdUs(0) {
+    os_event_init(&stopEvent, OS_EVENT_TYPE_MANUAL);
 }
 
 MultistreamOutput::~MultistreamOutput() {
     Stop();
+    DisconnectSignalHandlers();
+    DetachTap();
+    ReleaseFailover();
+    ReleaseOffload();
+    DelayBuffer::Release(delayBuffer);
+    delayBuffer = nullptr;
     
     if (service) {
         obs_service_release(service);
@@ -30,19 +63,30 @@ MultistreamOutput::~MultistreamOutput() {
         output = nullptr;
     }
     
-    // Note: We don't release encoders here as they might be shared
-    // The SharedEncoderManager handles encoder lifecycle
+    // After the output, which may still reference them
+    ReleaseEncoders();
+    
+    if (stopEvent) {
+        os_event_destroy(stopEvent);
+        stopEvent = nullptr;
+    }
 }
 
 bool MultistreamOutput::Initialize(const StreamDestination& dest) {
+    MS_TRACE_SCOPE_DETAIL("MultistreamOutput::Initialize", dest.name.c_str());
     destination = dest;
     
-    if (!CreateOutput()) {
+    // The offload stream is FLV, which carries H.264 only; the relays
+    // publish themselves
+    offloaded = RelayOffload::IsEnabled() && !UsesRelay() && (dest.useMainEncoder || dest.codec == "h264");
+    
+    if (!offloaded && !CreateOutput()) {
         blog(LOG_ERROR, "[multistream] Failed to create output for %s", dest.name.c_str());
         return false;
     }
     
-    if (!CreateEncoder()) {
+    // Shared encoders belong to the main output and are looked up in Start()
+    if (!destination.useMainEncoder && !CreateEncoder()) {
         blog(LOG_ERROR, "[multistream] Failed to create encoder for %s", dest.name.c_str());
         return false;
     }
@@ -60,6 +104,19 @@ bool MultistreamOutput::Initialize(const StreamDestination& dest) {
 }
 
 bool MultistreamOutput::CreateOutput() {
+    MS_TRACE_SCOPE("MultistreamOutput::CreateOutput");
+    
+    // rtmp_output cannot run without video
+    if (destination.audioOnly) {
+        output = AudioRelayOutput::Create(destination.name.c_str(), destination.url, destination.key);
+        return output != nullptr;
+    }
+    
+    if (IsDelayed()) {
+        output = DelayRelayOutput::Create(destination.name.c_str(), destination.url, destination.key);
+        return output != nullptr;
+    }
+    
     output = obs_output_create("rtmp_output", destination.name.c_str(), nullptr, nullptr);
     if (!output) {
         blog(LOG_ERROR, "[multistream] Failed to create RTMP output");
@@ -70,11 +127,27 @@ bool MultistreamOutput::CreateOutput() {
 }
 
 bool MultistreamOutput::CreateEncoder() {
+    MS_TRACE_SCOPE("MultistreamOutput::CreateEncoder");
     SharedEncoderManager* manager = SharedEncoderManager::GetInstance();
     
+    if (destination.audioOnly) {
+        // Nothing to encode but sound; the shared audio encoder costs nothing extra
+        videoEncoder = nullptr;
+        audioEncoder = destination.useMainEncoder ? manager->GetSharedAudioEncoder()
+                                                  : manager->CreateCustomAudioEncoder(destination.bitrate);
+        ownsEncoders = !destination.useMainEncoder;
+        
+        if (!audioEncoder) {
+            blog(LOG_ERROR, "[multistream] Failed to get an audio encoder for %s", destination.name.c_str());
+            return false;
+        }
+        return true;
+    }
+    
     if (destination.useMainEncoder) {
-        // Use shared encoders from main output
-        videoEncoder = manager->GetSharedVideoEncoder();
+        // Use shared encoders from main output, or the vertical canvas's
+        // pooled one, held from Start()
+        videoEncoder = verticalCanvas ? verticalCanvas->GetPooledEncoder() : manager->GetSharedVideoEncoder();
         audioEncoder = manager->GetSharedAudioEncoder();
         
         if (!videoEncoder || !audioEncoder) {
@@ -83,11 +156,27 @@ bool MultistreamOutput::CreateEncoder() {
         }
     } else {
         // Create custom encoders with specific bitrate
-        videoEncoder = manager->CreateCustomVideoEncoder(destination.bitrate);
-        audioEncoder = manager->CreateCustomAudioEncoder(destination.bitrate);
+        EncoderProfile profile = EncoderProfiles::Find(destination.encoderProfile);
+        if (profile.name != destination.encoderProfile) {
+            blog(LOG_WARNING, "[multistream] Unknown encoder profile '%s' for %s, using '%s'",
+                 destination.encoderProfile.c_str(), destination.name.c_str(), profile.name.c_str());
+        }
+        
+        // The delay relay muxes H.264 only
+        std::string codec = destination.codec;
+        if (IsDelayed() && codec != "h264") {
+            blog(LOG_WARNING, "[multistream] %s is delayed and encodes H.264 instead of %s", destination.name.c_str(),
+                 codec.c_str());
+            codec = "h264";
+        }
+        
+        videoEncoder = manager->CreateCustomVideoEncoder(destination.bitrate, codec, profile);
+        audioEncoder = manager->CreateCustomAudioEncoder(std::min(320, std::max(64, destination.bitrate / 10)));
+        ownsEncoders = true;
         
         if (!videoEncoder || !audioEncoder) {
             blog(LOG_ERROR, "[multistream] Failed to create custom encoders");
+            ReleaseEncoders();
             return false;
         }
     }
@@ -95,7 +184,59 @@ bool MultistreamOutput::CreateEncoder() {
     return true;
 }
 
+void MultistreamOutput::ReleaseEncoders() {
+    if (ownsEncoders) {
+        SharedEncoderManager* manager = SharedEncoderManager::GetInstance();
+        manager->ReleaseCustomEncoder(videoEncoder);
+        manager->ReleaseCustomEncoder(audioEncoder);
+        ownsEncoders = false;
+    }
+    
+    videoEncoder = nullptr;
+    audioEncoder = nullptr;
+    
+    // After the encoders, which may render from it
+    ReleaseVerticalCanvas();
+}
+
+bool MultistreamOutput::AcquireVerticalCanvas() {
+    if (!destination.vertical || destination.audioOnly || verticalCanvas) return true;
+    
+    verticalCanvas = VerticalCanvas::Acquire();
+    if (!verticalCanvas) {
+        blog(LOG_ERROR, "[multistream] No vertical canvas for %s", destination.name.c_str());
+        return false;
+    }
+    
+    // A custom encoder follows the canvas of this session; the pooled one
+    // is picked up by CreateEncoder()
+    if (ownsEncoders && videoEncoder) {
+        obs_encoder_set_video(videoEncoder, verticalCanvas->GetVideo());
+    }
+    return true;
+}
+
+void MultistreamOutput::ReleaseVerticalCanvas() {
+    if (!verticalCanvas) return;
+    
+    // The pooled encoder goes away with the canvas
+    if (!ownsEncoders) {
+        videoEncoder = nullptr;
+    }
+    
+    VerticalCanvas::Release(verticalCanvas);
+    verticalCanvas = nullptr;
+}
+
 bool MultistreamOutput::SetupService() {
+    MS_TRACE_SCOPE("MultistreamOutput::SetupService");
+    activeUrl = destination.url;
+    standbyUrl = destination.backupUrl;
+    
+    // The relays publish to the URL they were created with, and the relay
+    // process to the one it is handed
+    if (UsesRelay() || offloaded) return true;
+    
     service = RTMPService::CreateService(destination.url, destination.key);
     if (!service) {
         blog(LOG_ERROR, "[multistream] Failed to create RTMP service");
@@ -106,7 +247,131 @@ bool MultistreamOutput::SetupService() {
     return true;
 }
 
+void MultistreamOutput::BindToUplink() {
+    if (destination.bindAddress.empty()) return;
+    
+    // The relay's ffmpeg process connects from the default route
+    if (UsesRelay() || offloaded) {
+        blog(LOG_WARNING, "[multistream] %s is published through a relay and cannot be bound to %s",
+             destination.name.c_str(), destination.bindAddress.c_str());
+        return;
+    }
+    
+    if (destination.bindAddress == MULTISTREAM_BIND_AUTO) {
+        boundAddress = InterfaceBalancer::GetInstance()->AssignAddress(GetExpectedBitrate());
+    } else {
+        boundAddress = destination.bindAddress;
+    }
+    
+    if (boundAddress.empty()) return;
+    
+    // rtmp_output binds its socket to this address before connecting
+    obs_data_t* settings = obs_data_create();
+    obs_data_set_string(settings, "bind_ip", boundAddress.c_str());
+    obs_output_update(output, settings);
+    obs_data_release(settings);
+    
+    blog(LOG_INFO, "[multistream] Bound %s to local address %s", destination.name.c_str(), boundAddress.c_str());
+}
+
+void MultistreamOutput::ApplyServiceUrl(obs_service_t* target, const std::string& url) {
+    if (!target) return;
+    
+    std::string server = url;
+    std::string host = DnsCache::GetUrlHost(url);
+    
+    // Only where the destination opted in: the tcUrl carries the host, and
+    // TLS needs the hostname for SNI and certificate checks
+    if (DnsCache::IsEnabled() && destination.connectByAddress && !host.empty() &&
+        url.compare(0, 8, "rtmps://") != 0) {
+        std::string address = DnsCache::GetInstance()->Lookup(host);
+        if (!address.empty()) {
+            server = DnsCache::ReplaceUrlHost(url, address);
+        }
+    }
+    
+    obs_data_t* settings = obs_service_get_settings(target);
+    bool changed = server != obs_data_get_string(settings, "server");
+    obs_data_release(settings);
+    
+    if (!changed) return;
+    
+    settings = obs_data_create();
+    obs_data_set_string(settings, "server", server.c_str());
+    obs_service_update(target, settings);
+    obs_data_release(settings);
+    
+    blog(LOG_INFO, "[multistream] %s connects to %s", destination.name.c_str(), server.c_str());
+}
+
+int MultistreamOutput::GetExpectedBitrate() const {
+    obs_encoder_t* encoder = destination.audioOnly ? audioEncoder : videoEncoder;
+    if (!encoder || (!destination.useMainEncoder && !destination.audioOnly)) {
+        return destination.bitrate;
+    }
+    
+    obs_data_t* settings = obs_encoder_get_settings(encoder);
+    int bitrate = settings ? (int)obs_data_get_int(settings, "bitrate") : 0;
+    obs_data_release(settings);
+    
+    return bitrate > 0 ? bitrate : destination.bitrate;
+}
+
+bool MultistreamOutput::IsDelayed() const {
+    return destination.delaySec > 0 && !destination.audioOnly;
+}
+
+bool MultistreamOutput::UsesRelay() const {
+    return destination.audioOnly || IsDelayed();
+}
+
+void MultistreamOutput::ReportUplinkThroughput() {
+    if (boundAddress.empty() || !startTime) return;
+    
+    uint64_t elapsedMs = (os_gettime_ns() - startTime) / 1000000;
+    if (elapsedMs == 0) return;
+    
+    uint64_t kbps = GetTotalBytes() * 8 / elapsedMs;
+    InterfaceBalancer::GetInstance()->ReportThroughput(boundAddress, kbps, GetCongestion());
+}
+
+bool MultistreamOutput::StartOffload() {
+    offload = RelayOffload::Acquire(videoEncoder, audioEncoder);
+    if (!offload) return false;
+    
+    offloadStatus = RelayDestinationStatus();
+    offload->AddDestination(destination);
+    return true;
+}
+
+void MultistreamOutput::ReleaseOffload() {
+    if (!offload) return;
+    
+    offloadStatus = offload->GetStatus(destination.id);
+    offload->RemoveDestination(destination.id);
+    RelayOffload::Release(offload);
+    offload = nullptr;
+}
+
+void MultistreamOutput::PollOffload() {
+    if (!offload) return;
+    
+    offloadStatus = offload->GetStatus(destination.id);
+    bool live = offloadStatus.state == RELAY_DESTINATION_LIVE;
+    
+    // The transitions an output's signals would have reported
+    if (live && isConnecting) {
+        OnStarted(this, nullptr);
+    } else if (live && isReconnecting) {
+        OnReconnected(this, nullptr);
+    } else if (!live && !isConnecting && !isReconnecting) {
+        OnReconnecting(this, nullptr);
+    }
+}
+
 bool MultistreamOutput::Start() {
+    MS_TRACE_SCOPE_DETAIL("MultistreamOutput::Start", destination.name.c_str());
+    
     if (!isInitialized) {
         blog(LOG_ERROR, "[multistream] Cannot start uninitialized output");
         return false;
@@ -117,18 +382,114 @@ bool MultistreamOutput::Start() {
         return true;
     }
     
+    // Vertical destinations encode the shared 9:16 canvas
+    if (!AcquireVerticalCanvas()) {
+        return false;
+    }
+    
+    // The main output's encoders can change between sessions
+    if (destination.useMainEncoder && !CreateEncoder()) {
+        blog(LOG_ERROR, "[multistream] Failed to create encoder for %s", destination.name.c_str());
+        ReleaseVerticalCanvas();
+        return false;
+    }
+    
+    // Every session starts on the primary ingest
+    activeUrl = destination.url;
+    standbyUrl = destination.backupUrl;
+    
+    BindToUplink();
+    ApplyServiceUrl(service, activeUrl);
+    
     // Set encoders
-    obs_output_set_video_encoder(output, videoEncoder);
-    obs_output_set_audio_encoder(output, audioEncoder, 0);
+    if (output) {
+        if (videoEncoder) {
+            obs_output_set_video_encoder(output, videoEncoder);
+        }
+        obs_output_set_audio_encoder(output, audioEncoder, 0);
+    }
+    
+    // Recording starts now and the first packets air one delay later; the
+    // buffer is kept through reconnects. 320 kbps covers the audio.
+    if (IsDelayed() && !delayBuffer) {
+        delayBuffer = DelayBuffer::Acquire(videoEncoder, audioEncoder, destination.delaySec, GetExpectedBitrate() + 320);
+        if (!delayBuffer) {
+            blog(LOG_ERROR, "[multistream] No delay buffer for %s", destination.name.c_str());
+            ReleaseVerticalCanvas();
+            return false;
+        }
+        DelayRelayOutput::SetBuffer(output, delayBuffer);
+    }
+    
+    // What an audio/video destination would add on top of this one: the
+    // session's video bitrate, and in custom mode a video encode of its own
+    videoEgressSavedKbps = 0;
+    if (destination.audioOnly) {
+        obs_encoder_t* sharedVideo = SharedEncoderManager::GetInstance()->GetSharedVideoEncoder();
+        obs_data_t* settings = sharedVideo ? obs_encoder_get_settings(sharedVideo) : nullptr;
+        videoEgressSavedKbps = settings ? (int)obs_data_get_int(settings, "bitrate") : 0;
+        obs_data_release(settings);
+    }
+    
+    connectCount = 0;
+    lastConnectMs = 0;
+    maxConnectMs = 0;
+    totalConnectMs = 0;
     
     // Start the output
-    bool result = obs_output_start(output);
+    bool result = offloaded ? StartOffload() : obs_output_start(output);
     if (result) {
         isActive = true;
         isConnecting = true;
+        startTime = os_gettime_ns();
+        publishTime = 0;
+        timeToPublishMs = 0;
+        reconnectStartTime = 0;
+        reconnectCount = 0;
+        lastReconnectRecoveryMs = 0;
+        maxReconnectRecoveryMs = 0;
+        keyframeWaitStart.store(0);
+        lastKeyframeWaitMs = 0;
+        maxKeyframeWaitMs = 0;
+        
+        failoverCount = 0;
+        failoverCooldownUntil = 0;
+        congestedSince = 0;
+        stalledSince = 0;
+        lastTickBytes = 0;
+        reconnectWindowStart = startTime;
+        reconnectWindowBase = 0;
+        
+        watchdogLastBytes = 0;
+        watchdogLastTick = 0;
+        stallOnset = 0;
+        stallCount = 0;
+        lastStallDetectMs = 0;
+        maxStallDetectMs = 0;
+        
+        // rtmp_output reports congestion as send buffer duration over this threshold
+        obs_data_t* settings = output ? obs_output_get_settings(output) : nullptr;
+        dropThresholdUs = settings ? (uint64_t)obs_data_get_int(settings, "drop_threshold_ms") * 1000 : 0;
+        obs_data_release(settings);
+        
+        enqueueLatency.Reset();
+        sendLatency.Reset();
+        totalLatency.Reset();
+        
+        // Per-packet work for every destination is what offloading avoids
+        DetachTap();
+        tap = offloaded ? nullptr : PacketTap::Acquire(videoEncoder, audioEncoder);
+        if (tap) {
+            tap->AddCallback(OnTapPacket, this);
+        }
+        EmitStateEvent("connecting");
+        RecordTelemetryEvent(TELEMETRY_EVENT_START);
         blog(LOG_INFO, "[multistream] Started streaming to %s", destination.name.c_str());
     } else {
         blog(LOG_ERROR, "[multistream] Failed to start streaming to %s", destination.name.c_str());
+        DelayBuffer::Release(delayBuffer);
+        delayBuffer = nullptr;
+        ReleaseVerticalCanvas();
     }
     
     return result;
@@ -137,23 +498,110 @@ bool MultistreamOutput::Start() {
 void MultistreamOutput::Stop() {
     if (!isActive) return;
     
-    DisconnectSignalHandlers();
-    
-    if (output && obs_output_active(output)) {
-        obs_output_stop(output);
+    RequestStop();
+    if (!WaitForStop(MULTISTREAM_STOP_FLUSH_WINDOW_MS)) {
+        ForceStop();
     }
+    ReleaseVerticalCanvas();
+}
+
+void MultistreamOutput::RequestStop() {
+    MS_TRACE_SCOPE_DETAIL("MultistreamOutput::RequestStop", destination.name.c_str());
+    if (!isActive) return;
+    
+    ReportUplinkThroughput();
+    
+    os_event_reset(stopEvent);
+    stopLatencyMs = 0;
+    forceStopped = false;
+    stopRequestTime = os_gettime_ns();
     
     isActive = false;
     isConnecting = false;
     isReconnecting = false;
     
-    blog(LOG_INFO, "[multistream] Stopped streaming to %s", destination.name.c_str());
+    DetachTap();
+    ReleaseFailover();
+    
+    // A stopping relay holds its own reference until its thread ends
+    DelayBuffer::Release(delayBuffer);
+    delayBuffer = nullptr;
+    
+    // The relay process flushes on its own; nothing to wait for here
+    if (offload) {
+        ReleaseOffload();
+        ReleaseVerticalCanvas();
+        
+        calldata_t cd = {};
+        calldata_set_int(&cd, "code", OBS_OUTPUT_SUCCESS);
+        OnStopped(this, &cd);
+        calldata_free(&cd);
+        return;
+    }
+    
+    // The "stop" signal fires once buffered data has been flushed
+    if (output && obs_output_active(output)) {
+        obs_output_stop(output);
+    } else {
+        ReleaseVerticalCanvas();
+        os_event_signal(stopEvent);
+    }
+}
+
+bool MultistreamOutput::WaitForStop(uint64_t timeoutMs) {
+    if (!stopRequestTime) return true;
+    
+    if (os_event_timedwait(stopEvent, (unsigned long)timeoutMs) == 0) {
+        return true;
+    }
+    
+    return !output || !obs_output_active(output);
+}
+
+void MultistreamOutput::ForceStop() {
+    MS_TRACE_SCOPE_DETAIL("MultistreamOutput::ForceStop", destination.name.c_str());
+    
+    if (output && obs_output_active(output)) {
+        blog(LOG_WARNING, "[multistream] Force-stopping %s, dropping unsent data", destination.name.c_str());
+        forceStopped = true;
+        obs_output_force_stop(output);
+    }
+    
+    RecordStopLatency();
+    os_event_signal(stopEvent);
+}
+
+void MultistreamOutput::RecordStopLatency() {
+    uint64_t requested = stopRequestTime;
+    if (!requested) return;
+    
+    // Never 0 once recorded, so a later caller keeps the first value
+    uint64_t latencyMs = std::max<uint64_t>((os_gettime_ns() - requested) / 1000000, 1);
+    uint64_t expected = 0;
+    stopLatencyMs.compare_exchange_strong(expected, latencyMs);
+}
+
+uint64_t MultistreamOutput::GetStopRequestTime() const {
+    return stopRequestTime;
+}
+
+uint64_t MultistreamOutput::GetStopLatencyMs() const {
+    return stopLatencyMs;
+}
+
+bool MultistreamOutput::WasForceStopped() const {
+    return forceStopped;
 }
 
 bool MultistreamOutput::IsActive() const {
+    if (offloaded) return isActive;
     return isActive && output && obs_output_active(output);
 }
 
+bool MultistreamOutput::IsOffloaded() const {
+    return offloaded;
+}
+
 bool MultistreamOutput::IsConnecting() const {
     return isConnecting;
 }
@@ -175,20 +623,125 @@ std::string MultistreamOutput::GetStatusString() const {
 }
 
 uint64_t MultistreamOutput::GetTotalBytes() const {
+    if (offloaded) return offloadStatus.totalBytes;
     if (!output) return 0;
     return obs_output_get_total_bytes(output);
 }
 
 int MultistreamOutput::GetDroppedFrames() const {
+    if (offloaded) return offloadStatus.droppedPackets;
     if (!output) return 0;
     return obs_output_get_frames_dropped(output);
 }
 
 float MultistreamOutput::GetCongestion() const {
+    if (offloaded) return offloadStatus.congestion;
     if (!output) return 0.0f;
     return obs_output_get_congestion(output);
 }
 
+OutputStats MultistreamOutput::GetStats() const {
+    OutputStats stats;
+    stats.id = destination.id;
+    stats.name = destination.name;
+    stats.status = GetStatusString();
+    stats.totalBytes = GetTotalBytes();
+    stats.droppedFrames = GetDroppedFrames();
+    stats.totalFrames = output ? obs_output_get_total_frames(output) : 0;
+    stats.congestion = GetCongestion();
+    
+    stats.timeToPublishMs = timeToPublishMs;
+    stats.connectTimeMs = output ? obs_output_get_connect_time_ms(output) : 0;
+    stats.reconnectCount = reconnectCount;
+    stats.lastReconnectRecoveryMs = lastReconnectRecoveryMs;
+    stats.maxReconnectRecoveryMs = maxReconnectRecoveryMs;
+    
+    stats.usesTls = destination.url.compare(0, 8, "rtmps://") == 0;
+    stats.connectCount = connectCount;
+    stats.lastConnectMs = lastConnectMs;
+    stats.maxConnectMs = maxConnectMs;
+    stats.avgConnectMs = connectCount ? (int)(totalConnectMs / connectCount) : 0;
+    stats.failoverCount = failoverCount;
+    stats.stallCount = stallCount;
+    stats.lastStallDetectMs = lastStallDetectMs;
+    stats.maxStallDetectMs = maxStallDetectMs;
+    stats.lastKeyframeWaitMs = lastKeyframeWaitMs;
+    stats.maxKeyframeWaitMs = maxKeyframeWaitMs;
+    stats.audioOnly = destination.audioOnly;
+    stats.videoEgressSavedKbps = videoEgressSavedKbps;
+    
+    stats.enqueueLatency = enqueueLatency.GetSummary();
+    stats.sendLatency = sendLatency.GetSummary();
+    stats.totalLatency = totalLatency.GetSummary();
+    
+    if (publishTime) {
+        uint64_t elapsedMs = (os_gettime_ns() - publishTime) / 1000000;
+        if (elapsedMs > 0) {
+            stats.throughputKbps = (double)stats.totalBytes * 8.0 / (double)elapsedMs;
+        }
+    }
+    
+    return stats;
+}
+
+void MultistreamOutput::LogSessionSummary() const {
+    OutputStats stats = GetStats();
+    
+    blog(LOG_INFO,
+         "[multistream] Session summary for %s: published after %llu ms (connect %d ms), "
+         "%.0f kbps avg, %d/%d frames dropped, %u reconnect(s), recovery last %llu ms / max %llu ms",
+         stats.name.c_str(), (unsigned long long)stats.timeToPublishMs, stats.connectTimeMs, stats.throughputKbps,
+         stats.droppedFrames, stats.totalFrames, stats.reconnectCount,
+         (unsigned long long)stats.lastReconnectRecoveryMs, (unsigned long long)stats.maxReconnectRecoveryMs);
+    
+    if (stats.failoverCount > 0) {
+        blog(LOG_INFO, "[multistream] %s failed over %u time(s), ended on %s", stats.name.c_str(),
+             stats.failoverCount, activeUrl.c_str());
+    }
+    
+    if (stats.audioOnly) {
+        blog(LOG_INFO, "[multistream] %s was audio-only: %.0f kbps sent with no video encode, "
+             "%d kbps of video not sent", stats.name.c_str(), stats.throughputKbps, stats.videoEgressSavedKbps);
+    }
+    
+    if (IsDelayed()) {
+        blog(LOG_INFO, "[multistream] %s aired with a %d s delay", stats.name.c_str(), destination.delaySec);
+    }
+    
+    if (offloaded) {
+        blog(LOG_INFO, "[multistream] %s was published by the relay process, which restarted ffmpeg %u time(s)",
+             stats.name.c_str(), offloadStatus.retries);
+    }
+    
+    if (stats.stallCount > 0) {
+        blog(LOG_INFO, "[multistream] %s stalled %u time(s), detected after last %llu ms / max %llu ms",
+             stats.name.c_str(), stats.stallCount, (unsigned long long)stats.lastStallDetectMs,
+             (unsigned long long)stats.maxStallDetectMs);
+    }
+    
+    if (stats.maxKeyframeWaitMs > 0) {
+        blog(LOG_INFO, "[multistream] First keyframe for %s after (re)connect: last %llu ms / max %llu ms",
+             stats.name.c_str(), (unsigned long long)stats.lastKeyframeWaitMs,
+             (unsigned long long)stats.maxKeyframeWaitMs);
+    }
+    
+    if (stats.connectCount > 0) {
+        blog(LOG_INFO, "[multistream] Connects for %s (%s): %u, handshake last %d ms / avg %d ms / max %d ms",
+             stats.name.c_str(), stats.usesTls ? "rtmps, full TLS handshake each" : "rtmp", stats.connectCount,
+             stats.lastConnectMs, stats.avgConnectMs, stats.maxConnectMs);
+    }
+    
+    const LatencySummary& total = stats.totalLatency;
+    if (total.count > 0) {
+        blog(LOG_INFO,
+             "[multistream] Latency for %s over %llu packets (ms): total p50 %.1f p99 %.1f p99.9 %.1f max %.1f, "
+             "send buffer p99 %.1f max %.1f",
+             stats.name.c_str(), (unsigned long long)total.count, total.p50Us / 1000.0, total.p99Us / 1000.0,
+             total.p999Us / 1000.0, total.maxUs / 1000.0, stats.sendLatency.p99Us / 1000.0,
+             stats.sendLatency.maxUs / 1000.0);
+    }
+}
+
 void MultistreamOutput::ConnectSignalHandlers() {
     if (!output) return;
     
@@ -215,48 +768,535 @@ void MultistreamOutput::DisconnectSignalHandlers() {
 
 void MultistreamOutput::OnStarted(void* data, calldata_t* cd) {
     MultistreamOutput* output = static_cast<MultistreamOutput*>(data);
+    MS_TRACE_SCOPE_DETAIL("MultistreamOutput::OnStarted", output->destination.name.c_str());
     output->isConnecting = false;
-    blog(LOG_INFO, "[multistream] Stream started for %s", output->destination.name.c_str());
+    
+    output->publishTime = os_gettime_ns();
+    output->keyframeWaitStart.store(output->publishTime);
+    if (output->startTime) {
+        output->timeToPublishMs = (output->publishTime - output->startTime) / 1000000;
+    }
+    
+    output->RecordConnect();
+    
+    char detail[48];
+    snprintf(detail, sizeof(detail), "after %llu ms (connect %d ms)", (unsigned long long)output->timeToPublishMs,
+             output->lastConnectMs);
+    MultistreamLog::Lifecycle(LOG_INFO, "Stream started", output->destination.name.c_str(), detail);
+    output->EmitStateEvent("streaming");
+    output->RecordTelemetryEvent(TELEMETRY_EVENT_PUBLISHING);
 }
 
 void MultistreamOutput::OnStopped(void* data, calldata_t* cd) {
     MultistreamOutput* output = static_cast<MultistreamOutput*>(data);
+    MS_TRACE_SCOPE_DETAIL("MultistreamOutput::OnStopped", output->destination.name.c_str());
     output->isActive = false;
     output->isConnecting = false;
     output->isReconnecting = false;
     
+    output->RecordStopLatency();
+    
     int code = (int)calldata_int(cd, "code");
     if (code != OBS_OUTPUT_SUCCESS) {
         const char* error = calldata_string(cd, "error");
         output->lastError = error ? error : "Unknown error";
-        blog(LOG_ERROR, "[multistream] Stream stopped with error for %s: %s", 
-             output->destination.name.c_str(), output->lastError.c_str());
+        MultistreamLog::Lifecycle(LOG_ERROR, "Stream stopped with error", output->destination.name.c_str(),
+                                  output->lastError.c_str());
     } else {
         output->lastError.clear();
-        blog(LOG_INFO, "[multistream] Stream stopped for %s", output->destination.name.c_str());
+        MultistreamLog::Lifecycle(LOG_INFO, "Stream stopped", output->destination.name.c_str());
     }
+    
+    output->EmitStateEvent("stopped");
+    output->RecordTelemetryEvent(TELEMETRY_EVENT_STOPPED, code);
+    os_event_signal(output->stopEvent);
 }
 
+// Reconnecting and reconnected lines share one rate window, so a flap storm
+// becomes a single summary
+#define RECONNECT_LOG_GROUP "Reconnect events"
+
 void MultistreamOutput::OnReconnecting(void* data, calldata_t* cd) {
     MultistreamOutput* output = static_cast<MultistreamOutput*>(data);
+    MS_TRACE_SCOPE_DETAIL("MultistreamOutput::OnReconnecting", output->destination.name.c_str());
     output->isReconnecting = true;
-    blog(LOG_INFO, "[multistream] Reconnecting stream for %s", output->destination.name.c_str());
+    output->reconnectCount++;
+    if (!output->reconnectStartTime) {
+        output->reconnectStartTime = os_gettime_ns();
+    }
+    MultistreamLog::Event(LOG_INFO, "Reconnecting stream", output->destination.name.c_str(), nullptr,
+                          RECONNECT_LOG_GROUP);
+    output->EmitStateEvent("reconnecting");
+    output->RecordTelemetryEvent(TELEMETRY_EVENT_RECONNECTING);
+    
+    // The output reads the service URL again before each reconnect attempt
+    output->ApplyServiceUrl(output->service, output->activeUrl);
 }
 
 void MultistreamOutput::OnReconnected(void* data, calldata_t* cd) {
     MultistreamOutput* output = static_cast<MultistreamOutput*>(data);
+    MS_TRACE_SCOPE_DETAIL("MultistreamOutput::OnReconnected", output->destination.name.c_str());
     output->isReconnecting = false;
-    blog(LOG_INFO, "[multistream] Reconnected stream for %s", output->destination.name.c_str());
+    
+    if (output->reconnectStartTime) {
+        output->lastReconnectRecoveryMs = (os_gettime_ns() - output->reconnectStartTime) / 1000000;
+        output->maxReconnectRecoveryMs = std::max(output->maxReconnectRecoveryMs, output->lastReconnectRecoveryMs);
+        output->reconnectStartTime = 0;
+    }
+    
+    output->keyframeWaitStart.store(os_gettime_ns());
+    output->RecordConnect();
+    
+    char detail[48];
+    snprintf(detail, sizeof(detail), "after %llu ms (connect %d ms)",
+             (unsigned long long)output->lastReconnectRecoveryMs, output->lastConnectMs);
+    MultistreamLog::Event(LOG_INFO, "Reconnected stream", output->destination.name.c_str(), detail,
+                          RECONNECT_LOG_GROUP);
+    output->EmitStateEvent("streaming");
+    output->RecordTelemetryEvent(TELEMETRY_EVENT_RECONNECTED);
+}
+
+void MultistreamOutput::RecordConnect() {
+    // The relay process does not report connect times
+    if (!output) return;
+    
+    // libobs measures each connect attempt separately, reconnects included
+    int connectMs = obs_output_get_connect_time_ms(output);
+    if (connectMs <= 0) return;
+    
+    connectCount++;
+    lastConnectMs = connectMs;
+    maxConnectMs = std::max(maxConnectMs, connectMs);
+    totalConnectMs += (uint64_t)connectMs;
+}
+
+void MultistreamOutput::EmitStateEvent(const char* state) const {
+    if (!MultistreamEvents::HasCallbacks()) return;
+    
+    obs_data_t* data = obs_data_create();
+    obs_data_set_string(data, "id", destination.id.c_str());
+    obs_data_set_string(data, "name", destination.name.c_str());
+    obs_data_set_string(data, "state", state);
+    obs_data_set_string(data, "url", activeUrl.c_str());
+    if (!lastError.empty()) {
+        obs_data_set_string(data, "error", lastError.c_str());
+    }
+    
+    MultistreamEvents::Emit("DestinationStateChanged", data);
+    obs_data_release(data);
+}
+
+void MultistreamOutput::SetTelemetrySlot(uint16_t slot) {
+    telemetrySlot = slot;
+}
+
+void MultistreamOutput::RecordTelemetryEvent(uint8_t event, int32_t code) const {
+    // Only outputs of a recorded session have a slot
+    if (telemetrySlot == TELEMETRY_NO_SLOT) return;
+    
+    TelemetryRecorder::GetInstance()->Event(telemetrySlot, event, code);
+}
+
+void MultistreamOutput::DetachTap() {
+    if (!tap) return;
+    
+    tap->RemoveCallback(OnTapPacket, this);
+    PacketTap::Release(tap);
+    tap = nullptr;
+}
+
+void MultistreamOutput::OnTapPacket(void* data, struct encoder_packet* packet, uint64_t receivedNs) {
+    MultistreamOutput* output = static_cast<MultistreamOutput*>(data);
+    MS_TRACE_SCOPE("MultistreamOutput::OnTapPacket");
+    
+    // Only video packets, and only once the output is actually publishing
+    if (packet->type != OBS_ENCODER_VIDEO || !output->publishTime || output->isReconnecting) return;
+    
+    // The output drops everything up to the first keyframe after (re)connecting
+    uint64_t waitStart = output->keyframeWaitStart.load();
+    if (waitStart && packet->keyframe && output->keyframeWaitStart.compare_exchange_strong(waitStart, 0)) {
+        uint64_t waitMs = receivedNs > waitStart ? (receivedNs - waitStart) / 1000000 : 0;
+        output->lastKeyframeWaitMs = waitMs;
+        output->maxKeyframeWaitMs = std::max(output->maxKeyframeWaitMs, waitMs);
+    }
+    
+    // sys_dts_usec is the frame's capture time on the os_gettime_ns() clock
+    uint64_t nowUs = receivedNs / 1000;
+    uint64_t enqueueUs = nowUs > (uint64_t)packet->sys_dts_usec ? nowUs - (uint64_t)packet->sys_dts_usec : 0;
+    
+    // The packet waits behind everything already buffered, which rtmp_output
+    // exposes as the buffer's duration relative to its drop threshold
+    float congestion = obs_output_get_congestion(output->output);
+    uint64_t sendUs = (uint64_t)((double)congestion * (double)output->dropThresholdUs);
+    
+    output->enqueueLatency.Record(enqueueUs);
+    output->sendLatency.Record(sendUs);
+    output->totalLatency.Record(enqueueUs + sendUs);
+}
+
+// ============================================================================
+// Failover
+// ============================================================================
+
+// Degradation that triggers a failover to the backup ingest
+#define FAILOVER_CONGESTION 0.8f
+#define FAILOVER_CONGESTION_MS 5000
+#define FAILOVER_STALL_MS 5000
+#define FAILOVER_RECONNECTING_MS 5000
+#define FAILOVER_RECONNECT_LIMIT 3
+#define FAILOVER_RECONNECT_WINDOW_MS 60000
+
+// The backup must be publishing within this time or the attempt is abandoned
+#define FAILOVER_CONNECT_TIMEOUT_MS 10000
+
+// Minimum time between failover attempts
+#define FAILOVER_COOLDOWN_MS 30000
+
+void MultistreamOutput::MonitorTick() {
+    uint64_t now = os_gettime_ns();
+    
+    if (telemetrySlot != TELEMETRY_NO_SLOT) {
+        uint8_t state = !isActive ? TELEMETRY_STATE_STOPPED
+                        : isReconnecting ? TELEMETRY_STATE_RECONNECTING
+                        : isConnecting ? TELEMETRY_STATE_CONNECTING
+                        : TELEMETRY_STATE_STREAMING;
+        TelemetryRecorder::GetInstance()->Sample(telemetrySlot, state, GetTotalBytes(), (uint32_t)GetDroppedFrames(),
+                                                 output ? (uint32_t)obs_output_get_total_frames(output) : 0,
+                                                 GetCongestion());
+    }
+    
+    // The output we switched away from is released once it has stopped
+    if (retiringOutput) {
+        bool stopped = !obs_output_active(retiringOutput);
+        if (!stopped && now - retireStartTime > MULTISTREAM_STOP_FLUSH_WINDOW_MS * 1000000ULL) {
+            obs_output_force_stop(retiringOutput);
+            stopped = true;
+        }
+        
+        if (stopped) {
+            obs_output_release(retiringOutput);
+            obs_service_release(retiringService);
+            retiringOutput = nullptr;
+            retiringService = nullptr;
+        }
+    }
+    
+    if (!isActive) return;
+    
+    // The relay process does its own retries and ingest switching
+    if (offloaded) {
+        PollOffload();
+        return;
+    }
+    
+    if (backupOutput) {
+        if (backupPublishing.load()) {
+            SwitchToBackup();
+        } else if (backupFailed.load() || now - backupStartTime > FAILOVER_CONNECT_TIMEOUT_MS * 1000000ULL) {
+            blog(LOG_WARNING, "[multistream] %s for %s did not come up, staying on %s",
+                 replacingStalled ? "Replacement connection" : "Backup ingest", destination.name.c_str(),
+                 activeUrl.c_str());
+            AbortBackup();
+            failoverCooldownUntil = now + FAILOVER_COOLDOWN_MS * 1000000ULL;
+        }
+        return;
+    }
+    
+    if (retiringOutput || now < failoverCooldownUntil) return;
+    
+    // A standby ingest is the better way out of trouble; the watchdog
+    // covers destinations without one
+    if (!standbyUrl.empty()) {
+        if (ShouldFailover(now)) {
+            StartBackup(standbyUrl);
+        }
+        return;
+    }
+    
+    if (CheckStall(now)) {
+        replacingStalled = true;
+        StartBackup(activeUrl);
+    }
+}
+
+// ============================================================================
+// Stall Watchdog
+// ============================================================================
+
+// Sending less than this share of the expected bitrate counts as stalled
+#define STALL_MIN_PROGRESS 0.1
+
+void MultistreamOutput::SetStallWindowMs(uint64_t windowMs) {
+    stallWindowMs = windowMs;
+}
+
+uint64_t MultistreamOutput::GetStallWindowMs() {
+    return stallWindowMs;
+}
+
+bool MultistreamOutput::CheckStall(uint64_t now) {
+    uint64_t bytes = GetTotalBytes();
+    uint64_t previousBytes = watchdogLastBytes;
+    uint64_t previousTick = watchdogLastTick;
+    watchdogLastBytes = bytes;
+    watchdogLastTick = now;
+    
+    // Only an output that claims to be streaming can be a zombie, and a
+    // delayed one sends nothing until its first packet falls due
+    bool awaitingDelay = IsDelayed() && now - startTime < (uint64_t)destination.delaySec * 1000000000ULL;
+    if (!stallWindowMs || !publishTime || isConnecting || isReconnecting || !previousTick || bytes < previousBytes ||
+        awaitingDelay) {
+        stallOnset = 0;
+        return false;
+    }
+    
+    // kbps * ms = bits
+    uint64_t expectedBytes = (uint64_t)GetExpectedBitrate() * ((now - previousTick) / 1000000) / 8;
+    uint64_t sentBytes = bytes - previousBytes;
+    bool slow = expectedBytes ? sentBytes < (uint64_t)((double)expectedBytes * STALL_MIN_PROGRESS) : sentBytes == 0;
+    
+    if (!slow) {
+        stallOnset = 0;
+        return false;
+    }
+    
+    // The previous tick is the last time the output was known to be sending
+    if (!stallOnset) stallOnset = previousTick;
+    if (now - stallOnset < stallWindowMs * 1000000ULL) return false;
+    
+    lastStallDetectMs = (now - stallOnset) / 1000000;
+    maxStallDetectMs = std::max(maxStallDetectMs, lastStallDetectMs);
+    stallCount++;
+    stallOnset = 0;
+    
+    blog(LOG_WARNING, "[multistream] %s is reported as streaming but sent almost nothing for %llu ms, "
+         "replacing the connection", destination.name.c_str(), (unsigned long long)lastStallDetectMs);
+    EmitStateEvent("stalled");
+    RecordTelemetryEvent(TELEMETRY_EVENT_STALL);
+    return true;
+}
+
+bool MultistreamOutput::ShouldFailover(uint64_t now) {
+    // Stuck reconnecting
+    if (isReconnecting && reconnectStartTime && now - reconnectStartTime > FAILOVER_RECONNECTING_MS * 1000000ULL) {
+        blog(LOG_WARNING, "[multistream] %s reconnecting for over %d ms", destination.name.c_str(),
+             FAILOVER_RECONNECTING_MS);
+        return true;
+    }
+    
+    // Flapping
+    if (now - reconnectWindowStart > FAILOVER_RECONNECT_WINDOW_MS * 1000000ULL) {
+        reconnectWindowStart = now;
+        reconnectWindowBase = reconnectCount;
+    }
+    if (reconnectCount - reconnectWindowBase >= FAILOVER_RECONNECT_LIMIT) {
+        blog(LOG_WARNING, "[multistream] %s reconnected %u times within %d s", destination.name.c_str(),
+             reconnectCount - reconnectWindowBase, FAILOVER_RECONNECT_WINDOW_MS / 1000);
+        return true;
+    }
+    
+    // Only a publishing, connected output can be congested or stalled
+    if (!publishTime || isReconnecting) {
+        congestedSince = 0;
+        stalledSince = 0;
+        return false;
+    }
+    
+    if (GetCongestion() >= FAILOVER_CONGESTION) {
+        if (!congestedSince) congestedSince = now;
+    } else {
+        congestedSince = 0;
+    }
+    
+    uint64_t bytes = GetTotalBytes();
+    if (bytes == lastTickBytes) {
+        if (!stalledSince) stalledSince = now;
+    } else {
+        stalledSince = 0;
+    }
+    lastTickBytes = bytes;
+    
+    if (congestedSince && now - congestedSince > FAILOVER_CONGESTION_MS * 1000000ULL) {
+        blog(LOG_WARNING, "[multistream] %s congested for over %d ms", destination.name.c_str(),
+             FAILOVER_CONGESTION_MS);
+        return true;
+    }
+    
+    if (stalledSince && now - stalledSince > FAILOVER_STALL_MS * 1000000ULL) {
+        blog(LOG_WARNING, "[multistream] %s sent nothing for over %d ms", destination.name.c_str(), FAILOVER_STALL_MS);
+        return true;
+    }
+    
+    return false;
+}
+
+void MultistreamOutput::StartBackup(const std::string& url) {
+    MS_TRACE_SCOPE_DETAIL("MultistreamOutput::StartBackup", destination.name.c_str());
+    
+    std::string backupName = destination.name + (replacingStalled ? " (reconnect)" : " (backup)");
+    if (destination.audioOnly) {
+        backupOutput = AudioRelayOutput::Create(backupName.c_str(), url, destination.key);
+    } else if (IsDelayed()) {
+        // Reads the same buffer, so the delay carries over to the new connection
+        backupOutput = DelayRelayOutput::Create(backupName.c_str(), url, destination.key);
+        DelayRelayOutput::SetBuffer(backupOutput, delayBuffer);
+    } else {
+        backupOutput = obs_output_create("rtmp_output", backupName.c_str(), nullptr, nullptr);
+        backupService = RTMPService::CreateService(url, destination.key);
+    }
+    
+    if (!backupOutput || (!backupService && !UsesRelay())) {
+        blog(LOG_ERROR, "[multistream] Failed to create backup output for %s", destination.name.c_str());
+        AbortBackup();
+        failoverCooldownUntil = os_gettime_ns() + FAILOVER_COOLDOWN_MS * 1000000ULL;
+        return;
+    }
+    
+    if (backupService) {
+        obs_output_set_service(backupOutput, backupService);
+        ApplyServiceUrl(backupService, url);
+    }
+    
+    if (!boundAddress.empty()) {
+        obs_data_t* settings = obs_data_create();
+        obs_data_set_string(settings, "bind_ip", boundAddress.c_str());
+        obs_output_update(backupOutput, settings);
+        obs_data_release(settings);
+    }
+    
+    // Same encoders: libobs starts the new output on the next keyframe
+    if (videoEncoder) {
+        obs_output_set_video_encoder(backupOutput, videoEncoder);
+    }
+    obs_output_set_audio_encoder(backupOutput, audioEncoder, 0);
+    
+    signal_handler_t* handler = obs_output_get_signal_handler(backupOutput);
+    signal_handler_connect(handler, "start", OnBackupStarted, this);
+    signal_handler_connect(handler, "stop", OnBackupStopped, this);
+    
+    backupPublishing.store(false);
+    backupFailed.store(false);
+    backupStartTime = os_gettime_ns();
+    
+    if (!obs_output_start(backupOutput)) {
+        backupFailed.store(true);
+    }
+    
+    blog(LOG_WARNING, "[multistream] %s %s: connecting %s", replacingStalled ? "Reconnecting" : "Failing over",
+         destination.name.c_str(), url.c_str());
+    MS_TRACE_INSTANT_DETAIL("Failover started", destination.name.c_str());
+}
+
+void MultistreamOutput::SwitchToBackup() {
+    MS_TRACE_SCOPE_DETAIL("MultistreamOutput::SwitchToBackup", destination.name.c_str());
+    uint64_t now = os_gettime_ns();
+    
+    signal_handler_t* handler = obs_output_get_signal_handler(backupOutput);
+    signal_handler_disconnect(handler, "start", OnBackupStarted, this);
+    signal_handler_disconnect(handler, "stop", OnBackupStopped, this);
+    DisconnectSignalHandlers();
+    
+    // The backup is publishing; the old output can go now
+    retiringOutput = output;
+    retiringService = service;
+    retireStartTime = now;
+    
+    output = backupOutput;
+    service = backupService;
+    backupOutput = nullptr;
+    backupService = nullptr;
+    
+    ConnectSignalHandlers();
+    obs_output_stop(retiringOutput);
+    
+    if (isReconnecting && reconnectStartTime) {
+        lastReconnectRecoveryMs = (now - reconnectStartTime) / 1000000;
+        maxReconnectRecoveryMs = std::max(maxReconnectRecoveryMs, lastReconnectRecoveryMs);
+    }
+    isConnecting = false;
+    isReconnecting = false;
+    reconnectStartTime = 0;
+    congestedSince = 0;
+    stalledSince = 0;
+    lastTickBytes = 0;
+    reconnectWindowStart = now;
+    reconnectWindowBase = reconnectCount;
+    failoverCooldownUntil = now + FAILOVER_COOLDOWN_MS * 1000000ULL;
+    
+    RecordConnect();
+    
+    // A replaced stalled connection stays on the same ingest
+    if (!replacingStalled) {
+        failoverCount++;
+        std::swap(activeUrl, standbyUrl);
+        RecordTelemetryEvent(TELEMETRY_EVENT_FAILOVER);
+    }
+    replacingStalled = false;
+    
+    blog(LOG_WARNING, "[multistream] %s switched to %s after %llu ms", destination.name.c_str(), activeUrl.c_str(),
+         (unsigned long long)((now - backupStartTime) / 1000000));
+    EmitStateEvent("streaming");
+}
+
+void MultistreamOutput::AbortBackup() {
+    if (backupOutput) {
+        signal_handler_t* handler = obs_output_get_signal_handler(backupOutput);
+        signal_handler_disconnect(handler, "start", OnBackupStarted, this);
+        signal_handler_disconnect(handler, "stop", OnBackupStopped, this);
+        
+        if (obs_output_active(backupOutput)) {
+            obs_output_force_stop(backupOutput);
+        }
+        obs_output_release(backupOutput);
+        backupOutput = nullptr;
+    }
+    
+    if (backupService) {
+        obs_service_release(backupService);
+        backupService = nullptr;
+    }
+    
+    backupPublishing.store(false);
+    backupFailed.store(false);
+    replacingStalled = false;
+}
+
+void MultistreamOutput::ReleaseFailover() {
+    AbortBackup();
+    
+    if (retiringOutput) {
+        if (obs_output_active(retiringOutput)) {
+            obs_output_force_stop(retiringOutput);
+        }
+        obs_output_release(retiringOutput);
+        obs_service_release(retiringService);
+        retiringOutput = nullptr;
+        retiringService = nullptr;
+    }
+}
+
+void MultistreamOutput::OnBackupStarted(void* data, calldata_t* cd) {
+    UNUSED_PARAMETER(cd);
+    MultistreamOutput* output = static_cast<MultistreamOutput*>(data);
+    output->backupPublishing.store(true);
+}
+
+void MultistreamOutput::OnBackupStopped(void* data, calldata_t* cd) {
+    UNUSED_PARAMETER(cd);
+    MultistreamOutput* output = static_cast<MultistreamOutput*>(data);
+    output->backupFailed.store(true);
 }
 
 // ============================================================================
 // SharedEncoderManager Implementation
 // ============================================================================
 
-SharedEncoderManager::SharedEncoderManager() {
+SharedEncoderManager::SharedEncoderManager()
+    : useOwnedEncoders(false), ownedVideoEncoder(nullptr), ownedAudioEncoder(nullptr) {
 }
 
 SharedEncoderManager::~SharedEncoderManager() {
+    ReleaseOwnedEncoders();
 }
 
 SharedEncoderManager* SharedEncoderManager::GetInstance() {
@@ -266,7 +1306,19 @@ SharedEncoderManager* SharedEncoderManager::GetInstance() {
     return instance;
 }
 
+void SharedEncoderManager::DestroyInstance() {
+    delete instance;
+    instance = nullptr;
+}
+
 obs_encoder_t* SharedEncoderManager::GetSharedVideoEncoder() {
+    if (useOwnedEncoders) {
+        if (!ownedVideoEncoder) {
+            blog(LOG_ERROR, "[multistream] Shared encoders have not been prepared");
+        }
+        return ownedVideoEncoder;
+    }
+    
     // Get the main streaming output's video encoder
     obs_output_t* streamOutput = obs_frontend_get_streaming_output();
     if (!streamOutput) {
@@ -281,6 +1333,13 @@ obs_encoder_t* SharedEncoderManager::GetSharedVideoEncoder() {
 }
 
 obs_encoder_t* SharedEncoderManager::GetSharedAudioEncoder() {
+    if (useOwnedEncoders) {
+        if (!ownedAudioEncoder) {
+            blog(LOG_ERROR, "[multistream] Shared encoders have not been prepared");
+        }
+        return ownedAudioEncoder;
+    }
+    
     // Get the main streaming output's audio encoder
     obs_output_t* streamOutput = obs_frontend_get_streaming_output();
     if (!streamOutput) {
@@ -294,9 +1353,24 @@ obs_encoder_t* SharedEncoderManager::GetSharedAudioEncoder() {
     return encoder;
 }
 
-obs_encoder_t* SharedEncoderManager::CreateCustomVideoEncoder(int bitrate) {
-    obs_data_t* settings = CreateVideoEncoderSettings(bitrate);
-    obs_encoder_t* encoder = obs_video_encoder_create("obs_x264", "multistream_video", settings, nullptr);
+obs_encoder_t* SharedEncoderManager::CreateCustomVideoEncoder(int bitrate, const std::string& codec,
+                                                              const EncoderProfile& profile) {
+    MS_TRACE_SCOPE("SharedEncoderManager::CreateCustomVideoEncoder");
+    
+    obs_data_t* settings = nullptr;
+    const char* encoderId = FindVideoEncoder(codec);
+    
+    if (encoderId) {
+        settings = CreateCodecEncoderSettings(encoderId, bitrate, profile);
+    } else {
+        if (codec != "h264") {
+            blog(LOG_WARNING, "[multistream] No usable %s encoder, falling back to H.264", codec.c_str());
+        }
+        encoderId = "obs_x264";
+        settings = CreateVideoEncoderSettings(bitrate, profile);
+    }
+    
+    obs_encoder_t* encoder = obs_video_encoder_create(encoderId, "multistream_video", settings, nullptr);
     obs_data_release(settings);
     
     if (!encoder) {
@@ -304,6 +1378,9 @@ obs_encoder_t* SharedEncoderManager::CreateCustomVideoEncoder(int bitrate) {
         return nullptr;
     }
     
+    blog(LOG_INFO, "[multistream] Custom %s encoder at %d kbps with profile '%s'", encoderId, bitrate,
+         profile.name.c_str());
+    
     // Set video info from main output
     obs_video_info ovi;
     if (obs_get_video_info(&ovi)) {
@@ -313,8 +1390,10 @@ obs_encoder_t* SharedEncoderManager::CreateCustomVideoEncoder(int bitrate) {
     return encoder;
 }
 
-obs_encoder_t* SharedEncoderManager::CreateCustomAudioEncoder(int bitrate) {
-    obs_data_t* settings = CreateAudioEncoderSettings(bitrate);
+obs_encoder_t* SharedEncoderManager::CreateCustomAudioEncoder(int audioBitrate) {
+    MS_TRACE_SCOPE("SharedEncoderManager::CreateCustomAudioEncoder");
+    
+    obs_data_t* settings = CreateAudioEncoderSettings(audioBitrate);
     obs_encoder_t* encoder = obs_audio_encoder_create("ffmpeg_aac", "multistream_audio", settings, 0, nullptr);
     obs_data_release(settings);
     
@@ -338,25 +1417,204 @@ void SharedEncoderManager::ReleaseCustomEncoder(obs_encoder_t* encoder) {
     }
 }
 
-obs_data_t* SharedEncoderManager::CreateVideoEncoderSettings(int bitrate) {
+void SharedEncoderManager::SetUseOwnedEncoders(bool use) {
+    useOwnedEncoders = use;
+}
+
+bool SharedEncoderManager::IsUsingOwnedEncoders() const {
+    return useOwnedEncoders;
+}
+
+bool SharedEncoderManager::PrepareOwnedEncoders() {
+    MS_TRACE_SCOPE("SharedEncoderManager::PrepareOwnedEncoders");
+    
+    std::string videoId;
+    obs_data_t* videoSettings = CreateProfileVideoSettings(videoId);
+    obs_data_t* audioSettings = CreateProfileAudioSettings();
+    
+    // A different encoder type needs a new encoder; outputs pick it up on Start()
+    if (ownedVideoEncoder && videoId != obs_encoder_get_id(ownedVideoEncoder)) {
+        obs_encoder_release(ownedVideoEncoder);
+        ownedVideoEncoder = nullptr;
+    }
+    
+    if (ownedVideoEncoder) {
+        obs_encoder_update(ownedVideoEncoder, videoSettings);
+    } else {
+        ownedVideoEncoder = obs_video_encoder_create(videoId.c_str(), "multistream_shared_video", videoSettings, nullptr);
+        if (ownedVideoEncoder) {
+            obs_encoder_set_video(ownedVideoEncoder, obs_get_video());
+        }
+    }
+    
+    if (ownedAudioEncoder) {
+        obs_encoder_update(ownedAudioEncoder, audioSettings);
+    } else {
+        ownedAudioEncoder = obs_audio_encoder_create("ffmpeg_aac", "multistream_shared_audio", audioSettings, 0, nullptr);
+        if (ownedAudioEncoder) {
+            obs_encoder_set_audio(ownedAudioEncoder, obs_get_audio());
+        }
+    }
+    
+    obs_data_release(videoSettings);
+    obs_data_release(audioSettings);
+    
+    if (!ownedVideoEncoder || !ownedAudioEncoder) {
+        blog(LOG_ERROR, "[multistream] Failed to create shared encoders (video: %s)", videoId.c_str());
+        return false;
+    }
+    
+    blog(LOG_INFO, "[multistream] Shared encoders ready (video: %s)", videoId.c_str());
+    return true;
+}
+
+void SharedEncoderManager::ReleaseOwnedEncoders() {
+    if (ownedVideoEncoder) {
+        obs_encoder_release(ownedVideoEncoder);
+        ownedVideoEncoder = nullptr;
+    }
+    
+    if (ownedAudioEncoder) {
+        obs_encoder_release(ownedAudioEncoder);
+        ownedAudioEncoder = nullptr;
+    }
+}
+
+obs_data_t* SharedEncoderManager::CreateProfileVideoSettings(std::string& encoderId) {
+    config_t* profile = obs_frontend_get_profile_config();
+    const char* mode = profile ? config_get_string(profile, "Output", "Mode") : nullptr;
+    
+    if (mode && strcmp(mode, "Advanced") == 0) {
+        // Advanced mode keeps the stream encoder settings next to the profile
+        const char* id = config_get_string(profile, "AdvOut", "Encoder");
+        encoderId = id && *id ? id : "obs_x264";
+        
+        obs_data_t* settings = nullptr;
+        char* profilePath = obs_frontend_get_current_profile_path();
+        if (profilePath) {
+            std::string path = std::string(profilePath) + "/streamEncoder.json";
+            settings = obs_data_create_from_json_file_safe(path.c_str(), "bak");
+            bfree(profilePath);
+        }
+        
+        return settings ? settings : obs_data_create();
+    }
+    
+    // Simple mode: only the bitrate and x264 preset are stored
+    encoderId = "obs_x264";
+    int bitrate = profile ? (int)config_get_uint(profile, "SimpleOutput", "VBitrate") : 0;
+    
+    // x264 defaults apart from the preset, as OBS itself configures it
+    obs_data_t* settings = CreateVideoEncoderSettings(bitrate > 0 ? bitrate : 2500, EncoderProfile());
+    
+    const char* preset = profile ? config_get_string(profile, "SimpleOutput", "Preset") : nullptr;
+    if (preset && *preset) {
+        obs_data_set_string(settings, "preset", preset);
+    }
+    
+    return settings;
+}
+
+obs_data_t* SharedEncoderManager::CreateProfileAudioSettings() {
+    config_t* profile = obs_frontend_get_profile_config();
+    const char* mode = profile ? config_get_string(profile, "Output", "Mode") : nullptr;
+    
+    uint64_t bitrate = 0;
+    if (profile) {
+        bitrate = (mode && strcmp(mode, "Advanced") == 0) ? config_get_uint(profile, "AdvOut", "Track1Bitrate")
+                                                          : config_get_uint(profile, "SimpleOutput", "ABitrate");
+    }
+    
+    obs_data_t* settings = obs_data_create();
+    obs_data_set_int(settings, "bitrate", bitrate > 0 ? (long long)bitrate : 160);
+    return settings;
+}
+
+// Software encoders are preferred; hardware ones come after them for codecs
+// stock OBS has no software encoder for (HEVC needs a third-party x265 plugin)
+static const char* hevcEncoderIds[] = {"obs_x265", "obs_nvenc_hevc_tex", "jim_hevc_nvenc", "h265_texture_amf",
+                                       "obs_qsv11_hevc", "ffmpeg_hevc_nvenc", nullptr};
+static const char* av1EncoderIds[] = {"ffmpeg_svt_av1", "ffmpeg_aom_av1", "obs_nvenc_av1_tex", "jim_av1_nvenc",
+                                      "av1_texture_amf", "obs_qsv11_av1", nullptr};
+
+static bool CodecListContains(const char* list, const std::string& codec) {
+    // Semicolon separated, e.g. "h264;hevc;av1"
+    std::string codecs = std::string(";") + list + ";";
+    return codecs.find(";" + codec + ";") != std::string::npos;
+}
+
+const char* SharedEncoderManager::FindVideoEncoder(const std::string& codec) {
+    const char** candidates = nullptr;
+    if (codec == "hevc") {
+        candidates = hevcEncoderIds;
+    } else if (codec == "av1") {
+        candidates = av1EncoderIds;
+    } else {
+        return nullptr;
+    }
+    
+    // Older RTMP outputs only carry H.264
+    const char* outputCodecs = obs_get_output_supported_video_codecs("rtmp_output");
+    if (!outputCodecs || !CodecListContains(outputCodecs, codec)) {
+        blog(LOG_WARNING, "[multistream] RTMP output does not support %s (Enhanced RTMP needs OBS 29.1+)",
+             codec.c_str());
+        return nullptr;
+    }
+    
+    for (const char** id = candidates; *id; id++) {
+        const char* encoderCodec = obs_get_encoder_codec(*id);
+        if (encoderCodec && codec == encoderCodec) {
+            return *id;
+        }
+    }
+    
+    return nullptr;
+}
+
+obs_data_t* SharedEncoderManager::CreateCodecEncoderSettings(const char* encoderId, int bitrate,
+                                                             const EncoderProfile& profile) {
+    obs_data_t* settings = obs_data_create();
+    
+    obs_data_set_int(settings, "bitrate", bitrate);
+    obs_data_set_string(settings, "rate_control", profile.rateControl.c_str());
+    obs_data_set_int(settings, "keyint_sec", profile.keyintSec);
+    
+    if (strcmp(encoderId, "ffmpeg_svt_av1") == 0) {
+        // Fastest presets that still keep the AV1 efficiency advantage
+        obs_data_set_int(settings, "preset", 9);
+    } else if (strcmp(encoderId, "ffmpeg_aom_av1") == 0) {
+        obs_data_set_int(settings, "cpu-used", 8);
+    } else if (strcmp(encoderId, "obs_x265") == 0) {
+        // x265 shares x264's preset and tune names
+        obs_data_set_string(settings, "preset", profile.preset.c_str());
+        obs_data_set_string(settings, "tune", profile.tune.c_str());
+    } else if (strstr(encoderId, "nvenc")) {
+        if (profile.bframes >= 0) obs_data_set_int(settings, "bf", profile.bframes);
+        if (profile.lookahead >= 0) obs_data_set_bool(settings, "lookahead", profile.lookahead > 0);
+    }
+    
+    return settings;
+}
+
+obs_data_t* SharedEncoderManager::CreateVideoEncoderSettings(int bitrate, const EncoderProfile& profile) {
     obs_data_t* settings = obs_data_create();
     
     obs_data_set_int(settings, "bitrate", bitrate);
-    obs_data_set_string(settings, "rate_control", "CBR");
-    obs_data_set_int(settings, "keyint_sec", 2);
-    obs_data_set_string(settings, "preset", "veryfast");
-    obs_data_set_string(settings, "profile", "baseline");
-    obs_data_set_string(settings, "tune", "zerolatency");
+    obs_data_set_string(settings, "rate_control", profile.rateControl.c_str());
+    obs_data_set_int(settings, "keyint_sec", profile.keyintSec);
+    obs_data_set_string(settings, "preset", profile.preset.c_str());
+    obs_data_set_string(settings, "profile", profile.profile.c_str());
+    obs_data_set_string(settings, "tune", profile.tune.c_str());
+    obs_data_set_string(settings, "x264opts", profile.GetX264Options().c_str());
     
     return settings;
 }
 
-obs_data_t* SharedEncoderManager::CreateAudioEncoderSettings(int bitrate) {
+obs_data_t* SharedEncoderManager::CreateAudioEncoderSettings(int audioBitrate) {
     obs_data_t* settings = obs_data_create();
     
-    // Calculate audio bitrate (typically much lower than video)
-    int audioBitrate = std::min(320, std::max(64, bitrate / 10));
-    obs_data_set_int(settings, "bitrate", audioBitrate);
+    // Within what AAC encoders accept
+    obs_data_set_int(settings, "bitrate", std::min(320, std::max(32, audioBitrate)));
     
     return settings;
 }
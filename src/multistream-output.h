@@ -2,26 +2,126 @@
 
 #include <obs.h>
 #include <obs-output.h>
+#include <util/threading.h>
+#include <atomic>
 #include <string>
 
 // Include StreamDestination definition
 #include "stream-destination.h"
+#include "latency-histogram.h"
+#include "encoder-profile.h"
+#include "relay-offload.h"
 
-// Class for managing individual RTMP outputs
+class PacketTap;
+class VerticalCanvas;
+class DelayBuffer;
+
+// Default time an output may spend flushing buffered data on stop
+#define MULTISTREAM_STOP_FLUSH_WINDOW_MS 3000
+
+// Default time a publishing output may send (almost) nothing before the
+// stall watchdog replaces its connection
+#define MULTISTREAM_STALL_WINDOW_MS 10000
+
+// Snapshot of one output for the plugin's stats surface
+struct OutputStats {
+    std::string id;
+    std::string name;
+    std::string status;
+    uint64_t totalBytes;
+    int droppedFrames;
+    int totalFrames;
+    float congestion;
+    
+    // Connection timing
+    uint64_t timeToPublishMs;         // Start() to the output reporting it is publishing
+    int connectTimeMs;                // RTMP connect time as measured by libobs
+    double throughputKbps;            // Average since publishing began
+    uint32_t reconnectCount;
+    uint64_t lastReconnectRecoveryMs; // "reconnect" to "reconnect_success"
+    uint64_t maxReconnectRecoveryMs;
+    
+    // Connection establishment (TCP, TLS for rtmps://, RTMP handshake) for
+    // the initial connect and every reconnect
+    bool usesTls;
+    uint32_t connectCount;
+    int lastConnectMs;
+    int maxConnectMs;
+    int avgConnectMs;
+    
+    // Switches between primary and backup ingest this session
+    uint32_t failoverCount;
+    
+    // Stall watchdog: connections replaced because they stopped sending
+    // while reported as streaming, and how long each stall lasted before
+    // it was detected
+    uint32_t stallCount;
+    uint64_t lastStallDetectMs;
+    uint64_t maxStallDetectMs;
+    
+    // Time from (re)publishing to the first video keyframe, which is how
+    // long viewers wait for a picture after a start or reconnect
+    uint64_t lastKeyframeWaitMs;
+    uint64_t maxKeyframeWaitMs;
+    
+    // Audio-only destinations: the video bitrate an audio/video destination
+    // sharing the session's encoder would have sent on top
+    bool audioOnly;
+    int videoEgressSavedKbps;
+    
+    // Per-packet latency: capture to the packet reaching the output,
+    // time spent in the output's send buffer, and the sum of both
+    LatencySummary enqueueLatency;
+    LatencySummary sendLatency;
+    LatencySummary totalLatency;
+    
+    OutputStats()
+        : totalBytes(0), droppedFrames(0), totalFrames(0), congestion(0.0f), timeToPublishMs(0),
+          connectTimeMs(0), throughputKbps(0.0), reconnectCount(0), lastReconnectRecoveryMs(0),
+          maxReconnectRecoveryMs(0), usesTls(false), connectCount(0), lastConnectMs(0), maxConnectMs(0),
+          avgConnectMs(0), failoverCount(0), stallCount(0), lastStallDetectMs(0), maxStallDetectMs(0),
+          lastKeyframeWaitMs(0), maxKeyframeWaitMs(0), audioOnly(false), videoEgressSavedKbps(0) {}
+};
+
+// Class for managing individual RTMP outputs. Audio-only destinations use an
+// AudioRelayOutput instead of rtmp_output and have no video encoder; delayed
+// destinations use a DelayRelayOutput. In relay offload mode the others have
+// no output of their own: a RelayOffload publishes them from the relay
+// process, and its reports drive their state.
 class MultistreamOutput {
 public:
     MultistreamOutput();
     ~MultistreamOutput();
     
-    // Initialize with a stream destination
+    // Initialize with a stream destination: creates the output, service and
+    // any custom encoders. An initialized output can be started and stopped
+    // any number of times.
     bool Initialize(const StreamDestination& destination);
     
     // Start/stop streaming
     bool Start();
     void Stop();
     
+    // Split stop for stopping many outputs at once: request a graceful stop,
+    // wait for the output to finish flushing, force-stop if it doesn't
+    void RequestStop();
+    bool WaitForStop(uint64_t timeoutMs);
+    void ForceStop();
+    
+    // Once the output has stopped: a flushing output still encodes from the
+    // vertical canvas, so RequestStop() only lets go of it when nothing flushes
+    void ReleaseVerticalCanvas();
+    
+    // When RequestStop() was last called (os_gettime_ns), or 0
+    uint64_t GetStopRequestTime() const;
+    
+    // Time from RequestStop() to the output reporting it stopped
+    uint64_t GetStopLatencyMs() const;
+    bool WasForceStopped() const;
+    
     // Status checking
     bool IsActive() const;
+    bool IsOffloaded() const;
     bool IsConnecting() const;
     bool IsReconnecting() const;
     
@@ -33,64 +133,246 @@ public:
     uint64_t GetTotalBytes() const;
     int GetDroppedFrames() const;
     float GetCongestion() const;
+    OutputStats GetStats() const;
+    
+    // One-line summary of the session for the log
+    void LogSessionSummary() const;
+    
+    // A publishing output that sends less than a tenth of its expected
+    // bitrate for this long gets a fresh connection (0 = watchdog off)
+    static void SetStallWindowMs(uint64_t windowMs);
+    static uint64_t GetStallWindowMs();
+    
+    // Slot for this session's telemetry records (TELEMETRY_NO_SLOT = none)
+    void SetTelemetrySlot(uint16_t slot);
+    
+    // Periodic health check, on the UI thread from the output monitor.
+    // Starts a failover to the backup ingest when the current one degrades
+    // and completes it once the backup is publishing.
+    void MonitorTick();
     
 private:
     // OBS output management
     bool CreateOutput();
     bool CreateEncoder();
+    // Release the custom encoders this output created; shared ones belong
+    // to the main output or SharedEncoderManager
+    void ReleaseEncoders();
+    // Hold the vertical canvas and point the video encoder at it
+    bool AcquireVerticalCanvas();
     bool SetupService();
+    void BindToUplink();
+    // Point a service at url, or at the cached address of its host so the
+    // connect skips DNS
+    void ApplyServiceUrl(obs_service_t* target, const std::string& url);
+    
+    // Video bitrate this output is expected to send, in kbps
+    int GetExpectedBitrate() const;
+    
+    // Delayed destinations air from a DelayBuffer; they and audio-only ones
+    // publish through an ffmpeg relay instead of rtmp_output
+    bool IsDelayed() const;
+    bool UsesRelay() const;
+    
+    // Relay offload: hand the destination to the encoders' RelayOffload,
+    // and follow its state from the output monitor
+    bool StartOffload();
+    void ReleaseOffload();
+    void PollOffload();
+    
+    // Report achieved throughput for the bound uplink back to the balancer
+    void ReportUplinkThroughput();
+    
+    // Account the connection that just completed
+    void RecordConnect();
+    
+    // Notify remote controllers (MultistreamEvents) of a state change
+    void EmitStateEvent(const char* state) const;
+    
+    // Append a lifecycle event to the session telemetry
+    void RecordTelemetryEvent(uint8_t event, int32_t code = 0) const;
     
     // Event handlers
     static void OnStarted(void* data, calldata_t* cd);
     static void OnStopped(void* data, calldata_t* cd);
     static void OnReconnecting(void* data, calldata_t* cd);
     static void OnReconnected(void* data, calldata_t* cd);
+    static void OnTapPacket(void* data, struct encoder_packet* packet, uint64_t receivedNs);
+    void DetachTap();
     
     // Connect signal handlers
     void ConnectSignalHandlers();
     void DisconnectSignalHandlers();
     
+    // Make-before-break failover: the backup output connects alongside the
+    // current one, and the current one is stopped only after the backup
+    // reports it is publishing
+    bool ShouldFailover(uint64_t now);
+    // The backup connection goes to url: the standby ingest for a failover,
+    // or the active one when replacing a stalled connection
+    void StartBackup(const std::string& url);
+    void SwitchToBackup();
+    void AbortBackup();
+    void ReleaseFailover();
+    static void OnBackupStarted(void* data, calldata_t* cd);
+    static void OnBackupStopped(void* data, calldata_t* cd);
+    
     StreamDestination destination;
     
     obs_output_t* output;
     obs_encoder_t* videoEncoder;
     obs_encoder_t* audioEncoder;
     obs_service_t* service;
+    bool ownsEncoders;
+    
+    // Held by vertical destinations from Start() until they have stopped, so
+    // warm standby outputs do not keep the canvas rendering
+    VerticalCanvas* verticalCanvas;
+    
+    // Held by delayed destinations from Start() to RequestStop(), so the
+    // buffer keeps recording through reconnects
+    DelayBuffer* delayBuffer;
+    
+    // Decided by Initialize(); the offload is held from Start() to
+    // RequestStop(), and the last report outlives it for the summary
+    bool offloaded;
+    RelayOffload* offload;
+    RelayDestinationStatus offloadStatus;
     
     bool isInitialized;
     bool isActive;
     
+    // Stop tracking, signalled from the output's "stop" signal. The latency
+    // is recorded once, by whichever of the signal thread and the force-stop
+    // thread gets there first.
+    os_event_t* stopEvent;
+    std::atomic<uint64_t> stopRequestTime;
+    std::atomic<uint64_t> stopLatencyMs;
+    std::atomic<bool> forceStopped;
+    void RecordStopLatency();
+    
     // Status tracking
     bool isConnecting;
     bool isReconnecting;
     std::string lastError;
+    
+    // Local address the output is bound to (empty = default route)
+    std::string boundAddress;
+    uint64_t startTime;
+    
+    // Connection timing, in os_gettime_ns() time
+    uint64_t publishTime;
+    uint64_t reconnectStartTime;
+    uint64_t timeToPublishMs;
+    uint32_t reconnectCount;
+    uint64_t lastReconnectRecoveryMs;
+    uint64_t maxReconnectRecoveryMs;
+    uint32_t connectCount;
+    int lastConnectMs;
+    int maxConnectMs;
+    uint64_t totalConnectMs;
+    
+    // Failover state. activeUrl is the ingest in use and standbyUrl the one
+    // a failover goes to; they swap on every switch.
+    std::string activeUrl;
+    std::string standbyUrl;
+    obs_output_t* backupOutput;
+    obs_service_t* backupService;
+    obs_output_t* retiringOutput;
+    obs_service_t* retiringService;
+    std::atomic<bool> backupPublishing;
+    std::atomic<bool> backupFailed;
+    uint64_t backupStartTime;
+    uint64_t retireStartTime;
+    uint64_t failoverCooldownUntil;
+    uint64_t congestedSince;
+    uint64_t stalledSince;
+    uint64_t lastTickBytes;
+    uint64_t reconnectWindowStart;
+    uint32_t reconnectWindowBase;
+    uint32_t failoverCount;
+    
+    // Stall watchdog; the backup connection machinery does the replacing
+    bool CheckStall(uint64_t now);
+    static uint64_t stallWindowMs;
+    bool replacingStalled;
+    uint64_t watchdogLastBytes;
+    uint64_t watchdogLastTick;
+    uint64_t stallOnset;
+    uint32_t stallCount;
+    uint64_t lastStallDetectMs;
+    uint64_t maxStallDetectMs;
+    
+    // Set when the output (re)starts publishing, cleared by the tap at the
+    // next video keyframe
+    std::atomic<uint64_t> keyframeWaitStart;
+    uint64_t lastKeyframeWaitMs;
+    uint64_t maxKeyframeWaitMs;
+    
+    int videoEgressSavedKbps;
+    
+    uint16_t telemetrySlot;
+    
+    // Packet latency tracking
+    PacketTap* tap;
+    uint64_t dropThresholdUs;
+    LatencyHistogram enqueueLatency;
+    LatencyHistogram sendLatency;
+    LatencyHistogram totalLatency;
 };
 
 // Helper class for managing shared encoders
 class SharedEncoderManager {
 public:
     static SharedEncoderManager* GetInstance();
+    // Release the owned encoders and the instance, from plugin cleanup
+    static void DestroyInstance();
     
     // Get shared encoders from main output
     obs_encoder_t* GetSharedVideoEncoder();
     obs_encoder_t* GetSharedAudioEncoder();
     
     // Create custom encoder with specified bitrate
-    obs_encoder_t* CreateCustomVideoEncoder(int bitrate);
-    obs_encoder_t* CreateCustomAudioEncoder(int bitrate);
+    // codec is "h264", "hevc" or "av1"; falls back to H.264 if no encoder
+    // for it is installed or the RTMP output cannot carry it. The profile's
+    // settings apply as far as the chosen encoder supports them.
+    obs_encoder_t* CreateCustomVideoEncoder(int bitrate, const std::string& codec, const EncoderProfile& profile);
+    obs_encoder_t* CreateCustomAudioEncoder(int audioBitrate);
     
-    // Release custom encoders
+    // Release an encoder from CreateCustomVideoEncoder/CreateCustomAudioEncoder,
+    // once no output uses it any more
     void ReleaseCustomEncoder(obs_encoder_t* encoder);
     
+    // Multistream-only mode: the shared encoders are a plugin-owned pair
+    // configured from the current OBS profile instead of the main output's
+    void SetUseOwnedEncoders(bool use);
+    bool IsUsingOwnedEncoders() const;
+    
+    // Create or reconfigure the owned pair; call while it is not encoding
+    bool PrepareOwnedEncoders();
+    void ReleaseOwnedEncoders();
+    
 private:
     SharedEncoderManager();
     ~SharedEncoderManager();
     
     static SharedEncoderManager* instance;
     
+    bool useOwnedEncoders;
+    obs_encoder_t* ownedVideoEncoder;
+    obs_encoder_t* ownedAudioEncoder;
+    
+    // Stream encoder id and settings from the current profile
+    obs_data_t* CreateProfileVideoSettings(std::string& encoderId);
+    obs_data_t* CreateProfileAudioSettings();
+    
     // Encoder settings helpers
-    obs_data_t* CreateVideoEncoderSettings(int bitrate);
-    obs_data_t* CreateAudioEncoderSettings(int bitrate);
+    obs_data_t* CreateVideoEncoderSettings(int bitrate, const EncoderProfile& profile);
+    obs_data_t* CreateCodecEncoderSettings(const char* encoderId, int bitrate, const EncoderProfile& profile);
+    
+    // First installed encoder for the codec, or nullptr
+    const char* FindVideoEncoder(const std::string& codec);
+    obs_data_t* CreateAudioEncoderSettings(int audioBitrate);
 };
 
 // RTMP service helper
@@ -0,0 +1,239 @@
+#include "multistream-trace.h"
+
+#ifdef MULTISTREAM_TRACING
+
+#include <obs.h>
+#include <util/platform.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// Events kept per thread; older events are overwritten
+#define TRACE_BUFFER_EVENTS 2048
+
+// Undumped events kept from threads that have exited; the oldest go first
+#define TRACE_RETIRED_EVENTS 8192
+
+struct TraceEvent {
+    const char* name;
+    char detail[48];
+    uint64_t startNs;
+    uint64_t durationNs;
+    char phase;
+};
+
+// Ring written only by its owning thread
+struct TraceThreadBuffer {
+    uint32_t tid;
+    std::atomic<uint64_t> writeIndex;
+    uint64_t dumpedIndex;
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+
+    TraceThreadBuffer(uint32_t id) : tid(id), writeIndex(0), dumpedIndex(0) {}
+};
+
+// What a thread recorded and nobody dumped before it exited
+struct RetiredEvents {
+    uint32_t tid;
+    std::vector<TraceEvent> events;
+};
+
+// Frees the thread's ring when the thread exits, keeping its undumped events
+// for the next dump
+struct TraceThreadOwner {
+    TraceThreadBuffer* buffer = nullptr;
+    ~TraceThreadOwner();
+};
+
+std::atomic<bool> MultistreamTrace::enabled(false);
+
+static std::mutex buffersMutex;
+static std::vector<TraceThreadBuffer*> buffers;
+static std::deque<RetiredEvents> retired;
+static size_t retiredEvents = 0;
+static std::atomic<uint32_t> nextThreadId(1);
+static thread_local TraceThreadOwner threadOwner;
+
+TraceThreadOwner::~TraceThreadOwner() {
+    if (!buffer) return;
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+
+    // Shutdown() already unregistered the ring if it is not listed
+    auto it = std::find(buffers.begin(), buffers.end(), buffer);
+    if (it != buffers.end()) {
+        buffers.erase(it);
+
+        uint64_t end = buffer->writeIndex.load(std::memory_order_relaxed);
+        uint64_t begin = std::max(buffer->dumpedIndex, end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0);
+        if (end > begin) {
+            RetiredEvents entry;
+            entry.tid = buffer->tid;
+            for (uint64_t i = begin; i < end; i++) {
+                entry.events.push_back(buffer->events[i % TRACE_BUFFER_EVENTS]);
+            }
+            retiredEvents += entry.events.size();
+            retired.push_back(std::move(entry));
+
+            while (retiredEvents > TRACE_RETIRED_EVENTS) {
+                retiredEvents -= retired.front().events.size();
+                retired.pop_front();
+            }
+        }
+    }
+
+    delete buffer;
+    buffer = nullptr;
+}
+
+// Registration is the only locked step and happens once per thread
+static TraceThreadBuffer* GetThreadBuffer() {
+    TraceThreadOwner& owner = threadOwner;
+    if (!owner.buffer) {
+        owner.buffer = new TraceThreadBuffer(nextThreadId.fetch_add(1, std::memory_order_relaxed));
+
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.push_back(owner.buffer);
+    }
+    return owner.buffer;
+}
+
+void MultistreamTrace::SetEnabled(bool enable) {
+    enabled.store(enable, std::memory_order_relaxed);
+    blog(LOG_INFO, "[multistream] Tracing %s", enable ? "enabled" : "disabled");
+}
+
+void MultistreamTrace::Instant(const char* name, const char* detail) {
+    if (!IsEnabled()) return;
+    Record('i', name, detail, os_gettime_ns(), 0);
+}
+
+void MultistreamTrace::Record(char phase, const char* name, const char* detail, uint64_t startNs,
+                              uint64_t durationNs) {
+    TraceThreadBuffer* buffer = GetThreadBuffer();
+
+    uint64_t index = buffer->writeIndex.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[index % TRACE_BUFFER_EVENTS];
+
+    event.name = name;
+    event.phase = phase;
+    event.startNs = startNs;
+    event.durationNs = durationNs;
+    if (detail) {
+        strncpy(event.detail, detail, sizeof(event.detail) - 1);
+        event.detail[sizeof(event.detail) - 1] = 0;
+    } else {
+        event.detail[0] = 0;
+    }
+
+    buffer->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+MultistreamTrace::Scope::Scope(const char* scopeName, const char* scopeDetail)
+    : name(scopeName), detail(scopeDetail), startNs(0) {
+    if (IsEnabled()) {
+        startNs = os_gettime_ns();
+    }
+}
+
+MultistreamTrace::Scope::~Scope() {
+    if (!startNs) return;
+    Record('X', name, detail, startNs, os_gettime_ns() - startNs);
+}
+
+static void WriteEscaped(FILE* file, const char* str) {
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\') {
+            fprintf(file, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+}
+
+static void WriteEvent(FILE* file, const TraceEvent& event, uint32_t tid, bool first) {
+    fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+    WriteEscaped(file, event.name);
+    fprintf(file, "\",\"cat\":\"multistream\",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", event.phase, tid,
+            event.startNs / 1000.0);
+
+    if (event.phase == 'X') {
+        fprintf(file, ",\"dur\":%.3f", event.durationNs / 1000.0);
+    } else {
+        fprintf(file, ",\"s\":\"t\"");
+    }
+
+    if (event.detail[0]) {
+        fprintf(file, ",\"args\":{\"detail\":\"");
+        WriteEscaped(file, event.detail);
+        fprintf(file, "\"}");
+    }
+
+    fprintf(file, "}");
+}
+
+bool MultistreamTrace::Dump(const std::string& path) {
+    FILE* file = os_fopen(path.c_str(), "wb");
+    if (!file) {
+        blog(LOG_ERROR, "[multistream] Failed to open trace file %s", path.c_str());
+        return false;
+    }
+
+    size_t eventCount = 0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+
+    // Threads that have exited since the last dump
+    for (const auto& entry : retired) {
+        for (const auto& event : entry.events) {
+            WriteEvent(file, event, entry.tid, eventCount == 0);
+            eventCount++;
+        }
+    }
+    retired.clear();
+    retiredEvents = 0;
+
+    for (auto* buffer : buffers) {
+        // Events being written while we read may come out torn; the trace
+        // is meant to be dumped after the interesting activity is over
+        uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+        uint64_t begin = buffer->dumpedIndex;
+        if (end - begin > TRACE_BUFFER_EVENTS) {
+            begin = end - TRACE_BUFFER_EVENTS;
+        }
+
+        for (uint64_t i = begin; i < end; i++) {
+            WriteEvent(file, buffer->events[i % TRACE_BUFFER_EVENTS], buffer->tid, eventCount == 0);
+            eventCount++;
+        }
+
+        buffer->dumpedIndex = end;
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    blog(LOG_INFO, "[multistream] Wrote %zu trace events to %s", eventCount, path.c_str());
+    return true;
+}
+
+void MultistreamTrace::Shutdown() {
+    enabled.store(false, std::memory_order_relaxed);
+
+    // Rings stay with their threads, which may still be recording; each is
+    // freed when its thread exits
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffers.clear();
+    retired.clear();
+    retiredEvents = 0;
+}
+
+#endif
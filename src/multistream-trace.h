@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Chrome trace-event / Perfetto tracing of plugin lifecycle and hot paths.
+//
+// Compiled in only when MULTISTREAM_TRACING is defined (the
+// MULTISTREAM_ENABLE_TRACING CMake option); otherwise the macros below expand
+// to nothing. When compiled in, recording is off until SetEnabled(true), and
+// a disabled trace point costs one relaxed atomic load.
+//
+// Each thread records into its own fixed-size ring, so recording takes no
+// locks. A ring is freed when its thread exits; what the thread recorded
+// since the last dump is kept, up to a bound, for the next one. Dump() writes
+// every ring as a Chrome trace JSON file that loads in chrome://tracing or
+// ui.perfetto.dev.
+
+#ifdef MULTISTREAM_TRACING
+
+#define MS_TRACE_CONCAT_INNER(a, b) a##b
+#define MS_TRACE_CONCAT(a, b) MS_TRACE_CONCAT_INNER(a, b)
+
+// Span covering the rest of the enclosing scope; name must be a string literal
+#define MS_TRACE_SCOPE(name) MultistreamTrace::Scope MS_TRACE_CONCAT(msTraceScope, __LINE__)(name, nullptr)
+#define MS_TRACE_SCOPE_DETAIL(name, detail) \
+    MultistreamTrace::Scope MS_TRACE_CONCAT(msTraceScope, __LINE__)(name, detail)
+
+// Zero-duration event
+#define MS_TRACE_INSTANT(name) MultistreamTrace::Instant(name, nullptr)
+#define MS_TRACE_INSTANT_DETAIL(name, detail) MultistreamTrace::Instant(name, detail)
+
+class MultistreamTrace {
+public:
+    static void SetEnabled(bool enable);
+    static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    static void Instant(const char* name, const char* detail);
+
+    // Write all recorded events to a trace file and clear the buffers
+    static bool Dump(const std::string& path);
+
+    // Stop recording and forget every ring, from module unload; threads
+    // still running free their own
+    static void Shutdown();
+
+    class Scope {
+    public:
+        Scope(const char* name, const char* detail);
+        ~Scope();
+
+    private:
+        const char* name;
+        const char* detail;
+        uint64_t startNs;
+    };
+
+private:
+    static void Record(char phase, const char* name, const char* detail, uint64_t startNs, uint64_t durationNs);
+
+    static std::atomic<bool> enabled;
+};
+
+#else
+
+#define MS_TRACE_SCOPE(name)
+#define MS_TRACE_SCOPE_DETAIL(name, detail)
+#define MS_TRACE_INSTANT(name)
+#define MS_TRACE_INSTANT_DETAIL(name, detail)
+
+#endif
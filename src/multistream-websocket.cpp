@@ -0,0 +1,333 @@
+#include "multistream-websocket.h"
+
+#ifdef HAVE_OBS_WEBSOCKET
+
+#include "obs-multistream.h"
+#include "multistream-output.h"
+#include "multistream-events.h"
+#include "delay-buffer.h"
+#include <obs.h>
+#include <obs-websocket-api.h>
+#include <string>
+#include <vector>
+
+typedef void (*RequestHandler)(obs_data_t* request, obs_data_t* response);
+
+struct VendorRequest {
+    const char* type;
+    RequestHandler handler;
+};
+
+struct UiCall {
+    RequestHandler handler;
+    obs_data_t* request;
+    obs_data_t* response;
+};
+
+static obs_websocket_vendor vendor = nullptr;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static void SetError(obs_data_t* response, const char* error) {
+    obs_data_set_bool(response, "success", false);
+    obs_data_set_string(response, "error", error);
+}
+
+// Ids listed in request["ids"]; false when the request has no list.
+// obs_data arrays only hold objects, so each entry is { "id": ... }.
+static bool ReadIds(obs_data_t* request, std::vector<std::string>& ids) {
+    obs_data_array_t* array = obs_data_get_array(request, "ids");
+    if (!array) return false;
+
+    size_t count = obs_data_array_count(array);
+    for (size_t i = 0; i < count; i++) {
+        obs_data_t* item = obs_data_array_item(array, i);
+        const char* id = obs_data_get_string(item, "id");
+        if (id && *id) {
+            ids.push_back(id);
+        }
+        obs_data_release(item);
+    }
+
+    obs_data_array_release(array);
+    return true;
+}
+
+static void SetIds(obs_data_t* response, const char* name, const std::vector<std::string>& ids) {
+    obs_data_array_t* array = obs_data_array_create();
+    for (const auto& id : ids) {
+        obs_data_t* item = obs_data_create();
+        obs_data_set_string(item, "id", id.c_str());
+        obs_data_array_push_back(array, item);
+        obs_data_release(item);
+    }
+    obs_data_set_array(response, name, array);
+    obs_data_array_release(array);
+}
+
+static void ReadDestinationFields(obs_data_t* item, StreamDestination& dest) {
+    if (obs_data_has_user_value(item, "name")) dest.name = obs_data_get_string(item, "name");
+    if (obs_data_has_user_value(item, "url")) dest.url = obs_data_get_string(item, "url");
+    if (obs_data_has_user_value(item, "backupUrl")) dest.backupUrl = obs_data_get_string(item, "backupUrl");
+    if (obs_data_has_user_value(item, "key")) dest.key = obs_data_get_string(item, "key");
+    if (obs_data_has_user_value(item, "enabled")) dest.enabled = obs_data_get_bool(item, "enabled");
+    if (obs_data_has_user_value(item, "useMainEncoder")) {
+        dest.useMainEncoder = obs_data_get_bool(item, "useMainEncoder");
+    }
+    if (obs_data_has_user_value(item, "bitrate")) dest.bitrate = (int)obs_data_get_int(item, "bitrate");
+    if (obs_data_has_user_value(item, "bindAddress")) dest.bindAddress = obs_data_get_string(item, "bindAddress");
+    if (obs_data_has_user_value(item, "codec")) dest.codec = obs_data_get_string(item, "codec");
+    if (obs_data_has_user_value(item, "audioOnly")) dest.audioOnly = obs_data_get_bool(item, "audioOnly");
+    if (obs_data_has_user_value(item, "vertical")) dest.vertical = obs_data_get_bool(item, "vertical");
+    if (obs_data_has_user_value(item, "delaySec")) {
+        dest.delaySec = DelayBuffer::ClampDelay((int)obs_data_get_int(item, "delaySec"));
+    }
+    if (obs_data_has_user_value(item, "encoderProfile")) {
+        dest.encoderProfile = obs_data_get_string(item, "encoderProfile");
+    }
+    if (obs_data_has_user_value(item, "connectByAddress")) {
+        dest.connectByAddress = obs_data_get_bool(item, "connectByAddress");
+    }
+}
+
+// ============================================================================
+// Requests (UI thread)
+// ============================================================================
+
+static void GetDestinations(obs_data_t* request, obs_data_t* response) {
+    UNUSED_PARAMETER(request);
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+
+    obs_data_array_t* array = obs_data_array_create();
+    for (const auto& dest : plugin->GetDestinations()) {
+        MultistreamOutput* output = plugin->FindOutput(dest.id);
+
+        // The stream key is write-only
+        obs_data_t* item = obs_data_create();
+        obs_data_set_string(item, "id", dest.id.c_str());
+        obs_data_set_string(item, "name", dest.name.c_str());
+        obs_data_set_string(item, "url", dest.url.c_str());
+        obs_data_set_string(item, "backupUrl", dest.backupUrl.c_str());
+        obs_data_set_bool(item, "hasKey", !dest.key.empty());
+        obs_data_set_bool(item, "enabled", dest.enabled);
+        obs_data_set_bool(item, "useMainEncoder", dest.useMainEncoder);
+        obs_data_set_int(item, "bitrate", dest.bitrate);
+        obs_data_set_string(item, "bindAddress", dest.bindAddress.c_str());
+        obs_data_set_string(item, "codec", dest.codec.c_str());
+        obs_data_set_bool(item, "audioOnly", dest.audioOnly);
+        obs_data_set_bool(item, "vertical", dest.vertical);
+        obs_data_set_int(item, "delaySec", dest.delaySec);
+        obs_data_set_string(item, "encoderProfile", dest.encoderProfile.c_str());
+        obs_data_set_bool(item, "connectByAddress", dest.connectByAddress);
+        obs_data_set_string(item, "status", output ? output->GetStatusString().c_str() : "Stopped");
+
+        obs_data_array_push_back(array, item);
+        obs_data_release(item);
+    }
+
+    obs_data_set_bool(response, "success", true);
+    obs_data_set_bool(response, "streaming", plugin->IsStreaming());
+    obs_data_set_array(response, "destinations", array);
+    obs_data_array_release(array);
+}
+
+static void StartDestinations(obs_data_t* request, obs_data_t* response) {
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+
+    std::vector<std::string> ids;
+    if (!ReadIds(request, ids)) {
+        for (const auto& dest : plugin->GetDestinations()) {
+            if (dest.enabled) {
+                ids.push_back(dest.id);
+            }
+        }
+    }
+
+    std::vector<std::string> started = plugin->StartDestinations(ids);
+
+    obs_data_set_bool(response, "success", true);
+    obs_data_set_bool(response, "streaming", plugin->IsStreaming());
+    SetIds(response, "started", started);
+}
+
+static void StopDestinations(obs_data_t* request, obs_data_t* response) {
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+
+    std::vector<std::string> ids;
+    if (!ReadIds(request, ids)) {
+        for (const auto& dest : plugin->GetDestinations()) {
+            ids.push_back(dest.id);
+        }
+    }
+
+    std::vector<std::string> stopped = plugin->StopDestinations(ids);
+
+    obs_data_array_t* report = obs_data_array_create();
+    if (!stopped.empty()) {
+        for (const auto& entry : plugin->GetLastStopReport()) {
+            obs_data_t* item = obs_data_create();
+            obs_data_set_string(item, "name", entry.name.c_str());
+            obs_data_set_int(item, "latencyMs", (long long)entry.latencyMs);
+            obs_data_set_bool(item, "forced", entry.forced);
+            obs_data_array_push_back(report, item);
+            obs_data_release(item);
+        }
+    }
+
+    obs_data_set_bool(response, "success", true);
+    obs_data_set_bool(response, "streaming", plugin->IsStreaming());
+    SetIds(response, "stopped", stopped);
+    obs_data_set_array(response, "report", report);
+    obs_data_array_release(report);
+}
+
+static void UpdateDestinations(obs_data_t* request, obs_data_t* response) {
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+
+    obs_data_array_t* array = obs_data_get_array(request, "destinations");
+    if (!array) {
+        SetError(response, "destinations array is required");
+        return;
+    }
+
+    // Unlisted fields keep their current values
+    std::vector<StreamDestination> updates;
+    std::string error;
+    size_t count = obs_data_array_count(array);
+
+    for (size_t i = 0; i < count && error.empty(); i++) {
+        obs_data_t* item = obs_data_array_item(array, i);
+        const char* id = obs_data_get_string(item, "id");
+        const StreamDestination* existing = id ? plugin->FindDestination(id) : nullptr;
+
+        if (existing) {
+            StreamDestination dest = *existing;
+            ReadDestinationFields(item, dest);
+            updates.push_back(dest);
+        } else {
+            error = std::string("unknown destination id: ") + (id ? id : "");
+        }
+        obs_data_release(item);
+    }
+
+    obs_data_array_release(array);
+
+    if (!error.empty()) {
+        SetError(response, error.c_str());
+        return;
+    }
+
+    if (!plugin->UpdateDestinations(updates)) {
+        SetError(response, "update rejected");
+        return;
+    }
+
+    obs_data_set_bool(response, "success", true);
+    obs_data_set_int(response, "updated", (long long)updates.size());
+}
+
+static void GetStats(obs_data_t* request, obs_data_t* response) {
+    UNUSED_PARAMETER(request);
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+
+    obs_data_array_t* array = obs_data_array_create();
+    for (const auto& stats : plugin->GetOutputStats()) {
+        obs_data_t* item = obs_data_create();
+        obs_data_set_string(item, "id", stats.id.c_str());
+        obs_data_set_string(item, "name", stats.name.c_str());
+        obs_data_set_string(item, "status", stats.status.c_str());
+        obs_data_set_int(item, "totalBytes", (long long)stats.totalBytes);
+        obs_data_set_int(item, "droppedFrames", stats.droppedFrames);
+        obs_data_set_int(item, "totalFrames", stats.totalFrames);
+        obs_data_set_double(item, "congestion", stats.congestion);
+        obs_data_set_double(item, "throughputKbps", stats.throughputKbps);
+        obs_data_set_int(item, "timeToPublishMs", (long long)stats.timeToPublishMs);
+        obs_data_set_int(item, "reconnectCount", stats.reconnectCount);
+        obs_data_set_int(item, "failoverCount", stats.failoverCount);
+        obs_data_set_int(item, "stallCount", stats.stallCount);
+        obs_data_set_int(item, "lastStallDetectMs", (long long)stats.lastStallDetectMs);
+        obs_data_set_int(item, "lastConnectMs", stats.lastConnectMs);
+        obs_data_set_double(item, "latencyP99Ms", stats.totalLatency.p99Us / 1000.0);
+        obs_data_set_bool(item, "audioOnly", stats.audioOnly);
+        obs_data_set_int(item, "videoEgressSavedKbps", stats.videoEgressSavedKbps);
+
+        obs_data_array_push_back(array, item);
+        obs_data_release(item);
+    }
+
+    obs_data_set_bool(response, "success", true);
+    obs_data_set_bool(response, "streaming", plugin->IsStreaming());
+    obs_data_set_int(response, "lastStartLatencyMs", (long long)plugin->GetLastStartLatencyMs());
+    obs_data_set_array(response, "outputs", array);
+    obs_data_array_release(array);
+}
+
+static const VendorRequest vendorRequests[] = {
+    {"GetDestinations", GetDestinations},
+    {"StartDestinations", StartDestinations},
+    {"StopDestinations", StopDestinations},
+    {"UpdateDestinations", UpdateDestinations},
+    {"GetStats", GetStats},
+};
+
+// ============================================================================
+// obs-websocket glue
+// ============================================================================
+
+static void RunUiCall(void* param) {
+    UiCall* call = static_cast<UiCall*>(param);
+    call->handler(call->request, call->response);
+}
+
+static void OnVendorRequest(obs_data_t* request, obs_data_t* response, void* param) {
+    const VendorRequest* entry = static_cast<const VendorRequest*>(param);
+
+    if (obs_in_task_thread(OBS_TASK_UI)) {
+        entry->handler(request, response);
+        return;
+    }
+
+    UiCall call = {entry->handler, request, response};
+    obs_queue_task(OBS_TASK_UI, RunUiCall, &call, true);
+}
+
+static void OnMultistreamEvent(const char* eventType, obs_data_t* data, void* param) {
+    UNUSED_PARAMETER(param);
+    obs_websocket_vendor_emit_event(vendor, eventType, data);
+}
+
+void MultistreamWebsocket::Register() {
+    vendor = obs_websocket_register_vendor(MULTISTREAM_VENDOR_NAME);
+    if (!vendor) {
+        blog(LOG_INFO, "[multistream] obs-websocket not available, remote control disabled");
+        return;
+    }
+
+    for (const auto& entry : vendorRequests) {
+        if (!obs_websocket_vendor_register_request(vendor, entry.type, OnVendorRequest, (void*)&entry)) {
+            blog(LOG_WARNING, "[multistream] Failed to register vendor request %s", entry.type);
+        }
+    }
+
+    MultistreamEvents::AddCallback(OnMultistreamEvent, nullptr);
+    blog(LOG_INFO, "[multistream] Registered obs-websocket vendor %s", MULTISTREAM_VENDOR_NAME);
+}
+
+void MultistreamWebsocket::Unregister() {
+    if (!vendor) return;
+
+    MultistreamEvents::RemoveCallback(OnMultistreamEvent, nullptr);
+    vendor = nullptr;
+}
+
+#else
+
+void MultistreamWebsocket::Register() {
+}
+
+void MultistreamWebsocket::Unregister() {
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+// Vendor name controllers address in CallVendorRequest and see on VendorEvent
+#define MULTISTREAM_VENDOR_NAME "obs-multistream"
+
+// obs-websocket vendor requests and events for remote control.
+//
+// Requests:
+//   GetDestinations     - all destinations with their settings and state
+//   StartDestinations   - { ids?: [{ id }] } start a subset (default: all enabled)
+//   StopDestinations    - { ids?: [{ id }] } stop a subset (default: all running)
+//   UpdateDestinations  - { destinations: [{ id, ...changed fields }] },
+//                         applied together or not at all
+//   GetStats            - one snapshot of every running output
+//
+// Events: DestinationStateChanged and MultistreamStateChanged, forwarded from
+// MultistreamEvents so controllers never have to poll.
+//
+// Requests arrive on obs-websocket threads and are run on the UI thread,
+// which owns the plugin state. Builds without obs-websocket-api.h
+// (HAVE_OBS_WEBSOCKET unset) register nothing.
+class MultistreamWebsocket {
+public:
+    // From obs_module_post_load, once obs-websocket is loaded
+    static void Register();
+
+    // From obs_module_unload. obs-websocket has already unloaded by then and
+    // its proc handler is gone, so this only stops forwarding events; the
+    // vendor and its requests go away with obs-websocket.
+    static void Unregister();
+};
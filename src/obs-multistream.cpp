@@ -1,27 +1,139 @@
 #include "obs-multistream.h"
-#include "multistream-dock.h"
 #include "multistream-output.h"
+#include "interface-balancer.h"
+#include "multistream-trace.h"
+#include "dns-cache.h"
+#include "output-monitor.h"
+#include "multistream-events.h"
+#include "telemetry-recorder.h"
+#include "audio-relay-output.h"
+#include "vertical-canvas.h"
+#include "delay-buffer.h"
+#include "relay-offload.h"
 #include <obs-frontend-api.h>
 #include <util/config-file.h>
 #include <util/platform.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <thread>
+
+// Default upper bound for the graceful part of StopStreaming()
+#define STOP_DEADLINE_MS 5000
+
+// Longest go-live waits for ingest hostnames that are not cached yet
+#define DNS_PREFETCH_TIMEOUT_MS 2000
 
 // Static instance
 MultistreamPlugin* MultistreamPlugin::instance = nullptr;
 
-// Module globals
-OBS_DECLARE_MODULE()
-OBS_MODULE_USE_DEFAULT_LOCALE("obs-multistream", "en-US")
+// Replaces the OBS config directory when set, see SetConfigDirectory()
+static std::string configDirectory;
 
 // ============================================================================
 // Plugin Implementation
 // ============================================================================
 
+// File in the OBS config directory, or in the module's own config directory
+// when there is no frontend (headless libobs)
+static std::string GetConfigFilePath(const char* fileName) {
+    if (!configDirectory.empty()) {
+        return configDirectory + "/" + fileName;
+    }
+    
+    char* configPath = obs_frontend_get_global_config_path();
+    if (configPath) {
+        std::string path = std::string(configPath) + "/" + fileName;
+        bfree(configPath);
+        return path;
+    }
+    
+    char* modulePath = obs_module_config_path(fileName);
+    if (!modulePath) return std::string();
+    
+    std::string path = modulePath;
+    bfree(modulePath);
+    
+    char* directory = obs_module_config_path("");
+    if (directory) {
+        os_mkdirs(directory);
+        bfree(directory);
+    }
+    
+    return path;
+}
+
+// An executable installed next to the plugin module, else whatever PATH
+// finds for name
+static std::string GetBundledExecutable(const char* name) {
+    const char* binary = obs_get_module_binary_path(obs_current_module());
+    std::string path = binary ? binary : "";
+    size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos) return name;
+    
+#ifdef _WIN32
+    path = path.substr(0, slash + 1) + name + ".exe";
+#else
+    path = path.substr(0, slash + 1) + name;
+#endif
+    return os_file_exists(path.c_str()) ? path : name;
+}
+
+// Local time for naming per-session files
+static std::string GetSessionTimestamp() {
+    char timestamp[32];
+    time_t now = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d_%H-%M-%S", localtime(&now));
+    return timestamp;
+}
+
+// Deletes the oldest per-session files in a directory until at most keep are
+// left. The timestamp in the name sorts them by age.
+static void PruneSessionFiles(const std::string& directory, const char* prefix, const char* suffix, size_t keep) {
+    os_dir_t* dir = os_opendir(directory.c_str());
+    if (!dir) return;
+    
+    std::vector<std::string> names;
+    size_t prefixLength = strlen(prefix);
+    size_t suffixLength = strlen(suffix);
+    struct os_dirent* entry;
+    while ((entry = os_readdir(dir)) != nullptr) {
+        if (entry->directory) continue;
+        
+        std::string name = entry->d_name;
+        if (name.size() > prefixLength + suffixLength && name.compare(0, prefixLength, prefix) == 0 &&
+            name.compare(name.size() - suffixLength, suffixLength, suffix) == 0) {
+            names.push_back(name);
+        }
+    }
+    os_closedir(dir);
+    
+    if (names.size() <= keep) return;
+    
+    std::sort(names.begin(), names.end());
+    for (size_t i = 0; i < names.size() - keep; i++) {
+        std::string path = directory + "/" + names[i];
+        if (os_unlink(path.c_str()) == 0) {
+            blog(LOG_INFO, "[%s] Removed old session file %s", PLUGIN_NAME, names[i].c_str());
+        } else {
+            blog(LOG_WARNING, "[%s] Failed to remove old session file %s", PLUGIN_NAME, path.c_str());
+        }
+    }
+}
+
 MultistreamPlugin::MultistreamPlugin() 
-    : dock(nullptr), isStreaming(false) {
+    : isStreaming(false),
+      stopFlushWindowMs(MULTISTREAM_STOP_FLUSH_WINDOW_MS), stopDeadlineMs(STOP_DEADLINE_MS),
+      tracingEnabled(false),
+      telemetryMaxMB(TELEMETRY_DEFAULT_MAX_MB), telemetryMaxFiles(TELEMETRY_DEFAULT_MAX_FILES), sessionCpu(nullptr),
+      multistreamOnly(false),
+      warmStandby(false), coreReady(false), lastStartLatencyMs(0) {
 }
 
 MultistreamPlugin::~MultistreamPlugin() {
-    Shutdown();
+    // Cleanup() has shut down already
 }
 
 MultistreamPlugin* MultistreamPlugin::GetInstance() {
@@ -34,31 +146,18 @@ MultistreamPlugin* MultistreamPlugin::GetInstance() {
 bool MultistreamPlugin::Initialize() {
     blog(LOG_INFO, "[%s] Initializing plugin v%s", PLUGIN_NAME, PLUGIN_VERSION);
     
+    // Hosts without a frontend register every output and encoder type
+    // before Initialize() and never send OBS_FRONTEND_EVENT_FINISHED_LOADING
+    coreReady = !configDirectory.empty();
+    
     // Load settings
     LoadSettings();
-    
-    // Create dock
-    dock = new MultistreamDock();
-    if (!dock->Initialize()) {
-        blog(LOG_ERROR, "[%s] Failed to initialize dock", PLUGIN_NAME);
-        return false;
-    }
+    CheckFfmpeg();
     
     // Register event handlers
-    obs_frontend_add_event_callback(
-        [](enum obs_frontend_event event, void* data) {
-            MultistreamPlugin* plugin = static_cast<MultistreamPlugin*>(data);
-            switch (event) {
-            case OBS_FRONTEND_EVENT_STREAMING_STARTED:
-                plugin->OnMainStreamingStarted(event, data);
-                break;
-            case OBS_FRONTEND_EVENT_STREAMING_STOPPED:
-                plugin->OnMainStreamingStopped(event, data);
-                break;
-            default:
-                break;
-            }
-        }, this);
+    obs_frontend_add_event_callback(OnFrontendEvent, this);
+    
+    OutputMonitor::AddCallback(OnMonitorTick, this);
     
     blog(LOG_INFO, "[%s] Plugin initialized successfully", PLUGIN_NAME);
     return true;
@@ -67,45 +166,118 @@ bool MultistreamPlugin::Initialize() {
 void MultistreamPlugin::Shutdown() {
     blog(LOG_INFO, "[%s] Shutting down plugin", PLUGIN_NAME);
     
+    OutputMonitor::RemoveCallback(OnMonitorTick, this);
+    
     // Stop streaming if active
     StopStreaming();
+    ReleaseStandby();
+    SharedEncoderManager::GetInstance()->ReleaseOwnedEncoders();
+    DnsCache::GetInstance()->Shutdown();
     
     // Remove event callbacks
-    obs_frontend_remove_event_callback(OnMainStreamingStarted, nullptr);
-    obs_frontend_remove_event_callback(OnMainStreamingStopped, nullptr);
-    
-    // Clean up dock
-    if (dock) {
-        delete dock;
-        dock = nullptr;
-    }
+    obs_frontend_remove_event_callback(OnFrontendEvent, this);
 }
 
 void MultistreamPlugin::Cleanup() {
     // Perform shutdown operations
     Shutdown();
     
-    // Reset the singleton instance
+    // Reset the singleton instance. Every output is gone by now, so the
+    // encoder manager can go with it.
     delete this;
     instance = nullptr;
+    SharedEncoderManager::DestroyInstance();
+}
+
+void MultistreamPlugin::SetConfigDirectory(const std::string& directory) {
+    configDirectory = directory;
 }
 
-void MultistreamPlugin::AddDestination(const StreamDestination& dest) {
-    destinations.push_back(dest);
+std::string MultistreamPlugin::AddDestination(const StreamDestination& dest) {
+    StreamDestination added = dest;
+    if (added.id.empty() || destinationIndex.count(added.id)) {
+        added.id = GenerateDestinationId();
+    }
+    
+    destinationIndex[added.id] = destinations.size();
+    destinations.push_back(added);
     SaveSettings();
+    PrefetchIngestHosts(0);
+    PrepareStandby();
+    
+    return added.id;
 }
 
-void MultistreamPlugin::RemoveDestination(size_t index) {
-    if (index < destinations.size()) {
-        destinations.erase(destinations.begin() + index);
-        SaveSettings();
+bool MultistreamPlugin::RemoveDestination(const std::string& id) {
+    auto it = destinationIndex.find(id);
+    if (it == destinationIndex.end()) return false;
+    
+    destinations.erase(destinations.begin() + it->second);
+    RebuildDestinationIndex();
+    SaveSettings();
+    PrepareStandby();
+    return true;
+}
+
+bool MultistreamPlugin::UpdateDestination(const std::string& id, const StreamDestination& dest) {
+    auto it = destinationIndex.find(id);
+    if (it == destinationIndex.end()) return false;
+    
+    StreamDestination& existing = destinations[it->second];
+    existing = dest;
+    existing.id = id;
+    SaveSettings();
+    PrefetchIngestHosts(0);
+    PrepareStandby();
+    return true;
+}
+
+bool MultistreamPlugin::UpdateDestinations(const std::vector<StreamDestination>& updates) {
+    // All or nothing: check every id before touching anything
+    for (const auto& dest : updates) {
+        if (!destinationIndex.count(dest.id)) {
+            blog(LOG_WARNING, "[%s] Batch update rejected, unknown destination %s", PLUGIN_NAME, dest.id.c_str());
+            return false;
+        }
+    }
+    
+    for (const auto& dest : updates) {
+        destinations[destinationIndex[dest.id]] = dest;
     }
+    
+    SaveSettings();
+    PrefetchIngestHosts(0);
+    PrepareStandby();
+    return true;
+}
+
+const StreamDestination* MultistreamPlugin::FindDestination(const std::string& id) const {
+    auto it = destinationIndex.find(id);
+    return it != destinationIndex.end() ? &destinations[it->second] : nullptr;
+}
+
+MultistreamOutput* MultistreamPlugin::FindOutput(const std::string& id) const {
+    auto it = outputsById.find(id);
+    return it != outputsById.end() ? it->second : nullptr;
+}
+
+std::string MultistreamPlugin::GenerateDestinationId() const {
+    static std::mt19937_64 rng(std::random_device{}() ^ os_gettime_ns());
+    
+    char id[17];
+    do {
+        snprintf(id, sizeof(id), "%016llx", (unsigned long long)rng());
+    } while (destinationIndex.count(id));
+    
+    return id;
 }
 
-void MultistreamPlugin::UpdateDestination(size_t index, const StreamDestination& dest) {
-    if (index < destinations.size()) {
-        destinations[index] = dest;
-        SaveSettings();
+void MultistreamPlugin::RebuildDestinationIndex() {
+    destinationIndex.clear();
+    destinationIndex.reserve(destinations.size());
+    
+    for (size_t i = 0; i < destinations.size(); i++) {
+        destinationIndex[destinations[i].id] = i;
     }
 }
 
@@ -114,6 +286,8 @@ const std::vector<StreamDestination>& MultistreamPlugin::GetDestinations() const
 }
 
 void MultistreamPlugin::StartStreaming() {
+    MS_TRACE_SCOPE("MultistreamPlugin::StartStreaming");
+    
     if (isStreaming) {
         blog(LOG_WARNING, "[%s] Streaming already active", PLUGIN_NAME);
         return;
@@ -122,22 +296,137 @@ void MultistreamPlugin::StartStreaming() {
     blog(LOG_INFO, "[%s] Starting multistream to %zu destinations", 
          PLUGIN_NAME, destinations.size());
     
-    // Create outputs for each enabled destination
+    std::vector<const StreamDestination*> starting;
     for (const auto& dest : destinations) {
-        if (!dest.enabled) continue;
+        if (dest.enabled) {
+            starting.push_back(&dest);
+        }
+    }
+    
+    StartOutputs(starting);
+}
+
+std::vector<std::string> MultistreamPlugin::StartDestinations(const std::vector<std::string>& ids) {
+    MS_TRACE_SCOPE("MultistreamPlugin::StartDestinations");
+    
+    std::vector<const StreamDestination*> starting;
+    for (const auto& id : ids) {
+        const StreamDestination* dest = FindDestination(id);
+        if (!dest || FindOutput(id) ||
+            std::find(starting.begin(), starting.end(), dest) != starting.end()) continue;
         
-        MultistreamOutput* output = new MultistreamOutput();
-        if (output->Initialize(dest)) {
-            outputs.push_back(output);
-            output->Start();
+        starting.push_back(dest);
+    }
+    
+    std::vector<std::string> started;
+    if (starting.empty()) return started;
+    
+    StartOutputs(starting);
+    
+    for (const auto* dest : starting) {
+        if (FindOutput(dest->id)) {
+            started.push_back(dest->id);
+        }
+    }
+    
+    return started;
+}
+
+void MultistreamPlugin::StartOutputs(const std::vector<const StreamDestination*>& starting) {
+    // Re-evaluate uplinks before any automatic binding happens
+    for (const auto* dest : starting) {
+        if (dest->bindAddress == MULTISTREAM_BIND_AUTO) {
+            InterfaceBalancer::GetInstance()->Refresh();
+            break;
+        }
+    }
+    
+    uint64_t startTime = os_gettime_ns();
+    size_t warmCount = 0;
+    size_t startedCount = 0;
+    size_t audioOnlyCount = 0;
+    size_t videoEncodesSkipped = 0;
+    size_t verticalCount = 0;
+    size_t verticalEncodes = 0;
+    size_t delayedCount = 0;
+    size_t offloadedCount = 0;
+    
+    // Without the main stream the plugin encodes once for all shared destinations
+    if (multistreamOnly && !SharedEncoderManager::GetInstance()->PrepareOwnedEncoders()) {
+        blog(LOG_ERROR, "[%s] Cannot start multistream-only mode without shared encoders", PLUGIN_NAME);
+        return;
+    }
+    
+    // Usually already warm from load time; bounded so a dead resolver cannot hold go-live
+    PrefetchIngestHosts(DNS_PREFETCH_TIMEOUT_MS);
+    
+    if (!isStreaming) {
+        OpenTelemetry();
+        sessionCpu = os_cpu_usage_info_start();
+    }
+    TelemetryRecorder* telemetry = TelemetryRecorder::GetInstance();
+    
+    // Start an output for each destination, reusing standby outputs
+    for (const auto* dest : starting) {
+        MultistreamOutput* output = TakeStandbyOutput(*dest);
+        if (output) {
+            warmCount++;
         } else {
-            delete output;
-            blog(LOG_ERROR, "[%s] Failed to initialize output for %s", 
-                 PLUGIN_NAME, dest.name.c_str());
+            output = new MultistreamOutput();
+            if (!output->Initialize(*dest)) {
+                delete output;
+                blog(LOG_ERROR, "[%s] Failed to initialize output for %s", 
+                     PLUGIN_NAME, dest->name.c_str());
+                continue;
+            }
+        }
+        
+        outputs.push_back(output);
+        outputsById[dest->id] = output;
+        output->SetTelemetrySlot(telemetry->RegisterDestination(dest->id, dest->name));
+        output->Start();
+        startedCount++;
+        
+        if (dest->audioOnly) {
+            audioOnlyCount++;
+            if (!dest->useMainEncoder) videoEncodesSkipped++;
+        } else if (dest->vertical) {
+            verticalCount++;
+            if (!dest->useMainEncoder) verticalEncodes++;
+        }
+        
+        if (dest->delaySec > 0 && !dest->audioOnly) {
+            delayedCount++;
+        }
+        if (output->IsOffloaded()) {
+            offloadedCount++;
         }
     }
     
-    isStreaming = true;
+    lastStartLatencyMs = (os_gettime_ns() - startTime) / 1000000;
+    blog(LOG_INFO, "[%s] Go-live setup took %llu ms (%zu warm, %zu cold output(s))", PLUGIN_NAME,
+         (unsigned long long)lastStartLatencyMs, warmCount, startedCount - warmCount);
+    if (audioOnlyCount > 0) {
+        blog(LOG_INFO, "[%s] %zu audio-only destination(s) without video, %zu custom video encode(s) avoided",
+             PLUGIN_NAME, audioOnlyCount, videoEncodesSkipped);
+    }
+    if (verticalCount > 0) {
+        blog(LOG_INFO, "[%s] %zu vertical destination(s) on one shared canvas, %zu custom vertical encode(s)",
+             PLUGIN_NAME, verticalCount, verticalEncodes);
+    }
+    if (delayedCount > 0) {
+        blog(LOG_INFO, "[%s] %zu delayed destination(s), sharing one disk buffer per encoder pair and delay",
+             PLUGIN_NAME, delayedCount);
+    }
+    if (offloadedCount > 0) {
+        blog(LOG_INFO, "[%s] %zu destination(s) published by the relay process, one local stream per encoder pair",
+             PLUGIN_NAME, offloadedCount);
+    }
+    
+    if (!isStreaming && !outputs.empty()) {
+        isStreaming = true;
+        EmitStreamingEvent();
+    }
 }
 
 void MultistreamPlugin::StopStreaming() {
@@ -145,28 +434,276 @@ void MultistreamPlugin::StopStreaming() {
     
     blog(LOG_INFO, "[%s] Stopping multistream", PLUGIN_NAME);
     
-    // Stop and clean up all outputs
-    for (auto* output : outputs) {
-        output->Stop();
-        delete output;
+    StopOutputs(std::vector<MultistreamOutput*>(outputs));
+    FinishSession();
+}
+
+std::vector<std::string> MultistreamPlugin::StopDestinations(const std::vector<std::string>& ids) {
+    MS_TRACE_SCOPE("MultistreamPlugin::StopDestinations");
+    
+    std::vector<MultistreamOutput*> stopping;
+    std::vector<std::string> stopped;
+    for (const auto& id : ids) {
+        MultistreamOutput* output = FindOutput(id);
+        if (!output || std::find(stopping.begin(), stopping.end(), output) != stopping.end()) continue;
+        
+        stopping.push_back(output);
+        stopped.push_back(id);
     }
-    outputs.clear();
     
+    if (stopping.empty()) return stopped;
+    
+    StopOutputs(stopping);
+    if (outputs.empty()) {
+        FinishSession();
+    }
+    
+    return stopped;
+}
+
+void MultistreamPlugin::FinishSession() {
     isStreaming = false;
+    EmitStreamingEvent();
+    TelemetryRecorder::GetInstance()->Close();
+    
+    // Whole-process figure, for comparing sessions with different destination setups
+    if (sessionCpu) {
+        blog(LOG_INFO, "[%s] Session CPU usage %.1f%% average", PLUGIN_NAME, os_cpu_usage_info_query(sessionCpu));
+        os_cpu_usage_info_destroy(sessionCpu);
+        sessionCpu = nullptr;
+    }
+    
+    // Pick up configuration changes made while live
+    PrepareStandby();
+    
+    // One trace file per session
+    DumpTrace();
+}
+
+void MultistreamPlugin::OpenTelemetry() {
+    if (!TelemetryRecorder::IsEnabled()) return;
+    
+    // One file per session
+    std::string path = GetConfigFilePath(("obs-multistream-telemetry-" + GetSessionTimestamp() + ".bin").c_str());
+    if (path.empty()) return;
+    
+    // Each file is preallocated at full size, so old sessions go before the
+    // new one is created
+    size_t slash = path.find_last_of("/\\");
+    if (slash != std::string::npos) {
+        PruneSessionFiles(path.substr(0, slash), "obs-multistream-telemetry-", ".bin", (size_t)telemetryMaxFiles - 1);
+    }
+    
+    TelemetryRecorder::GetInstance()->Open(path, telemetryMaxMB * 1024 * 1024);
+}
+
+void MultistreamPlugin::CheckFfmpeg() {
+    bool needed = RelayOffload::IsEnabled() && !destinations.empty();
+    for (const auto& dest : destinations) {
+        needed = needed || dest.audioOnly || dest.delaySec > 0;
+    }
+    
+    if (!needed || AudioRelayOutput::HasFfmpeg()) return;
+    
+    blog(LOG_WARNING,
+         "[%s] ffmpeg was not found at '%s'. Audio-only, delayed and offloaded destinations will not connect "
+         "until ffmpeg 7.0 or newer is installed next to the plugin or on PATH, or audioRelayFfmpeg names it.",
+         PLUGIN_NAME, AudioRelayOutput::GetFfmpegPath().c_str());
+}
+
+void MultistreamPlugin::EmitStreamingEvent() {
+    if (!MultistreamEvents::HasCallbacks()) return;
+    
+    obs_data_t* data = obs_data_create();
+    obs_data_set_bool(data, "streaming", isStreaming);
+    obs_data_set_int(data, "outputCount", (long long)outputs.size());
+    
+    MultistreamEvents::Emit("MultistreamStateChanged", data);
+    obs_data_release(data);
+}
+
+void MultistreamPlugin::PrefetchIngestHosts(uint64_t timeoutMs) {
+    if (!DnsCache::IsEnabled()) return;
+    
+    std::vector<std::string> hosts;
+    for (const auto& dest : destinations) {
+        if (dest.enabled) {
+            hosts.push_back(DnsCache::GetUrlHost(dest.url));
+        }
+    }
+    
+    DnsCache::GetInstance()->Prefetch(hosts, timeoutMs);
+}
+
+void MultistreamPlugin::PrepareStandby() {
+    if (!warmStandby || isStreaming || !coreReady) return;
+    
+    MS_TRACE_SCOPE("MultistreamPlugin::PrepareStandby");
+    
+    // Drop standby outputs whose destination changed or went away
+    size_t dropped = 0;
+    for (auto it = standbyOutputs.begin(); it != standbyOutputs.end();) {
+        const StreamDestination* dest = FindDestination(it->first);
+        if (dest && dest->enabled && *dest == it->second->GetDestination()) {
+            ++it;
+            continue;
+        }
+        
+        delete it->second;
+        it = standbyOutputs.erase(it);
+        dropped++;
+    }
+    
+    size_t created = 0;
+    for (const auto& dest : destinations) {
+        if (!dest.enabled || standbyOutputs.count(dest.id)) continue;
+        
+        MultistreamOutput* output = new MultistreamOutput();
+        if (output->Initialize(dest)) {
+            standbyOutputs[dest.id] = output;
+            created++;
+        } else {
+            delete output;
+            blog(LOG_WARNING, "[%s] Failed to prepare standby output for %s", PLUGIN_NAME, dest.name.c_str());
+        }
+    }
+    
+    if (dropped || created) {
+        blog(LOG_INFO, "[%s] Warm standby: %zu output(s) ready", PLUGIN_NAME, standbyOutputs.size());
+    }
+}
+
+MultistreamOutput* MultistreamPlugin::TakeStandbyOutput(const StreamDestination& dest) {
+    auto it = standbyOutputs.find(dest.id);
+    if (it == standbyOutputs.end()) return nullptr;
+    
+    MultistreamOutput* output = it->second;
+    standbyOutputs.erase(it);
+    
+    // Prepared for an older version of the destination
+    if (output->GetDestination() != dest) {
+        delete output;
+        return nullptr;
+    }
+    
+    return output;
+}
+
+void MultistreamPlugin::ReleaseStandby() {
+    for (auto& entry : standbyOutputs) {
+        delete entry.second;
+    }
+    standbyOutputs.clear();
+}
+
+void MultistreamPlugin::StopOutputs(const std::vector<MultistreamOutput*>& stopping) {
+    MS_TRACE_SCOPE("MultistreamPlugin::StopOutputs");
+    
+    // Ask every output to stop at once so a slow ingest only delays itself
+    uint64_t stopStart = os_gettime_ns();
+    for (auto* output : stopping) {
+        output->LogSessionSummary();
+        output->RequestStop();
+    }
+    
+    // Each output's flush window runs from its own stop request, and none
+    // extends past the global deadline
+    uint64_t globalDeadline = stopStart + stopDeadlineMs * 1000000;
+    
+    std::vector<MultistreamOutput*> stragglers;
+    for (auto* output : stopping) {
+        uint64_t requested = output->GetStopRequestTime();
+        uint64_t deadline = requested ? std::min(requested + stopFlushWindowMs * 1000000, globalDeadline) : globalDeadline;
+        uint64_t now = os_gettime_ns();
+        uint64_t remainingMs = deadline > now ? (deadline - now) / 1000000 : 0;
+        
+        if (!output->WaitForStop(remainingMs)) {
+            stragglers.push_back(output);
+        }
+    }
+    
+    // Force-stop whatever is still draining, in parallel since each one
+    // may block until its socket gives up
+    std::vector<std::thread> forceThreads;
+    for (auto* output : stragglers) {
+        forceThreads.emplace_back([output]() { output->ForceStop(); });
+    }
+    for (auto& thread : forceThreads) {
+        thread.join();
+    }
+    
+    lastStopReport.clear();
+    for (auto* output : stopping) {
+        OutputStopReport report;
+        report.name = output->GetDestination().name;
+        report.latencyMs = output->GetStopLatencyMs();
+        report.forced = output->WasForceStopped();
+        lastStopReport.push_back(report);
+        
+        blog(report.forced ? LOG_WARNING : LOG_INFO, "[%s] %s stopped in %llu ms%s", PLUGIN_NAME,
+             report.name.c_str(), (unsigned long long)report.latencyMs, report.forced ? " (forced)" : "");
+        
+        output->ReleaseVerticalCanvas();
+        outputs.erase(std::find(outputs.begin(), outputs.end(), output));
+        outputsById.erase(output->GetDestination().id);
+        
+        // Keep stopped outputs around for the next go-live
+        if (warmStandby) {
+            standbyOutputs[output->GetDestination().id] = output;
+        } else {
+            delete output;
+        }
+    }
+    
+    blog(LOG_INFO, "[%s] %zu output(s) stopped in %llu ms, %zu force-stopped", PLUGIN_NAME, stopping.size(),
+         (unsigned long long)((os_gettime_ns() - stopStart) / 1000000), stragglers.size());
+}
+
+void MultistreamPlugin::DumpTrace() {
+#ifdef MULTISTREAM_TRACING
+    if (!MultistreamTrace::IsEnabled()) return;
+    
+    std::string tracePath = GetConfigFilePath(("obs-multistream-trace-" + GetSessionTimestamp() + ".json").c_str());
+    if (tracePath.empty()) return;
+    
+    MultistreamTrace::Dump(tracePath);
+#endif
 }
 
 bool MultistreamPlugin::IsStreaming() const {
     return isStreaming;
 }
 
+std::vector<OutputStats> MultistreamPlugin::GetOutputStats() const {
+    std::vector<OutputStats> stats;
+    stats.reserve(outputs.size());
+    
+    for (const auto* output : outputs) {
+        stats.push_back(output->GetStats());
+    }
+    
+    return stats;
+}
+
+bool MultistreamPlugin::IsMultistreamOnly() const {
+    return multistreamOnly;
+}
+
+uint64_t MultistreamPlugin::GetLastStartLatencyMs() const {
+    return lastStartLatencyMs;
+}
+
+const std::vector<OutputStopReport>& MultistreamPlugin::GetLastStopReport() const {
+    return lastStopReport;
+}
+
 void MultistreamPlugin::SaveSettings() {
-    // Get OBS config path
-    char* configPath = obs_frontend_get_global_config_path();
-    if (!configPath) return;
+    MS_TRACE_SCOPE("MultistreamPlugin::SaveSettings");
     
-    // Create config file path
-    std::string configFilePath = std::string(configPath) + "/obs-multistream.json";
-    bfree(configPath);
+    std::string configFilePath = GetConfigFilePath("obs-multistream.json");
+    if (configFilePath.empty()) return;
+    
+    uint64_t saveStart = os_gettime_ns();
     
     // Create JSON data
     obs_data_t* data = obs_data_create();
@@ -174,12 +711,21 @@ void MultistreamPlugin::SaveSettings() {
     
     for (const auto& dest : destinations) {
         obs_data_t* destData = obs_data_create();
+        obs_data_set_string(destData, "id", dest.id.c_str());
         obs_data_set_string(destData, "name", dest.name.c_str());
         obs_data_set_string(destData, "url", dest.url.c_str());
+        obs_data_set_string(destData, "backupUrl", dest.backupUrl.c_str());
         obs_data_set_string(destData, "key", dest.key.c_str());
         obs_data_set_bool(destData, "enabled", dest.enabled);
         obs_data_set_bool(destData, "useMainEncoder", dest.useMainEncoder);
         obs_data_set_int(destData, "bitrate", dest.bitrate);
+        obs_data_set_string(destData, "bindAddress", dest.bindAddress.c_str());
+        obs_data_set_string(destData, "codec", dest.codec.c_str());
+        obs_data_set_bool(destData, "audioOnly", dest.audioOnly);
+        obs_data_set_string(destData, "encoderProfile", dest.encoderProfile.c_str());
+        obs_data_set_bool(destData, "vertical", dest.vertical);
+        obs_data_set_int(destData, "delaySec", dest.delaySec);
+        obs_data_set_bool(destData, "connectByAddress", dest.connectByAddress);
         
         obs_data_array_push_back(destArray, destData);
         obs_data_release(destData);
@@ -187,23 +733,88 @@ void MultistreamPlugin::SaveSettings() {
     
     obs_data_set_array(data, "destinations", destArray);
     
+    // Uplinks for automatic binding
+    obs_data_array_t* uplinkArray = obs_data_array_create();
+    
+    for (const auto& uplink : InterfaceBalancer::GetInstance()->GetConfiguredUplinks()) {
+        obs_data_t* uplinkData = obs_data_create();
+        obs_data_set_string(uplinkData, "name", uplink.name.c_str());
+        obs_data_set_string(uplinkData, "address", uplink.address.c_str());
+        obs_data_set_int(uplinkData, "capacityKbps", (long long)uplink.capacityKbps);
+        
+        obs_data_array_push_back(uplinkArray, uplinkData);
+        obs_data_release(uplinkData);
+    }
+    
+    obs_data_set_array(data, "uplinks", uplinkArray);
+    obs_data_array_release(uplinkArray);
+    
+    // Only configured profiles; the built-in ones are part of the plugin
+    obs_data_array_t* profileArray = obs_data_array_create();
+    
+    for (const auto& profile : EncoderProfiles::GetCustom()) {
+        obs_data_t* profileData = obs_data_create();
+        obs_data_set_string(profileData, "name", profile.name.c_str());
+        obs_data_set_string(profileData, "rateControl", profile.rateControl.c_str());
+        obs_data_set_string(profileData, "profile", profile.profile.c_str());
+        obs_data_set_string(profileData, "preset", profile.preset.c_str());
+        obs_data_set_string(profileData, "tune", profile.tune.c_str());
+        obs_data_set_int(profileData, "bframes", profile.bframes);
+        obs_data_set_int(profileData, "lookahead", profile.lookahead);
+        obs_data_set_int(profileData, "keyintSec", profile.keyintSec);
+        
+        obs_data_array_push_back(profileArray, profileData);
+        obs_data_release(profileData);
+    }
+    
+    obs_data_set_array(data, "encoderProfiles", profileArray);
+    obs_data_array_release(profileArray);
+    
+    obs_data_set_bool(data, "tracing", tracingEnabled);
+    obs_data_set_bool(data, "warmStandby", warmStandby);
+    obs_data_set_bool(data, "multistreamOnly", multistreamOnly);
+    obs_data_set_bool(data, "dnsCache", DnsCache::IsEnabled());
+    obs_data_set_bool(data, "telemetry", TelemetryRecorder::IsEnabled());
+    obs_data_set_int(data, "telemetryMaxMB", (long long)telemetryMaxMB);
+    obs_data_set_int(data, "telemetryMaxFiles", (long long)telemetryMaxFiles);
+    obs_data_set_int(data, "stopFlushWindowMs", (long long)stopFlushWindowMs);
+    obs_data_set_int(data, "stopDeadlineMs", (long long)stopDeadlineMs);
+    obs_data_set_int(data, "stallWindowMs", (long long)MultistreamOutput::GetStallWindowMs());
+    obs_data_set_string(data, "audioRelayFfmpeg", ffmpegPath.c_str());
+    obs_data_set_string(data, "delayBufferDirectory", delayBufferDirectory.c_str());
+    obs_data_set_bool(data, "relayOffload", RelayOffload::IsEnabled());
+    obs_data_set_string(data, "relayPath", relayPath.c_str());
+    
+    VerticalCanvasConfig vertical = VerticalCanvas::GetConfig();
+    obs_data_set_string(data, "verticalScene", vertical.scene.c_str());
+    obs_data_set_int(data, "verticalWidth", vertical.width);
+    obs_data_set_int(data, "verticalHeight", vertical.height);
+    obs_data_set_int(data, "verticalCropLeft", vertical.cropLeft);
+    obs_data_set_int(data, "verticalCropTop", vertical.cropTop);
+    obs_data_set_int(data, "verticalCropRight", vertical.cropRight);
+    obs_data_set_int(data, "verticalCropBottom", vertical.cropBottom);
+    obs_data_set_int(data, "verticalBitrate", vertical.pooledBitrate);
+    
     // Save to file
     obs_data_save_json_safe(data, configFilePath.c_str(), "tmp", "bak");
     
     obs_data_array_release(destArray);
     obs_data_release(data);
     
-    blog(LOG_INFO, "[%s] Settings saved to %s", PLUGIN_NAME, configFilePath.c_str());
+    blog(LOG_INFO, "[%s] Settings for %zu destinations saved to %s in %llu ms", PLUGIN_NAME, destinations.size(),
+         configFilePath.c_str(), (unsigned long long)((os_gettime_ns() - saveStart) / 1000000));
 }
 
 void MultistreamPlugin::LoadSettings() {
-    // Get OBS config path
-    char* configPath = obs_frontend_get_global_config_path();
-    if (!configPath) return;
+    MS_TRACE_SCOPE("MultistreamPlugin::LoadSettings");
     
-    // Create config file path
-    std::string configFilePath = std::string(configPath) + "/obs-multistream.json";
-    bfree(configPath);
+    std::string configFilePath = GetConfigFilePath("obs-multistream.json");
+    if (configFilePath.empty()) return;
+    
+    // Delay ring files go next to the settings unless configured otherwise
+    DelayBuffer::SetDirectory(GetConfigFilePath("obs-multistream-delay"));
+    RelayOffload::SetRelayPath(GetBundledExecutable(RELAY_OFFLOAD_DEFAULT_PATH));
+    AudioRelayOutput::SetFfmpegPath(GetBundledExecutable(AUDIO_RELAY_DEFAULT_FFMPEG));
     
     // Load from file
     obs_data_t* data = obs_data_create_from_json_file(configFilePath.c_str());
@@ -212,39 +823,209 @@ void MultistreamPlugin::LoadSettings() {
         return;
     }
     
+    uint64_t loadStart = os_gettime_ns();
     destinations.clear();
+    destinationIndex.clear();
+    
+    obs_data_set_default_int(data, "stopFlushWindowMs", MULTISTREAM_STOP_FLUSH_WINDOW_MS);
+    obs_data_set_default_int(data, "stopDeadlineMs", STOP_DEADLINE_MS);
+    stopFlushWindowMs = (uint64_t)obs_data_get_int(data, "stopFlushWindowMs");
+    stopDeadlineMs = (uint64_t)obs_data_get_int(data, "stopDeadlineMs");
+    obs_data_set_default_int(data, "stallWindowMs", MULTISTREAM_STALL_WINDOW_MS);
+    MultistreamOutput::SetStallWindowMs((uint64_t)obs_data_get_int(data, "stallWindowMs"));
+    // Older settings saved the bare name, which now also prefers the
+    // bundled ffmpeg
+    ffmpegPath = obs_data_get_string(data, "audioRelayFfmpeg");
+    if (ffmpegPath == AUDIO_RELAY_DEFAULT_FFMPEG) {
+        ffmpegPath.clear();
+    }
+    if (!ffmpegPath.empty()) {
+        AudioRelayOutput::SetFfmpegPath(ffmpegPath);
+    }
+    delayBufferDirectory = obs_data_get_string(data, "delayBufferDirectory");
+    if (!delayBufferDirectory.empty()) {
+        DelayBuffer::SetDirectory(delayBufferDirectory);
+    }
+    RelayOffload::SetEnabled(obs_data_get_bool(data, "relayOffload"));
+    relayPath = obs_data_get_string(data, "relayPath");
+    if (!relayPath.empty()) {
+        RelayOffload::SetRelayPath(relayPath);
+    }
+    
+    VerticalCanvasConfig vertical;
+    obs_data_set_default_int(data, "verticalWidth", vertical.width);
+    obs_data_set_default_int(data, "verticalHeight", vertical.height);
+    obs_data_set_default_int(data, "verticalBitrate", vertical.pooledBitrate);
+    vertical.scene = obs_data_get_string(data, "verticalScene");
+    vertical.width = std::max(2, (int)obs_data_get_int(data, "verticalWidth"));
+    vertical.height = std::max(2, (int)obs_data_get_int(data, "verticalHeight"));
+    vertical.cropLeft = (int)obs_data_get_int(data, "verticalCropLeft");
+    vertical.cropTop = (int)obs_data_get_int(data, "verticalCropTop");
+    vertical.cropRight = (int)obs_data_get_int(data, "verticalCropRight");
+    vertical.cropBottom = (int)obs_data_get_int(data, "verticalCropBottom");
+    vertical.pooledBitrate = (int)obs_data_get_int(data, "verticalBitrate");
+    VerticalCanvas::SetConfig(vertical);
+    
+    warmStandby = obs_data_get_bool(data, "warmStandby");
+    multistreamOnly = obs_data_get_bool(data, "multistreamOnly");
+    obs_data_set_default_bool(data, "dnsCache", true);
+    DnsCache::SetEnabled(obs_data_get_bool(data, "dnsCache"));
+    obs_data_set_default_int(data, "telemetryMaxMB", TELEMETRY_DEFAULT_MAX_MB);
+    TelemetryRecorder::SetEnabled(obs_data_get_bool(data, "telemetry"));
+    telemetryMaxMB = (uint64_t)obs_data_get_int(data, "telemetryMaxMB");
+    obs_data_set_default_int(data, "telemetryMaxFiles", TELEMETRY_DEFAULT_MAX_FILES);
+    telemetryMaxFiles = (uint64_t)std::max<long long>(obs_data_get_int(data, "telemetryMaxFiles"), 1);
+    SharedEncoderManager::GetInstance()->SetUseOwnedEncoders(multistreamOnly);
+    tracingEnabled = obs_data_get_bool(data, "tracing");
+#ifdef MULTISTREAM_TRACING
+    MultistreamTrace::SetEnabled(tracingEnabled);
+#else
+    if (tracingEnabled) {
+        blog(LOG_WARNING, "[%s] Tracing requested but this build has MULTISTREAM_ENABLE_TRACING off", PLUGIN_NAME);
+    }
+#endif
     
     obs_data_array_t* destArray = obs_data_get_array(data, "destinations");
     size_t count = obs_data_array_count(destArray);
+    destinations.reserve(count);
+    destinationIndex.reserve(count);
     
     for (size_t i = 0; i < count; i++) {
         obs_data_t* destData = obs_data_array_item(destArray, i);
         
         StreamDestination dest;
+        dest.id = obs_data_get_string(destData, "id");
         dest.name = obs_data_get_string(destData, "name");
         dest.url = obs_data_get_string(destData, "url");
+        dest.backupUrl = obs_data_get_string(destData, "backupUrl");
         dest.key = obs_data_get_string(destData, "key");
         dest.enabled = obs_data_get_bool(destData, "enabled");
         dest.useMainEncoder = obs_data_get_bool(destData, "useMainEncoder");
         dest.bitrate = (int)obs_data_get_int(destData, "bitrate");
+        dest.bindAddress = obs_data_get_string(destData, "bindAddress");
+        dest.audioOnly = obs_data_get_bool(destData, "audioOnly");
+        dest.vertical = obs_data_get_bool(destData, "vertical");
+        dest.delaySec = DelayBuffer::ClampDelay((int)obs_data_get_int(destData, "delaySec"));
+        dest.connectByAddress = obs_data_get_bool(destData, "connectByAddress");
+        
+        const char* encoderProfile = obs_data_get_string(destData, "encoderProfile");
+        if (encoderProfile && *encoderProfile) {
+            dest.encoderProfile = encoderProfile;
+        }
         
+        const char* codec = obs_data_get_string(destData, "codec");
+        if (codec && *codec) {
+            dest.codec = codec;
+        }
+        
+        // Configs from older versions have no ids
+        if (dest.id.empty() || destinationIndex.count(dest.id)) {
+            dest.id = GenerateDestinationId();
+        }
+        
+        destinationIndex[dest.id] = destinations.size();
         destinations.push_back(dest);
         obs_data_release(destData);
     }
     
     obs_data_array_release(destArray);
+    
+    obs_data_array_t* uplinkArray = obs_data_get_array(data, "uplinks");
+    size_t uplinkCount = obs_data_array_count(uplinkArray);
+    std::vector<UplinkInterface> uplinks;
+    
+    for (size_t i = 0; i < uplinkCount; i++) {
+        obs_data_t* uplinkData = obs_data_array_item(uplinkArray, i);
+        
+        UplinkInterface uplink;
+        uplink.name = obs_data_get_string(uplinkData, "name");
+        uplink.address = obs_data_get_string(uplinkData, "address");
+        uplink.capacityKbps = (uint64_t)obs_data_get_int(uplinkData, "capacityKbps");
+        
+        if (!uplink.address.empty()) {
+            uplinks.push_back(uplink);
+        }
+        obs_data_release(uplinkData);
+    }
+    
+    obs_data_array_release(uplinkArray);
+    InterfaceBalancer::GetInstance()->SetConfiguredUplinks(uplinks);
+
+    obs_data_array_t* profileArray = obs_data_get_array(data, "encoderProfiles");
+    size_t profileCount = obs_data_array_count(profileArray);
+    std::vector<EncoderProfile> profiles;
+
+    for (size_t i = 0; i < profileCount; i++) {
+        obs_data_t* profileData = obs_data_array_item(profileArray, i);
+
+        // Unset fields keep the EncoderProfile defaults
+        EncoderProfile profile;
+        obs_data_set_default_string(profileData, "rateControl", profile.rateControl.c_str());
+        obs_data_set_default_string(profileData, "profile", profile.profile.c_str());
+        obs_data_set_default_string(profileData, "preset", profile.preset.c_str());
+        obs_data_set_default_int(profileData, "bframes", profile.bframes);
+        obs_data_set_default_int(profileData, "lookahead", profile.lookahead);
+        obs_data_set_default_int(profileData, "keyintSec", profile.keyintSec);
+
+        profile.name = obs_data_get_string(profileData, "name");
+        profile.rateControl = obs_data_get_string(profileData, "rateControl");
+        profile.profile = obs_data_get_string(profileData, "profile");
+        profile.preset = obs_data_get_string(profileData, "preset");
+        profile.tune = obs_data_get_string(profileData, "tune");
+        profile.bframes = (int)obs_data_get_int(profileData, "bframes");
+        profile.lookahead = (int)obs_data_get_int(profileData, "lookahead");
+        profile.keyintSec = (int)obs_data_get_int(profileData, "keyintSec");
+
+        if (!profile.name.empty()) {
+            profiles.push_back(profile);
+        }
+        obs_data_release(profileData);
+    }
+
+    obs_data_array_release(profileArray);
+    EncoderProfiles::SetCustom(profiles);
     obs_data_release(data);
     
-    blog(LOG_INFO, "[%s] Loaded %zu destinations from config", 
-         PLUGIN_NAME, destinations.size());
+    blog(LOG_INFO, "[%s] Loaded %zu destinations from config in %llu ms", 
+         PLUGIN_NAME, destinations.size(), (unsigned long long)((os_gettime_ns() - loadStart) / 1000000));
+    
+    if (warmStandby) {
+        PrepareStandby();
+    } else {
+        ReleaseStandby();
+    }
+}
+
+void MultistreamPlugin::OnFrontendEvent(enum obs_frontend_event event, void* data) {
+    MultistreamPlugin* plugin = static_cast<MultistreamPlugin*>(data);
+    switch (event) {
+    case OBS_FRONTEND_EVENT_STREAMING_STARTED:
+        plugin->OnMainStreamingStarted(event, data);
+        break;
+    case OBS_FRONTEND_EVENT_STREAMING_STOPPED:
+        plugin->OnMainStreamingStopped(event, data);
+        break;
+    case OBS_FRONTEND_EVENT_FINISHED_LOADING:
+        // Output and encoder types are all registered by now
+        plugin->coreReady = true;
+        plugin->PrefetchIngestHosts(0);
+        plugin->PrepareStandby();
+        break;
+    default:
+        break;
+    }
 }
 
 void MultistreamPlugin::OnMainStreamingStarted(enum obs_frontend_event event, void* data) {
     UNUSED_PARAMETER(event);
     UNUSED_PARAMETER(data);
     
-    // Automatically start multistream when main streaming starts
-    MultistreamPlugin::GetInstance()->StartStreaming();
+    // Automatically start multistream when main streaming starts, unless
+    // destinations run on their own
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+    if (!plugin->IsMultistreamOnly()) {
+        plugin->StartStreaming();
+    }
 }
 
 void MultistreamPlugin::OnMainStreamingStopped(enum obs_frontend_event event, void* data) {
@@ -252,7 +1033,19 @@ void MultistreamPlugin::OnMainStreamingStopped(enum obs_frontend_event event, vo
     UNUSED_PARAMETER(data);
     
     // Automatically stop multistream when main streaming stops
-    MultistreamPlugin::GetInstance()->StopStreaming();
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+    if (!plugin->IsMultistreamOnly()) {
+        plugin->StopStreaming();
+    }
+}
+
+void MultistreamPlugin::OnMonitorTick(void* param) {
+    MultistreamPlugin* plugin = static_cast<MultistreamPlugin*>(param);
+    if (!plugin->isStreaming) return;
+    
+    for (auto* output : plugin->outputs) {
+        output->MonitorTick();
+    }
 }
 
 // ============================================================================
@@ -266,41 +1059,3 @@ const char* GetPluginVersion() {
 const char* GetPluginName() {
     return PLUGIN_NAME;
 }
-
-// ============================================================================
-// Module Exports
-// ============================================================================
-
-extern "C" {
-
-EXPORT bool obs_module_load(void) {
-    blog(LOG_INFO, "[%s] Loading module", PLUGIN_NAME);
-    
-    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
-    if (!plugin->Initialize()) {
-        blog(LOG_ERROR, "[%s] Failed to initialize plugin", PLUGIN_NAME);
-        return false;
-    }
-    
-    return true;
-}
-
-EXPORT void obs_module_unload(void) {
-    blog(LOG_INFO, "[%s] Unloading module", PLUGIN_NAME);
-    
-    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
-    if (plugin) {
-        // Use public cleanup method instead of accessing private members
-        plugin->Cleanup();
-    }
-}
-
-EXPORT MODULE_EXPORT const char* obs_module_name(void) {
-    return "OBS Multistream Plugin";
-}
-
-EXPORT MODULE_EXPORT const char* obs_module_description(void) {
-    return "Plugin for streaming to multiple RTMP destinations and YouTube channels simultaneously";
-}
-
-} 
\ No newline at end of file
@@ -4,8 +4,10 @@
 #include <obs-frontend-api.h>
 #include <util/config-file.h>
 #include <util/dstr.h>
+#include <util/platform.h>
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 // Include StreamDestination definition
 #include "stream-destination.h"
@@ -14,8 +16,15 @@
 #define PLUGIN_VERSION "1.0.0"
 
 // Forward declarations
-class MultistreamDock;
 class MultistreamOutput;
+struct OutputStats;
+
+// Outcome of stopping one destination
+struct OutputStopReport {
+    std::string name;
+    uint64_t latencyMs;
+    bool forced;
+};
 
 // Main plugin class
 class MultistreamPlugin {
@@ -26,17 +35,53 @@ public:
     void Shutdown();
     void Cleanup(); // Public cleanup method for proper singleton destruction
     
-    // Stream management
-    void AddDestination(const StreamDestination& dest);
-    void RemoveDestination(size_t index);
-    void UpdateDestination(size_t index, const StreamDestination& dest);
+    // Keep settings and session files in this directory instead of the OBS
+    // config directory; for hosts without a frontend, such as the soak
+    // harness. Call before Initialize(), once the host has registered its
+    // output and encoder types: the plugin then treats the core as loaded
+    // from Initialize() on, which warm standby waits for.
+    static void SetConfigDirectory(const std::string& directory);
+    
+    // Stream management. Destinations are addressed by their id, which
+    // AddDestination() assigns and which never changes afterwards.
+    std::string AddDestination(const StreamDestination& dest);
+    bool RemoveDestination(const std::string& id);
+    bool UpdateDestination(const std::string& id, const StreamDestination& dest);
+    // Apply several updates, matched by StreamDestination::id, with a single
+    // save. Nothing changes unless every id exists.
+    bool UpdateDestinations(const std::vector<StreamDestination>& updates);
+    const StreamDestination* FindDestination(const std::string& id) const;
     const std::vector<StreamDestination>& GetDestinations() const;
     
+    // Running output for a destination, or nullptr
+    MultistreamOutput* FindOutput(const std::string& id) const;
+    
     // Streaming control
     void StartStreaming();
     void StopStreaming();
     bool IsStreaming() const;
     
+    // Batch control: start or stop a subset of destinations while the others
+    // keep their state. Starting also starts the session if it is not
+    // running; stopping the last output ends it. Unknown ids and
+    // destinations already in the requested state are skipped. Both return
+    // the ids that changed state.
+    std::vector<std::string> StartDestinations(const std::vector<std::string>& ids);
+    std::vector<std::string> StopDestinations(const std::vector<std::string>& ids);
+    
+    // Live statistics for every running output
+    std::vector<OutputStats> GetOutputStats() const;
+    
+    // Destinations start and stop from the dock, independent of the main
+    // stream, sharing a plugin-owned encoder pair
+    bool IsMultistreamOnly() const;
+    
+    // Time StartStreaming() spent setting up and starting outputs
+    uint64_t GetLastStartLatencyMs() const;
+    
+    // Per-destination results of the most recent StopStreaming()
+    const std::vector<OutputStopReport>& GetLastStopReport() const;
+    
     // Configuration
     void SaveSettings();
     void LoadSettings();
@@ -47,15 +92,73 @@ private:
     
     static MultistreamPlugin* instance;
     
+    // Destinations in display order, with an id -> position index
     std::vector<StreamDestination> destinations;
+    std::unordered_map<std::string, size_t> destinationIndex;
+    std::string GenerateDestinationId() const;
+    void RebuildDestinationIndex();
+    
     std::vector<MultistreamOutput*> outputs;
-    MultistreamDock* dock;
+    std::unordered_map<std::string, MultistreamOutput*> outputsById;
     
     bool isStreaming;
     
+    // Stop timing: each output gets stopFlushWindowMs to drain, and the
+    // whole graceful phase ends at stopDeadlineMs regardless
+    uint64_t stopFlushWindowMs;
+    uint64_t stopDeadlineMs;
+    std::vector<OutputStopReport> lastStopReport;
+    void StartOutputs(const std::vector<const StreamDestination*>& starting);
+    void StopOutputs(const std::vector<MultistreamOutput*>& stopping);
+    void FinishSession();
+    void EmitStreamingEvent();
+    
+    // Record trace events (only effective in MULTISTREAM_TRACING builds)
+    bool tracingEnabled;
+    void DumpTrace();
+    
+    // Per-session binary telemetry file, see TelemetryRecorder
+    uint64_t telemetryMaxMB;
+    uint64_t telemetryMaxFiles;
+    void OpenTelemetry();
+    
+    // Configured directory for delay ring files (empty = next to the settings)
+    std::string delayBufferDirectory;
+    
+    // Configured relay executable for relay offload (empty = the one
+    // installed with the plugin)
+    std::string relayPath;
+    
+    // Configured ffmpeg for the relays (empty = the one installed with the
+    // plugin, else PATH), and a warning at load when it cannot be found
+    std::string ffmpegPath;
+    void CheckFfmpeg();
+    
+    // Process CPU usage over the session, logged when it ends
+    os_cpu_usage_info_t* sessionCpu;
+    
+    bool multistreamOnly;
+    
+    // Warm the DNS cache for all enabled destinations
+    void PrefetchIngestHosts(uint64_t timeoutMs);
+    
+    // Warm standby: outputs for enabled destinations are created ahead of
+    // time and kept across stop/start so go-live only has to connect
+    bool warmStandby;
+    // Output and encoder types are all registered: set once the frontend has
+    // finished loading, or by Initialize() in hosts without one
+    bool coreReady;
+    std::unordered_map<std::string, MultistreamOutput*> standbyOutputs;
+    uint64_t lastStartLatencyMs;
+    void PrepareStandby();
+    MultistreamOutput* TakeStandbyOutput(const StreamDestination& dest);
+    void ReleaseStandby();
+    
     // Event handlers
+    static void OnFrontendEvent(enum obs_frontend_event event, void* data);
     static void OnMainStreamingStarted(enum obs_frontend_event event, void* data);
     static void OnMainStreamingStopped(enum obs_frontend_event event, void* data);
+    static void OnMonitorTick(void* param);
 };
 
 // Helper functions
@@ -0,0 +1,120 @@
+#include "output-monitor.h"
+#include <obs.h>
+#include <util/threading.h>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct MonitorCallback {
+    OutputMonitorCallback callback;
+    void* param;
+};
+
+static std::mutex callbacksMutex;
+static std::vector<MonitorCallback> callbacks;
+
+static std::thread timerThread;
+static os_event_t* stopEvent = nullptr;
+
+std::atomic<bool> OutputMonitor::running(false);
+std::atomic<bool> OutputMonitor::tickPending(false);
+std::atomic<uint32_t> OutputMonitor::pendingIntervals(0);
+uint32_t OutputMonitor::intervalMs = 1000;
+
+// Intervals a queued tick may wait before the UI thread is reported as not
+// running them
+#define TICK_PENDING_WARN_INTERVALS 30
+
+bool OutputMonitor::Start(uint32_t interval) {
+    if (running.load()) return true;
+
+    // From the UI thread the handler runs a waited task in place; without a
+    // handler libobs logs and returns without running it
+    bool probed = false;
+    obs_queue_task(OBS_TASK_UI, Probe, &probed, true);
+    if (!probed) {
+        blog(LOG_ERROR, "[multistream] Output monitor not started: the host has no UI task handler, "
+                        "so failover, the stall watchdog and telemetry are disabled");
+        return false;
+    }
+
+    intervalMs = interval;
+    tickPending.store(false);
+    pendingIntervals.store(0);
+    os_event_init(&stopEvent, OS_EVENT_TYPE_MANUAL);
+    running.store(true);
+    timerThread = std::thread(TimerThread);
+    return true;
+}
+
+void OutputMonitor::Stop() {
+    if (!running.load()) return;
+
+    running.store(false);
+    os_event_signal(stopEvent);
+    timerThread.join();
+
+    os_event_destroy(stopEvent);
+    stopEvent = nullptr;
+
+    std::lock_guard<std::mutex> lock(callbacksMutex);
+    callbacks.clear();
+}
+
+uint32_t OutputMonitor::GetIntervalMs() {
+    return intervalMs;
+}
+
+void OutputMonitor::AddCallback(OutputMonitorCallback callback, void* param) {
+    std::lock_guard<std::mutex> lock(callbacksMutex);
+    callbacks.push_back({callback, param});
+}
+
+void OutputMonitor::RemoveCallback(OutputMonitorCallback callback, void* param) {
+    std::lock_guard<std::mutex> lock(callbacksMutex);
+    callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(),
+                                   [callback, param](const MonitorCallback& entry) {
+                                       return entry.callback == callback && entry.param == param;
+                                   }),
+                    callbacks.end());
+}
+
+void OutputMonitor::TimerThread() {
+    os_set_thread_name("multistream-monitor");
+
+    while (os_event_timedwait(stopEvent, intervalMs) != 0) {
+        if (tickPending.exchange(true)) {
+            // Once per stuck tick, so a blocked UI thread shows up in the log
+            if (pendingIntervals.fetch_add(1) + 1 == TICK_PENDING_WARN_INTERVALS) {
+                blog(LOG_WARNING, "[multistream] Output monitor tick has waited %u ms for the UI thread",
+                     TICK_PENDING_WARN_INTERVALS * intervalMs);
+            }
+            continue;
+        }
+        obs_queue_task(OBS_TASK_UI, Tick, nullptr, false);
+    }
+}
+
+void OutputMonitor::Tick(void* param) {
+    UNUSED_PARAMETER(param);
+    pendingIntervals.store(0);
+    tickPending.store(false);
+
+    if (!running.load()) return;
+
+    // Callbacks may add or remove callbacks
+    std::vector<MonitorCallback> current;
+    {
+        std::lock_guard<std::mutex> lock(callbacksMutex);
+        current = callbacks;
+    }
+
+    for (const auto& entry : current) {
+        entry.callback(entry.param);
+    }
+}
+
+void OutputMonitor::Probe(void* param) {
+    *static_cast<bool*>(param) = true;
+}
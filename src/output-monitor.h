@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Called on the UI thread once per monitor tick
+typedef void (*OutputMonitorCallback)(void* param);
+
+// Periodic health checks for running outputs.
+//
+// A background thread wakes every interval and queues a tick on the UI
+// thread with obs_queue_task. Outputs are created, started, stopped and
+// swapped on the UI thread, so callbacks can inspect and act on them without
+// extra locking. A tick is skipped while the previous one is still queued,
+// so a busy UI thread delays checks instead of piling them up.
+//
+// libobs drops UI tasks when the host never installed a UI task handler
+// (obs_set_ui_task_handler), as a bare libobs host without the frontend may
+// not. Start() runs a probe task first and refuses to start, with an error,
+// when the probe does not run: failover, the stall watchdog and telemetry
+// would otherwise be silently off.
+class OutputMonitor {
+public:
+    // Start/stop the timer thread, from module load/unload. Start() must be
+    // called on the UI thread and fails when UI tasks cannot run.
+    static bool Start(uint32_t intervalMs);
+    static void Stop();
+
+    static uint32_t GetIntervalMs();
+
+    static void AddCallback(OutputMonitorCallback callback, void* param);
+    static void RemoveCallback(OutputMonitorCallback callback, void* param);
+
+private:
+    static void TimerThread();
+    static void Tick(void* param);
+    static void Probe(void* param);
+
+    static std::atomic<bool> running;
+    static std::atomic<bool> tickPending;
+    static std::atomic<uint32_t> pendingIntervals;
+    static uint32_t intervalMs;
+};
@@ -0,0 +1,207 @@
+#include "packet-tap.h"
+#include <util/platform.h>
+#include <algorithm>
+
+#define PACKET_TAP_AV_ID "multistream_packet_tap"
+#define PACKET_TAP_VIDEO_ID "multistream_video_tap"
+
+// Static members
+std::mutex PacketTap::tapsMutex;
+std::vector<PacketTap*> PacketTap::taps;
+
+// Private data of a tap output instance
+struct TapOutputData {
+    PacketTap* tap;
+    obs_output_t* output;
+};
+
+// ============================================================================
+// Tap Registry
+// ============================================================================
+
+void PacketTap::RegisterOutputType() {
+    struct obs_output_info info = {};
+    info.id = PACKET_TAP_AV_ID;
+    info.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED;
+    info.get_name = GetName;
+    info.create = Create;
+    info.destroy = Destroy;
+    info.start = OutputStart;
+    info.stop = OutputStop;
+    info.encoded_packet = EncodedPacket;
+    obs_register_output(&info);
+
+    // Variant for encoder pairs without audio
+    info.id = PACKET_TAP_VIDEO_ID;
+    info.flags = OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED;
+    obs_register_output(&info);
+}
+
+PacketTap* PacketTap::Acquire(obs_encoder_t* videoEncoder, obs_encoder_t* audioEncoder) {
+    if (!videoEncoder) return nullptr;
+
+    std::lock_guard<std::mutex> lock(tapsMutex);
+
+    for (auto* tap : taps) {
+        if (tap->videoEncoder == videoEncoder && tap->audioEncoder == audioEncoder) {
+            tap->refCount++;
+            return tap;
+        }
+    }
+
+    PacketTap* tap = new PacketTap(videoEncoder, audioEncoder);
+    if (!tap->Start()) {
+        delete tap;
+        return nullptr;
+    }
+
+    taps.push_back(tap);
+    return tap;
+}
+
+void PacketTap::Release(PacketTap* tap) {
+    if (!tap) return;
+
+    std::lock_guard<std::mutex> lock(tapsMutex);
+
+    if (--tap->refCount > 0) return;
+
+    taps.erase(std::remove(taps.begin(), taps.end(), tap), taps.end());
+    delete tap;
+}
+
+// ============================================================================
+// PacketTap Implementation
+// ============================================================================
+
+PacketTap::PacketTap(obs_encoder_t* video, obs_encoder_t* audio)
+    : output(nullptr), videoEncoder(video), audioEncoder(audio), refCount(1), gopCacheUsers(0) {
+}
+
+PacketTap::~PacketTap() {
+    Stop();
+}
+
+bool PacketTap::Start() {
+    obs_data_t* settings = obs_data_create();
+    obs_data_set_int(settings, "tap", (long long)(intptr_t)this);
+
+    const char* id = audioEncoder ? PACKET_TAP_AV_ID : PACKET_TAP_VIDEO_ID;
+    output = obs_output_create(id, "multistream_packet_tap", settings, nullptr);
+    obs_data_release(settings);
+
+    if (!output) {
+        blog(LOG_ERROR, "[multistream] Failed to create packet tap");
+        return false;
+    }
+
+    obs_output_set_video_encoder(output, videoEncoder);
+    if (audioEncoder) {
+        obs_output_set_audio_encoder(output, audioEncoder, 0);
+    }
+
+    if (!obs_output_start(output)) {
+        blog(LOG_ERROR, "[multistream] Failed to start packet tap");
+        obs_output_release(output);
+        output = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void PacketTap::Stop() {
+    if (!output) return;
+
+    // Destroying the output guarantees no packet callback is still running
+    obs_output_force_stop(output);
+    obs_output_release(output);
+    output = nullptr;
+}
+
+void PacketTap::AddCallback(PacketTapCallback callback, void* param) {
+    std::lock_guard<std::mutex> lock(callbacksMutex);
+    callbacks.push_back({callback, param});
+}
+
+void PacketTap::RemoveCallback(PacketTapCallback callback, void* param) {
+    std::lock_guard<std::mutex> lock(callbacksMutex);
+
+    for (auto it = callbacks.begin(); it != callbacks.end(); ++it) {
+        if (it->callback == callback && it->param == param) {
+            callbacks.erase(it);
+            break;
+        }
+    }
+}
+
+void PacketTap::RetainGopCache() {
+    gopCacheUsers++;
+}
+
+void PacketTap::ReleaseGopCache() {
+    if (--gopCacheUsers == 0) {
+        gopCache.Clear();
+    }
+}
+
+const GopCache& PacketTap::GetGopCache() const {
+    return gopCache;
+}
+
+void PacketTap::Dispatch(struct encoder_packet* packet) {
+    uint64_t receivedNs = os_gettime_ns();
+
+    if (gopCacheUsers.load(std::memory_order_relaxed) > 0) {
+        gopCache.Push(packet);
+    }
+
+    std::lock_guard<std::mutex> lock(callbacksMutex);
+    for (const auto& cb : callbacks) {
+        cb.callback(cb.param, packet, receivedNs);
+    }
+}
+
+// ============================================================================
+// Output Type Callbacks
+// ============================================================================
+
+const char* PacketTap::GetName(void* typeData) {
+    UNUSED_PARAMETER(typeData);
+    return "Multistream Packet Tap";
+}
+
+void* PacketTap::Create(obs_data_t* settings, obs_output_t* output) {
+    TapOutputData* data = new TapOutputData();
+    data->tap = (PacketTap*)(intptr_t)obs_data_get_int(settings, "tap");
+    data->output = output;
+    return data;
+}
+
+void PacketTap::Destroy(void* data) {
+    delete static_cast<TapOutputData*>(data);
+}
+
+bool PacketTap::OutputStart(void* data) {
+    TapOutputData* tapData = static_cast<TapOutputData*>(data);
+
+    if (!obs_output_can_begin_data_capture(tapData->output, 0)) return false;
+    if (!obs_output_initialize_encoders(tapData->output, 0)) return false;
+
+    return obs_output_begin_data_capture(tapData->output, 0);
+}
+
+void PacketTap::OutputStop(void* data, uint64_t ts) {
+    UNUSED_PARAMETER(ts);
+    TapOutputData* tapData = static_cast<TapOutputData*>(data);
+    obs_output_end_data_capture(tapData->output);
+}
+
+void PacketTap::EncodedPacket(void* data, struct encoder_packet* packet) {
+    TapOutputData* tapData = static_cast<TapOutputData*>(data);
+
+    // A null packet signals an encoder error; nothing to observe
+    if (!packet || !tapData->tap) return;
+
+    tapData->tap->Dispatch(packet);
+}
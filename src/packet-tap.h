@@ -0,0 +1,70 @@
+#pragma once
+
+#include <obs.h>
+#include "gop-cache.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Called on the tap's output thread for every encoded packet
+typedef void (*PacketTapCallback)(void* param, struct encoder_packet* packet, uint64_t receivedNs);
+
+// Passive observer of an encoder pair's packet stream.
+//
+// A tap is a plugin-registered encoded output attached to the same encoders
+// as the RTMP outputs, so it sees each packet at the point libobs hands it to
+// outputs. Taps are shared: one per encoder pair, reference counted, with any
+// number of callbacks registered on it. A tap can also keep the encoder
+// pair's latest GOP for all of its users.
+class PacketTap {
+public:
+    // Register the tap output type with libobs, from obs_module_load
+    static void RegisterOutputType();
+
+    // Get (and start, if new) the tap for an encoder pair
+    static PacketTap* Acquire(obs_encoder_t* videoEncoder, obs_encoder_t* audioEncoder);
+    static void Release(PacketTap* tap);
+
+    void AddCallback(PacketTapCallback callback, void* param);
+    void RemoveCallback(PacketTapCallback callback, void* param);
+
+    // The GOP cache fills while at least one user retains it
+    void RetainGopCache();
+    void ReleaseGopCache();
+    const GopCache& GetGopCache() const;
+
+private:
+    PacketTap(obs_encoder_t* videoEncoder, obs_encoder_t* audioEncoder);
+    ~PacketTap();
+
+    bool Start();
+    void Stop();
+    void Dispatch(struct encoder_packet* packet);
+
+    // obs_output_info callbacks
+    static const char* GetName(void* typeData);
+    static void* Create(obs_data_t* settings, obs_output_t* output);
+    static void Destroy(void* data);
+    static bool OutputStart(void* data);
+    static void OutputStop(void* data, uint64_t ts);
+    static void EncodedPacket(void* data, struct encoder_packet* packet);
+
+    struct Callback {
+        PacketTapCallback callback;
+        void* param;
+    };
+
+    static std::mutex tapsMutex;
+    static std::vector<PacketTap*> taps;
+
+    obs_output_t* output;
+    obs_encoder_t* videoEncoder;
+    obs_encoder_t* audioEncoder;
+    int refCount;
+
+    std::mutex callbacksMutex;
+    std::vector<Callback> callbacks;
+
+    std::atomic<int> gopCacheUsers;
+    GopCache gopCache;
+};
@@ -0,0 +1,91 @@
+#include "obs-multistream.h"
+#include "multistream-dock.h"
+#include "packet-tap.h"
+#include "audio-relay-output.h"
+#include "delay-relay-output.h"
+#include "multistream-trace.h"
+#include "multistream-log.h"
+#include "output-monitor.h"
+#include "multistream-websocket.h"
+#include <obs-module.h>
+
+// How often running outputs are health-checked
+#define OUTPUT_MONITOR_INTERVAL_MS 1000
+
+// Module globals
+OBS_DECLARE_MODULE()
+OBS_MODULE_USE_DEFAULT_LOCALE("obs-multistream", "en-US")
+
+// The dock is the platform front-end; the plugin core does not know about it
+static MultistreamDock* dock = nullptr;
+
+// ============================================================================
+// Module Exports
+// ============================================================================
+
+extern "C" {
+
+EXPORT bool obs_module_load(void) {
+    blog(LOG_INFO, "[%s] Loading module", PLUGIN_NAME);
+    
+    MultistreamLog::Start();
+    OutputMonitor::Start(OUTPUT_MONITOR_INTERVAL_MS);
+    PacketTap::RegisterOutputType();
+    AudioRelayOutput::RegisterOutputType();
+    DelayRelayOutput::RegisterOutputType();
+    
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+    if (!plugin->Initialize()) {
+        blog(LOG_ERROR, "[%s] Failed to initialize plugin", PLUGIN_NAME);
+        return false;
+    }
+    
+    // Create dock
+    dock = new MultistreamDock();
+    if (!dock->Initialize()) {
+        blog(LOG_ERROR, "[%s] Failed to initialize dock", PLUGIN_NAME);
+        return false;
+    }
+    
+    return true;
+}
+
+EXPORT void obs_module_post_load(void) {
+    // obs-websocket registers its vendor API during its own load
+    MultistreamWebsocket::Register();
+}
+
+EXPORT void obs_module_unload(void) {
+    blog(LOG_INFO, "[%s] Unloading module", PLUGIN_NAME);
+    
+    MultistreamWebsocket::Unregister();
+    
+    // Clean up dock
+    if (dock) {
+        delete dock;
+        dock = nullptr;
+    }
+    
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+    if (plugin) {
+        // Use public cleanup method instead of accessing private members
+        plugin->Cleanup();
+    }
+    
+    OutputMonitor::Stop();
+    MultistreamLog::Stop();
+    
+#ifdef MULTISTREAM_TRACING
+    MultistreamTrace::Shutdown();
+#endif
+}
+
+EXPORT MODULE_EXPORT const char* obs_module_name(void) {
+    return "OBS Multistream Plugin";
+}
+
+EXPORT MODULE_EXPORT const char* obs_module_description(void) {
+    return "Plugin for streaming to multiple RTMP destinations and YouTube channels simultaneously";
+}
+
+}
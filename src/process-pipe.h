@@ -0,0 +1,38 @@
+#pragma once
+
+#include <util/pipe.h>
+#include <cstdint>
+#include <vector>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+// Writing to the companion processes OBS starts (ffmpeg, the relay) through
+// their stdin
+
+// Once at the start of a thread that writes to a process: a process that
+// died must fail the write, not raise SIGPIPE in OBS
+inline void BlockPipeSignals() {
+#ifndef _WIN32
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+#endif
+}
+
+// All of data, or false once the process has gone
+inline bool WriteProcessPipe(os_process_pipe_t* pipe, const std::vector<uint8_t>& data) {
+    return os_process_pipe_write(pipe, data.data(), data.size()) == data.size();
+}
+
+// Closing stdin lets the process flush and exit; this waits for it and
+// returns its exit code
+inline int CloseProcessPipe(os_process_pipe_t*& pipe) {
+    if (!pipe) return 0;
+
+    int exitCode = os_process_pipe_destroy(pipe);
+    pipe = nullptr;
+    return exitCode;
+}
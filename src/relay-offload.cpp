@@ -0,0 +1,724 @@
+#include "relay-offload.h"
+#include "relay-protocol.h"
+#include "packet-tap.h"
+#include "flv-tags.h"
+#include "process-pipe.h"
+#include "audio-relay-output.h"
+#include <util/pipe.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+typedef SOCKET socket_t;
+#define CloseSocket closesocket
+#define SHUTDOWN_BOTH SD_BOTH
+#define INVALID_SOCKET_VALUE INVALID_SOCKET
+#define SEND_FLAGS 0
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+#define CloseSocket close
+#define SHUTDOWN_BOTH SHUT_RDWR
+#define INVALID_SOCKET_VALUE -1
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+#endif
+
+// How long a new relay process has to connect back
+#define RELAY_OFFLOAD_ACCEPT_TIMEOUT_MS 5000
+
+// Restart backoff; it starts over once a relay has run this long
+#define RELAY_OFFLOAD_MIN_BACKOFF_MS 500
+#define RELAY_OFFLOAD_MAX_BACKOFF_MS 10000
+#define RELAY_OFFLOAD_STABLE_MS 30000
+
+// A relay that reads nothing for this long is treated as dead
+#define RELAY_OFFLOAD_SEND_STALL_MS 10000
+#define RELAY_OFFLOAD_SEND_SLICE_MS 500
+
+// Packets the relay may fall behind by before the newest are dropped
+#define RELAY_OFFLOAD_MAX_QUEUE_BYTES (16 * 1024 * 1024)
+
+// Characters that cannot appear inside the quoted command line
+#ifdef _WIN32
+#define RELAY_COMMAND_UNSAFE_CHARS "\"\r\n"
+#else
+#define RELAY_COMMAND_UNSAFE_CHARS "\"$`\\\r\n"
+#endif
+
+// Static members
+std::mutex RelayOffload::offloadsMutex;
+std::vector<RelayOffload*> RelayOffload::offloads;
+std::atomic<bool> RelayOffload::enabled(false);
+std::mutex RelayOffload::relayPathMutex;
+std::string RelayOffload::relayPath = RELAY_OFFLOAD_DEFAULT_PATH;
+
+// ============================================================================
+// Sockets
+// ============================================================================
+
+// Neither the relay nor any other process OBS starts may inherit the
+// connection, or a dead relay's socket would stay open
+static void SetNoInherit(socket_t sock) {
+#ifdef _WIN32
+    SetHandleInformation((HANDLE)sock, HANDLE_FLAG_INHERIT, 0);
+#else
+    fcntl(sock, F_SETFD, FD_CLOEXEC);
+#endif
+}
+
+static void SetSendTimeout(socket_t sock, int ms) {
+#ifdef _WIN32
+    DWORD timeout = (DWORD)ms;
+#else
+    struct timeval timeout = {ms / 1000, (ms % 1000) * 1000};
+#endif
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+static bool WouldBlock() {
+#ifdef _WIN32
+    int error = WSAGetLastError();
+    return error == WSAETIMEDOUT || error == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+static bool SendAll(socket_t sock, const uint8_t* data, size_t size, const std::atomic<bool>& stopping) {
+    uint64_t stalledSince = 0;
+    while (size > 0) {
+        int sent = send(sock, (const char*)data, (int)std::min<size_t>(size, 1 << 20), SEND_FLAGS);
+        if (sent > 0) {
+            data += sent;
+            size -= (size_t)sent;
+            stalledSince = 0;
+            continue;
+        }
+
+        if (sent < 0 && WouldBlock() && !stopping.load()) {
+            uint64_t now = os_gettime_ns();
+            if (!stalledSince) stalledSince = now;
+            if (now - stalledSince < RELAY_OFFLOAD_SEND_STALL_MS * 1000000ULL) continue;
+            blog(LOG_WARNING, "[multistream] Relay process read nothing for %d ms", RELAY_OFFLOAD_SEND_STALL_MS);
+        }
+        return false;
+    }
+    return true;
+}
+
+// True once sock has sent RELAY_MSG_HELLO with token before deadlineNs
+static bool ReceiveToken(socket_t sock, const std::string& token, uint64_t deadlineNs) {
+    std::vector<uint8_t> message(RELAY_MESSAGE_HEADER_BYTES + token.size());
+    size_t received = 0;
+    while (received < message.size()) {
+        uint64_t now = os_gettime_ns();
+        if (now >= deadlineNs) return false;
+
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(sock, &readable);
+        struct timeval timeout = {0, (long)std::min<uint64_t>((deadlineNs - now) / 1000, 200000)};
+        if (select((int)sock + 1, &readable, nullptr, nullptr, &timeout) <= 0) continue;
+
+        int count = recv(sock, (char*)message.data() + received, (int)(message.size() - received), 0);
+        if (count <= 0) return false;
+        received += (size_t)count;
+    }
+
+    return message[0] == RELAY_MSG_HELLO && ParseRelayPayloadSize(message.data()) == token.size() &&
+           memcmp(message.data() + RELAY_MESSAGE_HEADER_BYTES, token.data(), token.size()) == 0;
+}
+
+// Random hex token for one relay process
+static std::string CreateToken() {
+    static const char digits[] = "0123456789abcdef";
+    std::random_device random;
+    std::string token;
+    for (int i = 0; i < RELAY_TOKEN_CHARS; i++) {
+        token += digits[random() & 0xF];
+    }
+    return token;
+}
+
+static bool RecvAll(socket_t sock, uint8_t* data, size_t size) {
+    while (size > 0) {
+        int received = recv(sock, (char*)data, (int)size, 0);
+        if (received <= 0) return false;
+        data += received;
+        size -= (size_t)received;
+    }
+    return true;
+}
+
+// ============================================================================
+// Offload Registry
+// ============================================================================
+
+void RelayOffload::SetEnabled(bool enable) {
+    enabled = enable;
+}
+
+bool RelayOffload::IsEnabled() {
+    return enabled.load();
+}
+
+void RelayOffload::SetRelayPath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(relayPathMutex);
+    relayPath = path.empty() ? RELAY_OFFLOAD_DEFAULT_PATH : path;
+}
+
+std::string RelayOffload::GetRelayPath() {
+    std::lock_guard<std::mutex> lock(relayPathMutex);
+    return relayPath;
+}
+
+RelayOffload* RelayOffload::Acquire(obs_encoder_t* videoEncoder, obs_encoder_t* audioEncoder) {
+    if (!videoEncoder || !audioEncoder) return nullptr;
+
+    const char* videoCodec = obs_encoder_get_codec(videoEncoder);
+    const char* audioCodec = obs_encoder_get_codec(audioEncoder);
+    if (!videoCodec || strcmp(videoCodec, "h264") != 0 || !audioCodec || strcmp(audioCodec, "aac") != 0) {
+        blog(LOG_ERROR, "[multistream] Relay offload needs H.264 and AAC encoders");
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(offloadsMutex);
+
+    for (auto* offload : offloads) {
+        if (offload->videoEncoder == videoEncoder && offload->audioEncoder == audioEncoder) {
+            offload->refCount++;
+            return offload;
+        }
+    }
+
+    RelayOffload* offload = new RelayOffload(videoEncoder, audioEncoder);
+    if (!offload->Start()) {
+        delete offload;
+        return nullptr;
+    }
+
+    offloads.push_back(offload);
+    return offload;
+}
+
+void RelayOffload::Release(RelayOffload* offload) {
+    if (!offload) return;
+
+    std::lock_guard<std::mutex> lock(offloadsMutex);
+
+    if (--offload->refCount > 0) return;
+
+    offloads.erase(std::remove(offloads.begin(), offloads.end(), offload), offloads.end());
+    delete offload;
+}
+
+// ============================================================================
+// RelayOffload Implementation
+// ============================================================================
+
+RelayOffload::RelayOffload(obs_encoder_t* video, obs_encoder_t* audio)
+    : videoEncoder(video), audioEncoder(audio), refCount(1), tap(nullptr), pipe(nullptr),
+      relaySocket((intptr_t)INVALID_SOCKET_VALUE), connectionLost(false),
+      queuedBytes(0), maxQueuedBytes(0), connected(false), needKeyframe(true), needGop(false), stopping(false),
+      haveFirstPacket(false), firstDtsUsec(0),
+      bytesSent(0), droppedPackets(0), relayRestarts(0) {
+}
+
+RelayOffload::~RelayOffload() {
+    Stop();
+    LogSummary();
+}
+
+bool RelayOffload::Start() {
+#ifdef _WIN32
+    // Reference counted by Winsock; balanced in Stop()
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    sender = std::thread(&RelayOffload::SenderThread, this);
+
+    tap = PacketTap::Acquire(videoEncoder, audioEncoder);
+    if (!tap) {
+        blog(LOG_ERROR, "[multistream] Relay offload has no packet tap");
+        return false;
+    }
+    tap->AddCallback(OnTapPacket, this);
+    tap->RetainGopCache();
+
+    blog(LOG_INFO, "[multistream] Offloading publishing to %s", GetRelayPath().c_str());
+    return true;
+}
+
+void RelayOffload::Stop() {
+    if (tap) {
+        tap->RemoveCallback(OnTapPacket, this);
+        tap->ReleaseGopCache();
+        PacketTap::Release(tap);
+        tap = nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueWake.notify_one();
+    if (sender.joinable()) {
+        sender.join();
+    }
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void RelayOffload::LogSummary() {
+    blog(LOG_INFO,
+         "[multistream] Relay offload: %llu MB sent to the relay process, %llu packet(s) dropped, "
+         "%u relay restart(s), queue peaked at %llu KB",
+         (unsigned long long)(bytesSent.load() / (1024 * 1024)), (unsigned long long)droppedPackets.load(),
+         relayRestarts.load(), (unsigned long long)(maxQueuedBytes / 1024));
+}
+
+void RelayOffload::AddDestination(const StreamDestination& destination) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    destinations[destination.id] = destination;
+
+    {
+        std::lock_guard<std::mutex> statusLock(statusMutex);
+        statuses[destination.id] = RelayDestinationStatus();
+    }
+
+    // Otherwise it goes out with the rest when the relay connects
+    if (connected) {
+        std::vector<uint8_t> message;
+        AppendRelayMessage(message, RELAY_MSG_ADD,
+                           destination.id + "\n" + destination.url + "\n" + destination.key + "\n" +
+                               destination.backupUrl);
+        Enqueue(message);
+        queueWake.notify_one();
+    }
+}
+
+void RelayOffload::RemoveDestination(const std::string& id) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (!destinations.erase(id)) return;
+
+    {
+        std::lock_guard<std::mutex> statusLock(statusMutex);
+        statuses.erase(id);
+    }
+
+    if (connected) {
+        std::vector<uint8_t> message;
+        AppendRelayMessage(message, RELAY_MSG_REMOVE, id);
+        Enqueue(message);
+        queueWake.notify_one();
+    }
+}
+
+RelayDestinationStatus RelayOffload::GetStatus(const std::string& id) {
+    RelayDestinationStatus status;
+    {
+        std::lock_guard<std::mutex> lock(statusMutex);
+        auto it = statuses.find(id);
+        if (it != statuses.end()) status = it->second;
+    }
+
+    // Packets dropped on this side never reached any destination
+    status.droppedPackets += (int)droppedPackets.load();
+    return status;
+}
+
+void RelayOffload::SetAllStates(RelayDestinationState state) {
+    std::lock_guard<std::mutex> lock(statusMutex);
+    for (auto& entry : statuses) {
+        entry.second.state = state;
+    }
+}
+
+// ============================================================================
+// Muxing
+// ============================================================================
+
+void RelayOffload::OnTapPacket(void* data, struct encoder_packet* packet, uint64_t receivedNs) {
+    UNUSED_PARAMETER(receivedNs);
+    static_cast<RelayOffload*>(data)->MuxPacket(packet);
+}
+
+bool RelayOffload::BuildPreamble() {
+    uint8_t* videoExtra = nullptr;
+    size_t videoExtraSize = 0;
+    uint8_t* audioExtra = nullptr;
+    size_t audioExtraSize = 0;
+    if (!obs_encoder_get_extra_data(videoEncoder, &videoExtra, &videoExtraSize) ||
+        !obs_encoder_get_extra_data(audioEncoder, &audioExtra, &audioExtraSize)) {
+        return false;
+    }
+
+    std::vector<uint8_t> flv;
+    AppendFlvPreamble(flv, videoExtra, videoExtraSize, audioExtra, audioExtraSize);
+
+    preamble.clear();
+    AppendRelayHeader(preamble, RELAY_MSG_PREAMBLE, (uint32_t)flv.size());
+    preamble.insert(preamble.end(), flv.begin(), flv.end());
+    return true;
+}
+
+void RelayOffload::BuildTag(struct encoder_packet* packet, std::vector<uint8_t>& message) {
+    bool video = packet->type == OBS_ENCODER_VIDEO;
+    int64_t timestampMs = std::max<int64_t>(0, (packet->dts_usec - firstDtsUsec) / 1000);
+
+    message.reserve(packet->size + 32);
+    AppendRelayHeader(message, RELAY_MSG_TAG, 0);
+    message.push_back(video && packet->keyframe ? RELAY_TAG_KEYFRAME : 0);
+
+    if (video) {
+        struct encoder_packet converted = {};
+        obs_parse_avc_packet(&converted, packet);
+        int64_t compositionMs = packet->timebase_den
+                                    ? (packet->pts - packet->dts) * 1000 * packet->timebase_num / packet->timebase_den
+                                    : 0;
+        AppendVideoTag(message, (uint32_t)timestampMs, packet->keyframe, FLV_AVC_NALU, (int32_t)compositionMs,
+                       converted.data, converted.size);
+        obs_encoder_packet_release(&converted);
+    } else {
+        AppendAudioTag(message, (uint32_t)timestampMs, FLV_AAC_RAW, packet->data, packet->size);
+    }
+    SetRelayPayloadSize(message, 0);
+}
+
+void RelayOffload::MuxPacket(struct encoder_packet* packet) {
+    bool video = packet->type == OBS_ENCODER_VIDEO;
+
+    if (!haveFirstPacket) {
+        firstDtsUsec = packet->dts_usec;
+        haveFirstPacket = true;
+    }
+
+    // Muxed once here, whatever the number of destinations
+    std::vector<uint8_t> message;
+    BuildTag(packet, message);
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (stopping) return;
+
+        // The encoders have their extra data by the time they produce packets
+        if (preamble.empty()) {
+            if (!BuildPreamble()) return;
+            if (connected) {
+                std::vector<uint8_t> copy = preamble;
+                Enqueue(copy);
+            }
+        }
+
+        if (!connected) return;
+
+        // The tap caches each packet before passing it on, so the GOP ends
+        // with this one
+        if (needGop) {
+            needGop = false;
+            if (EnqueueGop()) {
+                needKeyframe = false;
+                queueWake.notify_one();
+                return;
+            }
+        }
+
+        if (video && packet->keyframe) {
+            needKeyframe = false;
+        }
+
+        bool full = queuedBytes + message.size() > RELAY_OFFLOAD_MAX_QUEUE_BYTES;
+        if (full || (video && needKeyframe)) {
+            // The relay gets video again from the next keyframe on
+            if (video) needKeyframe = true;
+            droppedPackets++;
+            return;
+        }
+
+        Enqueue(message);
+    }
+
+    queueWake.notify_one();
+}
+
+void RelayOffload::Enqueue(std::vector<uint8_t>& message) {
+    queuedBytes += message.size();
+    maxQueuedBytes = std::max(maxQueuedBytes, queuedBytes);
+    queue.push_back(std::move(message));
+}
+
+bool RelayOffload::EnqueueGop() {
+    std::vector<struct encoder_packet> packets;
+    if (!tap || !tap->GetGopCache().Copy(packets)) return false;
+
+    uint64_t durationMs = (uint64_t)(packets.back().dts_usec - packets.front().dts_usec) / 1000;
+    size_t bytes = 0;
+    for (auto& packet : packets) {
+        std::vector<uint8_t> message;
+        BuildTag(&packet, message);
+        bytes += message.size();
+        Enqueue(message);
+        obs_encoder_packet_release(&packet);
+    }
+
+    blog(LOG_INFO, "[multistream] Relay offload primed the relay with %zu packet(s), %llu ms, %zu KB",
+         packets.size(), (unsigned long long)durationMs, bytes / 1024);
+    return true;
+}
+
+// ============================================================================
+// Relay Process
+// ============================================================================
+
+bool RelayOffload::Connect() {
+    socket_t listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET_VALUE) {
+        blog(LOG_ERROR, "[multistream] Relay offload cannot create a socket");
+        return false;
+    }
+    SetNoInherit(listener);
+
+    // Loopback only, on a port of the system's choosing
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t addressSize = sizeof(address);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 1) != 0 ||
+        getsockname(listener, (struct sockaddr*)&address, &addressSize) != 0) {
+        blog(LOG_ERROR, "[multistream] Relay offload cannot listen on the loopback interface");
+        CloseSocket(listener);
+        return false;
+    }
+
+    std::string executable = GetRelayPath();
+    std::string ffmpeg = AudioRelayOutput::GetFfmpegPath();
+    if (executable.find_first_of(RELAY_COMMAND_UNSAFE_CHARS) != std::string::npos ||
+        ffmpeg.find_first_of(RELAY_COMMAND_UNSAFE_CHARS) != std::string::npos) {
+        blog(LOG_ERROR, "[multistream] Relay or ffmpeg path contains unsupported characters");
+        CloseSocket(listener);
+        return false;
+    }
+
+    // The relay exits when its stdin closes, so it never outlives OBS
+    std::string command = "\"" + executable + "\" --connect 127.0.0.1:" + std::to_string(ntohs(address.sin_port)) +
+                          " --protocol " + std::to_string(RELAY_PROTOCOL_VERSION) + " --ffmpeg \"" + ffmpeg + "\"";
+    pipe = os_process_pipe_create(command.c_str(), "w");
+    if (!pipe) {
+        blog(LOG_ERROR, "[multistream] Failed to run %s", executable.c_str());
+        CloseSocket(listener);
+        return false;
+    }
+
+    // Only the process holding the pipe learns the token
+    std::string token = CreateToken();
+    std::vector<uint8_t> tokenLine(token.begin(), token.end());
+    tokenLine.push_back('\n');
+    if (!WriteProcessPipe(pipe, tokenLine)) {
+        blog(LOG_ERROR, "[multistream] %s exited before it was given its token", executable.c_str());
+        CloseSocket(listener);
+        return false;
+    }
+
+    socket_t client = INVALID_SOCKET_VALUE;
+    uint64_t deadline = os_gettime_ns() + RELAY_OFFLOAD_ACCEPT_TIMEOUT_MS * 1000000ULL;
+    while (client == INVALID_SOCKET_VALUE && !stopping.load() && os_gettime_ns() < deadline) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        struct timeval timeout = {0, 200000};
+        if (select((int)listener + 1, &readable, nullptr, nullptr, &timeout) <= 0) continue;
+
+        socket_t candidate = accept(listener, nullptr, nullptr);
+        if (candidate == INVALID_SOCKET_VALUE) continue;
+
+        SetNoInherit(candidate);
+        if (ReceiveToken(candidate, token, deadline)) {
+            client = candidate;
+        } else {
+            blog(LOG_WARNING, "[multistream] Relay offload refused a local connection without the relay's token");
+            CloseSocket(candidate);
+        }
+    }
+    CloseSocket(listener);
+
+    if (client == INVALID_SOCKET_VALUE) {
+        if (!stopping.load()) {
+            blog(LOG_WARNING, "[multistream] %s did not connect within %d ms", executable.c_str(),
+                 RELAY_OFFLOAD_ACCEPT_TIMEOUT_MS);
+        }
+        return false;
+    }
+
+    SetSendTimeout(client, RELAY_OFFLOAD_SEND_SLICE_MS);
+    int noDelay = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+    relaySocket = (intptr_t)client;
+
+    connectionLost = false;
+    statusThread = std::thread(&RelayOffload::StatusThread, this);
+
+    // Everything the relay needs to publish, starting with the cached GOP
+    std::lock_guard<std::mutex> lock(queueMutex);
+    queue.clear();
+    queuedBytes = 0;
+    for (const auto& entry : destinations) {
+        const StreamDestination& destination = entry.second;
+        std::vector<uint8_t> message;
+        AppendRelayMessage(message, RELAY_MSG_ADD,
+                           destination.id + "\n" + destination.url + "\n" + destination.key + "\n" +
+                               destination.backupUrl);
+        Enqueue(message);
+    }
+    if (!preamble.empty()) {
+        std::vector<uint8_t> copy = preamble;
+        Enqueue(copy);
+    }
+    needKeyframe = true;
+    needGop = true;
+    connected = true;
+    return true;
+}
+
+int RelayOffload::Disconnect() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        connected = false;
+        queue.clear();
+        queuedBytes = 0;
+    }
+
+    // Wakes the status thread
+    socket_t sock = (socket_t)relaySocket;
+    if (sock != INVALID_SOCKET_VALUE) {
+        shutdown(sock, SHUTDOWN_BOTH);
+    }
+    if (statusThread.joinable()) {
+        statusThread.join();
+    }
+    if (sock != INVALID_SOCKET_VALUE) {
+        CloseSocket(sock);
+        relaySocket = (intptr_t)INVALID_SOCKET_VALUE;
+    }
+
+    // Ends the relay, and with it every connection it holds
+    return CloseProcessPipe(pipe);
+}
+
+void RelayOffload::SenderThread() {
+    os_set_thread_name("multistream-relay-offload");
+
+    BlockPipeSignals();
+
+    uint64_t backoffMs = RELAY_OFFLOAD_MIN_BACKOFF_MS;
+
+    while (!stopping.load()) {
+        if (Connect()) {
+            uint64_t connectedAt = os_gettime_ns();
+            std::vector<uint8_t> message;
+
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueWake.wait(lock, [this] { return !queue.empty() || stopping || connectionLost; });
+                    if (stopping || connectionLost) break;
+
+                    message = std::move(queue.front());
+                    queue.pop_front();
+                    queuedBytes -= message.size();
+                }
+
+                if (!SendAll((socket_t)relaySocket, message.data(), message.size(), stopping)) break;
+                bytesSent += message.size();
+            }
+
+            if (os_gettime_ns() - connectedAt > RELAY_OFFLOAD_STABLE_MS * 1000000ULL) {
+                backoffMs = RELAY_OFFLOAD_MIN_BACKOFF_MS;
+            }
+        }
+
+        int exitCode = Disconnect();
+        if (stopping.load()) break;
+
+        // OBS carries on; the destinations wait for the next relay
+        relayRestarts++;
+        SetAllStates(RELAY_DESTINATION_RETRYING);
+        blog(LOG_WARNING, "[multistream] Relay process lost (exit code %d), restarting it in %llu ms", exitCode,
+             (unsigned long long)backoffMs);
+
+        std::unique_lock<std::mutex> lock(queueMutex);
+        queueWake.wait_for(lock, std::chrono::milliseconds(backoffMs), [this] { return stopping.load(); });
+        backoffMs = std::min<uint64_t>(backoffMs * 2, RELAY_OFFLOAD_MAX_BACKOFF_MS);
+    }
+}
+
+void RelayOffload::StatusThread() {
+    os_set_thread_name("multistream-relay-status");
+
+    socket_t sock = (socket_t)relaySocket;
+    uint8_t header[RELAY_MESSAGE_HEADER_BYTES];
+    std::string payload;
+
+    while (RecvAll(sock, header, sizeof(header))) {
+        uint32_t size = ParseRelayPayloadSize(header);
+        if (size > RELAY_MAX_MESSAGE_BYTES) break;
+
+        payload.resize(size);
+        if (size && !RecvAll(sock, (uint8_t*)&payload[0], size)) break;
+        if (header[0] != RELAY_MSG_STATUS) continue;
+
+        std::istringstream lines(payload);
+        std::string id;
+        int state;
+        unsigned long long bytes;
+        int dropped;
+        int congestionPermille;
+        unsigned int retries;
+
+        std::lock_guard<std::mutex> lock(statusMutex);
+        while (lines >> id >> state >> bytes >> dropped >> congestionPermille >> retries) {
+            auto it = statuses.find(id);
+            if (it == statuses.end()) continue;
+
+            RelayDestinationStatus& status = it->second;
+            status.state = state == RELAY_STATE_LIVE ? RELAY_DESTINATION_LIVE
+                           : state == RELAY_STATE_RETRYING ? RELAY_DESTINATION_RETRYING
+                           : RELAY_DESTINATION_CONNECTING;
+            status.totalBytes = bytes;
+            status.droppedPackets = dropped;
+            status.congestion = std::min(1.0f, congestionPermille / 1000.0f);
+            status.retries = retries;
+        }
+    }
+
+    // The relay exited or broke the protocol; the sender restarts it
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        connectionLost = true;
+    }
+    queueWake.notify_one();
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <obs.h>
+#include "stream-destination.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class PacketTap;
+
+#define RELAY_OFFLOAD_DEFAULT_PATH "multistream-relay"
+
+enum RelayDestinationState {
+    RELAY_DESTINATION_CONNECTING,
+    RELAY_DESTINATION_LIVE,
+    RELAY_DESTINATION_RETRYING,
+};
+
+// A destination as last reported by the relay process
+struct RelayDestinationStatus {
+    RelayDestinationState state;
+    uint64_t totalBytes;
+    int droppedPackets;
+    float congestion;
+    uint32_t retries;
+
+    RelayDestinationStatus()
+        : state(RELAY_DESTINATION_CONNECTING), totalBytes(0), droppedPackets(0), congestion(0.0f), retries(0) {}
+};
+
+// Hands an encoder pair's stream to the multistream-relay companion process,
+// which publishes it to any number of destinations.
+//
+// With many destinations, every RTMP connection, TLS session and send
+// buffer otherwise lives in OBS. In offload mode a PacketTap feeds one
+// RelayOffload per encoder pair, which muxes each packet into FLV once and
+// writes it to the relay over a loopback connection; the relay runs the
+// per-destination connections, retries and buffering in its own process. The
+// work left in OBS does not grow with the number of destinations.
+//
+// The relay is started with the first destination and restarted with a
+// backoff whenever it exits or the connection breaks; its destinations
+// report retrying until it is back. A new relay is sent the tap's cached GOP
+// first, so it can publish without waiting for the next keyframe. A relay that cannot keep up has packets
+// dropped here, video up to the next keyframe, rather than ever blocking
+// OBS. Offloads are reference counted by the outputs that use them.
+// H.264 and AAC only.
+class RelayOffload {
+public:
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    // Relay executable, a path or a name on PATH
+    static void SetRelayPath(const std::string& path);
+    static std::string GetRelayPath();
+
+    // Get (and start, if new) the offload for an encoder pair
+    static RelayOffload* Acquire(obs_encoder_t* videoEncoder, obs_encoder_t* audioEncoder);
+    static void Release(RelayOffload* offload);
+
+    // Publish to, or stop publishing to, a destination
+    void AddDestination(const StreamDestination& destination);
+    void RemoveDestination(const std::string& id);
+
+    RelayDestinationStatus GetStatus(const std::string& id);
+
+private:
+    RelayOffload(obs_encoder_t* videoEncoder, obs_encoder_t* audioEncoder);
+    ~RelayOffload();
+
+    bool Start();
+    void Stop();
+    void LogSummary();
+
+    static void OnTapPacket(void* data, struct encoder_packet* packet, uint64_t receivedNs);
+    bool BuildPreamble();
+    void BuildTag(struct encoder_packet* packet, std::vector<uint8_t>& message);
+    void MuxPacket(struct encoder_packet* packet);
+
+    // Queue a message for the sender thread, with queueMutex held
+    void Enqueue(std::vector<uint8_t>& message);
+    // Queue the tap's cached GOP, with queueMutex held; false if none
+    bool EnqueueGop();
+
+    // Launch the relay and accept its connection, then resend the current
+    // destinations and preamble
+    bool Connect();
+    // Returns the relay's exit code
+    int Disconnect();
+    void SenderThread();
+    void StatusThread();
+    void SetAllStates(RelayDestinationState state);
+
+    static std::mutex offloadsMutex;
+    static std::vector<RelayOffload*> offloads;
+    static std::atomic<bool> enabled;
+    static std::mutex relayPathMutex;
+    static std::string relayPath;
+
+    obs_encoder_t* videoEncoder;
+    obs_encoder_t* audioEncoder;
+    int refCount;
+    PacketTap* tap;
+
+    // Relay process and its connection (a SOCKET on Windows); owned by the
+    // sender thread
+    struct os_process_pipe* pipe;
+    intptr_t relaySocket;
+    std::thread statusThread;
+    std::atomic<bool> connectionLost;
+
+    // Guarded by queueMutex: what the relay should be publishing, and the
+    // messages waiting for the sender thread
+    std::mutex queueMutex;
+    std::condition_variable queueWake;
+    std::map<std::string, StreamDestination> destinations;
+    std::vector<uint8_t> preamble;
+    std::deque<std::vector<uint8_t>> queue;
+    size_t queuedBytes;
+    size_t maxQueuedBytes;
+    bool connected;
+    bool needKeyframe;
+    bool needGop;
+    std::atomic<bool> stopping;
+    std::thread sender;
+
+    // Output thread only
+    bool haveFirstPacket;
+    int64_t firstDtsUsec;
+
+    std::mutex statusMutex;
+    std::map<std::string, RelayDestinationStatus> statuses;
+
+    // Session counters
+    std::atomic<uint64_t> bytesSent;
+    std::atomic<uint64_t> droppedPackets;
+    std::atomic<uint32_t> relayRestarts;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+// Wire format between the plugin's RelayOffload and the multistream-relay
+// companion process, over a loopback TCP connection. Plain C++ without
+// libobs.
+//
+// Every message is a one-byte type and a big-endian 32-bit payload length,
+// followed by the payload. The plugin sends the destination list, the FLV
+// preamble and one FLV tag per encoded packet; the relay fans the tags out
+// and reports the state of every destination about once a second.
+//
+// Any local process can connect to the loopback port, so the plugin writes a
+// random token line to the relay's stdin. The relay's first message is
+// RELAY_MSG_HELLO with that token, and the plugin sends nothing, stream keys
+// included, to a connection that does not present it.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Passed to the relay on its command line; it refuses any other version
+#define RELAY_PROTOCOL_VERSION 2
+
+#define RELAY_MESSAGE_HEADER_BYTES 5
+
+// Larger payloads mean a broken stream
+#define RELAY_MAX_MESSAGE_BYTES (16 * 1024 * 1024)
+
+// Hex characters in the token, and the longest line the relay accepts
+#define RELAY_TOKEN_CHARS 32
+#define RELAY_MAX_TOKEN_LINE 256
+
+enum RelayMessageType : uint8_t {
+    // Plugin to relay
+    RELAY_MSG_ADD = 1,      // "id\nurl\nkey\nbackupUrl"; replaces a destination with the same id
+    RELAY_MSG_REMOVE = 2,   // "id"
+    RELAY_MSG_PREAMBLE = 3, // FLV header and sequence header tags, sent first to every connection
+    RELAY_MSG_TAG = 4,      // flags byte, then one FLV tag with its trailing previous-tag-size
+
+    // Relay to plugin
+    RELAY_MSG_STATUS = 5,   // one "id state bytes dropped congestion-permille retries" line per destination
+    RELAY_MSG_HELLO = 6,    // the token from stdin; always the first message
+};
+
+// RELAY_MSG_TAG flags
+#define RELAY_TAG_KEYFRAME 0x01
+
+// Destination states in RELAY_MSG_STATUS
+#define RELAY_STATE_CONNECTING 0
+#define RELAY_STATE_LIVE 1
+#define RELAY_STATE_RETRYING 2
+
+inline void AppendRelayHeader(std::vector<uint8_t>& out, uint8_t type, uint32_t size) {
+    out.push_back(type);
+    out.push_back((uint8_t)(size >> 24));
+    out.push_back((uint8_t)(size >> 16));
+    out.push_back((uint8_t)(size >> 8));
+    out.push_back((uint8_t)size);
+}
+
+// Patch the length of a message built in place at offset
+inline void SetRelayPayloadSize(std::vector<uint8_t>& out, size_t offset) {
+    uint32_t size = (uint32_t)(out.size() - offset - RELAY_MESSAGE_HEADER_BYTES);
+    out[offset + 1] = (uint8_t)(size >> 24);
+    out[offset + 2] = (uint8_t)(size >> 16);
+    out[offset + 3] = (uint8_t)(size >> 8);
+    out[offset + 4] = (uint8_t)size;
+}
+
+inline void AppendRelayMessage(std::vector<uint8_t>& out, uint8_t type, const std::string& payload) {
+    AppendRelayHeader(out, type, (uint32_t)payload.size());
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+inline uint32_t ParseRelayPayloadSize(const uint8_t* header) {
+    return (uint32_t)header[1] << 24 | (uint32_t)header[2] << 16 | (uint32_t)header[3] << 8 | (uint32_t)header[4];
+}
@@ -1,15 +1,63 @@
 #pragma once
 
+#include "encoder-profile.h"
 #include <string>
 
 // Stream destination structure
 struct StreamDestination {
+    // Stable unique identifier, assigned by the plugin when empty
+    std::string id;
     std::string name;
     std::string url;
+    // Backup ingest for live failover, same stream key (empty = none)
+    std::string backupUrl;
     std::string key;
     bool enabled;
     bool useMainEncoder;
     int bitrate;
-    
-    StreamDestination() : enabled(false), useMainEncoder(true), bitrate(2500) {}
-}; 
\ No newline at end of file
+
+    // Local address to send from: empty for the default route,
+    // "auto" to let the InterfaceBalancer pick an uplink
+    std::string bindAddress;
+
+    // Video codec for custom encoding: "h264", "hevc" or "av1". HEVC and AV1
+    // go out over Enhanced RTMP and fall back to H.264 when unavailable.
+    std::string codec;
+
+    // Publish sound only (radio simulcasts, podcast ingests): no video
+    // encoder is attached, and bitrate is the audio bitrate for custom encoding
+    bool audioOnly;
+
+    // Named encoder profile for custom encoding, see EncoderProfiles
+    std::string encoderProfile;
+
+    // Encode from the shared 9:16 VerticalCanvas instead of the main canvas:
+    // with the canvas's pooled encoder on shared encoding, with an encoder
+    // of its own on custom encoding. Ignored for audio-only destinations.
+    bool vertical;
+
+    // Broadcast delay in seconds (0 = live), within DELAY_BUFFER_MIN_SEC and
+    // DELAY_BUFFER_MAX_SEC. Destinations with the same encoders and delay
+    // share one disk-backed DelayBuffer. Ignored for audio-only destinations.
+    int delaySec;
+
+    // Connect an rtmp:// destination to its cached DnsCache address instead
+    // of the hostname. The RTMP tcUrl then carries the IP, which ingests
+    // that route by host (CDN edges, multi-tenant servers) reject, so this
+    // is only for ingests known to accept it.
+    bool connectByAddress;
+
+    StreamDestination()
+        : enabled(false), useMainEncoder(true), bitrate(2500), codec("h264"), audioOnly(false),
+          encoderProfile(ENCODER_PROFILE_DEFAULT), vertical(false), delaySec(0), connectByAddress(false) {}
+
+    bool operator==(const StreamDestination& other) const {
+        return id == other.id && name == other.name && url == other.url && backupUrl == other.backupUrl &&
+               key == other.key && enabled == other.enabled &&
+               useMainEncoder == other.useMainEncoder && bitrate == other.bitrate &&
+               bindAddress == other.bindAddress && codec == other.codec && audioOnly == other.audioOnly &&
+               encoderProfile == other.encoderProfile && vertical == other.vertical && delaySec == other.delaySec &&
+               connectByAddress == other.connectByAddress;
+    }
+    bool operator!=(const StreamDestination& other) const { return !(*this == other); }
+};
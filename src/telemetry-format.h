@@ -0,0 +1,92 @@
+#pragma once
+
+// On-disk layout of a telemetry session file, shared by the recorder and
+// the offline telemetry-dump tool. Plain C++ without libobs.
+//
+// A file is a TelemetryHeader followed by header.capacity fixed-size
+// records used as a ring. Record i lives at index i % capacity and carries
+// sequence i + 1, written last, so a reader can tell complete records from
+// ones cut short by a crash and restore the order after the ring wrapped.
+
+#include <cstdint>
+
+#define TELEMETRY_MAGIC "MSTELEM1"
+#define TELEMETRY_VERSION 1
+
+// Destinations a session can name; later ones are not recorded
+#define TELEMETRY_MAX_SLOTS 64
+
+// Slot values that do not name a destination
+#define TELEMETRY_SESSION_SLOT 0xFFFE
+#define TELEMETRY_NO_SLOT 0xFFFF
+
+enum TelemetryRecordType : uint8_t {
+    TELEMETRY_RECORD_SAMPLE = 1,
+    TELEMETRY_RECORD_EVENT = 2,
+};
+
+enum TelemetryState : uint8_t {
+    TELEMETRY_STATE_STOPPED = 0,
+    TELEMETRY_STATE_CONNECTING = 1,
+    TELEMETRY_STATE_STREAMING = 2,
+    TELEMETRY_STATE_RECONNECTING = 3,
+};
+
+enum TelemetryEvent : uint8_t {
+    TELEMETRY_EVENT_NONE = 0,
+    TELEMETRY_EVENT_START = 1,         // output start requested
+    TELEMETRY_EVENT_PUBLISHING = 2,    // connected and sending
+    TELEMETRY_EVENT_STOPPED = 3,       // code is the output's stop code
+    TELEMETRY_EVENT_RECONNECTING = 4,
+    TELEMETRY_EVENT_RECONNECTED = 5,
+    TELEMETRY_EVENT_FAILOVER = 6,      // switched between primary and backup ingest
+    TELEMETRY_EVENT_SESSION_START = 7,
+    TELEMETRY_EVENT_SESSION_STOP = 8,
+    TELEMETRY_EVENT_STALL = 9,         // watchdog replacing a stalled connection
+};
+
+struct TelemetrySlot {
+    char id[24];
+    char name[40];
+};
+
+struct TelemetryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t slotCount;
+    uint64_t capacity;
+
+    // Record timestamps are os_gettime_ns(); this pair maps them to wall time
+    uint64_t startNs;
+    int64_t startUnixMs;
+
+    // Records appended so far, refreshed on every flush (informational;
+    // readers go by record sequence numbers)
+    uint64_t recordCount;
+
+    uint8_t reserved[200];
+
+    TelemetrySlot slots[TELEMETRY_MAX_SLOTS];
+};
+
+struct TelemetryRecord {
+    uint64_t timestampNs;
+    uint64_t totalBytes;
+    uint32_t droppedFrames;
+    uint32_t totalFrames;
+    float congestion;
+    uint32_t bitrateKbps;
+    int32_t code;
+    uint16_t slot;
+    uint8_t type;
+    uint8_t state;
+    uint8_t event;
+    uint8_t reserved[15];
+    // Record index + 1, written after everything else
+    uint64_t sequence;
+};
+
+static_assert(sizeof(TelemetryHeader) == 256 + TELEMETRY_MAX_SLOTS * 64, "telemetry header layout");
+static_assert(sizeof(TelemetryRecord) == 64, "telemetry record layout");
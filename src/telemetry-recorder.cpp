@@ -0,0 +1,311 @@
+#include "telemetry-recorder.h"
+#include <obs.h>
+#include <util/platform.h>
+#include <cstring>
+#include <ctime>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// How often mapped records are written back to disk
+#define TELEMETRY_FLUSH_INTERVAL_MS 1000
+
+// Smallest ring worth recording into
+#define TELEMETRY_MIN_RECORDS 1024
+
+// Static instance
+TelemetryRecorder* TelemetryRecorder::instance = nullptr;
+std::atomic<bool> TelemetryRecorder::enabled(false);
+
+TelemetryRecorder::TelemetryRecorder()
+    : header(nullptr), mappedSize(0),
+#ifdef _WIN32
+      fileHandle(nullptr), mappingHandle(nullptr),
+#else
+      fd(-1),
+#endif
+      records(nullptr), writers(0), nextIndex(0), capacity(0), slotCount(0), stopEvent(nullptr) {
+}
+
+TelemetryRecorder::~TelemetryRecorder() {
+    Close();
+}
+
+TelemetryRecorder* TelemetryRecorder::GetInstance() {
+    if (!instance) {
+        instance = new TelemetryRecorder();
+    }
+    return instance;
+}
+
+void TelemetryRecorder::SetEnabled(bool enable) {
+    enabled.store(enable);
+}
+
+bool TelemetryRecorder::IsEnabled() {
+    return enabled.load();
+}
+
+bool TelemetryRecorder::Open(const std::string& path, uint64_t maxBytes) {
+    Close();
+
+    uint64_t count = maxBytes > sizeof(TelemetryHeader) ? (maxBytes - sizeof(TelemetryHeader)) / sizeof(TelemetryRecord) : 0;
+    if (count < TELEMETRY_MIN_RECORDS) count = TELEMETRY_MIN_RECORDS;
+
+    uint64_t size = sizeof(TelemetryHeader) + count * sizeof(TelemetryRecord);
+    if (!MapFile(path, size)) {
+        blog(LOG_WARNING, "[multistream] Failed to create telemetry file %s", path.c_str());
+        return false;
+    }
+
+    // Touch every page now so appends never fault in new file blocks
+    memset(header, 0, (size_t)size);
+
+    memcpy(header->magic, TELEMETRY_MAGIC, sizeof(header->magic));
+    header->version = TELEMETRY_VERSION;
+    header->headerSize = sizeof(TelemetryHeader);
+    header->recordSize = sizeof(TelemetryRecord);
+    header->capacity = count;
+    header->startNs = os_gettime_ns();
+    header->startUnixMs = (int64_t)time(nullptr) * 1000;
+
+    capacity = count;
+    slotCount = 0;
+    nextIndex.store(0);
+    memset(lastBytes, 0, sizeof(lastBytes));
+    memset(lastSampleNs, 0, sizeof(lastSampleNs));
+
+    records.store(reinterpret_cast<TelemetryRecord*>(reinterpret_cast<uint8_t*>(header) + sizeof(TelemetryHeader)));
+
+    os_event_init(&stopEvent, OS_EVENT_TYPE_MANUAL);
+    flushThread = std::thread(&TelemetryRecorder::FlushThread, this);
+
+    Event(TELEMETRY_SESSION_SLOT, TELEMETRY_EVENT_SESSION_START);
+
+    blog(LOG_INFO, "[multistream] Recording telemetry to %s (%llu records)", path.c_str(), (unsigned long long)count);
+    return true;
+}
+
+void TelemetryRecorder::Close() {
+    if (!records.load()) return;
+
+    Event(TELEMETRY_SESSION_SLOT, TELEMETRY_EVENT_SESSION_STOP);
+
+    // No new appends; wait for the ones in progress
+    records.store(nullptr);
+    while (writers.load() > 0) {
+        std::this_thread::yield();
+    }
+
+    os_event_signal(stopEvent);
+    flushThread.join();
+    os_event_destroy(stopEvent);
+    stopEvent = nullptr;
+
+    Flush();
+    UnmapFile();
+
+    blog(LOG_INFO, "[multistream] Telemetry session closed, %llu record(s)", (unsigned long long)nextIndex.load());
+}
+
+bool TelemetryRecorder::IsOpen() const {
+    return records.load() != nullptr;
+}
+
+uint16_t TelemetryRecorder::RegisterDestination(const std::string& id, const std::string& name) {
+    if (!IsOpen()) return TELEMETRY_NO_SLOT;
+
+    for (uint16_t i = 0; i < slotCount; i++) {
+        if (strncmp(header->slots[i].id, id.c_str(), sizeof(header->slots[i].id) - 1) == 0) {
+            return i;
+        }
+    }
+
+    if (slotCount >= TELEMETRY_MAX_SLOTS) return TELEMETRY_NO_SLOT;
+
+    TelemetrySlot& slot = header->slots[slotCount];
+    strncpy(slot.id, id.c_str(), sizeof(slot.id) - 1);
+    strncpy(slot.name, name.c_str(), sizeof(slot.name) - 1);
+    header->slotCount = ++slotCount;
+
+    return slotCount - 1;
+}
+
+void TelemetryRecorder::Sample(uint16_t slot, uint8_t state, uint64_t totalBytes, uint32_t droppedFrames,
+                               uint32_t totalFrames, float congestion) {
+    if (slot >= TELEMETRY_MAX_SLOTS) return;
+
+    TelemetryRecord record = {};
+    record.timestampNs = os_gettime_ns();
+    record.type = TELEMETRY_RECORD_SAMPLE;
+    record.slot = slot;
+    record.state = state;
+    record.totalBytes = totalBytes;
+    record.droppedFrames = droppedFrames;
+    record.totalFrames = totalFrames;
+    record.congestion = congestion;
+
+    if (lastSampleNs[slot] && totalBytes >= lastBytes[slot] && record.timestampNs > lastSampleNs[slot]) {
+        uint64_t elapsedUs = (record.timestampNs - lastSampleNs[slot]) / 1000;
+        record.bitrateKbps = elapsedUs ? (uint32_t)((totalBytes - lastBytes[slot]) * 8000 / elapsedUs) : 0;
+    }
+    lastBytes[slot] = totalBytes;
+    lastSampleNs[slot] = record.timestampNs;
+
+    Append(record);
+}
+
+void TelemetryRecorder::Event(uint16_t slot, uint8_t event, int32_t code) {
+    if (slot == TELEMETRY_NO_SLOT) return;
+
+    TelemetryRecord record = {};
+    record.timestampNs = os_gettime_ns();
+    record.type = TELEMETRY_RECORD_EVENT;
+    record.slot = slot;
+    record.event = event;
+    record.code = code;
+
+    Append(record);
+}
+
+void TelemetryRecorder::Append(TelemetryRecord& record) {
+    writers.fetch_add(1);
+
+    TelemetryRecord* base = records.load();
+    if (base) {
+        uint64_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+        TelemetryRecord* target = &base[index % capacity];
+
+        // Invalidate the slot first, so a crash mid-copy leaves no record
+        // that looks complete
+        target->sequence = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+
+        record.sequence = 0;
+        memcpy(target, &record, sizeof(TelemetryRecord));
+
+        std::atomic_thread_fence(std::memory_order_release);
+        target->sequence = index + 1;
+    }
+
+    writers.fetch_sub(1);
+}
+
+void TelemetryRecorder::FlushThread() {
+    os_set_thread_name("multistream-telemetry");
+
+    while (os_event_timedwait(stopEvent, TELEMETRY_FLUSH_INTERVAL_MS) != 0) {
+        Flush();
+    }
+}
+
+// ============================================================================
+// Platform Mapping
+// ============================================================================
+
+#ifdef _WIN32
+
+bool TelemetryRecorder::MapFile(const std::string& path, uint64_t size) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    // Sizing the mapping extends the file to its full length
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)size);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    header = static_cast<TelemetryHeader*>(view);
+    mappedSize = size;
+    return true;
+}
+
+void TelemetryRecorder::UnmapFile() {
+    if (header) {
+        UnmapViewOfFile(header);
+        header = nullptr;
+    }
+    if (mappingHandle) {
+        CloseHandle((HANDLE)mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if (fileHandle) {
+        CloseHandle((HANDLE)fileHandle);
+        fileHandle = nullptr;
+    }
+    mappedSize = 0;
+}
+
+void TelemetryRecorder::Flush() {
+    if (!header) return;
+
+    header->recordCount = nextIndex.load();
+    FlushViewOfFile(header, (SIZE_T)mappedSize);
+    FlushFileBuffers((HANDLE)fileHandle);
+}
+
+#else
+
+bool TelemetryRecorder::MapFile(const std::string& path, uint64_t size) {
+    int file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) return false;
+
+    // Reserve the blocks up front where the filesystem supports it
+#ifdef __linux__
+    bool sized = posix_fallocate(file, 0, (off_t)size) == 0;
+#else
+    bool sized = false;
+#endif
+    if (!sized && ftruncate(file, (off_t)size) != 0) {
+        close(file);
+        return false;
+    }
+
+    void* view = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (view == MAP_FAILED) {
+        close(file);
+        return false;
+    }
+
+    fd = file;
+    header = static_cast<TelemetryHeader*>(view);
+    mappedSize = size;
+    return true;
+}
+
+void TelemetryRecorder::UnmapFile() {
+    if (header) {
+        munmap(header, (size_t)mappedSize);
+        header = nullptr;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    mappedSize = 0;
+}
+
+void TelemetryRecorder::Flush() {
+    if (!header) return;
+
+    header->recordCount = nextIndex.load();
+    msync(header, (size_t)mappedSize, MS_SYNC);
+}
+
+#endif
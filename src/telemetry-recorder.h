@@ -0,0 +1,89 @@
+#pragma once
+
+#include "telemetry-format.h"
+#include <util/threading.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// Default size of a session file; the ring wraps when it is full
+#define TELEMETRY_DEFAULT_MAX_MB 16
+
+// Session files kept next to the settings, including the current one
+#define TELEMETRY_DEFAULT_MAX_FILES 8
+
+// Per-session binary telemetry for post-mortem analysis.
+//
+// Each multistream session gets a preallocated, memory-mapped file (layout
+// in telemetry-format.h). Per-destination samples from the output monitor
+// and lifecycle events from output signal handlers are appended as fixed-size
+// records with a lock-free index bump and a memcpy into the mapping, so
+// recording never blocks an output thread. The mapping belongs to the OS, so
+// everything appended survives an OBS crash; a flush thread writes it to disk
+// every second, which bounds the loss on a power or OS failure.
+// tools/telemetry-dump.cpp converts a session file to CSV or JSON.
+class TelemetryRecorder {
+public:
+    static TelemetryRecorder* GetInstance();
+
+    static void SetEnabled(bool enable);
+    static bool IsEnabled();
+
+    // Create and map a session file, from session start (UI thread)
+    bool Open(const std::string& path, uint64_t maxBytes);
+    // Flush and unmap, from session end (UI thread)
+    void Close();
+    bool IsOpen() const;
+
+    // Slot naming a destination in this session's records, or
+    // TELEMETRY_NO_SLOT once all slots are taken (UI thread)
+    uint16_t RegisterDestination(const std::string& id, const std::string& name);
+
+    // Periodic per-destination sample, from the output monitor (UI thread)
+    void Sample(uint16_t slot, uint8_t state, uint64_t totalBytes, uint32_t droppedFrames, uint32_t totalFrames,
+                float congestion);
+
+    // Lifecycle event; safe from any thread and never blocks
+    void Event(uint16_t slot, uint8_t event, int32_t code = 0);
+
+private:
+    TelemetryRecorder();
+    ~TelemetryRecorder();
+
+    static TelemetryRecorder* instance;
+    static std::atomic<bool> enabled;
+
+    void Append(TelemetryRecord& record);
+    void Flush();
+    void FlushThread();
+
+    // Platform mapping
+    bool MapFile(const std::string& path, uint64_t size);
+    void UnmapFile();
+
+    TelemetryHeader* header;
+    uint64_t mappedSize;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fd;
+#endif
+
+    // Records base, nullptr while closed; writers in Append() are counted
+    // so Close() can wait for them before unmapping
+    std::atomic<TelemetryRecord*> records;
+    std::atomic<int> writers;
+    std::atomic<uint64_t> nextIndex;
+    uint64_t capacity;
+
+    uint16_t slotCount;
+
+    // Previous sample per slot, for the bitrate
+    uint64_t lastBytes[TELEMETRY_MAX_SLOTS];
+    uint64_t lastSampleNs[TELEMETRY_MAX_SLOTS];
+
+    std::thread flushThread;
+    os_event_t* stopEvent;
+};
@@ -0,0 +1,238 @@
+#include "vertical-canvas.h"
+#include "multistream-output.h"
+#include <algorithm>
+
+// Static members
+std::mutex VerticalCanvas::canvasMutex;
+VerticalCanvas* VerticalCanvas::instance = nullptr;
+VerticalCanvasConfig VerticalCanvas::config;
+
+// ============================================================================
+// Canvas Registry
+// ============================================================================
+
+void VerticalCanvas::SetConfig(const VerticalCanvasConfig& newConfig) {
+    std::lock_guard<std::mutex> lock(canvasMutex);
+    config = newConfig;
+    if (!instance) return;
+
+    // A live canvas switches its scene and crop in place; its size and
+    // encoder are bound to the running encodes until it is re-created
+    VerticalCanvasConfig& active = instance->activeConfig;
+    if (active.scene != config.scene || active.cropLeft != config.cropLeft || active.cropTop != config.cropTop ||
+        active.cropRight != config.cropRight || active.cropBottom != config.cropBottom) {
+        VerticalCanvasConfig previous = active;
+        active.scene = config.scene;
+        active.cropLeft = config.cropLeft;
+        active.cropTop = config.cropTop;
+        active.cropRight = config.cropRight;
+        active.cropBottom = config.cropBottom;
+        if (!instance->CreateScene()) {
+            active = previous;
+        }
+    }
+}
+
+VerticalCanvasConfig VerticalCanvas::GetConfig() {
+    std::lock_guard<std::mutex> lock(canvasMutex);
+    return config;
+}
+
+VerticalCanvas* VerticalCanvas::Acquire() {
+    std::lock_guard<std::mutex> lock(canvasMutex);
+
+    if (instance) {
+        instance->refCount++;
+        return instance;
+    }
+
+    VerticalCanvas* canvas = new VerticalCanvas();
+    canvas->activeConfig = config;
+    if (!canvas->Create()) {
+        delete canvas;
+        return nullptr;
+    }
+
+    instance = canvas;
+    return instance;
+}
+
+void VerticalCanvas::Release(VerticalCanvas* canvas) {
+    if (!canvas) return;
+
+    std::lock_guard<std::mutex> lock(canvasMutex);
+
+    if (canvas->refCount > 1) {
+        canvas->refCount--;
+        return;
+    }
+
+    canvas->LogSummary();
+    if (instance == canvas) instance = nullptr;
+    delete canvas;
+}
+
+// ============================================================================
+// VerticalCanvas Implementation
+// ============================================================================
+
+VerticalCanvas::VerticalCanvas()
+    : refCount(1), source(nullptr), scene(nullptr), view(nullptr), video(nullptr), pooledEncoder(nullptr),
+      baselineFrameNs(0), frameBase(0), skippedBase(0) {
+}
+
+VerticalCanvas::~VerticalCanvas() {
+    Destroy();
+}
+
+bool VerticalCanvas::Create() {
+    const VerticalCanvasConfig& cfg = activeConfig;
+
+    struct obs_video_info ovi;
+    if (!obs_get_video_info(&ovi)) {
+        blog(LOG_ERROR, "[multistream] Vertical canvas needs video to be running");
+        return false;
+    }
+
+    // The render cost of the canvas is the change in this
+    baselineFrameNs = obs_get_average_frame_time_ns();
+
+    view = obs_view_create();
+    if (!CreateScene()) return false;
+
+    ovi.base_width = ovi.output_width = (uint32_t)cfg.width;
+    ovi.base_height = ovi.output_height = (uint32_t)cfg.height;
+    video = obs_view_add2(view, &ovi);
+    if (!video) {
+        blog(LOG_ERROR, "[multistream] Failed to start the vertical canvas at %dx%d", cfg.width, cfg.height);
+        return false;
+    }
+
+    frameBase = video_output_get_total_frames(video);
+    skippedBase = video_output_get_skipped_frames(video);
+    return true;
+}
+
+bool VerticalCanvas::CreateScene() {
+    const VerticalCanvasConfig& cfg = activeConfig;
+
+    obs_source_t* newSource =
+        cfg.scene.empty() ? obs_get_output_source(0) : obs_get_source_by_name(cfg.scene.c_str());
+    if (!newSource) {
+        blog(LOG_ERROR, "[multistream] Vertical canvas has no source (scene '%s')", cfg.scene.c_str());
+        return false;
+    }
+
+    // The program source reports the main canvas size
+    int sourceWidth = (int)obs_source_get_width(newSource);
+    int sourceHeight = (int)obs_source_get_height(newSource);
+    struct obs_video_info ovi;
+    if ((sourceWidth <= 0 || sourceHeight <= 0) && obs_get_video_info(&ovi)) {
+        sourceWidth = (int)ovi.base_width;
+        sourceHeight = (int)ovi.base_height;
+    }
+
+    struct obs_sceneitem_crop crop = {cfg.cropLeft, cfg.cropTop, cfg.cropRight, cfg.cropBottom};
+    if (!crop.left && !crop.top && !crop.right && !crop.bottom) {
+        // Centre strip with the canvas aspect ratio
+        int stripWidth = sourceHeight * cfg.width / cfg.height;
+        if (stripWidth < sourceWidth) {
+            crop.left = (sourceWidth - stripWidth) / 2;
+            crop.right = sourceWidth - stripWidth - crop.left;
+        } else {
+            int stripHeight = sourceWidth * cfg.height / cfg.width;
+            crop.top = (sourceHeight - stripHeight) / 2;
+            crop.bottom = sourceHeight - stripHeight - crop.top;
+        }
+    }
+
+    obs_scene_t* newScene = obs_scene_create_private("multistream_vertical");
+    obs_sceneitem_t* item = obs_scene_add(newScene, newSource);
+    if (!item) {
+        blog(LOG_ERROR, "[multistream] Failed to add the source to the vertical canvas");
+        obs_scene_release(newScene);
+        obs_source_release(newSource);
+        return false;
+    }
+
+    struct vec2 bounds = {(float)cfg.width, (float)cfg.height};
+    obs_sceneitem_set_crop(item, &crop);
+    obs_sceneitem_set_bounds_type(item, OBS_BOUNDS_SCALE_INNER);
+    obs_sceneitem_set_bounds(item, &bounds);
+
+    // Swapped on the view so a live canvas never renders an empty frame
+    obs_view_set_source(view, 0, obs_scene_get_source(newScene));
+    if (scene) obs_scene_release(scene);
+    if (source) obs_source_release(source);
+    scene = newScene;
+    source = newSource;
+
+    blog(LOG_INFO, "[multistream] Vertical canvas %dx%d from %s, crop %d/%d/%d/%d", cfg.width, cfg.height,
+         cfg.scene.empty() ? "the program" : cfg.scene.c_str(), crop.left, crop.top, crop.right, crop.bottom);
+    return true;
+}
+
+void VerticalCanvas::Destroy() {
+    // Nothing encodes from the canvas once the last output is gone
+    if (pooledEncoder) {
+        obs_encoder_release(pooledEncoder);
+        pooledEncoder = nullptr;
+    }
+
+    if (view) {
+        if (video) {
+            obs_view_remove(view);
+            video = nullptr;
+        }
+        obs_view_set_source(view, 0, nullptr);
+        obs_view_destroy(view);
+        view = nullptr;
+    }
+
+    if (scene) {
+        obs_scene_release(scene);
+        scene = nullptr;
+    }
+
+    if (source) {
+        obs_source_release(source);
+        source = nullptr;
+    }
+}
+
+void VerticalCanvas::LogSummary() {
+    if (!video) return;
+
+    uint32_t frames = video_output_get_total_frames(video) - frameBase;
+    uint32_t skipped = video_output_get_skipped_frames(video) - skippedBase;
+    frameBase += frames;
+    skippedBase += skipped;
+
+    uint64_t frameNs = obs_get_average_frame_time_ns();
+    double addedMs = frameNs > baselineFrameNs ? (double)(frameNs - baselineFrameNs) / 1000000.0 : 0.0;
+
+    blog(LOG_INFO,
+         "[multistream] Vertical canvas: %u frames rendered, %u skipped, adds %.2f ms render time per frame "
+         "(%.2f -> %.2f ms), used by %d output(s)%s",
+         frames, skipped, addedMs, (double)baselineFrameNs / 1000000.0, (double)frameNs / 1000000.0, refCount,
+         pooledEncoder ? " with a pooled encoder" : "");
+}
+
+video_t* VerticalCanvas::GetVideo() const {
+    return video;
+}
+
+obs_encoder_t* VerticalCanvas::GetPooledEncoder() {
+    std::lock_guard<std::mutex> lock(canvasMutex);
+
+    if (!pooledEncoder) {
+        EncoderProfile profile = EncoderProfiles::Find(ENCODER_PROFILE_DEFAULT);
+        pooledEncoder =
+            SharedEncoderManager::GetInstance()->CreateCustomVideoEncoder(activeConfig.pooledBitrate, "h264", profile);
+        if (pooledEncoder) {
+            obs_encoder_set_video(pooledEncoder, video);
+        }
+    }
+
+    return pooledEncoder;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <obs.h>
+#include <mutex>
+#include <string>
+
+// Portrait canvas for TikTok, Shorts and Reels ingests
+#define VERTICAL_CANVAS_DEFAULT_WIDTH 1080
+#define VERTICAL_CANVAS_DEFAULT_HEIGHT 1920
+
+// Bitrate of the encoder shared by vertical destinations on shared encoding
+#define VERTICAL_CANVAS_DEFAULT_BITRATE 6000
+
+// What the vertical canvas shows and how it is encoded
+struct VerticalCanvasConfig {
+    // Scene to render; empty follows the program output
+    std::string scene;
+    int width;
+    int height;
+
+    // Pixels cropped from each edge of the scene before scaling. All zero
+    // crops the centre of the scene to the canvas aspect ratio.
+    int cropLeft;
+    int cropTop;
+    int cropRight;
+    int cropBottom;
+
+    int pooledBitrate;
+
+    VerticalCanvasConfig()
+        : width(VERTICAL_CANVAS_DEFAULT_WIDTH), height(VERTICAL_CANVAS_DEFAULT_HEIGHT), cropLeft(0), cropTop(0),
+          cropRight(0), cropBottom(0), pooledBitrate(VERTICAL_CANVAS_DEFAULT_BITRATE) {}
+};
+
+// Secondary 9:16 canvas that vertical destinations encode from.
+//
+// A libobs view renders the program, or a configured scene, through a private
+// scene whose only item crops it and scales it to the canvas size. libobs
+// renders the view once per frame on its graphics thread next to the main
+// canvas, reusing every source the main canvas already decodes, so a
+// vertical stream costs one extra scene render and its encodes instead of a
+// second OBS process. Destinations on shared encoding share one pooled
+// encoder owned by the canvas; destinations with custom encoding feed their
+// own encoder from it. The canvas is reference counted and exists while any
+// running output holds it.
+class VerticalCanvas {
+public:
+    // Configuration for canvases created from now on. A live canvas picks
+    // up a new scene or crop at once; size and bitrate wait for the next one.
+    static void SetConfig(const VerticalCanvasConfig& config);
+    static VerticalCanvasConfig GetConfig();
+
+    // Get (and create, if needed) the canvas
+    static VerticalCanvas* Acquire();
+    static void Release(VerticalCanvas* canvas);
+
+    video_t* GetVideo() const;
+
+    // The pooled encoder, created on first use
+    obs_encoder_t* GetPooledEncoder();
+
+private:
+    VerticalCanvas();
+    ~VerticalCanvas();
+
+    bool Create();
+    bool CreateScene();
+    void Destroy();
+    void LogSummary();
+
+    static std::mutex canvasMutex;
+    static VerticalCanvas* instance;
+    static VerticalCanvasConfig config;
+
+    int refCount;
+    VerticalCanvasConfig activeConfig;
+    obs_source_t* source;
+    obs_scene_t* scene;
+    obs_view_t* view;
+    video_t* video;
+    obs_encoder_t* pooledEncoder;
+
+    // Main render time per frame before the canvas existed, and frame
+    // counters at the start of the current summary period
+    uint64_t baselineFrameNs;
+    uint32_t frameBase;
+    uint32_t skippedBase;
+};
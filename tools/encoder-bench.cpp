@@ -0,0 +1,251 @@
+// Offline benchmark for the plugin's encoder profiles.
+//
+//   multistream-encoder-bench [--ffmpeg path] [--bitrates 2500,6000]
+//                             [--profiles balanced,quality] [--csv] <reference clip>
+//
+// Encodes the reference clip with ffmpeg's libx264 at every profile and
+// bitrate, using the same parameters the plugin hands obs_x264 (both wrap
+// the same x264 library), then scores each encode against the reference.
+// Reports the bitrate actually produced, PSNR and SSIM, and encode speed in
+// frames per second. Speed includes decoding the reference, so use an
+// uncompressed or lightly compressed clip for comparable fps numbers.
+
+#include "encoder-profile.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct BenchResult {
+    std::string profile;
+    int targetKbps;
+    double actualKbps;
+    double psnr;
+    double ssim;
+    double fps;
+};
+
+static std::vector<std::string> Split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(separator, start);
+        if (end == std::string::npos) end = text.size();
+        if (end > start) parts.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    return parts;
+}
+
+static std::string ReadFile(const std::string& path) {
+    std::string contents;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return contents;
+
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, read);
+    }
+    fclose(file);
+    return contents;
+}
+
+static long long FileSize(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return -1;
+    fseek(file, 0, SEEK_END);
+    long long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+// Number following the last occurrence of key, or -1
+static double LastValue(const std::string& text, const char* key) {
+    size_t pos = text.rfind(key);
+    if (pos == std::string::npos) return -1.0;
+    return atof(text.c_str() + pos + strlen(key));
+}
+
+static std::string Quote(const std::string& text) {
+    return "\"" + text + "\"";
+}
+
+// Frame rate of the clip's first video stream, from ffmpeg's input summary
+static double ProbeFps(const std::string& ffmpeg, const std::string& clip) {
+    std::string log = "encoder-bench-probe.log";
+    std::string command = Quote(ffmpeg) + " -hide_banner -nostdin -i " + Quote(clip) + " 2> " + Quote(log);
+    if (std::system(command.c_str()) < 0) return 0.0;
+
+    std::string info = ReadFile(log);
+    remove(log.c_str());
+
+    // "..., 1920x1080, 59.94 fps, 59.94 tbr, ..."
+    size_t pos = info.find(" fps,");
+    if (pos == std::string::npos) return 0.0;
+    size_t start = info.rfind(' ', pos - 1);
+    return start == std::string::npos ? 0.0 : atof(info.c_str() + start + 1);
+}
+
+// ffmpeg/libx264 options equivalent to the obs_x264 settings the plugin
+// derives from a profile
+static std::string EncoderOptions(const EncoderProfile& profile, int kbps, double fps) {
+    std::string rate = std::to_string(kbps) + "k";
+    std::string options = "-c:v libx264 -preset " + profile.preset + " -profile:v " + profile.profile;
+    if (!profile.tune.empty()) options += " -tune " + profile.tune;
+
+    std::string params;
+    if (profile.rateControl == "CBR") {
+        options += " -b:v " + rate + " -maxrate " + rate + " -bufsize " + rate;
+        params = "nal-hrd=cbr";
+    } else if (profile.rateControl == "VBR") {
+        options += " -crf 23 -maxrate " + rate + " -bufsize " + rate;
+    } else if (profile.rateControl == "CRF") {
+        options += " -crf 23";
+    } else {
+        options += " -b:v " + rate;
+    }
+
+    int keyint = (int)(profile.keyintSec * fps + 0.5);
+    if (keyint > 0) {
+        params += std::string(params.empty() ? "" : ":") + "keyint=" + std::to_string(keyint);
+    }
+
+    for (const auto& option : Split(profile.GetX264Options(), ' ')) {
+        params += std::string(params.empty() ? "" : ":") + option;
+    }
+
+    if (!params.empty()) options += " -x264-params " + params;
+    return options;
+}
+
+static bool RunBench(const std::string& ffmpeg, const std::string& clip, double fps, const EncoderProfile& profile,
+                     int kbps, BenchResult& result) {
+    std::string base = "encoder-bench-" + profile.name + "-" + std::to_string(kbps);
+    std::string encoded = base + ".flv";
+    std::string progress = base + ".progress";
+    std::string log = base + ".log";
+
+    std::string encode = Quote(ffmpeg) + " -hide_banner -nostdin -y -i " + Quote(clip) + " -an " +
+                         EncoderOptions(profile, kbps, fps) + " -progress " + Quote(progress) + " -f flv " +
+                         Quote(encoded) + " 2> " + Quote(log);
+
+    auto start = std::chrono::steady_clock::now();
+    int status = std::system(encode.c_str());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string progressText = ReadFile(progress);
+    double frames = LastValue(progressText, "frame=");
+    double outTimeUs = LastValue(progressText, "out_time_us=");
+    long long size = FileSize(encoded);
+
+    if (status != 0 || frames <= 0 || outTimeUs <= 0 || size <= 0) {
+        fprintf(stderr, "encode failed for %s at %d kbps, see %s\n", profile.name.c_str(), kbps, log.c_str());
+        return false;
+    }
+
+    std::string score = Quote(ffmpeg) + " -hide_banner -nostdin -i " + Quote(encoded) + " -i " + Quote(clip) +
+                        " -lavfi \"[0:v]split[a][b];[1:v]split[c][d];[a][c]psnr;[b][d]ssim\" -f null - 2> " +
+                        Quote(log);
+    if (std::system(score.c_str()) != 0) {
+        fprintf(stderr, "scoring failed for %s at %d kbps\n", profile.name.c_str(), kbps);
+    }
+    std::string scoreText = ReadFile(log);
+
+    result.profile = profile.name;
+    result.targetKbps = kbps;
+    result.actualKbps = (double)size * 8.0 / (outTimeUs / 1000.0);
+    result.psnr = LastValue(scoreText, "average:");
+    result.ssim = LastValue(scoreText, "All:");
+    result.fps = seconds > 0.0 ? frames / seconds : 0.0;
+
+    remove(encoded.c_str());
+    remove(progress.c_str());
+    remove(log.c_str());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string ffmpeg = "ffmpeg";
+    std::vector<int> bitrates = {2500, 4500, 6000};
+    std::vector<std::string> profileNames;
+    std::string clip;
+    bool csv = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ffmpeg") == 0 && i + 1 < argc) {
+            ffmpeg = argv[++i];
+        } else if (strcmp(argv[i], "--bitrates") == 0 && i + 1 < argc) {
+            bitrates.clear();
+            for (const auto& value : Split(argv[++i], ',')) {
+                if (atoi(value.c_str()) > 0) bitrates.push_back(atoi(value.c_str()));
+            }
+        } else if (strcmp(argv[i], "--profiles") == 0 && i + 1 < argc) {
+            profileNames = Split(argv[++i], ',');
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (clip.empty()) {
+            clip = argv[i];
+        } else {
+            clip.clear();
+            break;
+        }
+    }
+
+    if (clip.empty() || bitrates.empty()) {
+        fprintf(stderr,
+                "usage: %s [--ffmpeg path] [--bitrates 2500,6000] [--profiles balanced,quality] [--csv] <clip>\n",
+                argv[0]);
+        return 2;
+    }
+
+    std::vector<EncoderProfile> profiles;
+    if (profileNames.empty()) {
+        profiles = EncoderProfiles::GetBuiltins();
+    } else {
+        for (const auto& name : profileNames) {
+            EncoderProfile profile = EncoderProfiles::Find(name);
+            if (profile.name != name) {
+                fprintf(stderr, "unknown profile %s\n", name.c_str());
+                return 2;
+            }
+            profiles.push_back(profile);
+        }
+    }
+
+    double fps = ProbeFps(ffmpeg, clip);
+    if (fps <= 0.0) {
+        fprintf(stderr, "cannot read the frame rate of %s with %s\n", clip.c_str(), ffmpeg.c_str());
+        return 1;
+    }
+
+    if (csv) {
+        printf("profile,target_kbps,actual_kbps,psnr_db,ssim,encode_fps\n");
+    } else {
+        printf("%-12s %8s %8s %8s %8s %8s\n", "profile", "target", "actual", "PSNR", "SSIM", "fps");
+    }
+
+    int failures = 0;
+    for (const auto& profile : profiles) {
+        for (int kbps : bitrates) {
+            BenchResult result;
+            if (!RunBench(ffmpeg, clip, fps, profile, kbps, result)) {
+                failures++;
+                continue;
+            }
+
+            if (csv) {
+                printf("%s,%d,%.0f,%.3f,%.5f,%.1f\n", result.profile.c_str(), result.targetKbps, result.actualKbps,
+                       result.psnr, result.ssim, result.fps);
+            } else {
+                printf("%-12s %8d %8.0f %8.2f %8.4f %8.1f\n", result.profile.c_str(), result.targetKbps,
+                       result.actualKbps, result.psnr, result.ssim, result.fps);
+            }
+            fflush(stdout);
+        }
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+// Headless libobs for the tools that drive the plugin core directly
+// (multistream-soak, multistream-lookup-bench). Each includes this once.
+//
+// On Linux the OpenGL renderer needs a display (xvfb-run works).
+
+#include <obs.h>
+#include <util/platform.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#ifdef HEADLESS_X11
+#include <obs-nix-platform.h>
+#include <X11/Xlib.h>
+#endif
+
+// ============================================================================
+// UI thread
+// ============================================================================
+
+// libobs queues OBS_TASK_UI work here; the main thread plays the UI thread
+// and runs it while pumping
+struct UiTask {
+    obs_task_t task;
+    void* param;
+    bool* done;
+};
+
+static std::mutex uiMutex;
+static std::condition_variable uiChanged;
+static std::deque<UiTask> uiTasks;
+static std::thread::id uiThreadId;
+
+static void QueueUiTask(obs_task_t task, void* param, bool wait) {
+    if (wait && std::this_thread::get_id() == uiThreadId) {
+        task(param);
+        return;
+    }
+
+    bool done = false;
+    std::unique_lock<std::mutex> lock(uiMutex);
+    uiTasks.push_back({task, param, wait ? &done : nullptr});
+    uiChanged.notify_all();
+
+    if (wait) {
+        uiChanged.wait(lock, [&done] { return done; });
+    }
+}
+
+static void PumpUi(uint64_t ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+
+    std::unique_lock<std::mutex> lock(uiMutex);
+    for (;;) {
+        uiChanged.wait_until(lock, deadline, [] { return !uiTasks.empty(); });
+        if (uiTasks.empty()) break;
+
+        UiTask task = uiTasks.front();
+        uiTasks.pop_front();
+
+        lock.unlock();
+        task.task(task.param);
+        lock.lock();
+
+        if (task.done) {
+            *task.done = true;
+            uiChanged.notify_all();
+        }
+    }
+}
+
+// ============================================================================
+// Startup
+// ============================================================================
+
+// Start libobs with a small canvas and the stock modules, and make the calling
+// thread the UI thread
+static bool InitObs() {
+    uiThreadId = std::this_thread::get_id();
+
+#ifdef HEADLESS_X11
+    obs_set_nix_platform(OBS_NIX_PLATFORM_X11_EGL);
+    obs_set_nix_platform_display(XOpenDisplay(nullptr));
+#endif
+
+    if (!obs_startup("en-US", nullptr, nullptr)) {
+        fprintf(stderr, "libobs failed to start\n");
+        return false;
+    }
+
+    struct obs_video_info ovi = {};
+#ifdef _WIN32
+    ovi.graphics_module = "libobs-d3d11";
+#else
+    ovi.graphics_module = "libobs-opengl";
+#endif
+    ovi.fps_num = 30;
+    ovi.fps_den = 1;
+    ovi.base_width = ovi.output_width = 640;
+    ovi.base_height = ovi.output_height = 360;
+    ovi.output_format = VIDEO_FORMAT_NV12;
+    ovi.colorspace = VIDEO_CS_709;
+    ovi.range = VIDEO_RANGE_PARTIAL;
+    ovi.gpu_conversion = true;
+    ovi.scale_type = OBS_SCALE_BICUBIC;
+    if (obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS) {
+        fprintf(stderr, "libobs video failed to start\n");
+        return false;
+    }
+
+    struct obs_audio_info oai = {48000, SPEAKERS_STEREO};
+    if (!obs_reset_audio(&oai)) {
+        fprintf(stderr, "libobs audio failed to start\n");
+        return false;
+    }
+
+    // rtmp_output, obs_x264 and ffmpeg_aac; the installed copy of this
+    // plugin stays out so only the core under test is running
+    obs_add_disabled_module("obs-multistream");
+    obs_load_all_modules();
+    obs_post_load_modules();
+
+    obs_set_ui_task_handler(QueueUiTask);
+    return true;
+}
@@ -0,0 +1,203 @@
+// Destination and output lookup timings at scale, with the plugin's id
+// indexes and with the linear scans they replaced.
+//
+//   multistream-lookup-bench [--destinations 1000] [--lookups 100000]
+//                            [--sink rtmp://127.0.0.1:1/live]
+//                            [--config-dir multistream-lookup-bench]
+//
+// Adds the destinations one at a time through AddDestination(), as the dock
+// does, then starts them all so that every destination has an output. The
+// outputs only need to exist: by default they point at a closed port, fail
+// to connect and stay registered until the session stops. Each lookup pass
+// asks for every id in a shuffled order, once through FindDestination() or
+// FindOutput() and once by scanning the destinations or outputs for a
+// matching id. The timings are printed as CSV.
+//
+// On Linux, run it with a display for the OpenGL renderer (xvfb-run works).
+
+#include "obs-multistream.h"
+#include "multistream-output.h"
+#include "packet-tap.h"
+#include "audio-relay-output.h"
+#include "delay-relay-output.h"
+#include "multistream-log.h"
+#include "headless-obs.h"
+#include <obs.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// The core resolves its config path through the current module
+OBS_DECLARE_MODULE()
+
+// Time for the outputs to start (and fail) before the lookups
+#define START_SETTLE_MS 3000
+
+static void Report(const char* operation, size_t entries, size_t calls, uint64_t ns) {
+    printf("%s,%zu,%zu,%.3f,%.1f\n", operation, entries, calls, (double)ns / 1000000.0,
+           calls ? (double)ns / (double)calls : 0.0);
+    fflush(stdout);
+}
+
+static bool WriteConfig(const std::string& directory) {
+    obs_data_t* data = obs_data_create();
+    obs_data_array_t* destArray = obs_data_array_create();
+    obs_data_set_array(data, "destinations", destArray);
+    obs_data_array_release(destArray);
+
+    // Outputs on the plugin-owned encoders; short stop windows for the
+    // outputs that never connected
+    obs_data_set_bool(data, "multistreamOnly", true);
+    obs_data_set_int(data, "stopFlushWindowMs", 500);
+    obs_data_set_int(data, "stopDeadlineMs", 1000);
+
+    std::string path = directory + "/obs-multistream.json";
+    bool saved = obs_data_save_json_safe(data, path.c_str(), "tmp", "bak");
+    obs_data_release(data);
+    return saved;
+}
+
+int main(int argc, char** argv) {
+    std::string sink = "rtmp://127.0.0.1:1/live";
+    std::string configDir = "multistream-lookup-bench";
+    int destinationCount = 1000;
+    int lookups = 100000;
+    bool ok = true;
+
+    for (int i = 1; i < argc && ok; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--destinations") == 0 && hasValue) {
+            destinationCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--lookups") == 0 && hasValue) {
+            lookups = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sink") == 0 && hasValue) {
+            sink = argv[++i];
+        } else if (strcmp(argv[i], "--config-dir") == 0 && hasValue) {
+            configDir = argv[++i];
+        } else {
+            ok = false;
+        }
+    }
+
+    if (!ok || destinationCount < 1 || lookups < 1) {
+        fprintf(stderr,
+                "usage: %s [--destinations n] [--lookups n] [--sink rtmp://host/app] [--config-dir dir]\n",
+                argv[0]);
+        return 2;
+    }
+
+    if (!InitObs()) return 1;
+
+    os_mkdirs(configDir.c_str());
+    if (!WriteConfig(configDir)) {
+        fprintf(stderr, "cannot write settings to %s\n", configDir.c_str());
+        return 1;
+    }
+
+    // What obs_module_load does, minus the dock and the output monitor
+    MultistreamLog::Start();
+    PacketTap::RegisterOutputType();
+    AudioRelayOutput::RegisterOutputType();
+    DelayRelayOutput::RegisterOutputType();
+
+    MultistreamPlugin::SetConfigDirectory(configDir);
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+    plugin->Initialize();
+
+    printf("operation,entries,calls,total_ms,ns_per_call\n");
+
+    // Every add saves the settings, so this is the cost of building the list
+    // from the dock, not of the index alone
+    uint64_t start = os_gettime_ns();
+    uint64_t lastStart = start;
+    int lastCalls = std::min(destinationCount, 100);
+    for (int i = 0; i < destinationCount; i++) {
+        if (i == destinationCount - lastCalls) lastStart = os_gettime_ns();
+
+        StreamDestination dest;
+        dest.name = "bench-" + std::to_string(i);
+        dest.url = sink;
+        dest.key = dest.name;
+        dest.enabled = true;
+        plugin->AddDestination(dest);
+    }
+    uint64_t end = os_gettime_ns();
+    Report("add_destination", (size_t)destinationCount, (size_t)destinationCount, end - start);
+    Report("add_destination_last", (size_t)destinationCount, (size_t)lastCalls, end - lastStart);
+
+    std::vector<std::string> ids;
+    for (const auto& dest : plugin->GetDestinations()) {
+        ids.push_back(dest.id);
+    }
+    std::mt19937 random(1);
+    std::shuffle(ids.begin(), ids.end(), random);
+
+    // Keeps the compiler from dropping the lookups
+    size_t found = 0;
+
+    start = os_gettime_ns();
+    for (int i = 0; i < lookups; i++) {
+        found += plugin->FindDestination(ids[(size_t)i % ids.size()]) != nullptr;
+    }
+    Report("find_destination_index", ids.size(), (size_t)lookups, os_gettime_ns() - start);
+
+    start = os_gettime_ns();
+    for (int i = 0; i < lookups; i++) {
+        const std::string& id = ids[(size_t)i % ids.size()];
+        for (const auto& dest : plugin->GetDestinations()) {
+            if (dest.id == id) {
+                found++;
+                break;
+            }
+        }
+    }
+    Report("find_destination_scan", ids.size(), (size_t)lookups, os_gettime_ns() - start);
+
+    plugin->StartStreaming();
+    PumpUi(START_SETTLE_MS);
+
+    // The running outputs in start order, which is how they were kept
+    // before the index
+    std::vector<MultistreamOutput*> outputs;
+    for (const auto& dest : plugin->GetDestinations()) {
+        MultistreamOutput* output = plugin->FindOutput(dest.id);
+        if (output) outputs.push_back(output);
+    }
+    if (outputs.size() < ids.size()) {
+        fprintf(stderr, "only %zu of %zu destinations have an output\n", outputs.size(), ids.size());
+    }
+
+    start = os_gettime_ns();
+    for (int i = 0; i < lookups; i++) {
+        found += plugin->FindOutput(ids[(size_t)i % ids.size()]) != nullptr;
+    }
+    Report("find_output_index", outputs.size(), (size_t)lookups, os_gettime_ns() - start);
+
+    start = os_gettime_ns();
+    for (int i = 0; i < lookups; i++) {
+        const std::string& id = ids[(size_t)i % ids.size()];
+        for (auto* output : outputs) {
+            if (output->GetDestination().id == id) {
+                found++;
+                break;
+            }
+        }
+    }
+    Report("find_output_scan", outputs.size(), (size_t)lookups, os_gettime_ns() - start);
+
+    plugin->StopStreaming();
+    PumpUi(100);
+
+    plugin->Cleanup();
+    MultistreamLog::Stop();
+    obs_shutdown();
+
+    fprintf(stderr, "%zu lookups resolved\n", found);
+    return 0;
+}
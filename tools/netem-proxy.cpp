@@ -0,0 +1,574 @@
+// TCP proxy that impairs the connections passing through it on a timeline,
+// for reproducible congestion, stall and reconnect tests.
+//
+//   multistream-netem-proxy --listen 127.0.0.1:1936 --target 127.0.0.1:1935
+//                           --timeline scenario.txt [--buffer-kb 256] [--seed 1]
+//
+// Point a destination at the listen address and run a local RTMP sink
+// (multistream-rtmp-sink) at the target. Every accepted connection gets its own
+// upstream connection and replays the timeline from the moment it was
+// accepted. Timeline lines are "<seconds> <action> [value] [conn=N]":
+//
+//   rate <kbps>      cap client -> server throughput (0 = unlimited)
+//   latency <ms>     added one-way delay, both directions
+//   jitter <ms>      random +/- variation of the delay (order is preserved)
+//   stall <ms>       forward nothing in either direction for this long,
+//                    like a burst of loss that TCP retransmits through
+//   disconnect       close both sides of the connection
+//   clear            remove every impairment
+//
+// conn=N limits a line to the N-th accepted connection (from 1), so that a
+// scenario can drop the first connection and leave the reconnect alone.
+// '#' starts a comment. The proxy logs every accept, applied action, close
+// and per-connection byte counts as CSV on stdout, including how long each
+// reconnect took after the previous connection closed.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define CloseSocket closesocket
+#define SHUTDOWN_BOTH SD_BOTH
+#define INVALID_SOCKET_VALUE INVALID_SOCKET
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+#define CloseSocket close
+#define SHUTDOWN_BOTH SHUT_RDWR
+#define INVALID_SOCKET_VALUE -1
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+#define CHUNK_BYTES 16384
+#define RATE_SLICE_BYTES 4096
+
+enum Action { ACTION_RATE, ACTION_LATENCY, ACTION_JITTER, ACTION_STALL, ACTION_DISCONNECT, ACTION_CLEAR };
+
+struct TimelineEntry {
+    double atSec;
+    Action action;
+    long long value;
+    int connection; // 0 = every connection
+    std::string text;
+};
+
+struct Options {
+    std::string listenHost = "127.0.0.1";
+    std::string listenPort = "1936";
+    std::string targetHost = "127.0.0.1";
+    std::string targetPort = "1935";
+    size_t bufferBytes = 256 * 1024;
+    unsigned seed = 1;
+    std::vector<TimelineEntry> timeline;
+};
+
+static Clock::time_point proxyStart;
+static std::mutex logMutex;
+
+static void Log(int connection, const char* event, const std::string& detail = std::string()) {
+    double seconds = std::chrono::duration<double>(Clock::now() - proxyStart).count();
+    std::lock_guard<std::mutex> lock(logMutex);
+    printf("%.3f,%d,%s,%s\n", seconds, connection, event, detail.c_str());
+    fflush(stdout);
+}
+
+// ============================================================================
+// Timeline
+// ============================================================================
+
+static bool ParseAction(const std::string& name, Action& action) {
+    static const struct {
+        const char* name;
+        Action action;
+    } actions[] = {{"rate", ACTION_RATE},   {"latency", ACTION_LATENCY},       {"jitter", ACTION_JITTER},
+                   {"stall", ACTION_STALL}, {"disconnect", ACTION_DISCONNECT}, {"clear", ACTION_CLEAR}};
+
+    for (const auto& entry : actions) {
+        if (name == entry.name) {
+            action = entry.action;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool LoadTimeline(const char* path, std::vector<TimelineEntry>& timeline) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "cannot open timeline %s\n", path);
+        return false;
+    }
+
+    char line[512];
+    int lineNumber = 0;
+    bool ok = true;
+
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char name[32] = "";
+        char arg1[64] = "";
+        char arg2[64] = "";
+        double atSec = 0.0;
+        int fields = sscanf(line, "%lf %31s %63s %63s", &atSec, name, arg1, arg2);
+        if (fields <= 0) continue;
+
+        TimelineEntry entry;
+        entry.atSec = atSec;
+        entry.value = 0;
+        entry.connection = 0;
+
+        if (fields < 2 || !ParseAction(name, entry.action)) {
+            fprintf(stderr, "%s:%d: expected \"<seconds> <action> [value] [conn=N]\"\n", path, lineNumber);
+            ok = false;
+            continue;
+        }
+
+        for (const char* arg : {arg1, arg2}) {
+            if (strncmp(arg, "conn=", 5) == 0) {
+                entry.connection = atoi(arg + 5);
+            } else if (*arg) {
+                entry.value = atoll(arg);
+            }
+        }
+
+        entry.text = std::string(name) + (entry.value ? " " + std::to_string(entry.value) : std::string());
+        timeline.push_back(entry);
+    }
+
+    fclose(file);
+    std::stable_sort(timeline.begin(), timeline.end(),
+                     [](const TimelineEntry& a, const TimelineEntry& b) { return a.atSec < b.atSec; });
+    return ok;
+}
+
+// ============================================================================
+// Connection
+// ============================================================================
+
+struct Chunk {
+    std::vector<char> data;
+    Clock::time_point release;
+};
+
+struct Connection;
+
+// One direction of a proxied connection: a reader queues what arrives with
+// its release time, a writer forwards it when due and within the rate cap
+struct Pipe {
+    Connection* connection;
+    socket_t from;
+    socket_t to;
+    bool upstream;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Chunk> queue;
+    size_t queuedBytes = 0;
+    bool readerDone = false;
+    Clock::time_point lastRelease;
+
+    std::atomic<uint64_t> forwardedBytes{0};
+};
+
+struct Connection {
+    int id;
+    const Options* options;
+    socket_t client;
+    socket_t server;
+
+    // Current impairments, changed by the timeline thread
+    std::mutex mutex;
+    std::condition_variable changed;
+    long long rateKbps = 0;
+    long long latencyMs = 0;
+    long long jitterMs = 0;
+    Clock::time_point stallUntil;
+    bool closing = false;
+    std::mt19937 random;
+
+    Pipe up;
+    Pipe down;
+};
+
+static void CloseConnection(Connection* connection) {
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        if (connection->closing) return;
+        connection->closing = true;
+    }
+
+    shutdown(connection->client, SHUTDOWN_BOTH);
+    shutdown(connection->server, SHUTDOWN_BOTH);
+
+    connection->changed.notify_all();
+    for (Pipe* pipe : {&connection->up, &connection->down}) {
+        std::lock_guard<std::mutex> lock(pipe->mutex);
+        pipe->changed.notify_all();
+    }
+}
+
+static bool IsClosing(Connection* connection) {
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    return connection->closing;
+}
+
+static void ReaderThread(Pipe* pipe) {
+    Connection* connection = pipe->connection;
+    std::vector<char> buffer(CHUNK_BYTES);
+
+    for (;;) {
+        int received = recv(pipe->from, buffer.data(), (int)buffer.size(), 0);
+        if (received <= 0) break;
+
+        Clock::time_point now = Clock::now();
+        Clock::time_point release;
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            long long delayMs = connection->latencyMs;
+            if (connection->jitterMs > 0) {
+                std::uniform_int_distribution<long long> jitter(-connection->jitterMs, connection->jitterMs);
+                delayMs += jitter(connection->random);
+            }
+            release = now + std::chrono::milliseconds(std::max(0LL, delayMs));
+        }
+
+        std::unique_lock<std::mutex> lock(pipe->mutex);
+
+        // TCP delivers in order, whatever the jitter
+        release = std::max(release, pipe->lastRelease);
+        pipe->lastRelease = release;
+
+        // A full buffer pushes back on the sender, as a slow link would
+        pipe->changed.wait(lock, [pipe, connection] {
+            return pipe->queuedBytes < connection->options->bufferBytes || IsClosing(connection);
+        });
+        if (IsClosing(connection)) break;
+
+        pipe->queue.push_back({std::vector<char>(buffer.begin(), buffer.begin() + received), release});
+        pipe->queuedBytes += (size_t)received;
+        pipe->changed.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(pipe->mutex);
+    pipe->readerDone = true;
+    pipe->changed.notify_all();
+}
+
+static bool SendAll(socket_t socket, const char* data, size_t size) {
+    while (size > 0) {
+        int sent = send(socket, data, (int)size, 0);
+        if (sent <= 0) return false;
+        data += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+// Holds the caller until the connection is neither stalled nor closing
+static bool WaitWhileStalled(Connection* connection) {
+    std::unique_lock<std::mutex> lock(connection->mutex);
+    while (!connection->closing && Clock::now() < connection->stallUntil) {
+        connection->changed.wait_until(lock, connection->stallUntil);
+    }
+    return !connection->closing;
+}
+
+static void WriterThread(Pipe* pipe) {
+    Connection* connection = pipe->connection;
+    double tokens = 0.0;
+    Clock::time_point lastRefill = Clock::now();
+
+    for (;;) {
+        Chunk chunk;
+        {
+            std::unique_lock<std::mutex> lock(pipe->mutex);
+            pipe->changed.wait(lock, [pipe, connection] {
+                return !pipe->queue.empty() || pipe->readerDone || IsClosing(connection);
+            });
+            if (IsClosing(connection) || pipe->queue.empty()) break;
+
+            chunk = std::move(pipe->queue.front());
+            pipe->queue.pop_front();
+            pipe->queuedBytes -= chunk.data.size();
+            pipe->changed.notify_all();
+        }
+
+        std::this_thread::sleep_until(chunk.release);
+
+        size_t offset = 0;
+        while (offset < chunk.data.size()) {
+            if (!WaitWhileStalled(connection)) return;
+
+            size_t slice = std::min(chunk.data.size() - offset, (size_t)RATE_SLICE_BYTES);
+
+            long long rateKbps;
+            {
+                std::lock_guard<std::mutex> lock(connection->mutex);
+                rateKbps = pipe->upstream ? connection->rateKbps : 0;
+            }
+
+            // Token bucket with a one-slice burst
+            if (rateKbps > 0) {
+                double bytesPerSec = rateKbps * 1000.0 / 8.0;
+                Clock::time_point now = Clock::now();
+                tokens = std::min((double)RATE_SLICE_BYTES,
+                                  tokens + std::chrono::duration<double>(now - lastRefill).count() * bytesPerSec);
+                lastRefill = now;
+
+                if (tokens < (double)slice) {
+                    double waitSec = ((double)slice - tokens) / bytesPerSec;
+                    std::this_thread::sleep_for(std::chrono::duration<double>(waitSec));
+                    tokens = (double)slice;
+                    lastRefill = Clock::now();
+                }
+                tokens -= (double)slice;
+            }
+
+            if (!SendAll(pipe->to, chunk.data.data() + offset, slice)) {
+                CloseConnection(connection);
+                return;
+            }
+            offset += slice;
+            pipe->forwardedBytes += slice;
+        }
+    }
+
+    // Pass the end of stream on
+    if (!IsClosing(connection)) {
+        CloseConnection(connection);
+    }
+}
+
+static void TimelineThread(Connection* connection) {
+    Clock::time_point start = Clock::now();
+
+    for (const auto& entry : connection->options->timeline) {
+        if (entry.connection && entry.connection != connection->id) continue;
+
+        Clock::time_point due = start + std::chrono::duration_cast<Clock::duration>(
+                                            std::chrono::duration<double>(entry.atSec));
+        {
+            std::unique_lock<std::mutex> lock(connection->mutex);
+            connection->changed.wait_until(lock, due, [connection] { return connection->closing; });
+            if (connection->closing) return;
+
+            switch (entry.action) {
+            case ACTION_RATE: connection->rateKbps = entry.value; break;
+            case ACTION_LATENCY: connection->latencyMs = entry.value; break;
+            case ACTION_JITTER: connection->jitterMs = entry.value; break;
+            case ACTION_STALL:
+                connection->stallUntil = Clock::now() + std::chrono::milliseconds(entry.value);
+                break;
+            case ACTION_CLEAR:
+                connection->rateKbps = 0;
+                connection->latencyMs = 0;
+                connection->jitterMs = 0;
+                connection->stallUntil = Clock::now();
+                break;
+            case ACTION_DISCONNECT: break;
+            }
+            connection->changed.notify_all();
+        }
+
+        Log(connection->id, "apply", entry.text);
+        if (entry.action == ACTION_DISCONNECT) {
+            CloseConnection(connection);
+            return;
+        }
+    }
+}
+
+// ============================================================================
+// Sockets
+// ============================================================================
+
+static bool SplitAddress(const char* text, std::string& host, std::string& port) {
+    const char* colon = strrchr(text, ':');
+    if (!colon) return false;
+    host.assign(text, colon - text);
+    port = colon + 1;
+    return !host.empty() && !port.empty();
+}
+
+static socket_t OpenSocket(const std::string& host, const std::string& port, bool listening) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) return INVALID_SOCKET_VALUE;
+
+    socket_t sock = INVALID_SOCKET_VALUE;
+    for (struct addrinfo* info = result; info; info = info->ai_next) {
+        sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (sock == INVALID_SOCKET_VALUE) continue;
+
+        int one = 1;
+        if (listening) {
+            setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+            if (bind(sock, info->ai_addr, (int)info->ai_addrlen) == 0 && listen(sock, 16) == 0) break;
+        } else {
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+            if (connect(sock, info->ai_addr, (int)info->ai_addrlen) == 0) break;
+        }
+
+        CloseSocket(sock);
+        sock = INVALID_SOCKET_VALUE;
+    }
+
+    freeaddrinfo(result);
+    return sock;
+}
+
+static std::mutex reconnectMutex;
+static Clock::time_point lastClose;
+static bool hadClose = false;
+
+static void RunConnection(std::unique_ptr<Connection> connection) {
+    Connection* c = connection.get();
+
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex);
+        std::string detail;
+        if (hadClose) {
+            long long gapMs =
+                std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - lastClose).count();
+            detail = "reconnect_after_ms=" + std::to_string(gapMs);
+        }
+        Log(c->id, "accept", detail);
+    }
+
+    c->server = OpenSocket(c->options->targetHost, c->options->targetPort, false);
+    if (c->server == INVALID_SOCKET_VALUE) {
+        Log(c->id, "error", "cannot connect to target");
+        CloseSocket(c->client);
+        return;
+    }
+
+    c->up.connection = c;
+    c->up.from = c->client;
+    c->up.to = c->server;
+    c->up.upstream = true;
+    c->down.connection = c;
+    c->down.from = c->server;
+    c->down.to = c->client;
+    c->down.upstream = false;
+
+    Clock::time_point start = Clock::now();
+    std::thread threads[] = {
+        std::thread(ReaderThread, &c->up),   std::thread(WriterThread, &c->up), std::thread(ReaderThread, &c->down),
+        std::thread(WriterThread, &c->down), std::thread(TimelineThread, c),
+    };
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    CloseSocket(c->client);
+    CloseSocket(c->server);
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t upBytes = c->up.forwardedBytes.load();
+    char detail[160];
+    snprintf(detail, sizeof(detail), "duration_s=%.3f up_bytes=%llu down_bytes=%llu up_kbps=%.0f", seconds,
+             (unsigned long long)upBytes, (unsigned long long)c->down.forwardedBytes.load(),
+             seconds > 0.0 ? (double)upBytes * 8.0 / 1000.0 / seconds : 0.0);
+    Log(c->id, "close", detail);
+
+    std::lock_guard<std::mutex> lock(reconnectMutex);
+    lastClose = Clock::now();
+    hadClose = true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    const char* timelinePath = nullptr;
+    bool ok = true;
+
+    for (int i = 1; i < argc && ok; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--listen") == 0 && hasValue) {
+            ok = SplitAddress(argv[++i], options.listenHost, options.listenPort);
+        } else if (strcmp(argv[i], "--target") == 0 && hasValue) {
+            ok = SplitAddress(argv[++i], options.targetHost, options.targetPort);
+        } else if (strcmp(argv[i], "--timeline") == 0 && hasValue) {
+            timelinePath = argv[++i];
+        } else if (strcmp(argv[i], "--buffer-kb") == 0 && hasValue) {
+            options.bufferBytes = (size_t)std::max(1, atoi(argv[++i])) * 1024;
+        } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+            options.seed = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else {
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        fprintf(stderr,
+                "usage: %s [--listen host:port] [--target host:port] [--timeline file] [--buffer-kb n] [--seed n]\n",
+                argv[0]);
+        return 2;
+    }
+
+    if (timelinePath && !LoadTimeline(timelinePath, options.timeline)) return 2;
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#else
+    // A peer closing mid-send must fail the send, not end the proxy
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    socket_t listener = OpenSocket(options.listenHost, options.listenPort, true);
+    if (listener == INVALID_SOCKET_VALUE) {
+        fprintf(stderr, "cannot listen on %s:%s\n", options.listenHost.c_str(), options.listenPort.c_str());
+        return 1;
+    }
+
+    proxyStart = Clock::now();
+    printf("time_s,connection,event,detail\n");
+    Log(0, "listen",
+        options.listenHost + ":" + options.listenPort + " -> " + options.targetHost + ":" + options.targetPort);
+
+    int nextId = 1;
+    for (;;) {
+        socket_t client = accept(listener, nullptr, nullptr);
+        if (client == INVALID_SOCKET_VALUE) continue;
+
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+
+        std::unique_ptr<Connection> connection(new Connection());
+        connection->id = nextId++;
+        connection->options = &options;
+        connection->client = client;
+        connection->server = INVALID_SOCKET_VALUE;
+        connection->random.seed(options.seed + (unsigned)connection->id);
+
+        std::thread(RunConnection, std::move(connection)).detach();
+    }
+}
@@ -0,0 +1,539 @@
+// Companion relay process for the plugin's relay offload mode.
+//
+//   multistream-relay --connect 127.0.0.1:port --protocol 2 [--ffmpeg path]
+//
+// OBS starts the relay, which reads a token line from its stdin, connects
+// back, presents the token and receives the destination list and one FLV
+// stream per encoder pair (see relay-protocol.h). Every destination gets an
+// ffmpeg process that publishes the stream with stream copy, fed from a
+// queue of its own; tags are shared between the queues, not copied. Each new
+// ffmpeg starts with the GOP in progress instead of waiting for the next
+// keyframe. A destination that falls behind drops video up to the next
+// keyframe without holding up the others. One whose ffmpeg exits is
+// restarted with a backoff, switching between its primary and backup ingest
+// after repeated failures. Every destination's state, bytes sent, drops and
+// queue fill go back to OBS once a second.
+//
+// The relay exits as soon as its stdin or the connection to OBS closes, so
+// it never outlives OBS; its ffmpeg processes then see their stdin close and
+// exit as well. It is not meant to be run by hand.
+
+#include "relay-protocol.h"
+#include "ffmpeg-publish.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define INVALID_SOCKET_VALUE INVALID_SOCKET
+#define popen _popen
+#define pclose _pclose
+#define POPEN_WRITE "wb"
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET_VALUE -1
+#define POPEN_WRITE "w"
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+// Stream a destination may fall behind by before its newest tags are dropped
+#define DESTINATION_MAX_QUEUE_BYTES (8 * 1024 * 1024)
+
+// Largest GOP kept for starting destinations; a bigger one is dropped
+#define GOP_MAX_BYTES DESTINATION_MAX_QUEUE_BYTES
+
+// Restart backoff; it starts over once ffmpeg has run this long
+#define RESTART_MIN_BACKOFF_MS 1000
+#define RESTART_MAX_BACKOFF_MS 30000
+#define RESTART_STABLE_MS 30000
+
+// Failed attempts on one ingest before trying the other
+#define FAILURES_BEFORE_SWITCH 3
+
+#define STATUS_INTERVAL_MS 1000
+
+#define FLV_TAG_VIDEO 9
+
+typedef std::shared_ptr<const std::vector<uint8_t>> Tag;
+
+struct QueuedTag {
+    Tag data;
+    bool keyframe;
+};
+
+struct Destination {
+    std::string id;
+    std::string url;
+    std::string key;
+    std::string backupUrl;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<QueuedTag> queue;
+    size_t queuedBytes = 0;
+    bool needKeyframe = true;
+    bool stopping = false;
+
+    std::atomic<int> state{RELAY_STATE_CONNECTING};
+    std::atomic<uint64_t> totalBytes{0};
+    std::atomic<int> droppedTags{0};
+    std::atomic<uint32_t> retries{0};
+};
+
+static std::string ffmpegPath = "ffmpeg";
+
+static std::mutex destinationsMutex;
+static std::map<std::string, std::shared_ptr<Destination>> destinations;
+static Tag preamble;
+
+// Tags from the latest video keyframe on, under destinationsMutex
+static std::vector<QueuedTag> gop;
+static size_t gopBytes = 0;
+
+static Tag GetPreamble() {
+    std::lock_guard<std::mutex> lock(destinationsMutex);
+    return preamble;
+}
+
+// ============================================================================
+// Publishing
+// ============================================================================
+
+// The command the plugin's relays run for the same url; the key is read
+// from keyPath
+static std::string BuildCommand(const std::string& url, const std::string& keyPath) {
+    std::string command = BuildFfmpegPublishCommand(ffmpegPath, url, keyPath);
+#ifdef _WIN32
+    // cmd.exe strips the outermost quotes
+    if (!command.empty()) command = "\"" + command + "\"";
+#endif
+    return command;
+}
+
+static void Push(Destination* destination, const Tag& tag, bool video, bool keyframe) {
+    {
+        std::lock_guard<std::mutex> lock(destination->mutex);
+        if (video && keyframe) {
+            destination->needKeyframe = false;
+        }
+
+        bool full = destination->queuedBytes + tag->size() > DESTINATION_MAX_QUEUE_BYTES;
+        if (full || (video && destination->needKeyframe)) {
+            // This destination skips video until the next keyframe
+            if (video) destination->needKeyframe = true;
+            destination->droppedTags++;
+            return;
+        }
+
+        destination->queue.push_back({tag, keyframe});
+        destination->queuedBytes += tag->size();
+    }
+    destination->wake.notify_one();
+}
+
+// Remember tag for destinations that start later, with destinationsMutex held
+static void CacheGop(const Tag& tag, bool video, bool keyframe) {
+    if (video && keyframe) {
+        gop.clear();
+        gopBytes = 0;
+    } else if (gop.empty()) {
+        return;
+    }
+
+    if (gopBytes + tag->size() > GOP_MAX_BYTES) {
+        gop.clear();
+        gopBytes = 0;
+        return;
+    }
+
+    gop.push_back({tag, keyframe});
+    gopBytes += tag->size();
+}
+
+static bool Write(FILE* ffmpeg, const std::vector<uint8_t>& data) {
+    return fwrite(data.data(), 1, data.size(), ffmpeg) == data.size() && fflush(ffmpeg) == 0;
+}
+
+// Feed one ffmpeg process until it fails (false) or the destination is
+// removed. The key file goes as soon as ffmpeg must have read it.
+static bool Feed(Destination* destination, FILE* ffmpeg, std::string& keyPath) {
+    // Every connection starts with the sequence headers and the GOP in
+    // progress, or else the next keyframe
+    {
+        std::lock_guard<std::mutex> gopLock(destinationsMutex);
+        std::lock_guard<std::mutex> lock(destination->mutex);
+        destination->queue.assign(gop.begin(), gop.end());
+        destination->queuedBytes = gopBytes;
+        destination->needKeyframe = gop.empty();
+    }
+
+    bool wrotePreamble = false;
+    uint64_t written = 0;
+    for (;;) {
+        QueuedTag tag;
+        {
+            std::unique_lock<std::mutex> lock(destination->mutex);
+            destination->wake.wait(lock, [destination] { return destination->stopping || !destination->queue.empty(); });
+            if (destination->stopping) return true;
+
+            tag = destination->queue.front();
+            destination->queue.pop_front();
+            destination->queuedBytes -= tag.data->size();
+        }
+
+        if (!wrotePreamble) {
+            Tag header = GetPreamble();
+            if (!header) continue;
+            if (!Write(ffmpeg, *header)) return false;
+            wrotePreamble = true;
+        }
+
+        if (!Write(ffmpeg, *tag.data)) return false;
+        destination->totalBytes += tag.data->size();
+
+        written += tag.data->size();
+        if (written > FFMPEG_KEY_FILE_READ_BYTES) {
+            RemoveFfmpegKeyFile(keyPath);
+        }
+
+        if (tag.keyframe) {
+            destination->state = RELAY_STATE_LIVE;
+        }
+    }
+}
+
+static bool IsStopping(Destination* destination) {
+    std::lock_guard<std::mutex> lock(destination->mutex);
+    return destination->stopping;
+}
+
+static void PublishThread(std::shared_ptr<Destination> destination) {
+    uint64_t backoffMs = RESTART_MIN_BACKOFF_MS;
+    int failures = 0;
+    bool onBackup = false;
+
+    while (!IsStopping(destination.get())) {
+        const std::string& url = onBackup ? destination->backupUrl : destination->url;
+        std::string keyPath;
+        if (!destination->key.empty() && !WriteFfmpegKeyFile(destination->key, keyPath)) {
+            fprintf(stderr, "multistream-relay: %s: cannot write the stream key file\n", destination->id.c_str());
+        }
+
+        std::string command = BuildCommand(url, keyPath);
+        if (command.empty() || (!destination->key.empty() && keyPath.empty())) {
+            RemoveFfmpegKeyFile(keyPath);
+            fprintf(stderr, "multistream-relay: %s: URL or ffmpeg path contains unsupported characters\n",
+                    destination->id.c_str());
+            destination->state = RELAY_STATE_RETRYING;
+            std::unique_lock<std::mutex> lock(destination->mutex);
+            destination->wake.wait(lock, [&destination] { return destination->stopping; });
+            break;
+        }
+
+        Clock::time_point started = Clock::now();
+        destination->state = RELAY_STATE_CONNECTING;
+        FILE* ffmpeg = popen(command.c_str(), POPEN_WRITE);
+        if (ffmpeg) {
+            Feed(destination.get(), ffmpeg, keyPath);
+            // Waits for ffmpeg to send what it has and exit
+            pclose(ffmpeg);
+        } else {
+            fprintf(stderr, "multistream-relay: cannot run %s\n", ffmpegPath.c_str());
+        }
+        RemoveFfmpegKeyFile(keyPath);
+
+        if (IsStopping(destination.get())) break;
+
+        if (Clock::now() - started > std::chrono::milliseconds(RESTART_STABLE_MS)) {
+            backoffMs = RESTART_MIN_BACKOFF_MS;
+            failures = 0;
+        }
+
+        failures++;
+        destination->retries++;
+        destination->state = RELAY_STATE_RETRYING;
+        if (!destination->backupUrl.empty() && failures % FAILURES_BEFORE_SWITCH == 0) {
+            onBackup = !onBackup;
+            fprintf(stderr, "multistream-relay: %s: switching to %s\n", destination->id.c_str(),
+                    (onBackup ? destination->backupUrl : destination->url).c_str());
+        }
+
+        std::unique_lock<std::mutex> lock(destination->mutex);
+        destination->wake.wait_for(lock, std::chrono::milliseconds(backoffMs),
+                                   [&destination] { return destination->stopping; });
+        backoffMs = std::min<uint64_t>(backoffMs * 2, RESTART_MAX_BACKOFF_MS);
+    }
+}
+
+// Threads of removed destinations finish on their own, once ffmpeg has
+// flushed, without holding up the stream
+static void StopDestination(const std::shared_ptr<Destination>& destination) {
+    {
+        std::lock_guard<std::mutex> lock(destination->mutex);
+        destination->stopping = true;
+    }
+    destination->wake.notify_all();
+}
+
+static void AddDestination(const std::string& payload) {
+    std::shared_ptr<Destination> destination = std::make_shared<Destination>();
+    std::string* fields[] = {&destination->id, &destination->url, &destination->key, &destination->backupUrl};
+
+    size_t start = 0;
+    for (std::string* field : fields) {
+        size_t end = payload.find('\n', start);
+        *field = payload.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    if (destination->id.empty()) return;
+
+    std::lock_guard<std::mutex> lock(destinationsMutex);
+    auto it = destinations.find(destination->id);
+    if (it != destinations.end()) {
+        StopDestination(it->second);
+    }
+    destinations[destination->id] = destination;
+    std::thread(PublishThread, destination).detach();
+}
+
+static void RemoveDestination(const std::string& id) {
+    std::lock_guard<std::mutex> lock(destinationsMutex);
+    auto it = destinations.find(id);
+    if (it == destinations.end()) return;
+
+    StopDestination(it->second);
+    destinations.erase(it);
+}
+
+// ============================================================================
+// Connection to OBS
+// ============================================================================
+
+static bool RecvAll(socket_t sock, uint8_t* data, size_t size) {
+    while (size > 0) {
+        int received = recv(sock, (char*)data, (int)size, 0);
+        if (received <= 0) return false;
+        data += received;
+        size -= (size_t)received;
+    }
+    return true;
+}
+
+static bool SendAll(socket_t sock, const std::vector<uint8_t>& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        int sent = send(sock, (const char*)data.data() + offset, (int)(data.size() - offset), 0);
+        if (sent <= 0) return false;
+        offset += (size_t)sent;
+    }
+    return true;
+}
+
+static void StatusThread(socket_t sock) {
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(STATUS_INTERVAL_MS));
+
+        std::string lines;
+        {
+            std::lock_guard<std::mutex> lock(destinationsMutex);
+            for (const auto& entry : destinations) {
+                Destination* destination = entry.second.get();
+                size_t queuedBytes;
+                {
+                    std::lock_guard<std::mutex> queueLock(destination->mutex);
+                    queuedBytes = destination->queuedBytes;
+                }
+
+                char line[256];
+                snprintf(line, sizeof(line), " %d %llu %d %d %u\n", destination->state.load(),
+                         (unsigned long long)destination->totalBytes.load(), destination->droppedTags.load(),
+                         (int)(queuedBytes * 1000 / DESTINATION_MAX_QUEUE_BYTES), destination->retries.load());
+                lines += destination->id + line;
+            }
+        }
+
+        std::vector<uint8_t> message;
+        AppendRelayMessage(message, RELAY_MSG_STATUS, lines);
+        if (!SendAll(sock, message)) return;
+    }
+}
+
+// OBS closes stdin when it stops the relay or exits, however it exits
+static void WatchStdin() {
+    while (fgetc(stdin) != EOF) {
+    }
+    std::_Exit(0);
+}
+
+// The first line OBS writes to stdin; false if stdin closes first
+static bool ReadToken(std::string& token) {
+    char line[RELAY_MAX_TOKEN_LINE];
+    if (!fgets(line, sizeof(line), stdin)) return false;
+
+    token = line;
+    while (!token.empty() && (token.back() == '\n' || token.back() == '\r')) token.pop_back();
+    return !token.empty();
+}
+
+static socket_t Connect(const std::string& host, const std::string& port) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) return INVALID_SOCKET_VALUE;
+
+    socket_t sock = INVALID_SOCKET_VALUE;
+    for (struct addrinfo* info = result; info; info = info->ai_next) {
+        sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (sock == INVALID_SOCKET_VALUE) continue;
+        if (connect(sock, info->ai_addr, (int)info->ai_addrlen) == 0) break;
+#ifdef _WIN32
+        closesocket(sock);
+#else
+        close(sock);
+#endif
+        sock = INVALID_SOCKET_VALUE;
+    }
+
+    freeaddrinfo(result);
+    return sock;
+}
+
+int main(int argc, char** argv) {
+    std::string address;
+    int protocol = 0;
+    bool ok = true;
+
+    for (int i = 1; i < argc && ok; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--connect") == 0 && hasValue) {
+            address = argv[++i];
+        } else if (strcmp(argv[i], "--protocol") == 0 && hasValue) {
+            protocol = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ffmpeg") == 0 && hasValue) {
+            ffmpegPath = argv[++i];
+        } else {
+            ok = false;
+        }
+    }
+
+    size_t colon = address.rfind(':');
+    if (!ok || colon == std::string::npos || colon == 0 || colon + 1 == address.size()) {
+        fprintf(stderr, "usage: %s --connect host:port --protocol n [--ffmpeg path]\n", argv[0]);
+        return 2;
+    }
+    if (protocol != RELAY_PROTOCOL_VERSION) {
+        fprintf(stderr, "multistream-relay: protocol %d requested, this relay speaks %d\n", protocol,
+                RELAY_PROTOCOL_VERSION);
+        return 2;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#else
+    // A dead ffmpeg or OBS must fail the write, not end the relay
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    std::string token;
+    if (!ReadToken(token)) {
+        fprintf(stderr, "multistream-relay: no token on stdin\n");
+        return 1;
+    }
+
+    socket_t sock = Connect(address.substr(0, colon), address.substr(colon + 1));
+    if (sock == INVALID_SOCKET_VALUE) {
+        fprintf(stderr, "multistream-relay: cannot connect to %s\n", address.c_str());
+        return 1;
+    }
+
+    std::vector<uint8_t> hello;
+    AppendRelayMessage(hello, RELAY_MSG_HELLO, token);
+    if (!SendAll(sock, hello)) {
+        fprintf(stderr, "multistream-relay: cannot reach %s\n", address.c_str());
+        return 1;
+    }
+
+    // ffmpeg must not inherit the connection, or OBS would not see a dead
+    // relay's socket close
+#ifdef _WIN32
+    SetHandleInformation((HANDLE)sock, HANDLE_FLAG_INHERIT, 0);
+#else
+    fcntl(sock, F_SETFD, FD_CLOEXEC);
+#endif
+
+    std::thread(WatchStdin).detach();
+    std::thread(StatusThread, sock).detach();
+
+    uint8_t header[RELAY_MESSAGE_HEADER_BYTES];
+    std::vector<uint8_t> payload;
+    while (RecvAll(sock, header, sizeof(header))) {
+        uint32_t size = ParseRelayPayloadSize(header);
+        if (size > RELAY_MAX_MESSAGE_BYTES) {
+            fprintf(stderr, "multistream-relay: %u byte message, giving up\n", size);
+            break;
+        }
+
+        payload.resize(size);
+        if (size && !RecvAll(sock, payload.data(), size)) break;
+
+        switch (header[0]) {
+        case RELAY_MSG_ADD:
+            AddDestination(std::string(payload.begin(), payload.end()));
+            break;
+        case RELAY_MSG_REMOVE:
+            RemoveDestination(std::string(payload.begin(), payload.end()));
+            break;
+        case RELAY_MSG_PREAMBLE: {
+            std::lock_guard<std::mutex> lock(destinationsMutex);
+            preamble = std::make_shared<const std::vector<uint8_t>>(payload);
+            break;
+        }
+        case RELAY_MSG_TAG: {
+            if (size < 2) break;
+
+            // One copy of the tag, whatever the number of destinations
+            bool keyframe = (payload[0] & RELAY_TAG_KEYFRAME) != 0;
+            bool video = payload[1] == FLV_TAG_VIDEO;
+            Tag tag = std::make_shared<const std::vector<uint8_t>>(payload.begin() + 1, payload.end());
+
+            std::lock_guard<std::mutex> lock(destinationsMutex);
+            CacheGop(tag, video, keyframe);
+            for (const auto& entry : destinations) {
+                Push(entry.second.get(), tag, video, keyframe);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // OBS is gone or restarting the relay
+    std::_Exit(0);
+}
@@ -0,0 +1,920 @@
+// Loopback RTMP ingest for end-to-end tests without a real ingest.
+//
+//   multistream-rtmp-sink [--listen 127.0.0.1:1935] [--report-sec 5] [--tags]
+//                         [--rate-kbps n] [--publish-delay-ms n]
+//                         [--drop-after-s n] [--freeze-after-s n] [--impair-conns n]
+//
+// Accepts plain RTMP publish sessions for any app and stream key, answers
+// connect, createStream and publish, and drains every audio, video and
+// script tag, timestamping each one as it arrives. Impairments:
+//
+//   --rate-kbps n         read at most n kbps, so the publisher's queue grows
+//   --publish-delay-ms n  hold the publish response, delaying the first frame
+//   --drop-after-s n      close the connection n s after publishing starts
+//   --freeze-after-s n    stop reading n s after publishing starts and keep
+//                         the connection open, like a stalled ingest
+//   --impair-conns n      apply the impairments to the first n connections
+//                         only (default every connection), so that
+//                         reconnects run clean
+//
+// The sink logs CSV on stdout in the same layout as multistream-netem-proxy:
+// every accept (with reconnect_after_ms), handshake, connect and publish;
+// the first video and audio frame of each connection; throughput, frame rate
+// and lag behind the stream's own timestamps every --report-sec; every tag
+// with --tags; and each close with its totals. A frozen connection is held
+// open until the sink exits.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define CloseSocket closesocket
+#define SHUTDOWN_BOTH SD_BOTH
+#define INVALID_SOCKET_VALUE INVALID_SOCKET
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+#define CloseSocket close
+#define SHUTDOWN_BOTH SHUT_RDWR
+#define INVALID_SOCKET_VALUE -1
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+#define RECV_BYTES 65536
+#define RATE_SLICE_BYTES 4096
+#define POLL_MS 100
+
+#define HANDSHAKE_BYTES 1536
+#define OUT_CHUNK_BYTES 4096
+#define WINDOW_ACK_BYTES 2500000
+#define MAX_MESSAGE_BYTES (16 * 1024 * 1024)
+
+// RTMP message types
+#define MSG_SET_CHUNK_SIZE 1
+#define MSG_ACKNOWLEDGEMENT 3
+#define MSG_WINDOW_ACK_SIZE 5
+#define MSG_SET_PEER_BANDWIDTH 6
+#define MSG_AUDIO 8
+#define MSG_VIDEO 9
+#define MSG_AMF3_COMMAND 17
+#define MSG_DATA 18
+#define MSG_COMMAND 20
+
+// Chunk streams the sink sends on
+#define CSID_CONTROL 2
+#define CSID_COMMAND 3
+#define CSID_STREAM 5
+
+// The one stream id createStream hands out
+#define PUBLISH_STREAM_ID 1
+
+// AMF0 markers
+#define AMF_NUMBER 0x00
+#define AMF_BOOLEAN 0x01
+#define AMF_STRING 0x02
+#define AMF_OBJECT 0x03
+#define AMF_NULL 0x05
+#define AMF_UNDEFINED 0x06
+#define AMF_ECMA_ARRAY 0x08
+#define AMF_OBJECT_END 0x09
+#define AMF_STRICT_ARRAY 0x0a
+#define AMF_DATE 0x0b
+#define AMF_LONG_STRING 0x0c
+
+struct Options {
+    std::string listenHost = "127.0.0.1";
+    std::string listenPort = "1935";
+    double reportSec = 5.0;
+    bool logTags = false;
+    long long rateKbps = 0;
+    long long publishDelayMs = 0;
+    double dropAfterSec = 0.0;
+    double freezeAfterSec = 0.0;
+    int impairConnections = 0; // 0 = every connection
+};
+
+static Clock::time_point sinkStart;
+static std::mutex logMutex;
+
+static double Seconds(Clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+static long long Milliseconds(Clock::duration duration) {
+    return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+}
+
+static void Log(int connection, const char* event, const std::string& detail = std::string()) {
+    double seconds = Seconds(Clock::now() - sinkStart);
+    std::lock_guard<std::mutex> lock(logMutex);
+    printf("%.3f,%d,%s,%s\n", seconds, connection, event, detail.c_str());
+    fflush(stdout);
+}
+
+static uint32_t ReadU24(const uint8_t* data) {
+    return (uint32_t)data[0] << 16 | (uint32_t)data[1] << 8 | (uint32_t)data[2];
+}
+
+static uint32_t ReadU32(const uint8_t* data) {
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | (uint32_t)data[3];
+}
+
+static void AppendU16(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)value);
+}
+
+static void AppendU24(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back((uint8_t)(value >> 16));
+    AppendU16(out, value);
+}
+
+static void AppendU32(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back((uint8_t)(value >> 24));
+    AppendU24(out, value);
+}
+
+// ============================================================================
+// AMF0
+// ============================================================================
+
+// A decoded value; objects keep only their string properties, which is all
+// the commands below need
+struct AmfValue {
+    uint8_t type = AMF_NULL;
+    double number = 0.0;
+    std::string string;
+    std::map<std::string, std::string> properties;
+};
+
+static bool ReadAmf(const uint8_t*& p, const uint8_t* end, AmfValue& value, int depth = 0);
+
+static bool ReadAmfString(const uint8_t*& p, const uint8_t* end, std::string& string, bool longString = false) {
+    size_t lengthBytes = longString ? 4 : 2;
+    if ((size_t)(end - p) < lengthBytes) return false;
+    size_t length = longString ? ReadU32(p) : ((size_t)p[0] << 8 | p[1]);
+    p += lengthBytes;
+    if ((size_t)(end - p) < length) return false;
+    string.assign((const char*)p, length);
+    p += length;
+    return true;
+}
+
+// Key/value pairs up to the object end marker
+static bool ReadAmfProperties(const uint8_t*& p, const uint8_t* end, AmfValue& value, int depth) {
+    for (;;) {
+        std::string key;
+        if (!ReadAmfString(p, end, key)) return false;
+        if (key.empty() && p < end && *p == AMF_OBJECT_END) {
+            p++;
+            return true;
+        }
+
+        AmfValue property;
+        if (!ReadAmf(p, end, property, depth + 1)) return false;
+        if (property.type == AMF_STRING || property.type == AMF_LONG_STRING) {
+            value.properties[key] = property.string;
+        }
+    }
+}
+
+static bool ReadAmf(const uint8_t*& p, const uint8_t* end, AmfValue& value, int depth) {
+    if (p >= end || depth > 16) return false;
+    value.type = *p++;
+
+    switch (value.type) {
+    case AMF_NUMBER: {
+        if (end - p < 8) return false;
+        uint64_t bits = (uint64_t)ReadU32(p) << 32 | ReadU32(p + 4);
+        memcpy(&value.number, &bits, sizeof(value.number));
+        p += 8;
+        return true;
+    }
+    case AMF_BOOLEAN:
+        if (p >= end) return false;
+        value.number = *p++ ? 1.0 : 0.0;
+        return true;
+    case AMF_STRING: return ReadAmfString(p, end, value.string);
+    case AMF_LONG_STRING: return ReadAmfString(p, end, value.string, true);
+    case AMF_NULL:
+    case AMF_UNDEFINED: return true;
+    case AMF_OBJECT: return ReadAmfProperties(p, end, value, depth);
+    case AMF_ECMA_ARRAY:
+        if (end - p < 4) return false;
+        p += 4;
+        return ReadAmfProperties(p, end, value, depth);
+    case AMF_STRICT_ARRAY: {
+        if (end - p < 4) return false;
+        uint32_t count = ReadU32(p);
+        p += 4;
+        for (uint32_t i = 0; i < count; i++) {
+            AmfValue element;
+            if (!ReadAmf(p, end, element, depth + 1)) return false;
+        }
+        return true;
+    }
+    case AMF_DATE:
+        if (end - p < 10) return false;
+        p += 10;
+        return true;
+    default: return false;
+    }
+}
+
+static void AppendAmfNumber(std::vector<uint8_t>& out, double number) {
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    out.push_back(AMF_NUMBER);
+    AppendU32(out, (uint32_t)(bits >> 32));
+    AppendU32(out, (uint32_t)bits);
+}
+
+static void AppendAmfString(std::vector<uint8_t>& out, const std::string& string) {
+    out.push_back(AMF_STRING);
+    AppendU16(out, (uint32_t)string.size());
+    out.insert(out.end(), string.begin(), string.end());
+}
+
+static void AppendAmfKey(std::vector<uint8_t>& out, const char* key) {
+    size_t length = strlen(key);
+    AppendU16(out, (uint32_t)length);
+    out.insert(out.end(), key, key + length);
+}
+
+static void AppendAmfObjectEnd(std::vector<uint8_t>& out) {
+    AppendU16(out, 0);
+    out.push_back(AMF_OBJECT_END);
+}
+
+// ============================================================================
+// Connection
+// ============================================================================
+
+// Receive state of one chunk stream
+struct ChunkStream {
+    uint32_t timestamp = 0;
+    uint32_t delta = 0;
+    uint32_t length = 0;
+    uint8_t type = 0;
+    uint32_t streamId = 0;
+    bool extended = false;
+    std::vector<uint8_t> message;
+};
+
+struct Connection {
+    int id;
+    const Options* options;
+    socket_t socket;
+    bool impaired;
+    Clock::time_point accepted;
+    std::string endReason;
+
+    // Receive side
+    std::vector<uint8_t> buffer;
+    size_t bufferOffset = 0;
+    uint64_t receivedBytes = 0;
+    double tokens = 0.0;
+    Clock::time_point lastRefill;
+    uint32_t inChunkSize = 128;
+    uint32_t outChunkSize = 128;
+    uint32_t ackWindow = 0;
+    uint64_t ackedBytes = 0;
+    std::map<uint32_t, ChunkStream> chunkStreams;
+
+    // Publish session
+    bool publishing = false;
+    Clock::time_point publishStart;
+    uint64_t videoTags = 0;
+    uint64_t audioTags = 0;
+    uint64_t keyframes = 0;
+    bool haveVideo = false;
+    bool haveAudio = false;
+    Clock::time_point firstVideoArrival;
+    uint32_t firstVideoTs = 0;
+    uint32_t lastVideoTs = 0;
+
+    // Current report interval
+    Clock::time_point reportStart;
+    uint64_t reportBytes = 0;
+    uint64_t reportVideoTags = 0;
+};
+
+static bool SendAll(socket_t socket, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        int sent = send(socket, (const char*)data, (int)size, 0);
+        if (sent <= 0) return false;
+        data += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+// One message as a type 0 chunk followed by type 3 continuation chunks
+static bool SendMessage(Connection* c, uint8_t csid, uint8_t type, uint32_t streamId,
+                        const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> out;
+    out.reserve(payload.size() + 16 + payload.size() / c->outChunkSize);
+
+    out.push_back(csid);
+    AppendU24(out, 0);
+    AppendU24(out, (uint32_t)payload.size());
+    out.push_back(type);
+    for (int i = 0; i < 4; i++) {
+        out.push_back((uint8_t)(streamId >> (8 * i)));
+    }
+
+    for (size_t offset = 0; offset < payload.size(); offset += c->outChunkSize) {
+        if (offset) out.push_back((uint8_t)(0xc0 | csid));
+        size_t size = std::min(payload.size() - offset, (size_t)c->outChunkSize);
+        out.insert(out.end(), payload.begin() + offset, payload.begin() + offset + size);
+    }
+
+    return SendAll(c->socket, out.data(), out.size());
+}
+
+static bool SendControl(Connection* c, uint8_t type, uint32_t value) {
+    std::vector<uint8_t> payload;
+    AppendU32(payload, value);
+    if (type == MSG_SET_PEER_BANDWIDTH) payload.push_back(2); // dynamic
+    return SendMessage(c, CSID_CONTROL, type, 0, payload);
+}
+
+static void ReportStats(Connection* c, Clock::time_point now) {
+    double seconds = Seconds(now - c->reportStart);
+    long long lagMs = 0;
+    if (c->haveVideo) {
+        lagMs = Milliseconds(now - c->firstVideoArrival) - (long long)(c->lastVideoTs - c->firstVideoTs);
+    }
+
+    char detail[160];
+    snprintf(detail, sizeof(detail), "kbps=%.0f fps=%.1f lag_ms=%lld",
+             seconds > 0.0 ? (double)(c->receivedBytes - c->reportBytes) * 8.0 / 1000.0 / seconds : 0.0,
+             seconds > 0.0 ? (double)(c->videoTags - c->reportVideoTags) / seconds : 0.0, lagMs);
+    Log(c->id, "stats", detail);
+
+    c->reportStart = now;
+    c->reportBytes = c->receivedBytes;
+    c->reportVideoTags = c->videoTags;
+}
+
+static void LogTotals(Connection* c, const char* event) {
+    double seconds = Seconds(Clock::now() - c->accepted);
+    char detail[256];
+    snprintf(detail, sizeof(detail),
+             "reason=%s duration_s=%.3f bytes=%llu kbps=%.0f video_tags=%llu audio_tags=%llu keyframes=%llu",
+             c->endReason.c_str(), seconds, (unsigned long long)c->receivedBytes,
+             seconds > 0.0 ? (double)c->receivedBytes * 8.0 / 1000.0 / seconds : 0.0,
+             (unsigned long long)c->videoTags, (unsigned long long)c->audioTags, (unsigned long long)c->keyframes);
+    Log(c->id, event, detail);
+}
+
+// 1 when readable, 0 on timeout, -1 on error
+static int WaitReadable(socket_t socket, int timeoutMs) {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(socket, &readSet);
+    struct timeval timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    int result = select((int)socket + 1, &readSet, nullptr, nullptr, &timeout);
+    return result > 0 ? 1 : result;
+}
+
+// Receive more data, applying the rate cap and the drop/freeze timers.
+// Returns false once the connection has ended, with endReason set.
+static bool Fill(Connection* c) {
+    const Options* options = c->options;
+
+    for (;;) {
+        Clock::time_point now = Clock::now();
+
+        if (c->publishing && c->impaired) {
+            double publishedSec = Seconds(now - c->publishStart);
+            if (options->dropAfterSec > 0.0 && publishedSec >= options->dropAfterSec) {
+                c->endReason = "dropped";
+                return false;
+            }
+            if (options->freezeAfterSec > 0.0 && publishedSec >= options->freezeAfterSec) {
+                c->endReason = "frozen";
+                return false;
+            }
+        }
+
+        if (c->publishing && options->reportSec > 0.0 && Seconds(now - c->reportStart) >= options->reportSec) {
+            ReportStats(c, now);
+        }
+
+        size_t want = RECV_BYTES;
+
+        // Token bucket with a one-slice burst
+        if (c->impaired && options->rateKbps > 0) {
+            double bytesPerSec = options->rateKbps * 1000.0 / 8.0;
+            c->tokens = std::min((double)RATE_SLICE_BYTES, c->tokens + Seconds(now - c->lastRefill) * bytesPerSec);
+            c->lastRefill = now;
+
+            if (c->tokens < 1.0) {
+                std::this_thread::sleep_for(std::chrono::duration<double>((1.0 - c->tokens) / bytesPerSec));
+                continue;
+            }
+            want = (size_t)c->tokens;
+        }
+
+        int readable = WaitReadable(c->socket, POLL_MS);
+        if (readable == 0) continue;
+        if (readable < 0) {
+            c->endReason = "error";
+            return false;
+        }
+
+        // Keep unread bytes at the front
+        if (c->bufferOffset) {
+            c->buffer.erase(c->buffer.begin(), c->buffer.begin() + c->bufferOffset);
+            c->bufferOffset = 0;
+        }
+
+        size_t used = c->buffer.size();
+        c->buffer.resize(used + want);
+        int received = recv(c->socket, (char*)c->buffer.data() + used, (int)want, 0);
+        c->buffer.resize(used + (size_t)std::max(received, 0));
+        if (received <= 0) {
+            c->endReason = received == 0 ? "peer_closed" : "reset";
+            return false;
+        }
+
+        c->receivedBytes += (uint64_t)received;
+        if (c->impaired && options->rateKbps > 0) {
+            c->tokens -= received;
+        }
+
+        // Acknowledge every window the publisher asked for
+        if (c->ackWindow && c->receivedBytes - c->ackedBytes >= c->ackWindow) {
+            c->ackedBytes = c->receivedBytes;
+            if (!SendControl(c, MSG_ACKNOWLEDGEMENT, (uint32_t)c->receivedBytes)) {
+                c->endReason = "error";
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+static bool ReadBytes(Connection* c, uint8_t* out, size_t size) {
+    while (c->buffer.size() - c->bufferOffset < size) {
+        if (!Fill(c)) return false;
+    }
+
+    memcpy(out, c->buffer.data() + c->bufferOffset, size);
+    c->bufferOffset += size;
+    return true;
+}
+
+static bool Handshake(Connection* c) {
+    std::vector<uint8_t> c0c1(1 + HANDSHAKE_BYTES);
+    if (!ReadBytes(c, c0c1.data(), c0c1.size())) return false;
+    if (c0c1[0] != 3) {
+        c->endReason = "unsupported_version";
+        return false;
+    }
+
+    // S1 carries a zero version, so clients skip digest validation; S2
+    // echoes C1
+    std::vector<uint8_t> reply(1 + 2 * HANDSHAKE_BYTES, 0);
+    reply[0] = 3;
+    std::mt19937 random((unsigned)c->id);
+    for (size_t i = 9; i < 1 + HANDSHAKE_BYTES; i++) {
+        reply[i] = (uint8_t)random();
+    }
+    memcpy(reply.data() + 1 + HANDSHAKE_BYTES, c0c1.data() + 1, HANDSHAKE_BYTES);
+    if (!SendAll(c->socket, reply.data(), reply.size())) {
+        c->endReason = "error";
+        return false;
+    }
+
+    std::vector<uint8_t> c2(HANDSHAKE_BYTES);
+    if (!ReadBytes(c, c2.data(), c2.size())) return false;
+
+    Log(c->id, "handshake", "handshake_ms=" + std::to_string(Milliseconds(Clock::now() - c->accepted)));
+    return true;
+}
+
+static bool OnCommand(Connection* c, const uint8_t* data, size_t size) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+
+    AmfValue name;
+    AmfValue transaction;
+    if (!ReadAmf(p, end, name) || !ReadAmf(p, end, transaction)) return true;
+
+    const std::string& command = name.string;
+    std::vector<uint8_t> reply;
+
+    if (command == "connect") {
+        AmfValue properties;
+        ReadAmf(p, end, properties);
+
+        if (!SendControl(c, MSG_WINDOW_ACK_SIZE, WINDOW_ACK_BYTES) ||
+            !SendControl(c, MSG_SET_PEER_BANDWIDTH, WINDOW_ACK_BYTES) ||
+            !SendControl(c, MSG_SET_CHUNK_SIZE, OUT_CHUNK_BYTES)) {
+            return false;
+        }
+        c->outChunkSize = OUT_CHUNK_BYTES;
+
+        AppendAmfString(reply, "_result");
+        AppendAmfNumber(reply, transaction.number);
+        reply.push_back(AMF_OBJECT);
+        AppendAmfKey(reply, "fmsVer");
+        AppendAmfString(reply, "FMS/3,0,1,123");
+        AppendAmfKey(reply, "capabilities");
+        AppendAmfNumber(reply, 31.0);
+        AppendAmfObjectEnd(reply);
+        reply.push_back(AMF_OBJECT);
+        AppendAmfKey(reply, "level");
+        AppendAmfString(reply, "status");
+        AppendAmfKey(reply, "code");
+        AppendAmfString(reply, "NetConnection.Connect.Success");
+        AppendAmfKey(reply, "description");
+        AppendAmfString(reply, "Connection succeeded.");
+        AppendAmfKey(reply, "objectEncoding");
+        AppendAmfNumber(reply, 0.0);
+        AppendAmfObjectEnd(reply);
+
+        Log(c->id, "connect", "app=" + properties.properties["app"]);
+        return SendMessage(c, CSID_COMMAND, MSG_COMMAND, 0, reply);
+    }
+
+    if (command == "createStream") {
+        AppendAmfString(reply, "_result");
+        AppendAmfNumber(reply, transaction.number);
+        reply.push_back(AMF_NULL);
+        AppendAmfNumber(reply, PUBLISH_STREAM_ID);
+        return SendMessage(c, CSID_COMMAND, MSG_COMMAND, 0, reply);
+    }
+
+    if (command == "releaseStream" || command == "FCPublish" || command == "FCUnpublish") {
+        if (transaction.number == 0.0) return true;
+        AppendAmfString(reply, "_result");
+        AppendAmfNumber(reply, transaction.number);
+        reply.push_back(AMF_NULL);
+        return SendMessage(c, CSID_COMMAND, MSG_COMMAND, 0, reply);
+    }
+
+    if (command == "publish") {
+        AmfValue commandObject;
+        AmfValue streamName;
+        ReadAmf(p, end, commandObject);
+        ReadAmf(p, end, streamName);
+
+        if (c->impaired && c->options->publishDelayMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(c->options->publishDelayMs));
+        }
+
+        AppendAmfString(reply, "onStatus");
+        AppendAmfNumber(reply, 0.0);
+        reply.push_back(AMF_NULL);
+        reply.push_back(AMF_OBJECT);
+        AppendAmfKey(reply, "level");
+        AppendAmfString(reply, "status");
+        AppendAmfKey(reply, "code");
+        AppendAmfString(reply, "NetStream.Publish.Start");
+        AppendAmfKey(reply, "description");
+        AppendAmfString(reply, "Start publishing");
+        AppendAmfObjectEnd(reply);
+        if (!SendMessage(c, CSID_STREAM, MSG_COMMAND, PUBLISH_STREAM_ID, reply)) return false;
+
+        Clock::time_point now = Clock::now();
+        c->publishing = true;
+        c->publishStart = now;
+        c->reportStart = now;
+        c->reportBytes = c->receivedBytes;
+        c->reportVideoTags = c->videoTags;
+
+        Log(c->id, "publish",
+            "key=" + streamName.string + " since_accept_ms=" + std::to_string(Milliseconds(now - c->accepted)));
+        return true;
+    }
+
+    if (command == "deleteStream") {
+        Log(c->id, "unpublish");
+        c->publishing = false;
+    }
+
+    return true;
+}
+
+static void OnTag(Connection* c, const ChunkStream& stream) {
+    Clock::time_point now = Clock::now();
+    const std::vector<uint8_t>& data = stream.message;
+
+    const char* kind = "data";
+    bool keyframe = false;
+    bool sequenceHeader = false;
+
+    if (stream.type == MSG_VIDEO) {
+        kind = "video";
+        if (!data.empty()) {
+            keyframe = ((data[0] >> 4) & 0x07) == 1;
+            // Enhanced RTMP carries the packet type in the low nibble
+            sequenceHeader = (data[0] & 0x80) ? (data[0] & 0x0f) == 0 : data.size() > 1 && data[1] == 0;
+        }
+
+        if (!sequenceHeader) {
+            c->videoTags++;
+            if (keyframe) c->keyframes++;
+            c->lastVideoTs = stream.timestamp;
+
+            if (!c->haveVideo) {
+                c->haveVideo = true;
+                c->firstVideoArrival = now;
+                c->firstVideoTs = stream.timestamp;
+                Log(c->id, "first_video",
+                    "since_accept_ms=" + std::to_string(Milliseconds(now - c->accepted)) + " since_publish_ms=" +
+                        std::to_string(Milliseconds(now - c->publishStart)) + " keyframe=" + (keyframe ? "1" : "0"));
+            }
+        }
+    } else if (stream.type == MSG_AUDIO) {
+        kind = "audio";
+        sequenceHeader = data.size() > 1 && (data[0] >> 4) == 10 && data[1] == 0;
+
+        if (!sequenceHeader) {
+            c->audioTags++;
+
+            if (!c->haveAudio) {
+                c->haveAudio = true;
+                Log(c->id, "first_audio",
+                    "since_accept_ms=" + std::to_string(Milliseconds(now - c->accepted)) +
+                        " since_publish_ms=" + std::to_string(Milliseconds(now - c->publishStart)));
+            }
+        }
+    }
+
+    if (c->options->logTags) {
+        char detail[128];
+        snprintf(detail, sizeof(detail), "%s ts=%u bytes=%zu%s%s", kind, stream.timestamp, data.size(),
+                 keyframe ? " key" : "", sequenceHeader ? " header" : "");
+        Log(c->id, "tag", detail);
+    }
+}
+
+static bool OnMessage(Connection* c, const ChunkStream& stream) {
+    const std::vector<uint8_t>& data = stream.message;
+
+    switch (stream.type) {
+    case MSG_SET_CHUNK_SIZE:
+        if (data.size() >= 4) c->inChunkSize = std::max<uint32_t>(1, ReadU32(data.data()) & 0x7fffffff);
+        return true;
+    case MSG_WINDOW_ACK_SIZE:
+        if (data.size() >= 4) c->ackWindow = ReadU32(data.data());
+        return true;
+    case MSG_AUDIO:
+    case MSG_VIDEO:
+    case MSG_DATA: OnTag(c, stream); return true;
+    case MSG_COMMAND: return OnCommand(c, data.data(), data.size());
+    case MSG_AMF3_COMMAND:
+        // An AMF0 body after a format byte
+        return data.empty() || OnCommand(c, data.data() + 1, data.size() - 1);
+    default: return true;
+    }
+}
+
+// Read one chunk, handling the message it completes
+static bool ReadChunk(Connection* c) {
+    uint8_t basic;
+    if (!ReadBytes(c, &basic, 1)) return false;
+
+    uint8_t format = basic >> 6;
+    uint32_t csid = basic & 0x3f;
+    if (csid < 2) {
+        uint8_t extra[2] = {0, 0};
+        if (!ReadBytes(c, extra, csid == 0 ? 1 : 2)) return false;
+        csid = 64 + extra[0] + ((uint32_t)extra[1] << 8);
+    }
+
+    static const size_t headerBytes[] = {11, 7, 3, 0};
+    uint8_t header[11];
+    if (!ReadBytes(c, header, headerBytes[format])) return false;
+
+    ChunkStream& stream = c->chunkStreams[csid];
+    uint32_t timestamp = 0;
+    if (format <= 2) {
+        timestamp = ReadU24(header);
+        stream.extended = timestamp == 0xffffff;
+    }
+    if (format <= 1) {
+        stream.length = ReadU24(header + 3);
+        stream.type = header[6];
+    }
+    if (format == 0) {
+        stream.streamId = (uint32_t)header[7] | (uint32_t)header[8] << 8 | (uint32_t)header[9] << 16 |
+                          (uint32_t)header[10] << 24;
+    }
+
+    // Continuation chunks repeat the extended timestamp
+    if (stream.extended) {
+        uint8_t extended[4];
+        if (!ReadBytes(c, extended, sizeof(extended))) return false;
+        if (format <= 2) timestamp = ReadU32(extended);
+    }
+
+    if (format == 0) {
+        stream.timestamp = timestamp;
+        stream.delta = 0;
+        stream.message.clear();
+    } else if (format <= 2) {
+        stream.delta = timestamp;
+        stream.timestamp += timestamp;
+        stream.message.clear();
+    } else if (stream.message.empty()) {
+        stream.timestamp += stream.delta;
+    }
+
+    if (stream.length > MAX_MESSAGE_BYTES) {
+        c->endReason = "oversized_message";
+        return false;
+    }
+
+    size_t offset = stream.message.size();
+    size_t size = std::min((size_t)c->inChunkSize, stream.length - offset);
+    stream.message.resize(offset + size);
+    if (size && !ReadBytes(c, stream.message.data() + offset, size)) return false;
+
+    if (stream.message.size() < stream.length) return true;
+
+    bool ok = OnMessage(c, stream);
+    stream.message.clear();
+    if (!ok && c->endReason.empty()) c->endReason = "error";
+    return ok;
+}
+
+// ============================================================================
+// Sockets
+// ============================================================================
+
+static bool SplitAddress(const char* text, std::string& host, std::string& port) {
+    const char* colon = strrchr(text, ':');
+    if (!colon) return false;
+    host.assign(text, colon - text);
+    port = colon + 1;
+    return !host.empty() && !port.empty();
+}
+
+static socket_t OpenListener(const std::string& host, const std::string& port) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) return INVALID_SOCKET_VALUE;
+
+    socket_t sock = INVALID_SOCKET_VALUE;
+    for (struct addrinfo* info = result; info; info = info->ai_next) {
+        sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (sock == INVALID_SOCKET_VALUE) continue;
+
+        int one = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+        if (bind(sock, info->ai_addr, (int)info->ai_addrlen) == 0 && listen(sock, 16) == 0) break;
+
+        CloseSocket(sock);
+        sock = INVALID_SOCKET_VALUE;
+    }
+
+    freeaddrinfo(result);
+    return sock;
+}
+
+static std::mutex reconnectMutex;
+static Clock::time_point lastEnd;
+static bool hadEnd = false;
+
+static void RecordEnd() {
+    std::lock_guard<std::mutex> lock(reconnectMutex);
+    lastEnd = Clock::now();
+    hadEnd = true;
+}
+
+static void RunConnection(std::unique_ptr<Connection> connection) {
+    Connection* c = connection.get();
+
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex);
+        std::string detail;
+        if (hadEnd) {
+            detail = "reconnect_after_ms=" + std::to_string(Milliseconds(c->accepted - lastEnd));
+        }
+        Log(c->id, "accept", detail);
+    }
+
+    if (Handshake(c)) {
+        while (ReadChunk(c)) {
+        }
+    }
+
+    if (c->endReason == "frozen") {
+        LogTotals(c, "freeze");
+        RecordEnd();
+
+        // Hold the connection without reading; the publisher has to notice
+        // on its own
+        for (;;) {
+            std::this_thread::sleep_for(std::chrono::hours(1));
+        }
+    }
+
+    shutdown(c->socket, SHUTDOWN_BOTH);
+    CloseSocket(c->socket);
+    LogTotals(c, "close");
+    RecordEnd();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    bool ok = true;
+
+    for (int i = 1; i < argc && ok; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--listen") == 0 && hasValue) {
+            ok = SplitAddress(argv[++i], options.listenHost, options.listenPort);
+        } else if (strcmp(argv[i], "--report-sec") == 0 && hasValue) {
+            options.reportSec = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--tags") == 0) {
+            options.logTags = true;
+        } else if (strcmp(argv[i], "--rate-kbps") == 0 && hasValue) {
+            options.rateKbps = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--publish-delay-ms") == 0 && hasValue) {
+            options.publishDelayMs = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--drop-after-s") == 0 && hasValue) {
+            options.dropAfterSec = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--freeze-after-s") == 0 && hasValue) {
+            options.freezeAfterSec = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--impair-conns") == 0 && hasValue) {
+            options.impairConnections = atoi(argv[++i]);
+        } else {
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        fprintf(stderr,
+                "usage: %s [--listen host:port] [--report-sec n] [--tags] [--rate-kbps n] [--publish-delay-ms n]\n"
+                "       [--drop-after-s n] [--freeze-after-s n] [--impair-conns n]\n",
+                argv[0]);
+        return 2;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#else
+    // A publisher closing mid-send must fail the send, not end the sink
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    socket_t listener = OpenListener(options.listenHost, options.listenPort);
+    if (listener == INVALID_SOCKET_VALUE) {
+        fprintf(stderr, "cannot listen on %s:%s\n", options.listenHost.c_str(), options.listenPort.c_str());
+        return 1;
+    }
+
+    sinkStart = Clock::now();
+    printf("time_s,connection,event,detail\n");
+    Log(0, "listen", options.listenHost + ":" + options.listenPort);
+
+    int nextId = 1;
+    for (;;) {
+        socket_t client = accept(listener, nullptr, nullptr);
+        if (client == INVALID_SOCKET_VALUE) continue;
+
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+
+        std::unique_ptr<Connection> connection(new Connection());
+        connection->id = nextId++;
+        connection->options = &options;
+        connection->socket = client;
+        connection->impaired = options.impairConnections <= 0 || connection->id <= options.impairConnections;
+        connection->accepted = Clock::now();
+        connection->lastRefill = connection->accepted;
+
+        std::thread(RunConnection, std::move(connection)).detach();
+    }
+}
@@ -0,0 +1,402 @@
+// Start/stop soak harness for the plugin core, running in a headless libobs.
+//
+//   multistream-soak --sink rtmp://127.0.0.1:1935/live [--cycles 2000]
+//                    [--destinations 4] [--hold-ms 500] [--reconfigure-every 5]
+//                    [--warmup 3] [--rss-slack-mb 8] [--standby] [--csv]
+//   multistream-soak --sink rtmp://127.0.0.1:1935/live --cpu-sec 60
+//                    [--destinations 32] [--offload [--relay path]]
+//
+// Each cycle starts every destination against a local RTMP sink
+// (multistream-rtmp-sink), optionally stops half of them, changes their
+// settings and starts them again while live, then stops the session. Destinations mix
+// shared encoders, custom encoders, and audio-only with either. After each
+// stop the harness counts live libobs outputs, encoders and services and
+// reads the process RSS and thread count.
+//
+// With --standby the destinations use warm standby, so their outputs and
+// encoders are created at initialization and kept between cycles.
+//
+// Any object count above the post-warmup baseline fails the run at once.
+// Threads must be back at the baseline and RSS within --rss-slack-mb of it
+// at the end, since the allocator keeps some freed memory. Finally the
+// plugin is torn down and must leave no libobs objects behind.
+//
+// With --cpu-sec the harness measures instead: every destination publishes
+// the shared encoders, in process or, with --offload, through the
+// multistream-relay process. After a settling period it reports this
+// process's CPU usage over that many seconds as CSV, for comparing the two
+// modes at different destination counts. The relay's and ffmpeg's own CPU
+// is not included.
+//
+// On Linux, run it with a display for the OpenGL renderer (xvfb-run works).
+
+#include "obs-multistream.h"
+#include "multistream-output.h"
+#include "packet-tap.h"
+#include "audio-relay-output.h"
+#include "delay-relay-output.h"
+#include "output-monitor.h"
+#include "multistream-log.h"
+#include "headless-obs.h"
+#include <obs.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#endif
+
+// The core resolves its config path through the current module
+OBS_DECLARE_MODULE()
+
+#define MONITOR_INTERVAL_MS 1000
+
+// Time for every destination to connect before CPU is measured
+#define CPU_SETTLE_MS 10000
+
+struct Sample {
+    size_t outputs = 0;
+    size_t encoders = 0;
+    size_t services = 0;
+    uint64_t rssKB = 0;
+    int threads = 0;
+};
+
+// ============================================================================
+// Measurements
+// ============================================================================
+
+static bool CountOutput(void* param, obs_output_t*) {
+    (*static_cast<size_t*>(param))++;
+    return true;
+}
+
+static bool CountEncoder(void* param, obs_encoder_t*) {
+    (*static_cast<size_t*>(param))++;
+    return true;
+}
+
+static bool CountService(void* param, obs_service_t*) {
+    (*static_cast<size_t*>(param))++;
+    return true;
+}
+
+static void ReadProcessStats(Sample& sample) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        sample.rssKB = counters.WorkingSetSize / 1024;
+    }
+
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot != INVALID_HANDLE_VALUE) {
+        THREADENTRY32 entry;
+        entry.dwSize = sizeof(entry);
+        DWORD pid = GetCurrentProcessId();
+        for (BOOL more = Thread32First(snapshot, &entry); more; more = Thread32Next(snapshot, &entry)) {
+            if (entry.th32OwnerProcessID == pid) sample.threads++;
+        }
+        CloseHandle(snapshot);
+    }
+#else
+    FILE* status = fopen("/proc/self/status", "r");
+    if (!status) return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), status)) {
+        unsigned long long value;
+        if (sscanf(line, "VmRSS: %llu", &value) == 1) sample.rssKB = value;
+        if (sscanf(line, "Threads: %llu", &value) == 1) sample.threads = (int)value;
+    }
+    fclose(status);
+#endif
+}
+
+static Sample TakeSample() {
+    Sample sample;
+    obs_enum_outputs(CountOutput, &sample.outputs);
+    obs_enum_encoders(CountEncoder, &sample.encoders);
+    obs_enum_services(CountService, &sample.services);
+    ReadProcessStats(sample);
+    return sample;
+}
+
+// ============================================================================
+// Scenario
+// ============================================================================
+
+// uniform puts every destination on the shared encoders with video
+static bool WriteConfig(const std::string& directory, const std::string& sink, int destinationCount, bool uniform,
+                        bool offload, const std::string& relayPath, bool standby) {
+    obs_data_t* data = obs_data_create();
+    obs_data_array_t* destArray = obs_data_array_create();
+
+    // Otherwise cycle through every encoder arrangement an output can have
+    for (int i = 0; i < destinationCount; i++) {
+        obs_data_t* destData = obs_data_create();
+        std::string name = "soak-" + std::to_string(i);
+        obs_data_set_string(destData, "id", name.c_str());
+        obs_data_set_string(destData, "name", name.c_str());
+        obs_data_set_string(destData, "url", sink.c_str());
+        obs_data_set_string(destData, "key", name.c_str());
+        obs_data_set_bool(destData, "enabled", true);
+        obs_data_set_bool(destData, "useMainEncoder", uniform || i % 2 == 0);
+        obs_data_set_bool(destData, "audioOnly", !uniform && i % 4 >= 2);
+        obs_data_set_int(destData, "bitrate", !uniform && i % 4 >= 2 ? 128 : 1500);
+        obs_data_array_push_back(destArray, destData);
+        obs_data_release(destData);
+    }
+
+    obs_data_set_array(data, "destinations", destArray);
+    obs_data_array_release(destArray);
+
+    // Shared destinations need the plugin-owned encoders without a main
+    // stream; short stop windows keep cycles quick
+    obs_data_set_bool(data, "multistreamOnly", true);
+    obs_data_set_int(data, "stopFlushWindowMs", 500);
+    obs_data_set_int(data, "stopDeadlineMs", 1000);
+    obs_data_set_bool(data, "relayOffload", offload);
+    obs_data_set_string(data, "relayPath", relayPath.c_str());
+    obs_data_set_bool(data, "warmStandby", standby);
+
+    std::string path = directory + "/obs-multistream.json";
+    bool saved = obs_data_save_json_safe(data, path.c_str(), "tmp", "bak");
+    obs_data_release(data);
+    return saved;
+}
+
+// Stop every other destination, change its bitrate, profile and, for custom
+// encoding, audio-only mode, and start it again
+static void Reconfigure(MultistreamPlugin* plugin, int cycle) {
+    static const char* profiles[] = {"balanced", "quality", "latency"};
+
+    std::vector<std::string> ids;
+    std::vector<StreamDestination> updates;
+    const auto& destinations = plugin->GetDestinations();
+    for (size_t i = destinations.size() > 1 ? 1 : 0; i < destinations.size(); i += 2) {
+        StreamDestination dest = destinations[i];
+        dest.encoderProfile = profiles[cycle % 3];
+        dest.bitrate = dest.audioOnly ? 96 + 32 * (cycle % 3) : 1000 + 500 * (cycle % 3);
+        if (!dest.useMainEncoder && cycle % 2) {
+            dest.audioOnly = !dest.audioOnly;
+            dest.bitrate = dest.audioOnly ? 128 : 1500;
+        }
+        ids.push_back(dest.id);
+        updates.push_back(dest);
+    }
+
+    plugin->StopDestinations(ids);
+    plugin->UpdateDestinations(updates);
+    plugin->StartDestinations(ids);
+}
+
+static bool Grew(const char* what, size_t value, size_t baseline, int cycle) {
+    if (value <= baseline) return false;
+    fprintf(stderr, "FAIL cycle %d: %zu live %s, baseline %zu\n", cycle, value, what, baseline);
+    return true;
+}
+
+// Publish for a while and report this process's CPU usage; fails unless
+// every destination was streaming
+static int MeasureCpu(MultistreamPlugin* plugin, int destinationCount, bool offload, int seconds) {
+    plugin->StartStreaming();
+    PumpUi(CPU_SETTLE_MS);
+
+    os_cpu_usage_info_t* cpu = os_cpu_usage_info_start();
+    PumpUi((uint64_t)seconds * 1000);
+    double cpuPercent = os_cpu_usage_info_query(cpu);
+    os_cpu_usage_info_destroy(cpu);
+
+    size_t streaming = 0;
+    double kbps = 0.0;
+    for (const OutputStats& stats : plugin->GetOutputStats()) {
+        if (stats.status == "Streaming") streaming++;
+        kbps += stats.throughputKbps;
+    }
+
+    plugin->StopStreaming();
+    PumpUi(100);
+
+    printf("destinations,offload,streaming,cpu_percent,total_kbps\n");
+    printf("%d,%d,%zu,%.2f,%.0f\n", destinationCount, offload ? 1 : 0, streaming, cpuPercent, kbps);
+    fflush(stdout);
+
+    if (streaming < (size_t)destinationCount) {
+        fprintf(stderr, "FAIL: only %zu of %d destinations were streaming\n", streaming, destinationCount);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string sink;
+    std::string configDir = "multistream-soak";
+    int cycles = 2000;
+    int destinationCount = 4;
+    int holdMs = 500;
+    int reconfigureEvery = 5;
+    int warmup = 3;
+    int rssSlackMB = 8;
+    int cpuSec = 0;
+    bool offload = false;
+    std::string relayPath;
+    bool standby = false;
+    bool csv = false;
+    bool ok = true;
+
+    for (int i = 1; i < argc && ok; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--sink") == 0 && hasValue) {
+            sink = argv[++i];
+        } else if (strcmp(argv[i], "--config-dir") == 0 && hasValue) {
+            configDir = argv[++i];
+        } else if (strcmp(argv[i], "--cycles") == 0 && hasValue) {
+            cycles = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--destinations") == 0 && hasValue) {
+            destinationCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hold-ms") == 0 && hasValue) {
+            holdMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--reconfigure-every") == 0 && hasValue) {
+            reconfigureEvery = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rss-slack-mb") == 0 && hasValue) {
+            rssSlackMB = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cpu-sec") == 0 && hasValue) {
+            cpuSec = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--offload") == 0) {
+            offload = true;
+        } else if (strcmp(argv[i], "--relay") == 0 && hasValue) {
+            relayPath = argv[++i];
+        } else if (strcmp(argv[i], "--standby") == 0) {
+            standby = true;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else {
+            ok = false;
+        }
+    }
+
+    if (!ok || sink.empty() || cycles <= warmup || warmup < 1 || destinationCount < 1 || cpuSec < 0) {
+        fprintf(stderr,
+                "usage: %s --sink rtmp://host/app [--cycles n] [--destinations n] [--hold-ms n]\n"
+                "       [--reconfigure-every n] [--warmup n] [--rss-slack-mb n] [--config-dir dir] [--standby]\n"
+                "       [--csv]\n"
+                "       %s --sink rtmp://host/app --cpu-sec n [--destinations n] [--offload [--relay path]]\n",
+                argv[0], argv[0]);
+        return 2;
+    }
+
+    if (!InitObs()) return 1;
+
+    os_mkdirs(configDir.c_str());
+    if (!WriteConfig(configDir, sink, destinationCount, cpuSec > 0, offload, relayPath, standby)) {
+        fprintf(stderr, "cannot write settings to %s\n", configDir.c_str());
+        return 1;
+    }
+
+    // What obs_module_load does, minus the dock
+    MultistreamLog::Start();
+    if (!OutputMonitor::Start(MONITOR_INTERVAL_MS)) return 1;
+    PacketTap::RegisterOutputType();
+    AudioRelayOutput::RegisterOutputType();
+    DelayRelayOutput::RegisterOutputType();
+
+    MultistreamPlugin::SetConfigDirectory(configDir);
+    MultistreamPlugin* plugin = MultistreamPlugin::GetInstance();
+    plugin->Initialize();
+
+    if (cpuSec > 0) {
+        int result = MeasureCpu(plugin, destinationCount, offload, cpuSec);
+        plugin->Cleanup();
+        OutputMonitor::Stop();
+        MultistreamLog::Stop();
+        obs_shutdown();
+        return result;
+    }
+
+    if (csv) {
+        printf("cycle,outputs_live,outputs,encoders,services,rss_kb,threads\n");
+    }
+
+    Sample baseline;
+    bool failed = false;
+    size_t maxLive = 0;
+
+    for (int cycle = 1; cycle <= cycles && !failed; cycle++) {
+        plugin->StartStreaming();
+        PumpUi(holdMs);
+        size_t live = plugin->GetOutputStats().size();
+        maxLive = std::max(maxLive, live);
+
+        if (reconfigureEvery > 0 && cycle % reconfigureEvery == 0) {
+            Reconfigure(plugin, cycle / reconfigureEvery);
+            PumpUi(holdMs);
+        }
+
+        plugin->StopStreaming();
+        PumpUi(100);
+
+        Sample sample = TakeSample();
+        if (csv) {
+            printf("%d,%zu,%zu,%zu,%zu,%llu,%d\n", cycle, live, sample.outputs, sample.encoders, sample.services,
+                   (unsigned long long)sample.rssKB, sample.threads);
+            fflush(stdout);
+        } else if (cycle % 100 == 0) {
+            fprintf(stderr, "cycle %d: %zu outputs, %zu encoders, %zu services, %llu KB RSS, %d threads\n", cycle,
+                    sample.outputs, sample.encoders, sample.services, (unsigned long long)sample.rssKB,
+                    sample.threads);
+        }
+
+        if (cycle == warmup) {
+            baseline = sample;
+        } else if (cycle > warmup) {
+            failed = Grew("outputs", sample.outputs, baseline.outputs, cycle) ||
+                     Grew("encoders", sample.encoders, baseline.encoders, cycle) ||
+                     Grew("services", sample.services, baseline.services, cycle);
+        }
+    }
+
+    if (maxLive == 0) {
+        fprintf(stderr, "FAIL: no output ever started\n");
+        failed = true;
+    }
+
+    // Threads wind down asynchronously after a stop
+    PumpUi(2000);
+    Sample end = TakeSample();
+    if (!failed && end.threads > baseline.threads) {
+        fprintf(stderr, "FAIL: %d threads at the end, baseline %d\n", end.threads, baseline.threads);
+        failed = true;
+    }
+    if (!failed && end.rssKB > baseline.rssKB + (uint64_t)rssSlackMB * 1024) {
+        fprintf(stderr, "FAIL: RSS grew from %llu KB to %llu KB\n", (unsigned long long)baseline.rssKB,
+                (unsigned long long)end.rssKB);
+        failed = true;
+    }
+
+    // Teardown must release everything the plugin ever created
+    plugin->Cleanup();
+    OutputMonitor::Stop();
+    MultistreamLog::Stop();
+
+    Sample teardown = TakeSample();
+    if (teardown.outputs || teardown.encoders || teardown.services) {
+        fprintf(stderr, "FAIL: %zu outputs, %zu encoders, %zu services left after cleanup\n", teardown.outputs,
+                teardown.encoders, teardown.services);
+        failed = true;
+    }
+
+    fprintf(stderr, "%s: %d cycles, RSS %llu -> %llu KB, threads %d -> %d\n", failed ? "FAILED" : "PASSED", cycles,
+            (unsigned long long)baseline.rssKB, (unsigned long long)end.rssKB, baseline.threads, end.threads);
+
+    obs_shutdown();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+// Convert an obs-multistream telemetry session file to CSV or JSON.
+//
+//   multistream-telemetry-dump [--json] <session.bin> [output]
+//
+// Records are written in the order they were appended, with times relative
+// to the session start and as Unix milliseconds. Records cut short by a
+// crash are skipped.
+
+#include "telemetry-format.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char* StateName(uint8_t state) {
+    switch (state) {
+    case TELEMETRY_STATE_STOPPED: return "stopped";
+    case TELEMETRY_STATE_CONNECTING: return "connecting";
+    case TELEMETRY_STATE_STREAMING: return "streaming";
+    case TELEMETRY_STATE_RECONNECTING: return "reconnecting";
+    default: return "unknown";
+    }
+}
+
+static const char* EventName(uint8_t event) {
+    switch (event) {
+    case TELEMETRY_EVENT_NONE: return "";
+    case TELEMETRY_EVENT_START: return "start";
+    case TELEMETRY_EVENT_PUBLISHING: return "publishing";
+    case TELEMETRY_EVENT_STOPPED: return "stopped";
+    case TELEMETRY_EVENT_RECONNECTING: return "reconnecting";
+    case TELEMETRY_EVENT_RECONNECTED: return "reconnected";
+    case TELEMETRY_EVENT_FAILOVER: return "failover";
+    case TELEMETRY_EVENT_SESSION_START: return "session_start";
+    case TELEMETRY_EVENT_SESSION_STOP: return "session_stop";
+    case TELEMETRY_EVENT_STALL: return "stall";
+    default: return "unknown";
+    }
+}
+
+// Minimal JSON string escaping for ids and names
+static std::string Quote(const char* text, size_t maxLength) {
+    std::string out = "\"";
+    for (size_t i = 0; i < maxLength && text[i]; i++) {
+        char c = text[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string CsvField(const char* text, size_t maxLength) {
+    std::string value(text, strnlen(text, maxLength));
+    if (value.find_first_of(",\"\n") == std::string::npos) return value;
+
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+int main(int argc, char** argv) {
+    bool json = false;
+    std::vector<const char*> paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.empty() || paths.size() > 2) {
+        fprintf(stderr, "usage: %s [--json] <session.bin> [output]\n", argv[0]);
+        return 2;
+    }
+
+    FILE* in = fopen(paths[0], "rb");
+    if (!in) {
+        fprintf(stderr, "cannot open %s\n", paths[0]);
+        return 1;
+    }
+
+    TelemetryHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, TELEMETRY_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s is not a telemetry session file\n", paths[0]);
+        fclose(in);
+        return 1;
+    }
+
+    if (header.version != TELEMETRY_VERSION || header.recordSize != sizeof(TelemetryRecord) ||
+        header.headerSize != sizeof(TelemetryHeader)) {
+        fprintf(stderr, "unsupported telemetry file version %u\n", header.version);
+        fclose(in);
+        return 1;
+    }
+
+    // Keep complete records that sit where their sequence says they should
+    std::vector<TelemetryRecord> records;
+    records.reserve((size_t)std::min<uint64_t>(header.capacity, header.recordCount + 1));
+
+    TelemetryRecord record;
+    for (uint64_t i = 0; i < header.capacity && fread(&record, sizeof(record), 1, in) == 1; i++) {
+        if (record.sequence == 0 || (record.sequence - 1) % header.capacity != i) continue;
+        records.push_back(record);
+    }
+    fclose(in);
+
+    std::sort(records.begin(), records.end(),
+              [](const TelemetryRecord& a, const TelemetryRecord& b) { return a.sequence < b.sequence; });
+
+    FILE* out = paths.size() > 1 ? fopen(paths[1], "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "cannot write %s\n", paths[1]);
+        return 1;
+    }
+
+    uint32_t slotCount = std::min<uint32_t>(header.slotCount, TELEMETRY_MAX_SLOTS);
+    static const TelemetrySlot sessionSlot = {"", "(session)"};
+
+    if (json) {
+        fprintf(out, "{\n  \"startUnixMs\": %lld,\n  \"destinations\": [", (long long)header.startUnixMs);
+        for (uint32_t i = 0; i < slotCount; i++) {
+            fprintf(out, "%s\n    {\"id\": %s, \"name\": %s}", i ? "," : "",
+                    Quote(header.slots[i].id, sizeof(header.slots[i].id)).c_str(),
+                    Quote(header.slots[i].name, sizeof(header.slots[i].name)).c_str());
+        }
+        fprintf(out, "\n  ],\n  \"records\": [");
+    } else {
+        fprintf(out, "time_ms,unix_ms,id,name,type,state,event,code,total_bytes,bitrate_kbps,dropped_frames,"
+                     "total_frames,congestion\n");
+    }
+
+    for (size_t i = 0; i < records.size(); i++) {
+        const TelemetryRecord& r = records[i];
+        const TelemetrySlot& slot = r.slot < slotCount ? header.slots[r.slot] : sessionSlot;
+
+        double timeMs = r.timestampNs >= header.startNs ? (double)(r.timestampNs - header.startNs) / 1e6 : 0.0;
+        long long unixMs = (long long)header.startUnixMs + (long long)timeMs;
+        bool sample = r.type == TELEMETRY_RECORD_SAMPLE;
+
+        if (json) {
+            fprintf(out,
+                    "%s\n    {\"timeMs\": %.3f, \"unixMs\": %lld, \"id\": %s, \"type\": \"%s\", \"state\": \"%s\", "
+                    "\"event\": \"%s\", \"code\": %d, \"totalBytes\": %llu, \"bitrateKbps\": %u, "
+                    "\"droppedFrames\": %u, \"totalFrames\": %u, \"congestion\": %.3f}",
+                    i ? "," : "", timeMs, unixMs, Quote(slot.id, sizeof(slot.id)).c_str(),
+                    sample ? "sample" : "event", sample ? StateName(r.state) : "", EventName(r.event), r.code,
+                    (unsigned long long)r.totalBytes, r.bitrateKbps, r.droppedFrames, r.totalFrames, r.congestion);
+        } else {
+            fprintf(out, "%.3f,%lld,%s,%s,%s,%s,%s,%d,%llu,%u,%u,%u,%.3f\n", timeMs, unixMs,
+                    CsvField(slot.id, sizeof(slot.id)).c_str(), CsvField(slot.name, sizeof(slot.name)).c_str(),
+                    sample ? "sample" : "event", sample ? StateName(r.state) : "", EventName(r.event), r.code,
+                    (unsigned long long)r.totalBytes, r.bitrateKbps, r.droppedFrames, r.totalFrames, r.congestion);
+        }
+    }
+
+    if (json) {
+        fprintf(out, "\n  ]\n}\n");
+    }
+
+    if (out != stdout) fclose(out);
+    return 0;
+}